@@ -94,6 +94,19 @@ static TensorMetadata UnaryIdentityMd(const TensorMetadata& input) {
   return input;
 }
 
+// Output of the fused element-wise chain has the shape of the chain input.
+// Shapes of the fusion inputs are validated by the op implementation.
+static Expected<TensorMetadata> FusedCwiseMd(
+    const TensorMetadata& input, VariadicOpArg<TensorMetadata> fusion_inputs) {
+  for (int i = 0; i < fusion_inputs.size(); ++i) {
+    if (fusion_inputs[i].dtype != input.dtype)
+      return MakeStringError("incompatible dtypes for _FusedCwise: input: ",
+                             input.dtype, ", fusion input: ",
+                             fusion_inputs[i].dtype);
+  }
+  return input;
+}
+
 static Expected<TensorMetadata> MatMulMd(const TensorMetadata& a,
                                          const TensorMetadata& b,
                                          VariadicOpArg<TensorMetadata> _,
@@ -495,6 +508,7 @@ GetAllTFMetadataFunctions() {
     result->emplace_back("tf.MatMul", TFRT_METADATA(MatMulMd));
     result->emplace_back("tf._FusedMatMul", TFRT_METADATA(MatMulMd));
     result->emplace_back("tf._JitFusedMatMul", TFRT_METADATA(MatMulMd));
+    result->emplace_back("tf._FusedCwise", TFRT_METADATA(FusedCwiseMd));
     result->emplace_back("tf.Less", TFRT_METADATA(TfBinaryComparisonOpMd));
     result->emplace_back("tf.Log", TFRT_METADATA(UnaryIdentityMd));
     result->emplace_back("tf.Log1p", TFRT_METADATA(UnaryIdentityMd));
@@ -0,0 +1,234 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- cpurt_compilation_cache_test.cc --------------------------*- C++ -*-===//
+//
+// Tests and benchmarks for the asynchronous cpurt kernels compilation.
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "tfrt/cpu/jit/cpurt.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/location.h"
+#include "tfrt/support/error_util.h"
+#include "tfrt/support/latch.h"
+#include "tfrt/support/mutex.h"
+
+namespace tfrt {
+namespace cpu {
+namespace jit {
+namespace {
+
+static const char* kernel_module = R"(
+  func @main(%input: memref<?xf32>, %output: memref<?xf32>) {
+    linalg.generic { indexing_maps = [affine_map<(d0) -> (d0)>,
+                                      affine_map<(d0) -> (d0)>],
+                     iterator_types = ["parallel"] }
+    ins(%input: memref<?xf32>) outs(%output : memref<?xf32>) {
+      ^bb0(%in: f32, %out: f32):
+        %0 = addf %in, %in : f32
+        linalg.yield %0 : f32
+    }
+    return
+  })";
+
+std::unique_ptr<HostContext> CreateTestHostContext(int num_threads) {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedWorkQueue(num_threads, num_threads));
+}
+
+ExecutionContext CreateExecutionContext(HostContext* host) {
+  Expected<RCReference<RequestContext>> req_ctx =
+      RequestContextBuilder(host, /*resource_context=*/nullptr).build();
+  assert(req_ctx && "failed to build request context");
+  return ExecutionContext(std::move(*req_ctx));
+}
+
+Expected<CompilationResult> Compile() {
+  return CompileKernelMlirModule(kernel_module, "main", CompilationOptions());
+}
+
+TEST(CpurtCompilationCacheTest, DeduplicateConcurrentCompilations) {
+  auto host = CreateTestHostContext(4);
+  ExecutionContext exec_ctx = CreateExecutionContext(host.get());
+  CompilationResultCache cache(host.get());
+
+  std::atomic<int> num_compilations{0};
+  auto compile = [&]() -> Expected<CompilationResult> {
+    ++num_compilations;
+    return Compile();
+  };
+
+  // Request the same kernel concurrently from all worker threads.
+  constexpr int kNumRequests = 16;
+  std::vector<AsyncValueRef<CompilationResult>> results(kNumRequests);
+  latch requested(kNumRequests);
+  for (int i = 0; i < kNumRequests; ++i) {
+    EnqueueWork(exec_ctx, [&, i] {
+      results[i] = cache.FindOrCompile(/*key=*/0, exec_ctx, compile);
+      requested.count_down();
+    });
+  }
+  requested.wait();
+  host->Quiesce();
+
+  EXPECT_EQ(num_compilations, 1);
+  for (auto& result : results) {
+    ASSERT_TRUE(result.IsConcrete());
+    EXPECT_EQ(result.GetAsyncValue(), results[0].GetAsyncValue());
+  }
+}
+
+TEST(CpurtCompilationCacheTest, RetryFailedCompilation) {
+  auto host = CreateTestHostContext(1);
+  ExecutionContext exec_ctx = CreateExecutionContext(host.get());
+  CompilationResultCache cache(host.get());
+
+  auto failed = cache.FindOrCompile(/*key=*/0, exec_ctx, [] {
+    return Expected<CompilationResult>(MakeStringError("compilation failed"));
+  });
+  host->Quiesce();
+  EXPECT_TRUE(failed.IsError());
+
+  auto compiled = cache.FindOrCompile(/*key=*/0, exec_ctx, Compile);
+  host->Quiesce();
+  EXPECT_TRUE(compiled.IsConcrete());
+  EXPECT_EQ(cache.Find(0).GetAsyncValue(), compiled.GetAsyncValue());
+}
+
+class TestLocationHandler : public LocationHandler {
+ public:
+  DecodedLocation DecodeLocation(Location loc) const override {
+    DecodedLocation decoded;
+    decoded.filename = "kernel.mlir";
+    decoded.line = loc.data;
+    decoded.column = 1;
+    return decoded;
+  }
+};
+
+TEST(CpurtCompilationCacheTest, EmitCompilationErrorDiagnostic) {
+  mutex mu;
+  std::vector<DecodedDiagnostic> diagnostics;
+  HostContext host(
+      [&](const DecodedDiagnostic& diag) {
+        mutex_lock lock(mu);
+        diagnostics.push_back(diag);
+      },
+      CreateMallocAllocator(), CreateMultiThreadedWorkQueue(1, 1));
+
+  TestLocationHandler location_handler;
+  ExecutionContext exec_ctx = CreateExecutionContext(&host);
+  exec_ctx.set_location(Location(&location_handler, /*data=*/42));
+
+  CompilationResultCache cache(&host);
+  auto failed = cache.FindOrCompile(/*key=*/0, exec_ctx, [] {
+    return CompileKernelMlirModule("invalid module", "main",
+                                   CompilationOptions());
+  });
+  host.Quiesce();
+  ASSERT_TRUE(failed.IsError());
+
+  // The compilation error is reported once, at the location of the kernel.
+  mutex_lock lock(mu);
+  ASSERT_EQ(diagnostics.size(), 1);
+  ASSERT_TRUE(diagnostics[0].location.hasValue());
+  EXPECT_EQ(diagnostics[0].location->filename, "kernel.mlir");
+  EXPECT_EQ(diagnostics[0].location->line, 42);
+  EXPECT_EQ(diagnostics[0].message, failed.GetError().message);
+}
+
+// -------------------------------------------------------------------------- //
+// Latency of the non-blocking work while kernels are compiled.
+// -------------------------------------------------------------------------- //
+
+// Requests `num_kernels` different kernels at the same time (e.g. first
+// requests after the model is loaded), and measures the latency of the first
+// request that depends on the compiled kernel, and the latency of the
+// unrelated non-blocking work scheduled right after it.
+static void CompileUnderLoad(benchmark::State& state, bool async) {
+  const int num_kernels = state.range(0);
+  auto host = CreateTestHostContext(4);
+  ExecutionContext exec_ctx = CreateExecutionContext(host.get());
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration first_request, other_work;
+
+  for (auto _ : state) {
+    CompilationResultCache cache(host.get());
+
+    auto start = Clock::now();
+    std::vector<AsyncValueRef<CompilationResult>> compiled;
+
+    for (int i = 0; i < num_kernels; ++i) {
+      if (async) {
+        compiled.push_back(cache.FindOrCompile(i, exec_ctx, Compile));
+      } else {
+        // Compile on the non-blocking work queue, as cpurt.compile used to.
+        compiled.push_back(EnqueueWork(exec_ctx, [] { return Compile(); }));
+      }
+    }
+
+    latch other_work_done(1);
+    EnqueueWork(exec_ctx, [&] {
+      other_work = Clock::now() - start;
+      other_work_done.count_down();
+    });
+
+    latch first_request_done(1);
+    compiled[0].AndThen([&] {
+      first_request = Clock::now() - start;
+      first_request_done.count_down();
+    });
+
+    other_work_done.wait();
+    first_request_done.wait();
+    host->Quiesce();
+  }
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  state.counters["first_request_us"] =
+      duration_cast<microseconds>(first_request).count();
+  state.counters["other_work_us"] =
+      duration_cast<microseconds>(other_work).count();
+}
+
+static void BM_CompileSync(benchmark::State& state) {
+  CompileUnderLoad(state, /*async=*/false);
+}
+BENCHMARK(BM_CompileSync)->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+static void BM_CompileAsync(benchmark::State& state) {
+  CompileUnderLoad(state, /*async=*/true);
+}
+BENCHMARK(BM_CompileAsync)->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+}  // namespace
+}  // namespace jit
+}  // namespace cpu
+}  // namespace tfrt
@@ -0,0 +1,206 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- cpurt_object_cache_test.cc -------------------------------*- C++ -*-===//
+//
+// Tests and cold vs. warm startup benchmarks for the cpurt object cache.
+//
+//===----------------------------------------------------------------------===//
+
+#include <memory>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/cpu/jit/cpurt.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace cpu {
+namespace jit {
+namespace {
+
+static const char* kernel_module = R"(
+  func @main(%input: memref<?xf32>, %output: memref<?xf32>) {
+    linalg.generic { indexing_maps = [affine_map<(d0) -> (d0)>,
+                                      affine_map<(d0) -> (d0)>],
+                     iterator_types = ["parallel"] }
+    ins(%input: memref<?xf32>) outs(%output : memref<?xf32>) {
+      ^bb0(%in: f32, %out: f32):
+        %0 = addf %in, %in : f32
+        linalg.yield %0 : f32
+    }
+    return
+  })";
+
+std::unique_ptr<HostContext> CreateTestHostContext() {
+  return std::make_unique<HostContext>([](const DecodedDiagnostic&) {},
+                                       CreateMallocAllocator(),
+                                       CreateSingleThreadedWorkQueue());
+}
+
+std::string CreateCacheDir() {
+  llvm::SmallString<128> path;
+  EXPECT_FALSE(llvm::sys::fs::createUniqueDirectory("cpurt_object_cache", path));
+  return path.str().str();
+}
+
+int NumCacheFiles(const std::string& dir) {
+  int num_files = 0;
+  std::error_code ec;
+  for (llvm::sys::fs::directory_iterator it(dir, ec), end; it != end && !ec;
+       it.increment(ec))
+    ++num_files;
+  return num_files;
+}
+
+Expected<CompilationResult> Compile(const std::string& cache_dir,
+                                    int alignment = 0) {
+  CompilationOptions opts;
+  opts.alignment = alignment;
+  opts.object_cache_dir = cache_dir;
+  return CompileKernelMlirModule(kernel_module, "main", opts);
+}
+
+// Runs the compiled kernel and checks that it doubles the input.
+void VerifyExecute(const CompilationResult& compiled) {
+  auto host = CreateTestHostContext();
+  Expected<RCReference<RequestContext>> req_ctx =
+      RequestContextBuilder(host.get(), /*resource_context=*/nullptr).build();
+  ASSERT_FALSE(!req_ctx);
+  ExecutionContext exec_ctx(std::move(*req_ctx));
+
+  float input[4] = {1.0, 2.0, 3.0, 4.0};
+  float output[4] = {0.0, 0.0, 0.0, 0.0};
+
+  SmallVector<MemrefDesc, 2> operands(2);
+  operands[0] = {input, 0, {4}, {1}};
+  operands[1] = {output, 0, {4}, {1}};
+
+  CompilationResult::CallFrame call_frame;
+  ASSERT_FALSE(compiled.InitializeCallFrame(operands, &call_frame));
+  compiled.Execute(exec_ctx, &call_frame);
+
+  for (int i = 0; i < 4; ++i) EXPECT_EQ(output[i], 2 * input[i]);
+}
+
+TEST(CpurtObjectCacheTest, StoreAndLoad) {
+  std::string cache_dir = CreateCacheDir();
+
+  // First compilation stores the object code and metadata to the cache.
+  auto compiled = Compile(cache_dir);
+  ASSERT_FALSE(!compiled);
+  EXPECT_EQ(NumCacheFiles(cache_dir), 2);
+  VerifyExecute(*compiled);
+
+  // Second compilation loads the kernel from the cache.
+  auto loaded = Compile(cache_dir);
+  ASSERT_FALSE(!loaded);
+  EXPECT_EQ(NumCacheFiles(cache_dir), 2);
+  EXPECT_EQ(loaded->signature().getNumInputs(), 2);
+  EXPECT_FALSE(loaded->IsAsync());
+  VerifyExecute(*loaded);
+
+  // Different compilation options use a different cache entry.
+  auto aligned = Compile(cache_dir, /*alignment=*/64);
+  ASSERT_FALSE(!aligned);
+  EXPECT_EQ(NumCacheFiles(cache_dir), 4);
+  VerifyExecute(*aligned);
+
+  llvm::sys::fs::remove_directories(cache_dir);
+}
+
+TEST(CpurtObjectCacheTest, IgnoreInvalidEntry) {
+  std::string cache_dir = CreateCacheDir();
+
+  auto compiled = Compile(cache_dir);
+  ASSERT_FALSE(!compiled);
+
+  // Corrupt the cached metadata.
+  std::error_code ec;
+  for (llvm::sys::fs::directory_iterator it(cache_dir, ec), end;
+       it != end && !ec; it.increment(ec)) {
+    if (llvm::sys::path::extension(it->path()) != ".meta") continue;
+    llvm::raw_fd_ostream os(it->path(), ec);
+    os << "main\nnot a function type\n";
+  }
+
+  // Kernel must be recompiled, and the cache entry overwritten.
+  auto recompiled = Compile(cache_dir);
+  ASSERT_FALSE(!recompiled);
+  VerifyExecute(*recompiled);
+
+  auto loaded = Compile(cache_dir);
+  ASSERT_FALSE(!loaded);
+  VerifyExecute(*loaded);
+
+  llvm::sys::fs::remove_directories(cache_dir);
+}
+
+// -------------------------------------------------------------------------- //
+// Benchmarks for the kernel "startup" latency.
+// -------------------------------------------------------------------------- //
+
+static void BM_CompileNoCache(benchmark::State& state) {
+  for (auto _ : state) {
+    auto compiled = Compile(/*cache_dir=*/"");
+    if (!compiled) state.SkipWithError(StrCat(compiled.takeError()).c_str());
+  }
+}
+BENCHMARK(BM_CompileNoCache);
+
+// Compile with the empty object cache (includes the cost of storing the entry).
+static void BM_CompileColdCache(benchmark::State& state) {
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::string cache_dir = CreateCacheDir();
+    state.ResumeTiming();
+
+    auto compiled = Compile(cache_dir);
+    if (!compiled) state.SkipWithError(StrCat(compiled.takeError()).c_str());
+
+    state.PauseTiming();
+    llvm::sys::fs::remove_directories(cache_dir);
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_CompileColdCache);
+
+// Load the kernel from the populated object cache.
+static void BM_CompileWarmCache(benchmark::State& state) {
+  std::string cache_dir = CreateCacheDir();
+  auto warmup = Compile(cache_dir);
+  if (!warmup) state.SkipWithError(StrCat(warmup.takeError()).c_str());
+
+  for (auto _ : state) {
+    auto compiled = Compile(cache_dir);
+    if (!compiled) state.SkipWithError(StrCat(compiled.takeError()).c_str());
+  }
+
+  llvm::sys::fs::remove_directories(cache_dir);
+}
+BENCHMARK(BM_CompileWarmCache);
+
+}  // namespace
+}  // namespace jit
+}  // namespace cpu
+}  // namespace tfrt
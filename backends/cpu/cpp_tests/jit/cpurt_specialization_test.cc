@@ -0,0 +1,187 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- cpurt_specialization_test.cc -----------------------------*- C++ -*-===//
+//
+// Tests and benchmarks for the cpurt kernels specialized to operands shapes.
+//
+//===----------------------------------------------------------------------===//
+
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "tfrt/cpu/jit/cpurt.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace cpu {
+namespace jit {
+namespace {
+
+static const char* kernel_module = R"(
+  func @main(%input: memref<?x?xf32>, %output: memref<?x?xf32>) {
+    linalg.generic { indexing_maps = [affine_map<(d0, d1) -> (d0, d1)>,
+                                      affine_map<(d0, d1) -> (d0, d1)>],
+                     iterator_types = ["parallel", "parallel"] }
+    ins(%input: memref<?x?xf32>) outs(%output : memref<?x?xf32>) {
+      ^bb0(%in: f32, %out: f32):
+        %0 = addf %in, %in : f32
+        linalg.yield %0 : f32
+    }
+    return
+  })";
+
+std::unique_ptr<HostContext> CreateTestHostContext() {
+  return std::make_unique<HostContext>([](const DecodedDiagnostic&) {},
+                                       CreateMallocAllocator(),
+                                       CreateMultiThreadedWorkQueue(2, 2));
+}
+
+Expected<CompilationResult> Compile(bool specialize) {
+  CompilationOptions opts;
+  opts.specialization.enabled = specialize;
+  opts.specialization.min_num_executions = 2;
+  opts.specialization.max_num_specializations = 1;
+  return CompileKernelMlirModule(kernel_module, "main", opts);
+}
+
+class Kernel {
+ public:
+  Kernel(HostContext* host, ssize_t rows, ssize_t cols)
+      : host_(host), input_(rows * cols), output_(rows * cols) {
+    for (size_t i = 0; i < input_.size(); ++i) input_[i] = i;
+    operands_.resize(2);
+    operands_[0] = {input_.data(), 0, {rows, cols}, {cols, 1}};
+    operands_[1] = {output_.data(), 0, {rows, cols}, {cols, 1}};
+  }
+
+  Error Execute(const CompilationResult& compiled,
+                const ExecutionContext& exec_ctx) {
+    // Kernel does not have any results.
+    RemainingResults results(host_, MutableArrayRef<RCReference<AsyncValue>>());
+    ReturnValueConverter converter(results);
+    return compiled.Execute(operands_, converter, exec_ctx);
+  }
+
+  void Verify() {
+    for (size_t i = 0; i < input_.size(); ++i)
+      EXPECT_EQ(output_[i], 2 * input_[i]);
+  }
+
+ private:
+  HostContext* host_;
+  std::vector<float> input_;
+  std::vector<float> output_;
+  SmallVector<MemrefDesc, 2> operands_;
+};
+
+TEST(CpurtSpecializationTest, SpecializedKernelResults) {
+  auto host = CreateTestHostContext();
+  Expected<RCReference<RequestContext>> req_ctx =
+      RequestContextBuilder(host.get(), /*resource_context=*/nullptr).build();
+  ASSERT_FALSE(!req_ctx);
+  ExecutionContext exec_ctx(std::move(*req_ctx));
+
+  auto compiled = Compile(/*specialize=*/true);
+  ASSERT_FALSE(!compiled);
+
+  Kernel kernel_4x8(host.get(), 4, 8);
+  Kernel kernel_3x5(host.get(), 3, 5);
+
+  // Second execution with the same shapes starts compilation of the
+  // specialized kernel, and all executions use the generic kernel until it is
+  // ready.
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_FALSE(kernel_4x8.Execute(*compiled, exec_ctx));
+    kernel_4x8.Verify();
+  }
+  EXPECT_EQ(compiled->num_ready_specializations(), 0);
+
+  // Wait for the specialized kernel compilation.
+  host->Quiesce();
+  EXPECT_EQ(compiled->num_ready_specializations(), 1);
+
+  // Shape with the compiled specialized kernel.
+  ASSERT_FALSE(kernel_4x8.Execute(*compiled, exec_ctx));
+  kernel_4x8.Verify();
+
+  // Shapes over the specializations limit use the generic kernel.
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_FALSE(kernel_3x5.Execute(*compiled, exec_ctx));
+    kernel_3x5.Verify();
+  }
+  host->Quiesce();
+  EXPECT_EQ(compiled->num_ready_specializations(), 1);
+}
+
+// -------------------------------------------------------------------------- //
+// Benchmarks for the generic and specialized kernels execution.
+// -------------------------------------------------------------------------- //
+
+// Warms up the specialized kernel for `warmup_size` operands (or for the
+// benchmarked operands if it is zero), and executes the benchmarked operands.
+static void Execute(benchmark::State& state, bool specialize,
+                    ssize_t warmup_size = 0) {
+  auto host = CreateTestHostContext();
+  Expected<RCReference<RequestContext>> req_ctx =
+      RequestContextBuilder(host.get(), /*resource_context=*/nullptr).build();
+  ExecutionContext exec_ctx(std::move(*req_ctx));
+
+  auto compiled = Compile(specialize);
+  if (!compiled) {
+    state.SkipWithError(StrCat(compiled.takeError()).c_str());
+    return;
+  }
+
+  Kernel kernel(host.get(), state.range(0), state.range(0));
+
+  // Warm up and wait for the specialized kernel compilation.
+  if (warmup_size == 0) warmup_size = state.range(0);
+  Kernel warmup(host.get(), warmup_size, warmup_size);
+  for (int i = 0; i < 2; ++i) (void)warmup.Execute(*compiled, exec_ctx);
+  host->Quiesce();
+
+  for (auto _ : state) (void)kernel.Execute(*compiled, exec_ctx);
+
+  state.SetItemsProcessed(state.range(0) * state.range(0) * state.iterations());
+}
+
+static void BM_ExecuteGeneric(benchmark::State& state) {
+  Execute(state, /*specialize=*/false);
+}
+BENCHMARK(BM_ExecuteGeneric)->Arg(4)->Arg(32)->Arg(256);
+
+static void BM_ExecuteSpecialized(benchmark::State& state) {
+  Execute(state, /*specialize=*/true);
+}
+BENCHMARK(BM_ExecuteSpecialized)->Arg(4)->Arg(32)->Arg(256);
+
+// Measures the specializations lookup overhead on top of the generic kernel,
+// for operands that do not match the only specialized kernel.
+static void BM_ExecuteNotSpecialized(benchmark::State& state) {
+  Execute(state, /*specialize=*/true, /*warmup_size=*/state.range(0) + 1);
+}
+BENCHMARK(BM_ExecuteNotSpecialized)->Arg(4)->Arg(32)->Arg(256);
+
+}  // namespace
+}  // namespace jit
+}  // namespace cpu
+}  // namespace tfrt
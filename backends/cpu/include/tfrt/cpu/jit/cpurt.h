@@ -26,8 +26,13 @@
 #define TFRT_BACKENDS_CPU_JIT_CPURT_H_
 
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
 #include <type_traits>
 
+#include "llvm/ADT/FunctionExtras.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "mlir/Dialect/Async/IR/AsyncTypes.h"
 #include "mlir/ExecutionEngine/ExecutionEngine.h"
 #include "mlir/IR/BuiltinTypes.h"
@@ -64,15 +69,58 @@ struct CompilationOptions {
   Optional<llvm::CodeGenOpt::Level> jit_code_opt_level;
 
   // Register dialects that are allowed in the serialized module.
-  llvm::function_ref<void(mlir::DialectRegistry&)> register_dialects;
+  //
+  // Compilation options are kept by the compilation result for compiling
+  // specialized kernels later (see `Specialization` below), so registration
+  // functions must outlive the compilation result if specialization is enabled.
+  std::function<void(mlir::DialectRegistry&)> register_dialects;
 
   // Register a pass pipeline that lowers serialized module from high level
   // dialects to the dialects supported by the CPURT lowering to LLVM.
-  llvm::function_ref<void(mlir::OpPassManager&)> register_pass_pipeline;
+  std::function<void(mlir::OpPassManager&)> register_pass_pipeline;
+
+  // If not empty, the object code of compiled kernels is stored in this
+  // directory, and later compilations of the same kernel (in this or any other
+  // process on the same host) load it instead of running the compilation
+  // pipeline. Entries are keyed by the hash of the serialized module, the
+  // entrypoint, the compilation options (including the textual form of the
+  // registered pass pipeline), the LLVM version and the host CPU features.
+  std::string object_cache_dir;
+
+  // Compiled kernels with dynamically shaped operands can be specialized to
+  // the concrete operand shapes seen at runtime: statically known shapes are
+  // folded into the kernel body (constant loop bounds and strides). When the
+  // kernel is executed with the same operand shapes `min_num_executions` times,
+  // a specialized kernel is compiled in the background using the blocking work
+  // queue. All executions use the generic kernel until the specialized kernel
+  // is ready.
+  struct Specialization {
+    bool enabled = false;
+
+    // The number of executions with the same operand shapes that triggers
+    // compilation of the specialized kernel.
+    int min_num_executions = 8;
+
+    // The maximum number of specialized kernels compiled for each kernel.
+    int max_num_specializations = 16;
+  };
+
+  Specialization specialization;
 };
 
+// Returns the object cache directory set by the `TFRT_CPURT_OBJECT_CACHE_DIR`
+// environment variable, or an empty string if it is not set.
+std::string DefaultObjectCacheDir();
+
+// Returns true if the `TFRT_CPURT_ENABLE_SPECIALIZATION` environment variable
+// is set to `1`.
+bool DefaultSpecializationEnabled();
+
 // Compiles a kernel defined by the serialized MLIR module to the executable
-// compilation result.
+// compilation result. If `opts.object_cache_dir` is set, tries to load the
+// kernel from the object cache first, and stores the newly compiled kernel to
+// the cache. Object cache failures are not errors, the kernel is compiled as
+// if the cache was disabled.
 Expected<CompilationResult> CompileKernelMlirModule(
     string_view mlir_module, string_view entrypoint,
     const CompilationOptions& opts);
@@ -331,6 +379,9 @@ class CompilationResult {
   struct ResultsMemoryLayout;
   struct CallFrame;
 
+  // Pointer to a compiled kernel function.
+  using KernelFunctionPtr = void (*)(void**);
+
   CompilationResult(std::unique_ptr<mlir::MLIRContext> context,
                     std::unique_ptr<mlir::ExecutionEngine> engine,
                     mlir::FunctionType signature, string_view entrypoint,
@@ -343,6 +394,20 @@ class CompilationResult {
     assert(fptr_ != nullptr && "entrypoint was not found");
   }
 
+  // Constructs compilation result from the kernel object code loaded into the
+  // `jit` (see `CompilationOptions::object_cache_dir`).
+  CompilationResult(std::unique_ptr<mlir::MLIRContext> context,
+                    std::unique_ptr<llvm::orc::LLJIT> jit,
+                    mlir::FunctionType signature, KernelFunctionPtr fptr,
+                    ResultsMemoryLayout results_memory_layout)
+      : context_(std::move(context)),
+        jit_(std::move(jit)),
+        signature_(signature),
+        fptr_(fptr),
+        results_memory_layout_(std::move(results_memory_layout)) {
+    assert(fptr_ != nullptr && "entrypoint was not found");
+  }
+
   // Initializes call frame by adding all operands as pointers to arguments
   // vector. Also allocates storage for returned values, which are passed to the
   // compiled kernel as return value arguments.
@@ -359,6 +424,9 @@ class CompilationResult {
   // Executes compiled function with given operands. If operands passed at
   // runtime are not compatible with the compiled function signature, allocates
   // error async values for each returned value.
+  //
+  // If specialization is enabled, executes the kernel specialized to the
+  // operands shapes if it is available, and might start its compilation.
   Error Execute(ArrayRef<MemrefDesc> operands,
                 const ReturnValueConverter& results,
                 const ExecutionContext& exec_ctx) const;
@@ -368,6 +436,16 @@ class CompilationResult {
 
   mlir::FunctionType signature() const;
 
+  // Enables specialization of this kernel to the operands shapes (see
+  // `CompilationOptions::Specialization`). Specialized kernels are compiled
+  // from the `mlir_module` source.
+  void EnableSpecialization(string_view mlir_module, string_view entrypoint,
+                            const CompilationOptions& opts);
+
+  // Returns the number of kernels specialized to the operands shapes that are
+  // compiled and ready to execute. Only intended for tests.
+  int num_ready_specializations() const;
+
   bool IsAsync() const { return results_memory_layout_.has_async_results; }
 
   // CallFrame provides a pointer-stable storage for packed function arguments
@@ -408,14 +486,18 @@ class CompilationResult {
       mlir::FunctionType signature);
 
  private:
-  // Pointer to a compiled kernel function.
-  using KernelFunctionPtr = void (*)(void**);
-
   std::unique_ptr<mlir::MLIRContext> context_;
+  // Only one of the `engine_` or `jit_` owns the compiled kernel code.
   std::unique_ptr<mlir::ExecutionEngine> engine_;
+  std::unique_ptr<llvm::orc::LLJIT> jit_;
   mlir::FunctionType signature_;
   KernelFunctionPtr fptr_;
   ResultsMemoryLayout results_memory_layout_;
+
+  // Kernels specialized to the operands shapes, defined in cpurt.cc. Shared
+  // with the background compilation tasks.
+  class Specializations;
+  std::shared_ptr<Specializations> specializations_;
 };
 
 //----------------------------------------------------------------------------//
@@ -424,11 +506,22 @@ class CompilationResult {
 
 class CompilationResultCache {
  public:
+  using CompileFn = llvm::unique_function<Expected<CompilationResult>()>;
+
   explicit CompilationResultCache(HostContext* host) : host_(host) {}
   AsyncValueRef<CompilationResult> Find(intptr_t key) const;
   AsyncValueRef<CompilationResult> Insert(intptr_t key,
                                           CompilationResult compilation_result);
 
+  // Returns the compilation result cached for the `key`. If the cache does not
+  // have it (or the cached compilation failed), runs `compile` on the blocking
+  // work queue and caches the async value that becomes available when the
+  // compilation is completed. Concurrent requests for the same key wait for
+  // the single compilation. Compilation errors are emitted as diagnostics at
+  // the location of the `exec_ctx`.
+  AsyncValueRef<CompilationResult> FindOrCompile(
+      intptr_t key, const ExecutionContext& exec_ctx, CompileFn compile);
+
  private:
   HostContext* host_;
   mutable tfrt::mutex mu_;
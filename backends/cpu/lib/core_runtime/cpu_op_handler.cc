@@ -196,6 +196,87 @@ struct CpuOpHandlerTraits {
   }
 };
 
+// Executes `invocation` inline and returns true if all of its arguments are
+// concrete tensors on `device` that need no conversion, the op has a metadata
+// function and the in chain, if any, is concrete. Like ExecuteOnOpHandler, the
+// op depends on the in chain even if it does not update it. This is the
+// common case for op-by-op execution, in which going through
+// ExecuteOnOpHandler would only add a result chain allocation, a continuation
+// to fulfill it and reference count traffic for argument conversion. Returns
+// false without side effects otherwise.
+bool TryExecuteInline(const CpuOpEntry& op_entry, bool update_chain,
+                      const RCReference<Device>& device,
+                      const OpInvocation& invocation) {
+  using internal::MDFunctionExecResult;
+
+  if (!op_entry.metadata_fn) return false;
+  if (invocation.chain && *invocation.chain &&
+      !invocation.chain->IsConcrete())
+    return false;
+  const ExecutionContext& exec_ctx = invocation.exec_ctx;
+  if (exec_ctx.GetCancelAsyncValue()) return false;
+
+  auto arguments = invocation.arguments;
+  for (auto& argument : arguments) {
+    AsyncValue* tensor_av = argument.GetAsyncTensor();
+    if (!tensor_av->IsConcrete() || !argument.IsDeviceAvailable() ||
+        argument.GetAvailableDevice().get() != device.get())
+      return false;
+    const auto& tensor = tensor_av->get<Tensor>();
+    if (ArgumentTensorType(tensor, op_entry.flags) != tensor.tensor_type())
+      return false;
+  }
+
+  // All argument metadata is available, so the metadata function runs
+  // synchronously.
+  SmallVector<TensorMetadata, 4> result_mds;
+  auto md_exec_result = internal::ExecuteMetadataFunction(
+      op_entry.metadata_fn, invocation, result_mds);
+  assert(md_exec_result != MDFunctionExecResult::kMetadataUnavailable);
+  if (md_exec_result == MDFunctionExecResult::kError) return true;
+
+  // Take the arguments, so that the op can forward their buffers.
+  SmallVector<RCReference<AsyncValue>, 4> arg_tensors;
+  SmallVector<AsyncValue*, 4> inputs;
+  arg_tensors.reserve(arguments.size());
+  inputs.reserve(arguments.size());
+  for (auto& argument : arguments) {
+    arg_tensors.push_back(argument.ReleaseTensorRef().ReleaseRCRef());
+    inputs.push_back(arg_tensors.back().get());
+  }
+
+  auto results = invocation.results;
+  SmallVector<RCReference<AsyncValue>, 4> result_tensors;
+  result_tensors.resize(results.size());
+  AsyncValueRef<Chain> op_chain;
+  {
+    ArrayRef<RCReference<AsyncValue>> arg_tensors_ref = arg_tensors;
+    ArrayRef<TensorMetadata> result_mds_ref = result_mds;
+    TFRT_TRACE_SCOPE(
+        Default,
+        tfrt::tracing::IsAboveTracingLevel(tracing::TracingLevel::Debug)
+            ? internal::GetOpDebugString(op_entry.op_name, arg_tensors_ref,
+                                         invocation.attrs, result_mds_ref,
+                                         exec_ctx)
+            : StrCat("RunDispatch: ", op_entry.op_name));
+    op_entry.dispatch_fn(exec_ctx, inputs, invocation.attrs, result_mds,
+                         result_tensors, &op_chain);
+  }
+
+  // The out chain of the op becomes the result chain directly.
+  if (update_chain) {
+    assert(op_chain && "the op does not produce a required out chain.");
+    *invocation.chain = std::move(op_chain);
+  }
+
+  for (size_t i = 0, e = results.size(); i != e; ++i) {
+    results[i] =
+        TensorHandle(device.CopyRef(), result_mds[i],
+                     AsyncValueRef<Tensor>(std::move(result_tensors[i])));
+  }
+  return true;
+}
+
 }  // namespace
 
 llvm::Expected<CpuOpHandler*> CreateCpuOpHandler(CoreRuntime* runtime,
@@ -247,6 +328,11 @@ Expected<CoreRuntimeOp> CpuOpHandler::MakeOp(string_view op_name) {
         assert(this->device_);
         bool update_chain = !(op_entry->flags & CpuOpFlags::NoSideEffects);
 
+        // Most invocations have concrete arguments, which do not need the
+        // machinery in ExecuteOnOpHandler.
+        if (TryExecuteInline(*op_entry, update_chain, device_, invocation))
+          return;
+
         // Convert the argument tensors if needed.
         for (auto& argument : invocation.arguments) {
           argument = MaybeConvertArgument(invocation.exec_ctx, op_entry->flags,
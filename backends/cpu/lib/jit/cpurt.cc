@@ -23,12 +23,28 @@
 
 #include "tfrt/cpu/jit/cpurt.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
-
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <tuple>
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Support/TargetSelect.h"
 #include "mlir/Conversion/AffineToStandard/AffineToStandard.h"
 #include "mlir/Conversion/AsyncToLLVM/AsyncToLLVM.h"
@@ -64,7 +80,9 @@
 #include "mlir/Transforms/Passes.h"
 #include "tfrt/cpu/jit/async_runtime.h"
 #include "tfrt/cpu/jit/async_runtime_api.h"
+#include "tfrt/host_context/async_dispatch.h"
 #include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/diagnostic.h"
 #include "tfrt/host_context/host_buffer.h"
 #include "tfrt/support/error_util.h"
 #include "tfrt/support/string_util.h"
@@ -87,6 +105,90 @@ static bool DebugCpurtCompile() {
 using CallFrame = CompilationResult::CallFrame;
 using ResultsMemoryLayout = CompilationResult::ResultsMemoryLayout;
 
+// Concrete operand shape used for the kernel specialization.
+using OperandShape = llvm::SmallVector<int64_t, 4>;
+
+//----------------------------------------------------------------------------//
+// Kernels specialized to the operands shapes.
+//----------------------------------------------------------------------------//
+
+// Compiles the kernel. If `specialization` is not empty, specializes the
+// entrypoint function to the operands shapes. Defined below.
+static Expected<CompilationResult> CompileKernel(
+    string_view mlir_module, string_view entrypoint,
+    const CompilationOptions& opts, ArrayRef<OperandShape> specialization);
+
+// Specialized kernels are stored in a map keyed by the operands shapes. Each
+// entry counts the number of executions with its operands shapes, and after
+// `min_num_executions` starts compilation of the specialized kernel. The number
+// of tracked operands shapes is bounded, to avoid unbounded memory growth for
+// kernels that are executed with a lot of different shapes.
+//
+// Kernels that are ready to execute are also published to a fixed size array
+// that is read without taking the mutex, and once all specializations are
+// compiled (or failed) the map is never consulted again. Steady state
+// executions do not take the lock or build the map key.
+class CompilationResult::Specializations
+    : public std::enable_shared_from_this<Specializations> {
+ public:
+  Specializations(string_view mlir_module, string_view entrypoint,
+                  const CompilationOptions& opts)
+      : mlir_module_(mlir_module.str()),
+        entrypoint_(entrypoint.str()),
+        opts_(opts),
+        ready_(new Ready[std::max(
+            0, opts.specialization.max_num_specializations)]),
+        saturated_(opts.specialization.max_num_specializations <= 0) {}
+
+  // Returns the kernel specialized to the operands shapes if it is available,
+  // otherwise returns nullptr and might start the compilation.
+  const CompilationResult* GetOrCompile(ArrayRef<MemrefDesc> operands,
+                                        const ExecutionContext& exec_ctx);
+
+  // Returns the number of specialized kernels that are ready to execute.
+  int NumReady();
+
+ private:
+  struct Entry {
+    int num_executions = 0;
+    AsyncValueRef<CompilationResult> specialized;
+  };
+
+  // Specialized kernel published to the lock-free lookup.
+  struct Ready {
+    // Returns true if the operands ranks and sizes match the `key`.
+    bool Matches(ArrayRef<MemrefDesc> operands) const;
+
+    llvm::SmallVector<int64_t, 16> key;
+    const CompilationResult* kernel = nullptr;
+  };
+
+  // Publishes the specialized kernel once its compilation is completed.
+  void OnCompiled(ArrayRef<int64_t> key, const Entry& entry);
+
+  // Limits the number of tracked operands shapes, relative to the maximum
+  // number of specializations.
+  static constexpr int kMaxTrackedShapesFactor = 8;
+
+  std::string mlir_module_;
+  std::string entrypoint_;
+  CompilationOptions opts_;
+
+  // Kernels `ready_[0, num_ready_)` are written under the mutex before
+  // `num_ready_` is incremented, and are immutable after that.
+  std::unique_ptr<Ready[]> ready_;
+  std::atomic<int> num_ready_{0};
+  // All specialized kernels are compiled or failed to compile, and lookups that
+  // do not match a ready kernel can skip the map.
+  std::atomic<bool> saturated_;
+
+  tfrt::mutex mu_;
+  int num_specializations_ TFRT_GUARDED_BY(mu_) = 0;
+  int num_compiled_ TFRT_GUARDED_BY(mu_) = 0;
+  // Keyed by the operands ranks and sizes (see `GetOrCompile`).
+  llvm::StringMap<Entry> entries_ TFRT_GUARDED_BY(mu_);
+};
+
 //----------------------------------------------------------------------------//
 // Verify compiled function signature and pre-compute memory layout for results.
 //----------------------------------------------------------------------------//
@@ -388,6 +490,12 @@ Error EmitErrors(ReturnValueConverter results, Error error,
 Error CompilationResult::Execute(ArrayRef<MemrefDesc> operands,
                                  const ReturnValueConverter& results,
                                  const ExecutionContext& exec_ctx) const {
+  // Execute the kernel specialized to the operands shapes if it is ready.
+  if (specializations_)
+    if (const CompilationResult* specialized =
+            specializations_->GetOrCompile(operands, exec_ctx))
+      return specialized->Execute(operands, results, exec_ctx);
+
   // CallFrame can be allocated on the stack because compiled function will
   // unpack all the arguments it needs, and async regions will not access
   // the data after the initial function will return the result.
@@ -442,6 +550,32 @@ AsyncValueRef<CompilationResult> CompilationResultCache::Insert(
   return emplaced.first->getSecond().CopyRef();
 }
 
+AsyncValueRef<CompilationResult> CompilationResultCache::FindOrCompile(
+    intptr_t key, const ExecutionContext& exec_ctx, CompileFn compile) {
+  tfrt::mutex_lock lock(mu_);
+  auto it = cache_.find(key);
+  if (it != cache_.end() && !it->second.IsError()) return it->second.CopyRef();
+
+  // Compilation runs the whole LLVM pipeline, and must not block the threads
+  // of the non-blocking work queue.
+  auto compiled = MakeUnconstructedAsyncValueRef<CompilationResult>(host_);
+  bool enqueued = EnqueueBlockingWork(
+      exec_ctx, [exec_ctx, compiled = compiled.CopyRef(),
+                 compile = std::move(compile)]() mutable {
+        Expected<CompilationResult> result = compile();
+        // Report compilation errors at the location of the compiling kernel.
+        if (auto err = result.takeError())
+          compiled.SetError(EmitError(exec_ctx, toString(std::move(err))));
+        else
+          compiled.emplace(std::move(*result));
+      });
+  if (!enqueued)
+    compiled.SetError(EmitError(exec_ctx, "failed to enqueue compilation"));
+
+  cache_[key] = compiled.CopyRef();
+  return compiled;
+}
+
 //----------------------------------------------------------------------------//
 // Setup MLIR pass pipeline to lower to LLVM dialect, and use ORC JIT to codegen
 // functions at runtime.
@@ -527,12 +661,10 @@ static mlir::LogicalResult LowerToCpurt(mlir::ModuleOp module,
   return pm.run(module);
 }
 
-// Runs the pipeline to lower kernel IR to LLVM dialect.
-static mlir::LogicalResult LowerToLlvm(mlir::ModuleOp module,
-                                       const CompilationOptions& opts) {
-  mlir::PassManager pm(module.getContext());
-  SetupPassDebugging(module.getContext(), pm);
-
+// Adds passes that lower kernel IR to LLVM dialect.
+static void BuildLowerToLlvmPipeline(mlir::MLIRContext* context,
+                                     mlir::OpPassManager& pm,
+                                     const CompilationOptions& opts) {
   pm.addPass(mlir::createInlinerPass());
   pm.addPass(mlir::createCanonicalizerPass());
   pm.addPass(mlir::createCSEPass());
@@ -567,9 +699,16 @@ static mlir::LogicalResult LowerToLlvm(mlir::ModuleOp module,
   mlir::LowerVectorToLLVMOptions vector_to_llvm_opts;
   pm.addPass(mlir::createConvertVectorToLLVMPass());
 
-  mlir::LowerToLLVMOptions lower_to_llvm_opts(module.getContext());
+  mlir::LowerToLLVMOptions lower_to_llvm_opts(context);
   pm.addPass(mlir::createLowerToLLVMPass(lower_to_llvm_opts));
+}
 
+// Runs the pipeline to lower kernel IR to LLVM dialect.
+static mlir::LogicalResult LowerToLlvm(mlir::ModuleOp module,
+                                       const CompilationOptions& opts) {
+  mlir::PassManager pm(module.getContext());
+  SetupPassDebugging(module.getContext(), pm);
+  BuildLowerToLlvmPipeline(module.getContext(), pm, opts);
   return pm.run(module);
 }
 
@@ -591,9 +730,250 @@ static Expected<mlir::FuncOp> ResolveEntrypointFunction(
   return entry_func;
 }
 
-Expected<CompilationResult> CompileKernelMlirModule(
+//----------------------------------------------------------------------------//
+// Persistent object cache for compiled kernels.
+//----------------------------------------------------------------------------//
+
+// Each cache entry is stored in two files:
+//   <key>.o     - object code of the compiled kernel module
+//   <key>.meta  - entrypoint function name and signature (one per line)
+//
+// Files are written to unique temporary paths and renamed into place, and the
+// metadata is renamed after the object file, so a concurrent reader that finds
+// the metadata file always finds a complete object file.
+
+// Bump the version when the cache entry format or the compiled kernel ABI
+// changes, to ignore previously cached objects.
+static constexpr const char* kObjectCacheVersion = "cpurt-object-cache-v1";
+
+static std::string ObjectCacheKey(string_view mlir_module,
+                                  string_view entrypoint,
+                                  const CompilationOptions& opts,
+                                  ArrayRef<OperandShape> specialization,
+                                  mlir::MLIRContext* context) {
+  std::string config;
+  llvm::raw_string_ostream os(config);
+
+  os << kObjectCacheVersion << "\n" << LLVM_VERSION_STRING << "\n";
+
+  // Object code is specialized for the host CPU.
+  llvm::StringMap<bool> host_features;
+  llvm::SmallVector<llvm::StringRef, 32> enabled_features;
+  if (llvm::sys::getHostCPUFeatures(host_features))
+    for (auto& feature : host_features)
+      if (feature.getValue()) enabled_features.push_back(feature.getKey());
+  llvm::sort(enabled_features);
+
+  os << llvm::sys::getHostCPUName() << "\n";
+  for (llvm::StringRef feature : enabled_features) os << "+" << feature;
+  os << "\n";
+
+  // Compilation options.
+  os << "alignment=" << opts.alignment << "\n";
+  os << "num_worker_threads=" << opts.num_worker_threads << "\n";
+  os << "jit_code_opt_level="
+     << (opts.jit_code_opt_level ? static_cast<int>(*opts.jit_code_opt_level)
+                                 : -1)
+     << "\n";
+
+  // Pass pipelines that lower the kernel module to LLVM.
+  mlir::PassManager pm(context);
+  if (opts.register_pass_pipeline) opts.register_pass_pipeline(pm);
+  BuildLowerToLlvmPipeline(context, pm, opts);
+  pm.printAsTextualPipeline(os);
+  os << "\n" << entrypoint << "\n";
+
+  // Operands shapes of the specialized kernel.
+  for (const OperandShape& shape : specialization) {
+    os << "[";
+    for (int64_t dim : shape) os << dim << ",";
+    os << "]";
+  }
+  os << "\n";
+
+  llvm::SHA1 hasher;
+  hasher.update(os.str());
+  hasher.update(mlir_module);
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::string DefaultObjectCacheDir() {
+  const char* dir = std::getenv("TFRT_CPURT_OBJECT_CACHE_DIR");
+  return dir ? dir : "";
+}
+
+// Loads compiled kernel from the object cache entry at `path` (without the file
+// extension). Returns an error if the entry does not exist or is invalid.
+static Expected<CompilationResult> LoadFromObjectCache(
+    const std::string& path, std::unique_ptr<mlir::MLIRContext>* context) {
+  auto meta = llvm::MemoryBuffer::getFile(path + ".meta");
+  if (!meta) return MakeStringError("object cache miss: ", path);
+
+  auto object = llvm::MemoryBuffer::getFile(path + ".o");
+  if (!object) return MakeStringError("object cache miss: ", path);
+
+  // Parse the entrypoint function name and signature.
+  llvm::StringRef entry_name, signature_str;
+  std::tie(entry_name, signature_str) = (*meta)->getBuffer().split('\n');
+
+  auto entry_signature = mlir::parseType(signature_str.trim(), context->get())
+                             .dyn_cast_or_null<mlir::FunctionType>();
+  if (entry_name.empty() || !entry_signature)
+    return MakeStringError("invalid object cache entry: ", path);
+
+  auto results_memory_layout =
+      CompilationResult::VerifyEntrypointSignature(entry_signature);
+  if (auto err = results_memory_layout.takeError()) return std::move(err);
+
+  // Load the object code into the JIT.
+  auto jit = llvm::orc::LLJITBuilder().create();
+  if (!jit) return jit.takeError();
+
+  llvm::orc::JITDylib& main_jd = (*jit)->getMainJITDylib();
+  const llvm::DataLayout& data_layout = (*jit)->getDataLayout();
+
+  // Resolve symbols that are not defined by the kernel (e.g. `malloc`) in the
+  // current process, and register Async Runtime API intrinsics the same way
+  // as the mlir::ExecutionEngine does it for the freshly compiled kernels.
+  auto generator =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          data_layout.getGlobalPrefix());
+  if (!generator) return generator.takeError();
+  main_jd.addGenerator(std::move(*generator));
+
+  llvm::orc::MangleAndInterner mangle(main_jd.getExecutionSession(),
+                                      data_layout);
+  if (auto err = main_jd.define(
+          llvm::orc::absoluteSymbols(AsyncRuntimeApiSymbolMap(mangle))))
+    return std::move(err);
+
+  if (auto err = (*jit)->addObjectFile(std::move(*object)))
+    return std::move(err);
+
+  // mlir::ExecutionEngine wraps the entrypoint function into the function with
+  // the packed arguments, and gives it the `_mlir_` name prefix.
+  auto symbol = (*jit)->lookup(("_mlir_" + entry_name).str());
+  if (!symbol) return symbol.takeError();
+
+  auto fptr = reinterpret_cast<CompilationResult::KernelFunctionPtr>(
+      static_cast<uintptr_t>(symbol->getAddress()));
+
+  return CompilationResult(std::move(*context), std::move(*jit),
+                           entry_signature, fptr,
+                           std::move(*results_memory_layout));
+}
+
+// Writes `write` output to the unique temporary file and renames it to `path`.
+static bool WriteAtomically(
+    const std::string& path,
+    llvm::function_ref<bool(llvm::StringRef tmp_path)> write) {
+  llvm::SmallString<128> tmp_path;
+  llvm::sys::fs::createUniquePath(path + ".%%%%%%%%.tmp", tmp_path,
+                                  /*MakeAbsolute=*/false);
+
+  if (!write(tmp_path) || llvm::sys::fs::rename(tmp_path, path)) {
+    llvm::sys::fs::remove(tmp_path);
+    return false;
+  }
+
+  return true;
+}
+
+// Stores object code of the compiled kernel to the object cache entry at `path`
+// (without the file extension). Failures to update the cache are ignored.
+static void StoreToObjectCache(const std::string& path,
+                               llvm::StringRef entry_name,
+                               mlir::FunctionType entry_signature,
+                               mlir::ExecutionEngine& engine) {
+  // Object code is generated lazily when the first symbol is looked up.
+  auto fptr = engine.lookup(entry_name);
+  if (!fptr) {
+    llvm::consumeError(fptr.takeError());
+    return;
+  }
+
+  bool stored_object = WriteAtomically(path + ".o", [&](llvm::StringRef tmp) {
+    engine.dumpToObjectFile(tmp);
+    return llvm::sys::fs::exists(tmp);
+  });
+  if (!stored_object) return;
+
+  WriteAtomically(path + ".meta", [&](llvm::StringRef tmp) {
+    std::error_code ec;
+    llvm::raw_fd_ostream os(tmp, ec);
+    if (ec) return false;
+    os << entry_name << "\n" << entry_signature << "\n";
+    os.close();
+    return !os.has_error();
+  });
+}
+
+//----------------------------------------------------------------------------//
+// Specialize compiled kernels to the operands shapes.
+//----------------------------------------------------------------------------//
+
+// Specializes the entrypoint function to the operands shapes: replaces memref
+// arguments types with statically shaped types, and casts arguments back to
+// the original types. Canonicalization folds the casts into the users, and
+// propagates static shapes into the function body.
+static Error SpecializeEntrypoint(mlir::FuncOp func,
+                                  ArrayRef<OperandShape> specialization) {
+  mlir::FunctionType signature = func.getType();
+  if (specialization.size() != signature.getNumInputs())
+    return MakeStringError("number of operands shapes must match the number ",
+                           "of inputs: ", specialization.size(), " vs ",
+                           signature.getNumInputs());
+
+  mlir::OpBuilder builder = mlir::OpBuilder::atBlockBegin(&func.front());
+  llvm::SmallVector<mlir::Type, 4> specialized_inputs;
+  specialized_inputs.reserve(signature.getNumInputs());
+
+  for (unsigned i = 0; i < signature.getNumInputs(); ++i) {
+    auto memref = signature.getInput(i).dyn_cast<mlir::MemRefType>();
+    if (!memref)
+      return MakeStringError("input #", i, " must be a ranked memref type");
+
+    const OperandShape& shape = specialization[i];
+    if (shape.size() != memref.getRank())
+      return MakeStringError("operand #", i, " rank does not match expected ",
+                             "input rank: ", shape.size(), " vs ",
+                             memref.getRank());
+
+    // Keep statically shaped inputs unchanged.
+    if (memref.hasStaticShape()) {
+      specialized_inputs.push_back(memref);
+      continue;
+    }
+
+    auto specialized = mlir::MemRefType::get(
+        shape, memref.getElementType(), memref.getAffineMaps(),
+        memref.getMemorySpace());
+    specialized_inputs.push_back(specialized);
+
+    // Cast the specialized argument back to the original type.
+    mlir::BlockArgument arg = func.getArgument(i);
+    arg.setType(specialized);
+    auto cast_op =
+        builder.create<mlir::memref::CastOp>(func.getLoc(), memref, arg);
+    llvm::SmallPtrSet<mlir::Operation*, 1> except = {cast_op.getOperation()};
+    arg.replaceAllUsesExcept(cast_op, except);
+  }
+
+  func.setType(mlir::FunctionType::get(func.getContext(), specialized_inputs,
+                                       signature.getResults()));
+  return Error::success();
+}
+
+static bool HasDynamicInputs(mlir::FunctionType signature) {
+  return llvm::any_of(signature.getInputs(), [](mlir::Type type) {
+    auto memref = type.dyn_cast<mlir::MemRefType>();
+    return memref && !memref.hasStaticShape();
+  });
+}
+
+static Expected<CompilationResult> CompileKernel(
     string_view mlir_module, string_view entrypoint,
-    const CompilationOptions& opts) {
+    const CompilationOptions& opts, ArrayRef<OperandShape> specialization) {
   // Setup LLVM target for code generation.
   InitializeCompiler();
 
@@ -615,6 +995,21 @@ Expected<CompilationResult> CompileKernelMlirModule(
 
   auto context = std::make_unique<mlir::MLIRContext>(registry);
 
+  // Try to load the compiled kernel from the object cache.
+  std::string object_cache_path;
+  if (!opts.object_cache_dir.empty() &&
+      !llvm::sys::fs::create_directories(opts.object_cache_dir)) {
+    llvm::SmallString<128> path(opts.object_cache_dir);
+    llvm::sys::path::append(
+        path, ObjectCacheKey(mlir_module, entrypoint, opts, specialization,
+                             context.get()));
+    object_cache_path = path.str().str();
+
+    auto loaded = LoadFromObjectCache(object_cache_path, &context);
+    if (loaded) return std::move(*loaded);
+    llvm::consumeError(loaded.takeError());
+  }
+
   // Collect all diagnostics emited while lowering kernel module to LLVM.
   std::string diagnostic_str;
   llvm::raw_string_ostream os(diagnostic_str);
@@ -637,6 +1032,11 @@ Expected<CompilationResult> CompileKernelMlirModule(
   auto entry_func = ResolveEntrypointFunction(*module, entrypoint);
   if (auto err = entry_func.takeError()) return std::move(err);
 
+  // Specialize entrypoint function to the operands shapes.
+  if (!specialization.empty())
+    if (auto err = SpecializeEntrypoint(*entry_func, specialization))
+      return std::move(err);
+
   std::string entry_name = entry_func->getName().str();
   mlir::FunctionType entry_signature = entry_func->getType();
   auto results_memory_layout =
@@ -671,11 +1071,147 @@ Expected<CompilationResult> CompileKernelMlirModule(
   // Register Async Runtime API intrinsics.
   (*engine)->registerSymbols(AsyncRuntimeApiSymbolMap);
 
+  // Store compiled kernel to the object cache.
+  if (!object_cache_path.empty())
+    StoreToObjectCache(object_cache_path, entry_name, entry_signature,
+                       **engine);
+
   return CompilationResult(std::move(context), std::move(*engine),
                            entry_signature, entry_name,
                            std::move(*results_memory_layout));
 }
 
+Expected<CompilationResult> CompileKernelMlirModule(
+    string_view mlir_module, string_view entrypoint,
+    const CompilationOptions& opts) {
+  auto compiled = CompileKernel(mlir_module, entrypoint, opts,
+                                /*specialization=*/{});
+  if (!compiled) return compiled.takeError();
+
+  if (opts.specialization.enabled && HasDynamicInputs(compiled->signature()))
+    compiled->EnableSpecialization(mlir_module, entrypoint, opts);
+
+  return compiled;
+}
+
+bool DefaultSpecializationEnabled() {
+  const char* enabled = std::getenv("TFRT_CPURT_ENABLE_SPECIALIZATION");
+  return enabled && string_view(enabled) == "1";
+}
+
+bool CompilationResult::Specializations::Ready::Matches(
+    ArrayRef<MemrefDesc> operands) const {
+  ArrayRef<int64_t> rest = key;
+  for (const MemrefDesc& memref : operands) {
+    size_t rank = memref.sizes.size();
+    if (rest.size() < rank + 1 || rest[0] != static_cast<int64_t>(rank))
+      return false;
+    if (!std::equal(memref.sizes.begin(), memref.sizes.end(), rest.begin() + 1))
+      return false;
+    rest = rest.drop_front(rank + 1);
+  }
+  return rest.empty();
+}
+
+const CompilationResult* CompilationResult::Specializations::GetOrCompile(
+    ArrayRef<MemrefDesc> operands, const ExecutionContext& exec_ctx) {
+  // Fast path: check the published specialized kernels without the lock.
+  int num_ready = num_ready_.load(std::memory_order_acquire);
+  for (int i = 0; i < num_ready; ++i)
+    if (ready_[i].Matches(operands)) return ready_[i].kernel;
+
+  // No more kernels will be specialized, use the generic kernel.
+  if (saturated_.load(std::memory_order_acquire)) return nullptr;
+
+  // Encode operands ranks and sizes as a byte string.
+  llvm::SmallVector<int64_t, 16> key;
+  for (const MemrefDesc& memref : operands) {
+    key.push_back(memref.sizes.size());
+    key.append(memref.sizes.begin(), memref.sizes.end());
+  }
+  string_view key_str(reinterpret_cast<const char*>(key.data()),
+                      key.size() * sizeof(int64_t));
+
+  const CompilationOptions::Specialization& opts = opts_.specialization;
+
+  Entry* entry;
+  {
+    tfrt::mutex_lock lock(mu_);
+
+    auto it = entries_.find(key_str);
+    if (it == entries_.end()) {
+      size_t max_tracked_shapes =
+          kMaxTrackedShapesFactor * opts.max_num_specializations;
+      if (entries_.size() >= max_tracked_shapes) return nullptr;
+      it = entries_.try_emplace(key_str).first;
+    }
+
+    entry = &it->second;
+
+    // Specialized kernel is ready, or compilation is in flight (or failed).
+    if (entry->specialized)
+      return entry->specialized.IsConcrete() ? &entry->specialized.get()
+                                             : nullptr;
+
+    if (++entry->num_executions < opts.min_num_executions ||
+        num_specializations_ >= opts.max_num_specializations)
+      return nullptr;
+
+    // Compile specialized kernel in the background.
+    ++num_specializations_;
+
+    llvm::SmallVector<OperandShape, 4> shapes;
+    shapes.reserve(operands.size());
+    for (const MemrefDesc& memref : operands)
+      shapes.emplace_back(memref.sizes.begin(), memref.sizes.end());
+
+    entry->specialized = EnqueueBlockingWork(
+        exec_ctx, [self = shared_from_this(), shapes = std::move(shapes)]() {
+          return CompileKernel(self->mlir_module_, self->entrypoint_,
+                               self->opts_, shapes);
+        });
+  }
+
+  // Entries are never erased, and the map does not move the values. The
+  // waiter might run inline, so it must be added without holding the lock.
+  entry->specialized.AndThen(
+      [self = shared_from_this(), key = std::move(key), entry]() {
+        self->OnCompiled(key, *entry);
+      });
+
+  return nullptr;
+}
+
+void CompilationResult::Specializations::OnCompiled(ArrayRef<int64_t> key,
+                                                    const Entry& entry) {
+  tfrt::mutex_lock lock(mu_);
+
+  if (entry.specialized.IsConcrete()) {
+    int num_ready = num_ready_.load(std::memory_order_relaxed);
+    ready_[num_ready].key.assign(key.begin(), key.end());
+    ready_[num_ready].kernel = &entry.specialized.get();
+    num_ready_.store(num_ready + 1, std::memory_order_release);
+  }
+
+  if (++num_compiled_ == opts_.specialization.max_num_specializations)
+    saturated_.store(true, std::memory_order_release);
+}
+
+int CompilationResult::Specializations::NumReady() {
+  return num_ready_.load(std::memory_order_acquire);
+}
+
+int CompilationResult::num_ready_specializations() const {
+  return specializations_ ? specializations_->NumReady() : 0;
+}
+
+void CompilationResult::EnableSpecialization(string_view mlir_module,
+                                             string_view entrypoint,
+                                             const CompilationOptions& opts) {
+  specializations_ =
+      std::make_shared<Specializations>(mlir_module, entrypoint, opts);
+}
+
 }  // namespace jit
 }  // namespace cpu
 }  // namespace tfrt
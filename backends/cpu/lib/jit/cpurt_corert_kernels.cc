@@ -25,6 +25,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <string>
 
 #include "tfrt/core_runtime/core_runtime.h"
 #include "tfrt/core_runtime/tensor_handle.h"
@@ -73,23 +74,27 @@ static AsyncValueRef<CompilationResult> Compile(
   // TODO(ezhulenev): Compute cache key based on the content of MLIR module.
   intptr_t key = exec_ctx.location().data;
 
-  // Return compiled kernel from the cache.
-  if (auto compiled = compilation_cache->Find(key)) return compiled;
+  // Return compiled kernel from the cache. Failed compilations are retried.
+  auto compiled = compilation_cache->Find(key);
+  if (compiled && !compiled.IsError()) return compiled;
 
   CompilationOptions opts;
   opts.num_worker_threads = host->GetNumWorkerThreads();
-
-  string_view entrypoint = kernel.nested_symbols()[0];
-  string_view module = kernel.serialized_operation();
-  Expected<CompilationResult> compiled =
-      CompileKernelMlirModule(module, entrypoint, opts);
-
-  // Failed to compile kernel source.
-  if (auto err = compiled.takeError())
-    return EmitErrorAsync(exec_ctx, std::move(err));
-
-  // Update the compilation cache and return the result.
-  return compilation_cache->Insert(key, std::move(*compiled));
+  opts.object_cache_dir = DefaultObjectCacheDir();
+  opts.specialization.enabled = DefaultSpecializationEnabled();
+
+  // Copy the kernel source, because compilation runs asynchronously.
+  std::string entrypoint = kernel.nested_symbols()[0].str();
+  std::string module = kernel.serialized_operation().str();
+
+  // Compile the kernel in the background. Kernels that use the compilation
+  // result wait for it to become available.
+  return compilation_cache->FindOrCompile(
+      key, exec_ctx,
+      [module = std::move(module), entrypoint = std::move(entrypoint),
+       opts = std::move(opts)]() {
+        return CompileKernelMlirModule(module, entrypoint, opts);
+      });
 }
 
 // -------------------------------------------------------------------------- //
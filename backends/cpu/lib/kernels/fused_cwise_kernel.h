@@ -0,0 +1,305 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- fused_cwise_kernel.h -------------------------------------*- C++ -*-===//
+//
+// Fused chain of element-wise operations evaluated in a single pass.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_BACKENDS_CPU_LIB_KERNELS_CPU_FUSED_CWISE_KERNEL_H_
+#define TFRT_BACKENDS_CPU_LIB_KERNELS_CPU_FUSED_CWISE_KERNEL_H_
+
+#include <algorithm>
+#include <cstring>
+
+#include "./cwise_binary_kernels.h"
+#include "./cwise_unary_kernels.h"
+#include "tfrt/common/compat/eigen/tensor_types.h"
+#include "tfrt/dtype/dtype.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/chain.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/parallel_for.h"
+#include "tfrt/support/error_util.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+#include "tfrt/tensor/dense_host_tensor_view.h"
+
+namespace tfrt {
+namespace cpu {
+namespace internal {
+
+// Fused operations are applied to the output one block at a time, so that the
+// intermediate results stay in L1 cache between the operations in the chain.
+constexpr size_t kFusedCwiseBlockSize = 1024;
+
+// Minimum number of elements processed by a single ParallelFor task.
+constexpr size_t kFusedCwiseMinParallelBlockSize = 16 * kFusedCwiseBlockSize;
+
+// A single element-wise operation in the fused chain. Binary operations take
+// the right hand side operand from `operand`, which is either a single value,
+// a tensor of the output shape, or a tensor broadcasted along the outer
+// dimensions of the output (e.g. a BiasAdd bias vector).
+template <typename T>
+struct FusedCwiseStep {
+  // Updates `size` elements of the `block` in place. The first element of the
+  // block has index `offset` in the flattened output.
+  using ApplyFn = void (*)(const FusedCwiseStep& step, T* block, size_t offset,
+                           size_t size);
+
+  ApplyFn apply;
+  const T* operand = nullptr;
+  size_t operand_size = 0;
+};
+
+// Blocks and operand runs start at arbitrary element offsets, so there is no
+// guarantee that they are aligned for Eigen packet loads and stores.
+template <typename T>
+using UnalignedBlock =
+    Eigen::TensorMap<Eigen::Tensor<T, 1, Eigen::RowMajor, Eigen::Index>,
+                     Eigen::Unaligned>;
+template <typename T>
+using UnalignedConstBlock =
+    Eigen::TensorMap<const Eigen::Tensor<T, 1, Eigen::RowMajor, Eigen::Index>,
+                     Eigen::Unaligned>;
+
+template <typename UnaryFunctor, typename T>
+void ApplyUnary(const FusedCwiseStep<T>&, T* block, size_t, size_t size) {
+  UnalignedBlock<T> out(block, size);
+  out = out.unaryExpr(typename UnaryFunctor::Functor());
+}
+
+template <typename T>
+void ApplyRelu(const FusedCwiseStep<T>&, T* block, size_t, size_t size) {
+  UnalignedBlock<T> out(block, size);
+  out = out.cwiseMax(static_cast<T>(0));
+}
+
+template <typename BinaryFunctor, typename T>
+void ApplyBinaryScalar(const FusedCwiseStep<T>& step, T* block, size_t,
+                       size_t size) {
+  using BindRight =
+      functor::BindRightScalar<T, T, typename BinaryFunctor::Functor>;
+  UnalignedBlock<T> out(block, size);
+  out = out.unaryExpr(BindRight(*step.operand));
+}
+
+template <typename BinaryFunctor, typename T>
+void ApplyBinaryTensor(const FusedCwiseStep<T>& step, T* block, size_t offset,
+                       size_t size) {
+  UnalignedBlock<T> out(block, size);
+  UnalignedConstBlock<T> rhs(step.operand + offset, size);
+  out = out.binaryExpr(rhs, typename BinaryFunctor::Functor());
+}
+
+template <typename BinaryFunctor, typename T>
+void ApplyBinaryInnerDims(const FusedCwiseStep<T>& step, T* block,
+                          size_t offset, size_t size) {
+  // Split the block into the runs that map to contiguous operand elements.
+  for (size_t i = 0; i < size;) {
+    size_t inner = (offset + i) % step.operand_size;
+    size_t n = std::min(step.operand_size - inner, size - i);
+    UnalignedBlock<T> out(block + i, n);
+    UnalignedConstBlock<T> rhs(step.operand + inner, n);
+    out = out.binaryExpr(rhs, typename BinaryFunctor::Functor());
+    i += n;
+  }
+}
+
+template <typename BinaryFunctor, typename T>
+Expected<FusedCwiseStep<T>> MakeBinaryStep(const DenseHostTensor& output,
+                                           const DenseHostTensor& operand) {
+  if (operand.dtype() != output.dtype())
+    return MakeStringError("fusion input dtype ", operand.dtype(),
+                           " doesn't match input dtype ", output.dtype());
+
+  FusedCwiseStep<T> step;
+  step.operand = DHTArrayView<T>(&operand).data();
+  step.operand_size = operand.NumElements();
+
+  if (operand.NumElements() == 1) {
+    step.apply = ApplyBinaryScalar<BinaryFunctor, T>;
+    return step;
+  }
+
+  if (operand.shape() == output.shape()) {
+    step.apply = ApplyBinaryTensor<BinaryFunctor, T>;
+    return step;
+  }
+
+  // Operand dimensions must match the inner dimensions of the output.
+  const int rank = output.shape().GetRank();
+  const int operand_rank = operand.shape().GetRank();
+  bool inner_dims = operand_rank > 0 && operand_rank < rank;
+  for (int i = 1; inner_dims && i <= operand_rank; ++i) {
+    inner_dims = operand.shape().GetDimensionSize(operand_rank - i) ==
+                 output.shape().GetDimensionSize(rank - i);
+  }
+  if (!inner_dims)
+    return MakeStringError("fusion input shape ", operand.shape(),
+                           " can't be broadcasted to ", output.shape());
+
+  step.apply = ApplyBinaryInnerDims<BinaryFunctor, T>;
+  return step;
+}
+
+// Converts fused operation names to the fused chain steps. Binary operations
+// consume `fusion_inputs` in order.
+template <typename T, typename FuseInputsRange>
+Expected<SmallVector<FusedCwiseStep<T>, 4>> MakeFusedCwiseSteps(
+    const DenseHostTensor& output, FuseInputsRange fusion_inputs,
+    ArrayRef<string_view> fused_ops) {
+  SmallVector<FusedCwiseStep<T>, 4> steps;
+  size_t num_fusion_inputs = 0;
+
+  auto binary = [&](auto functor, string_view op) -> Error {
+    using BinaryFunctor = typename decltype(functor)::template Functor<T>;
+    if (num_fusion_inputs == fusion_inputs.size())
+      return MakeStringError("missing fusion input for ", op);
+    const DenseHostTensor& operand = fusion_inputs[num_fusion_inputs++];
+
+    if (op == "BiasAdd" && (operand.shape().GetRank() != 1 ||
+                            output.shape().GetRank() < 2 ||
+                            operand.NumElements() !=
+                                output.shape().GetDimensionSize(
+                                    output.shape().GetRank() - 1)))
+      return MakeStringError("bias must be a vector of the size of the last "
+                             "input dimension");
+
+    auto step = MakeBinaryStep<BinaryFunctor, T>(output, operand);
+    if (!step) return step.takeError();
+    steps.push_back(*step);
+    return Error::success();
+  };
+
+  auto unary = [&](auto functor) -> Error {
+    using UnaryFunctor = typename decltype(functor)::template Functor<T>;
+    steps.push_back({ApplyUnary<UnaryFunctor, T>});
+    return Error::success();
+  };
+
+  auto add_step = [&](string_view op) -> Error {
+    if (op == "AddV2" || op == "BiasAdd") return binary(functor::Add(), op);
+    if (op == "Sub") return binary(functor::Sub(), op);
+    if (op == "Mul") return binary(functor::Mul(), op);
+    if (op == "RealDiv") return binary(functor::Div(), op);
+    if (op == "Sigmoid") return unary(functor::Sigmoid());
+    if (op == "Log") return unary(functor::Log());
+    if (op == "Log1p") return unary(functor::Log1p());
+    if (op == "Rsqrt") return unary(functor::Rsqrt());
+    if (op == "Relu") {
+      steps.push_back({ApplyRelu<T>});
+      return Error::success();
+    }
+    return MakeStringError("unsupported fused operation: ", op);
+  };
+
+  for (string_view op : fused_ops) {
+    if (auto error = add_step(op)) return std::move(error);
+  }
+
+  if (steps.empty())
+    return MakeStringError("FusedCwise must specify fused operations");
+  if (num_fusion_inputs != fusion_inputs.size())
+    return MakeStringError("expected ", num_fusion_inputs,
+                           " fusion inputs, got ", fusion_inputs.size());
+
+  return std::move(steps);
+}
+
+}  // namespace internal
+
+// Evaluates a chain of element-wise operations `fused_ops` (names of the
+// corresponding TF operations, e.g. ["BiasAdd", "Sigmoid"]) starting from the
+// `input` and writes the result into the `output`. Binary operations use the
+// value computed so far as the left operand and take the right operand from
+// `fusion_inputs` in order. `output` must have the shape of the `input`, and
+// can share its buffer.
+//
+// The chain is evaluated in a single pass over memory: each block of the
+// output goes through all the operations while it is in cache, and no
+// intermediate tensors are allocated.
+template <typename T, typename FuseInputsRange>
+void FusedCwise(const DenseHostTensor& input, DenseHostTensor* output,
+                FuseInputsRange fusion_inputs, ArrayRef<string_view> fused_ops,
+                const ExecutionContext& exec_ctx,
+                llvm::unique_function<void(Error)> on_done) {
+  static_assert(std::is_same<std::decay_t<decltype(fusion_inputs[0])>,
+                             DenseHostTensor>::value,
+                "fusion_inputs must be a range of DenseHostTensor");
+
+  if (input.shape() != output->shape())
+    return on_done(MakeStringError("tensor shape mismatch: ", input.shape(),
+                                   " vs. ", output->shape()));
+
+  auto steps = internal::MakeFusedCwiseSteps<T>(*output, fusion_inputs,
+                                                fused_ops);
+  if (!steps) return on_done(steps.takeError());
+
+  // Keep all the buffers alive until the chain is evaluated.
+  SmallVector<RCReference<HostBuffer>, 4> buffers;
+  buffers.push_back(input.buffer().CopyRef());
+  buffers.push_back(output->buffer().CopyRef());
+  for (int i = 0; i < fusion_inputs.size(); ++i)
+    buffers.push_back(fusion_inputs[i].buffer().CopyRef());
+
+  const T* in = DHTArrayView<T>(&input).data();
+  T* out = MutableDHTArrayView<T>(output).data();
+
+  auto compute = [in, out, steps = std::move(*steps)](size_t begin,
+                                                       size_t end) {
+    for (size_t offset = begin; offset < end;
+         offset += internal::kFusedCwiseBlockSize) {
+      size_t size = std::min(internal::kFusedCwiseBlockSize, end - offset);
+      T* block = out + offset;
+      if (in != out) std::memcpy(block, in + offset, size * sizeof(T));
+      for (const auto& step : steps) step.apply(step, block, offset, size);
+    }
+  };
+
+  ParallelFor(exec_ctx).Execute(
+      output->NumElements(),
+      ParallelFor::BlockSizes::Min(internal::kFusedCwiseMinParallelBlockSize),
+      std::move(compute),
+      [buffers = std::move(buffers), on_done = std::move(on_done)]() mutable {
+        on_done(Error::success());
+      });
+}
+
+template <typename T, typename FuseInputsRange>
+AsyncValueRef<Chain> FusedCwise(const DenseHostTensor& input,
+                                DenseHostTensor* output,
+                                FuseInputsRange fusion_inputs,
+                                ArrayRef<string_view> fused_ops,
+                                const ExecutionContext& exec_ctx) {
+  AsyncValueRef<Chain> chain =
+      MakeConstructedAsyncValueRef<Chain>(exec_ctx.host());
+
+  auto on_done = [chain = chain.CopyRef()](Error err) {
+    err ? chain.SetError(err) : chain.SetStateConcrete();
+  };
+
+  FusedCwise<T>(input, output, fusion_inputs, fused_ops, exec_ctx,
+                std::move(on_done));
+
+  return chain;
+}
+
+}  // namespace cpu
+}  // namespace tfrt
+
+#endif  // TFRT_BACKENDS_CPU_LIB_KERNELS_CPU_FUSED_CWISE_KERNEL_H_
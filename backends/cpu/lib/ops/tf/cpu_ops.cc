@@ -24,6 +24,7 @@
 #include "concat_op.h"
 #include "constant_ops.h"
 #include "cwise_binary_ops.h"
+#include "cwise_fusion_ops.h"
 #include "cwise_unary_ops.h"
 #include "matmul_fusion_ops.h"
 #include "matmul_ops.h"
@@ -52,8 +53,7 @@ namespace {
 static Expected<DenseHostTensor> TfConstOp(const OpAttrsRef& attrs,
                                            const TensorMetadata& dest_md,
                                            const ExecutionContext& exec_ctx) {
-  auto dest_alloc =
-      DenseHostTensor::CreateUninitialized(dest_md, exec_ctx.host());
+  auto dest_alloc = DenseHostTensor::CreateUninitialized(dest_md, exec_ctx);
   if (!dest_alloc) {
     return MakeStringError("out of memory allocating dht tensor");
   }
@@ -266,6 +266,7 @@ void RegisterTfCpuOps(CpuOpRegistry* op_registry) {
   RegisterTfConstantCpuOps(op_registry);
   RegisterTfUnaryCpuOps(op_registry);
   RegisterTfBinaryCpuOps(op_registry);
+  RegisterTfCwiseFusionCpuOps(op_registry);
   RegisterTfShapeCpuOps(op_registry);
   RegisterTfSofmaxCpuOps(op_registry);
   RegisterTfMatmulFusionCpuOps(op_registry);
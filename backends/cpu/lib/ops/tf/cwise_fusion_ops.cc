@@ -0,0 +1,94 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- cwise_fusion_ops.cc - ------------------------------------*- C++ -*-===//
+//
+// Tensorflow element-wise fusion operations.
+//
+//===----------------------------------------------------------------------===//
+
+#include "cwise_fusion_ops.h"
+
+#include "../../kernels/fused_cwise_kernel.h"
+#include "buffer_forwarding.h"
+#include "tfrt/core_runtime/op_attrs.h"
+#include "tfrt/core_runtime/op_utils.h"
+#include "tfrt/cpu/core_runtime/cpu_op_registry.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/chain.h"
+#include "tfrt/host_context/kernel_utils.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+#include "tfrt/tensor/tensor_serialize_utils.h"
+#include "type_dispatch.h"
+
+namespace tfrt {
+namespace {
+
+//===----------------------------------------------------------------------===//
+// tf._FusedCwise op
+//===----------------------------------------------------------------------===//
+
+// Evaluates a chain of element-wise operations (e.g. BiasAdd -> Sigmoid) in a
+// single pass over memory without materializing intermediate tensors. The
+// first operand is the chain input, the remaining operands are consumed in
+// order by the binary operations in `fused_ops`.
+static AsyncValueRef<DenseHostTensor> TfFusedCwiseOp(
+    Argument<DenseHostTensor> input,
+    RepeatedArguments<DenseHostTensor> fusion_inputs, const OpAttrsRef& attrs,
+    const TensorMetadata& output_md, const ExecutionContext& exec_ctx) {
+  // Forward input tensor or allocate new output tensor.
+  AsyncValueRef<DenseHostTensor> output =
+      ForwardInputOrAllocateOutput(exec_ctx, output_md, input);
+  if (output.IsError()) return output;
+
+  auto fused_ops_attr = attrs.GetAsserting<AggregateAttr>("fused_ops");
+  SmallVector<string_view, 4> fused_ops(fused_ops_attr.GetNumElements());
+  for (int i = 0; i < fused_ops_attr.GetNumElements(); ++i) {
+    fused_ops[i] = fused_ops_attr.GetAttribute(i).cast<StringAttr>().GetValue();
+  }
+
+  auto on_done = [output = output.CopyRef()](Error err) {
+    // Forward errors to the tensor output.
+    err ? output.SetError(err) : output.SetStateConcrete();
+  };
+
+  // Dispatch based on the input data type.
+  auto unsupported = [&](DType dtype) -> AsyncValueRef<DenseHostTensor> {
+    return EmitErrorAsync(exec_ctx, StrCat("Unsupported input dtype: ", dtype));
+  };
+
+  auto dispatch = [&](auto type_tag) -> AsyncValueRef<DenseHostTensor> {
+    using T = decltype(type_tag);
+    cpu::FusedCwise<T>(*input, &output.get(), fusion_inputs, fused_ops,
+                       exec_ctx, std::move(on_done));
+    return output.CopyRef();
+  };
+
+  // Unary functors in the chain (Sigmoid, Rsqrt, ...) are defined only for
+  // floating point types.
+  internal::TypeDispatch<float, double> type_dispatch(input->dtype());
+  return type_dispatch(dispatch, unsupported);
+}
+
+}  // namespace
+
+void RegisterTfCwiseFusionCpuOps(CpuOpRegistry* op_registry) {
+  op_registry->AddOp("tf._FusedCwise", TFRT_CPU_OP(TfFusedCwiseOp),
+                     CpuOpFlags::NoSideEffects, {"fused_ops"});
+}
+
+}  // namespace tfrt
@@ -0,0 +1,92 @@
+// Copyright 2020 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// RUN: bef_executor --test_init_function=register_op_handlers_cpu $(bef_name %s) | FileCheck %s --dump-input=fail
+
+func @register_op_handlers_cpu() {
+  %null = "corert.create_null_op_handler"() : () -> !corert.ophandler
+  %cpu = "corert.create_cpu_op_handler"(%null) : (!corert.ophandler) -> !corert.ophandler
+  corert.register_op_handler %cpu "cpu"
+  tfrt.return
+}
+
+// Element-wise chain BiasAdd -> Sigmoid -> Mul -> Relu executed as separate ops,
+// each allocating an intermediate tensor.
+// CHECK-LABEL: --- Running 'BM_CwiseChain_1024x1024_f32'
+func @BM_CwiseChain_1024x1024_f32() {
+  %ch0 = tfrt.new.chain
+  %cpu = corert.get_op_handler %ch0 "cpu"
+
+  %input = corert.executeop(%cpu) "tfrt_test.create_dense_tensor"()
+    { shape = [1024, 1024], values = [1.0 : f32] } : 1
+
+  %bias = corert.executeop(%cpu) "tfrt_test.create_dense_tensor"()
+    { shape = [1024], values = [1.0 : f32] } : 1
+
+  %scale = corert.executeop(%cpu) "tfrt_test.create_dense_tensor"()
+    { shape = [1], values = [2.0 : f32] } : 1
+
+  tfrt_test.benchmark "BM_CwiseChain_1024x1024_f32"(
+      %cpu     : !corert.ophandler,
+      %input   : !corert.tensorhandle,
+      %bias    : !corert.tensorhandle,
+      %scale   : !corert.tensorhandle
+  )
+  duration_secs = 5, max_count = 1000000, num_warmup_runs = 10
+  {
+    %biased = corert.executeop(%cpu)
+      "tf.BiasAdd"(%input, %bias) { T = f32, data_format = "NHWC" } : 1
+    %sigmoid = corert.executeop(%cpu) "tf.Sigmoid"(%biased) : 1
+    %scaled = corert.executeop(%cpu) "tf.Mul"(%sigmoid, %scale) : 1
+    %result = corert.executeop(%cpu) "tf.Relu"(%scaled) : 1
+
+    tfrt.return %result : !corert.tensorhandle
+  }
+
+  tfrt.return
+}
+
+// The same chain evaluated in a single pass by tf._FusedCwise.
+// CHECK-LABEL: --- Running 'BM_FusedCwiseChain_1024x1024_f32'
+func @BM_FusedCwiseChain_1024x1024_f32() {
+  %ch0 = tfrt.new.chain
+  %cpu = corert.get_op_handler %ch0 "cpu"
+
+  %input = corert.executeop(%cpu) "tfrt_test.create_dense_tensor"()
+    { shape = [1024, 1024], values = [1.0 : f32] } : 1
+
+  %bias = corert.executeop(%cpu) "tfrt_test.create_dense_tensor"()
+    { shape = [1024], values = [1.0 : f32] } : 1
+
+  %scale = corert.executeop(%cpu) "tfrt_test.create_dense_tensor"()
+    { shape = [1], values = [2.0 : f32] } : 1
+
+  tfrt_test.benchmark "BM_FusedCwiseChain_1024x1024_f32"(
+      %cpu     : !corert.ophandler,
+      %input   : !corert.tensorhandle,
+      %bias    : !corert.tensorhandle,
+      %scale   : !corert.tensorhandle
+  )
+  duration_secs = 5, max_count = 1000000, num_warmup_runs = 10
+  {
+    %result = corert.executeop(%cpu)
+      "tf._FusedCwise"(%input, %bias, %scale) {
+        fused_ops = ["BiasAdd", "Sigmoid", "Mul", "Relu"]
+      } : 1
+
+    tfrt.return %result : !corert.tensorhandle
+  }
+
+  tfrt.return
+}
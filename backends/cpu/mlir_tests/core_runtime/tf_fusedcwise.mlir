@@ -0,0 +1,113 @@
+// Copyright 2020 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// RUN: bef_executor --test_init_function=register_op_handlers_cpu $(bef_name %s) | FileCheck %s --dump-input=fail
+
+func @register_op_handlers_cpu() {
+  %null = "corert.create_null_op_handler"() : () -> !corert.ophandler
+  %cpu = "corert.create_cpu_op_handler"(%null) : (!corert.ophandler) -> !corert.ophandler
+  corert.register_op_handler %cpu "cpu"
+  tfrt.return
+}
+
+
+// CHECK: --- Running 'fused_biasadd_relu'
+func @fused_biasadd_relu() -> !tfrt.chain {
+  %ch_1 = tfrt.new.chain
+  %cpu = corert.get_op_handler %ch_1 "cpu"
+
+  %input = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[[1.0, -2.0], [3.0, -4.0], [-5.0, 6.0]]> : tensor<3x2xf32> } : 1
+  %bias = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[1.5, 2.5]> : tensor<2xf32> } : 1
+  %output = corert.executeop(%cpu) "tf._FusedCwise"(%input, %bias)
+    { fused_ops = ["BiasAdd", "Relu"] } : 1
+
+  // CHECK: DenseHostTensor dtype = F32, shape = [3, 2], values = [2.500000e+00, 5.000000e-01, 4.500000e+00, 0.000000e+00, 0.000000e+00, 8.500000e+00]
+  %ch_2 = corert.executeop.seq(%cpu, %ch_1) "tfrt_test.print"(%output) : 0
+  tfrt.return %ch_2 : !tfrt.chain
+}
+
+// CHECK: --- Running 'fused_biasadd_relu_unaligned'
+func @fused_biasadd_relu_unaligned() -> !tfrt.chain {
+  %ch_1 = tfrt.new.chain
+  %cpu = corert.get_op_handler %ch_1 "cpu"
+
+  // The bias length is not a multiple of the packet size, so the bias runs
+  // start at unaligned offsets into the output and the bias.
+  %input = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[[1.0, 2.0, 3.0, 4.0, 5.0],
+                                  [-6.0, 7.0, -8.0, 9.0, -10.0],
+                                  [11.0, 12.0, 13.0, 14.0, 15.0],
+                                  [-16.0, 17.0, -18.0, 19.0, -20.0]]> : tensor<4x5xf32> } : 1
+  %bias = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[1.0, -2.0, 3.0, -4.0, 5.0]> : tensor<5xf32> } : 1
+  %output = corert.executeop(%cpu) "tf._FusedCwise"(%input, %bias)
+    { fused_ops = ["BiasAdd", "Relu"] } : 1
+
+  // CHECK: DenseHostTensor dtype = F32, shape = [4, 5], values = [2.000000e+00, 0.000000e+00, 6.000000e+00, 0.000000e+00, 1.000000e+01, 0.000000e+00, 5.000000e+00, 0.000000e+00, 5.000000e+00, 0.000000e+00, 1.200000e+01, 1.000000e+01, 1.600000e+01, 1.000000e+01, 2.000000e+01, 0.000000e+00, 1.500000e+01, 0.000000e+00, 1.500000e+01, 0.000000e+00]
+  %ch_2 = corert.executeop.seq(%cpu, %ch_1) "tfrt_test.print"(%output) : 0
+  tfrt.return %ch_2 : !tfrt.chain
+}
+
+// CHECK: --- Running 'fused_mul_add_scalar'
+func @fused_mul_add_scalar() -> !tfrt.chain {
+  %ch_1 = tfrt.new.chain
+  %cpu = corert.get_op_handler %ch_1 "cpu"
+
+  %input = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[1.0, 2.0, 3.0, 4.0]> : tensor<4xf32> } : 1
+  %mul = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[2.0, 2.0, 2.0, 2.0]> : tensor<4xf32> } : 1
+  %add = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<1.0> : tensor<f32> } : 1
+  %output = corert.executeop(%cpu) "tf._FusedCwise"(%input, %mul, %add)
+    { fused_ops = ["Mul", "AddV2"] } : 1
+
+  // CHECK: DenseHostTensor dtype = F32, shape = [4], values = [3.000000e+00, 5.000000e+00, 7.000000e+00, 9.000000e+00]
+  %ch_2 = corert.executeop.seq(%cpu, %ch_1) "tfrt_test.print"(%output) : 0
+  tfrt.return %ch_2 : !tfrt.chain
+}
+
+// CHECK: --- Running 'fused_sub_sigmoid'
+func @fused_sub_sigmoid() -> !tfrt.chain {
+  %ch_1 = tfrt.new.chain
+  %cpu = corert.get_op_handler %ch_1 "cpu"
+
+  %input = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[[1.0, 2.0], [3.0, 4.0]]> : tensor<2x2xf32> } : 1
+  %sub = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[[1.0, 2.0], [3.0, 4.0]]> : tensor<2x2xf32> } : 1
+  %output = corert.executeop(%cpu) "tf._FusedCwise"(%input, %sub)
+    { fused_ops = ["Sub", "Sigmoid"] } : 1
+
+  // CHECK: DenseHostTensor dtype = F32, shape = [2, 2], values = [5.000000e-01, 5.000000e-01, 5.000000e-01, 5.000000e-01]
+  %ch_2 = corert.executeop.seq(%cpu, %ch_1) "tfrt_test.print"(%output) : 0
+  tfrt.return %ch_2 : !tfrt.chain
+}
+
+// CHECK: --- Running 'fused_missing_fusion_input'
+func @fused_missing_fusion_input() -> !tfrt.chain {
+  %ch_1 = tfrt.new.chain
+  %cpu = corert.get_op_handler %ch_1 "cpu"
+
+  %input = corert.executeop(%cpu) "tf.Const"()
+    { dtype = f32, value = dense<[1.0, 2.0]> : tensor<2xf32> } : 1
+  // expected-error @+1 {{runtime error: missing fusion input for AddV2}}
+  %output = corert.executeop(%cpu) "tf._FusedCwise"(%input)
+    { fused_ops = ["AddV2"] } : 1
+
+  %ch_2 = corert.executeop.seq(%cpu, %ch_1) "tfrt_test.print"(%output) : 0
+  tfrt.return %ch_2 : !tfrt.chain
+}
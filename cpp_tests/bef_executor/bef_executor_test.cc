@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- bef_executor_test.cc -------------------------------------*- C++ -*-===//
+//
+// Unit tests and benchmarks for scheduling kernels of different streams in
+// the BEF executor.
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "test_bef_builder.h"
+#include "tfrt/bef_executor/bef_file.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/function.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/kernel_registry.h"
+
+namespace tfrt {
+namespace {
+
+std::unique_ptr<HostContext> CreateTestHostContext(int num_threads) {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedWorkQueue(num_threads, /*num_blocking_threads=*/1));
+}
+
+std::atomic<int> num_kernel_calls{0};
+
+void CountingKernel(AsyncKernelFrame* frame) { ++num_kernel_calls; }
+
+// Busy waits for 10us, which models a small compute kernel.
+void ComputeKernel(AsyncKernelFrame* frame) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(10);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+// Sleeps for 200us, which models a kernel waiting on a device or on I/O. This
+// exposes the parallelism across streams even on a machine with few cores.
+void SleepKernel(AsyncKernelFrame* frame) {
+  std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+// Returns a BEF file with a function "fn_0" of `num_kernels` kernels named
+// `kernel_name` that are all ready at the start, round robin over
+// `num_streams` streams.
+TestBEFBuffer CreateFanOutBEFFile(const std::string& kernel_name,
+                                  int num_kernels, int num_streams) {
+  std::vector<TestBEFKernel> kernels;
+  for (int i = 0; i < num_kernels; ++i)
+    kernels.push_back(TestBEFKernel(/*kernel_code=*/0, i % num_streams));
+  return CreateTestBEFFile({kernel_name}, {kernels});
+}
+
+void ExecuteFunction(const Function* fn, HostContext* host) {
+  auto req_ctx =
+      RequestContextBuilder(host, /*resource_context=*/nullptr).build();
+  ExecutionContext exec_ctx(std::move(*req_ctx));
+  fn->Execute(exec_ctx, /*arguments=*/{}, /*results=*/{});
+  host->Quiesce();
+}
+
+TEST(BEFExecutorTest, FanOutToManyStreams) {
+  auto host = CreateTestHostContext(/*num_threads=*/4);
+  host->GetMutableRegistry()->AddKernel("test.count", CountingKernel);
+
+  // Kernels in the same stream as the pseudo kernel run inline, the others
+  // are launched as one task per stream.
+  for (int num_streams : {1, 2, 7, 64}) {
+    TestBEFBuffer bef_buffer =
+        CreateFanOutBEFFile("test.count", /*num_kernels=*/256, num_streams);
+    auto bef = BEFFile::Open(bef_buffer, host->GetKernelRegistry(),
+                             host->diag_handler(), host->allocator());
+    ASSERT_TRUE(bef);
+
+    num_kernel_calls = 0;
+    ExecuteFunction(bef->GetFunction("fn_0"), host.get());
+    EXPECT_EQ(num_kernel_calls, 256);
+  }
+}
+
+// Executes a function of 256 `kernel_name` kernels spread over state.range(0)
+// streams.
+void BM_FanOut(benchmark::State& state, const std::string& kernel_name,
+               AsyncKernelImplementation kernel) {
+  auto host = CreateTestHostContext(/*num_threads=*/4);
+  host->GetMutableRegistry()->AddKernel(kernel_name, kernel);
+
+  TestBEFBuffer bef_buffer = CreateFanOutBEFFile(
+      kernel_name, /*num_kernels=*/256, /*num_streams=*/state.range(0));
+  auto bef = BEFFile::Open(bef_buffer, host->GetKernelRegistry(),
+                           host->diag_handler(), host->allocator());
+  const Function* fn = bef->GetFunction("fn_0");
+
+  for (auto _ : state) ExecuteFunction(fn, host.get());
+}
+
+void BM_FanOutCompute(benchmark::State& state) {
+  BM_FanOut(state, "test.compute", ComputeKernel);
+}
+void BM_FanOutSleep(benchmark::State& state) {
+  BM_FanOut(state, "test.sleep", SleepKernel);
+}
+
+BENCHMARK(BM_FanOutCompute)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->UseRealTime();
+BENCHMARK(BM_FanOutSleep)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->UseRealTime();
+
+}  // namespace
+}  // namespace tfrt
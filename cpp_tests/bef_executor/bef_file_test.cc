@@ -0,0 +1,165 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- bef_file_test.cc -----------------------------------------*- C++ -*-===//
+//
+// Unit tests and open latency benchmarks for lazily opened BEF files.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/bef_executor/bef_file.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "test_bef_builder.h"
+#include "tfrt/host_context/async_value.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/function.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/kernel_registry.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace {
+
+std::unique_ptr<HostContext> CreateTestHostContext() {
+  return std::make_unique<HostContext>([](const DecodedDiagnostic&) {},
+                                       CreateMallocAllocator(),
+                                       CreateSingleThreadedWorkQueue());
+}
+
+std::atomic<int> num_kernel_calls{0};
+
+void CountingKernel(AsyncKernelFrame* frame) { ++num_kernel_calls; }
+
+void ExecuteFunction(const Function* fn, HostContext* host) {
+  auto req_ctx =
+      RequestContextBuilder(host, /*resource_context=*/nullptr).build();
+  ExecutionContext exec_ctx(std::move(*req_ctx));
+  fn->Execute(exec_ctx, /*arguments=*/{}, /*results=*/{});
+  host->Quiesce();
+}
+
+TEST(BEFFileTest, LazyOpenExecutesFunction) {
+  auto host = CreateTestHostContext();
+  host->GetMutableRegistry()->AddKernel("test.count", CountingKernel);
+
+  TestBEFBuffer bef_buffer = CreateTestBEFFile({"test.count"}, {{0, 0, 0}});
+  std::vector<std::string> errors;
+  auto bef = BEFFile::Open(
+      bef_buffer, host->GetKernelRegistry(),
+      [&](DecodedDiagnostic diag) { errors.push_back(diag.message); },
+      host->allocator(), /*lazy=*/true);
+  ASSERT_TRUE(bef);
+
+  const Function* fn = bef->GetFunction("fn_0");
+  ASSERT_NE(fn, nullptr);
+
+  num_kernel_calls = 0;
+  ExecuteFunction(fn, host.get());
+  EXPECT_EQ(num_kernel_calls, 3);
+
+  // The second execution reuses the decoded layout.
+  ExecuteFunction(fn, host.get());
+  EXPECT_EQ(num_kernel_calls, 6);
+  EXPECT_TRUE(errors.empty());
+}
+
+TEST(BEFFileTest, UnknownKernelFailsEagerOpen) {
+  auto host = CreateTestHostContext();
+  host->GetMutableRegistry()->AddKernel("test.count", CountingKernel);
+
+  TestBEFBuffer bef_buffer =
+      CreateTestBEFFile({"test.count", "test.unknown"}, {{0}, {1}});
+  std::vector<std::string> errors;
+  auto bef = BEFFile::Open(
+      bef_buffer, host->GetKernelRegistry(),
+      [&](DecodedDiagnostic diag) { errors.push_back(diag.message); },
+      host->allocator());
+  EXPECT_FALSE(bef);
+  ASSERT_EQ(errors.size(), 1);
+  EXPECT_EQ(errors[0], "unknown kernel name 'test.unknown'");
+}
+
+TEST(BEFFileTest, UnknownKernelReportedOnLazyExecution) {
+  auto host = CreateTestHostContext();
+  host->GetMutableRegistry()->AddKernel("test.count", CountingKernel);
+
+  TestBEFBuffer bef_buffer =
+      CreateTestBEFFile({"test.count", "test.unknown"}, {{0}, {1}});
+  std::vector<std::string> errors;
+  auto bef = BEFFile::Open(
+      bef_buffer, host->GetKernelRegistry(),
+      [&](DecodedDiagnostic diag) { errors.push_back(diag.message); },
+      host->allocator(), /*lazy=*/true);
+  ASSERT_TRUE(bef);
+  EXPECT_TRUE(errors.empty());
+
+  // Functions that only use registered kernels are unaffected.
+  num_kernel_calls = 0;
+  ExecuteFunction(bef->GetFunction("fn_0"), host.get());
+  EXPECT_EQ(num_kernel_calls, 1);
+  EXPECT_TRUE(errors.empty());
+
+  ExecuteFunction(bef->GetFunction("fn_1"), host.get());
+  ASSERT_EQ(errors.size(), 1);
+  EXPECT_EQ(errors[0], "unknown kernel name 'test.unknown'");
+
+  // The error is sticky, the layout is not decoded again.
+  ExecuteFunction(bef->GetFunction("fn_1"), host.get());
+  EXPECT_EQ(errors.size(), 1);
+}
+
+// Open latency benchmarks: the time to open a BEF file with state.range(0)
+// functions of 32 kernels each, out of 64 distinct kernels.
+TestBEFBuffer CreateBenchmarkBEFFile(HostContext* host, int num_functions) {
+  std::vector<std::string> kernel_names;
+  for (int i = 0; i < 64; ++i) {
+    kernel_names.push_back(StrCat("test.kernel.", i));
+    host->GetMutableRegistry()->AddKernel(kernel_names.back(), CountingKernel);
+  }
+  std::vector<std::vector<TestBEFKernel>> functions(num_functions);
+  for (int i = 0; i < num_functions; ++i)
+    for (int k = 0; k < 32; ++k) functions[i].push_back((i + k) % 64);
+  return CreateTestBEFFile(kernel_names, functions);
+}
+
+void BM_OpenBEF(benchmark::State& state, bool lazy) {
+  auto host = CreateTestHostContext();
+  TestBEFBuffer bef_buffer = CreateBenchmarkBEFFile(host.get(), state.range(0));
+
+  for (auto _ : state) {
+    auto bef = BEFFile::Open(bef_buffer, host->GetKernelRegistry(),
+                             host->diag_handler(), host->allocator(), lazy);
+    benchmark::DoNotOptimize(bef);
+  }
+}
+
+void BM_OpenEager(benchmark::State& state) { BM_OpenBEF(state, false); }
+void BM_OpenLazy(benchmark::State& state) { BM_OpenBEF(state, true); }
+
+BENCHMARK(BM_OpenEager)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(BM_OpenLazy)->Arg(16)->Arg(256)->Arg(4096);
+
+}  // namespace
+}  // namespace tfrt
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- mapped_bef_file_test.cc ----------------------------------*- C++ -*-===//
+//
+// Unit tests and startup benchmarks for MappedBEFFile.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/bef_executor/mapped_bef_file.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/bef_converter/bef_emitter.h"
+#include "tfrt/bef_executor/bef_file.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/aligned_buffer.h"
+#include "tfrt/support/bef_encoding.h"
+#include "tfrt/support/bef_reader.h"
+
+namespace tfrt {
+namespace {
+
+std::unique_ptr<HostContext> CreateTestHostContext() {
+  return std::make_unique<HostContext>([](const DecodedDiagnostic&) {},
+                                       CreateMallocAllocator(),
+                                       CreateSingleThreadedWorkQueue());
+}
+
+void EmitSection(BEFSectionID section_id, ArrayRef<uint8_t> data,
+                 BEFEmitter* emitter) {
+  emitter->EmitByte(static_cast<uint8_t>(section_id));
+  emitter->EmitInt(data.size() << 1);
+  emitter->EmitBytes(data);
+}
+
+// Writes a BEF file without functions, with an attributes section of
+// `attributes_size` bytes, which models the constant weights of a large model.
+// Returns the path to the file.
+std::string WriteTestBEFFile(size_t attributes_size) {
+  BEFEmitter emitter;
+  emitter.EmitByte(kBEFMagic1);
+  emitter.EmitByte(kBEFMagic2);
+  emitter.EmitByte(kBEFVersion0);
+
+  std::vector<uint8_t> attributes(attributes_size, 0xAB);
+  EmitSection(BEFSectionID::kAttributes, attributes, &emitter);
+
+  // Empty kernels, types and function index sections.
+  const uint8_t kZeroCount[] = {0};
+  EmitSection(BEFSectionID::kKernels, kZeroCount, &emitter);
+  EmitSection(BEFSectionID::kTypes, kZeroCount, &emitter);
+  EmitSection(BEFSectionID::kFunctionIndex, kZeroCount, &emitter);
+
+  llvm::SmallString<128> path;
+  EXPECT_FALSE(llvm::sys::fs::createTemporaryFile("test", "bef", path));
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  EXPECT_FALSE(ec);
+  auto result = emitter.TakeResult();
+  os.write(reinterpret_cast<const char*>(result.data()), result.size());
+
+  return path.str().str();
+}
+
+TEST(MappedBEFFileTest, OpenInPlace) {
+  std::string path = WriteTestBEFFile(1024);
+  auto host = CreateTestHostContext();
+
+  auto mapped = MappedBEFFile::Open(path);
+  ASSERT_TRUE(!!mapped);
+  ArrayRef<uint8_t> data = (*mapped)->data();
+  ASSERT_GT(data.size(), 1024);
+  EXPECT_EQ(data[0], kBEFMagic1);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(data.data()) %
+                BefGetRequiredAlignment(),
+            0);
+
+  auto bef = BEFFile::Open(data, host->GetKernelRegistry(),
+                           host->diag_handler(), host->allocator());
+  EXPECT_TRUE(bef);
+
+  llvm::sys::fs::remove(path);
+}
+
+TEST(MappedBEFFileTest, MissingFile) {
+  auto mapped = MappedBEFFile::Open("/nonexistent/file.bef");
+  EXPECT_FALSE(!!mapped);
+  llvm::consumeError(mapped.takeError());
+}
+
+TEST(MappedBEFFileTest, EmptyFile) {
+  llvm::SmallString<128> path;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("empty", "bef", path));
+
+  auto mapped = MappedBEFFile::Open(path.str());
+  EXPECT_FALSE(!!mapped);
+  llvm::consumeError(mapped.takeError());
+
+  llvm::sys::fs::remove(path);
+}
+
+// Startup benchmarks: the time to load and open a large BEF file.
+constexpr size_t kLargeBEFAttributesSize = 128 << 20;
+
+const std::string& GetLargeBEFFile() {
+  static std::string* path = [] {
+    auto* path = new std::string(WriteTestBEFFile(kLargeBEFAttributesSize));
+    std::atexit([] { llvm::sys::fs::remove(GetLargeBEFFile()); });
+    return path;
+  }();
+  return *path;
+}
+
+void BM_OpenCopiedBEF(benchmark::State& state) {
+  const std::string& path = GetLargeBEFFile();
+  auto host = CreateTestHostContext();
+
+  for (auto _ : state) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    AlignedBuffer<BefGetRequiredAlignment()> buffer(file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+
+    auto bef = BEFFile::Open(buffer, host->GetKernelRegistry(),
+                             host->diag_handler(), host->allocator());
+    benchmark::DoNotOptimize(bef);
+  }
+}
+
+void BM_OpenMappedBEF(benchmark::State& state) {
+  const std::string& path = GetLargeBEFFile();
+  auto host = CreateTestHostContext();
+
+  for (auto _ : state) {
+    auto mapped = MappedBEFFile::Open(path);
+    auto bef = BEFFile::Open((*mapped)->data(), host->GetKernelRegistry(),
+                             host->diag_handler(), host->allocator());
+    benchmark::DoNotOptimize(bef);
+  }
+}
+
+BENCHMARK(BM_OpenCopiedBEF);
+BENCHMARK(BM_OpenMappedBEF);
+
+}  // namespace
+}  // namespace tfrt
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- test_bef_builder.cc - Synthetic BEF files for tests ------*- C++ -*-===//
+//
+// This file implements helpers to build synthetic BEF files in C++.
+//
+//===----------------------------------------------------------------------===//
+
+#include "test_bef_builder.h"
+
+#include "tfrt/bef_converter/bef_emitter.h"
+#include "tfrt/support/bef_encoding.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace {
+
+void EmitSection(BEFSectionID section_id, ArrayRef<uint8_t> data,
+                 BEFEmitter* emitter, unsigned alignment = 1) {
+  emitter->EmitByte(static_cast<uint8_t>(section_id));
+  if (alignment == 1) {
+    emitter->EmitInt(data.size() << 1);
+  } else {
+    emitter->EmitInt(data.size() << 1 | 1);
+    emitter->EmitByte(alignment);
+    emitter->EmitAlignment(alignment);
+  }
+  emitter->EmitBytes(data);
+}
+
+void EmitKernelHeader(uint32_t kernel_code, uint32_t num_results,
+                      BEFEmitter* emitter) {
+  // kernel_code, location, num_arguments, num_attributes, num_functions,
+  // num_results and special_metadata.
+  const uint32_t header[] = {kernel_code, 0, 0, 0, 0, num_results, 0};
+  for (uint32_t entry : header) emitter->EmitInt4(entry);
+}
+
+}  // namespace
+
+TestBEFBuffer CreateTestBEFFile(
+    ArrayRef<std::string> kernel_names,
+    ArrayRef<std::vector<TestBEFKernel>> functions) {
+  BEFEmitter strings;
+  std::vector<size_t> kernel_name_offsets;
+  for (const auto& name : kernel_names) {
+    kernel_name_offsets.push_back(strings.size());
+    strings.EmitBytes(llvm::makeArrayRef(
+        reinterpret_cast<const uint8_t*>(name.c_str()), name.size() + 1));
+  }
+  std::vector<size_t> function_name_offsets;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    std::string name = StrCat("fn_", i);
+    function_name_offsets.push_back(strings.size());
+    strings.EmitBytes(llvm::makeArrayRef(
+        reinterpret_cast<const uint8_t*>(name.c_str()), name.size() + 1));
+  }
+
+  BEFEmitter kernels;
+  kernels.EmitInt(kernel_names.size());
+  for (size_t offset : kernel_name_offsets) kernels.EmitInt(offset);
+
+  BEFEmitter function_section;
+  BEFEmitter function_index;
+  function_index.EmitInt(functions.size());
+  for (size_t i = 0; i < functions.size(); ++i) {
+    ArrayRef<TestBEFKernel> function_kernels = functions[i];
+    size_t num_kernels = function_kernels.size();
+
+    function_index.EmitByte(static_cast<uint8_t>(FunctionKind::kBEFFunction));
+    function_index.EmitInt(function_section.size());
+    function_index.EmitInt(function_name_offsets[i]);
+    function_index.EmitInt(0);  // Arguments.
+    function_index.EmitInt(0);  // Results.
+
+    // Location and register table, there are no registers.
+    function_section.EmitInt(0);
+    function_section.EmitInt(0);
+
+    // Kernel index table. The argument pseudo kernel has one pseudo result
+    // used by all the kernels of the function.
+    size_t pseudo_kernel_size = (7 + 1 + 1 + num_kernels) * 4;
+    function_section.EmitInt(num_kernels + 1);
+    for (size_t k = 0; k <= num_kernels; ++k) {
+      size_t offset = k == 0 ? 0 : pseudo_kernel_size + (k - 1) * 7 * 4;
+      function_section.EmitInt(offset);
+      function_section.EmitInt(0);  // Operands.
+      function_section.EmitInt(k == 0 ? 0 : function_kernels[k - 1].stream_id);
+    }
+    function_section.EmitAlignment(kKernelEntryAlignment);
+
+    EmitKernelHeader(0xABABABAB, /*num_results=*/1, &function_section);
+    function_section.EmitInt4(num_kernels);  // Number of used_bys.
+    function_section.EmitInt4(0);            // The pseudo result register.
+    for (size_t k = 1; k <= num_kernels; ++k) function_section.EmitInt4(k);
+
+    for (const TestBEFKernel& kernel : function_kernels)
+      EmitKernelHeader(kernel.kernel_code, /*num_results=*/0,
+                       &function_section);
+  }
+
+  BEFEmitter emitter;
+  emitter.EmitByte(kBEFMagic1);
+  emitter.EmitByte(kBEFMagic2);
+  emitter.EmitByte(kBEFVersion0);
+  EmitSection(BEFSectionID::kStrings, strings.TakeResult(), &emitter);
+  EmitSection(BEFSectionID::kKernels, kernels.TakeResult(), &emitter);
+  const uint8_t kZeroCount[] = {0};
+  EmitSection(BEFSectionID::kTypes, kZeroCount, &emitter);
+  EmitSection(BEFSectionID::kFunctionIndex, function_index.TakeResult(),
+              &emitter);
+  EmitSection(BEFSectionID::kFunctions, function_section.TakeResult(),
+              &emitter, kKernelEntryAlignment);
+
+  auto result = emitter.TakeResult();
+  return TestBEFBuffer(result.begin(), result.end());
+}
+
+}  // namespace tfrt
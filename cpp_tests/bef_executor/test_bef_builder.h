@@ -0,0 +1,57 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- test_bef_builder.h - Synthetic BEF files for tests -------*- C++ -*-===//
+//
+// This file declares helpers to build synthetic BEF files in C++, for tests and
+// benchmarks of the BEF executor that do not depend on the MLIR converter.
+//
+//===----------------------------------------------------------------------===//
+#ifndef TFRT_CPP_TESTS_BEF_EXECUTOR_TEST_BEF_BUILDER_H_
+#define TFRT_CPP_TESTS_BEF_EXECUTOR_TEST_BEF_BUILDER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tfrt/support/aligned_buffer.h"
+#include "tfrt/support/bef_reader.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+
+using TestBEFBuffer = AlignedBuffer<BefGetRequiredAlignment()>;
+
+// A kernel of a test function. It takes no operands and produces no results.
+struct TestBEFKernel {
+  TestBEFKernel(uint32_t kernel_code, uint32_t stream_id = 0)
+      : kernel_code(kernel_code), stream_id(stream_id) {}
+
+  // Index into the kernel names of the BEF file.
+  uint32_t kernel_code;
+  uint32_t stream_id;
+};
+
+// Builds a BEF file with the specified kernels, and one function named
+// "fn_<i>" per element of `functions`, without arguments and results. All the
+// kernels of a function are ready at the start of its execution.
+TestBEFBuffer CreateTestBEFFile(
+    ArrayRef<std::string> kernel_names,
+    ArrayRef<std::vector<TestBEFKernel>> functions);
+
+}  // namespace tfrt
+
+#endif  // TFRT_CPP_TESTS_BEF_EXECUTOR_TEST_BEF_BUILDER_H_
@@ -84,6 +84,57 @@ TEST_F(CpuDriverTest, MatmulTest) {
   ASSERT_EQ(a2_view.Elements()[3], 8.0);
 }
 
+// Ops with concrete arguments are dispatched inline. Ops with pending arguments
+// produce results with available metadata, which resolve with the arguments.
+TEST_F(CpuDriverTest, MatmulWithPendingArgument) {
+  tfrt::OpAttrs attrs;
+  attrs.SetArray("shape", tfrt::ArrayRef<ssize_t>{2, 2});
+  attrs.SetArray("values", tfrt::ArrayRef<float>{2.0});
+  tfrt::TensorHandle a1;
+  driver_.Execute(driver_.CreateExecutionContext(__FILE__, __LINE__),
+                  "tfrt_test.create_dense_tensor", {}, attrs.freeze(), a1);
+  ASSERT_TRUE(a1.GetAsyncTensor()->IsConcrete());
+
+  auto* host = driver_.GetHostContext();
+  auto pending = MakeUnconstructedAsyncValueRef<DenseHostTensor>(host);
+  tfrt::TensorHandle a2(host->GetHostDeviceRef(), a1.GetAvailableMetadata(),
+                        AsyncValueRef<Tensor>(pending.CopyRCRef()));
+
+  tfrt::OpAttrs matmul_attrs;
+  matmul_attrs.Set<bool>("transpose_a", false);
+  matmul_attrs.Set<bool>("transpose_b", false);
+  tfrt::OpAttrsRef matmul_attrs_ref = matmul_attrs.freeze();
+  auto matmul_op = driver_.MakeOp("tfrt_test.matmul");
+
+  tfrt::TensorHandle concrete_args[2] = {a1.CopyRef(), a1.CopyRef()};
+  tfrt::TensorHandle a3;
+  matmul_op(driver_.CreateExecutionContext(__FILE__, __LINE__), concrete_args,
+            matmul_attrs_ref, a3, /*chain=*/nullptr);
+  ASSERT_TRUE(a3.GetAsyncTensor()->IsConcrete());
+  ASSERT_EQ(a3.GetAvailableMetadata().shape.GetRank(), 2);
+
+  tfrt::TensorHandle pending_args[2] = {a1.CopyRef(), a2.CopyRef()};
+  tfrt::TensorHandle a4;
+  matmul_op(driver_.CreateExecutionContext(__FILE__, __LINE__), pending_args,
+            matmul_attrs_ref, a4, /*chain=*/nullptr);
+  ASSERT_TRUE(a4.IsMetadataAvailable());
+  ASSERT_EQ(a4.GetAvailableMetadata().shape.GetRank(), 2);
+  ASSERT_FALSE(a4.GetAsyncTensor()->IsAvailable());
+
+  pending.emplace(a1.GetAsyncTensor()->get<DenseHostTensor>().CopyRef());
+  driver_.WaitForHostContextQuiesce();
+  ASSERT_TRUE(a4.GetAsyncTensor()->IsConcrete());
+
+  auto a3_view =
+      DHTArrayView<float>(&a3.GetAsyncTensor()->get<DenseHostTensor>());
+  auto a4_view =
+      DHTArrayView<float>(&a4.GetAsyncTensor()->get<DenseHostTensor>());
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(a3_view.Elements()[i], 8.0);
+    ASSERT_EQ(a4_view.Elements()[i], 8.0);
+  }
+}
+
 TEST_F(CpuDriverTest, ReluTest_InputForward) {
   tfrt::OpAttrs attrs;
   attrs.SetArray("shape", tfrt::ArrayRef<ssize_t>{2, 2});
@@ -0,0 +1,281 @@
+// Copyright 2020 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- execute_op_impl_test.cc --------------------------------------------===//
+//
+// This file has unit tests and dispatch latency benchmarks for PreparedOp and
+// PreparedOpCache.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/core_runtime/execute_op_impl.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "tfrt/bef_converter/bef_attr_encoder.h"
+#include "tfrt/core_runtime/core_runtime.h"
+#include "tfrt/core_runtime/op_handler.h"
+#include "tfrt/host_context/chain.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/support/error_util.h"
+
+namespace tfrt {
+namespace {
+
+// An OpHandler that counts MakeOp calls and supports a single op, "test.op",
+// which records its `n` attribute. The op has no results and is sequenced by
+// an op chain.
+class CountingOpHandler : public OpHandler {
+ public:
+  explicit CountingOpHandler(CoreRuntime* runtime)
+      : OpHandler("counting", runtime, /*fallback=*/nullptr) {}
+
+  Expected<CoreRuntimeOp> MakeOp(string_view op_name) override {
+    ++num_make_op_calls;
+    if (op_name != "test.op")
+      return MakeStringError(op_name, " is not supported.");
+    return CoreRuntimeOp(
+        [this](const OpInvocation& invocation) {
+          last_n = invocation.attrs.GetAsserting<int32_t>("n");
+        },
+        /*is_fallback=*/false);
+  }
+
+  int num_make_op_calls = 0;
+  int32_t last_n = 0;
+};
+
+std::unique_ptr<CoreRuntime> CreateCoreRuntime() {
+  auto corert = CoreRuntime::Create(
+      [](const DecodedDiagnostic& diag) {}, CreateMallocAllocator(),
+      CreateSingleThreadedWorkQueue());
+  assert(corert);
+  return std::move(*corert);
+}
+
+// Encodes `elements` as a BEF aggregate attribute into `emitter`.
+void EncodeAggregateAttr(ArrayRef<const BEFEmitter*> elements,
+                         BEFEmitter* emitter) {
+  assert(emitter->size() == 0);
+  size_t header_size = offsetof(BEFAggregateAttr, offsets) +
+                       sizeof(BEFAggregateAttrOffset32_t) * elements.size();
+  emitter->EmitAlignment(alignof(BEFAggregateAttr));
+  emitter->EmitRepeatedDummyByte(header_size);
+
+  SmallVector<BEFAggregateAttrOffset32_t, 4> offsets;
+  for (const auto* element : elements) {
+    emitter->EmitAlignment(element->GetRequiredAlignment());
+    offsets.push_back(emitter->size());
+    emitter->EmitEmitter(*element);
+  }
+
+  BEFAggregateAttr header;
+  header.base.type = BEFAttributeType::kAggregate;
+  header.num_elements = elements.size();
+  SetBEFAttrByteCount(emitter->size(), &header.base);
+  emitter->OverwriteBytes(0, &header, offsetof(BEFAggregateAttr, offsets));
+  emitter->OverwriteBytes(offsetof(BEFAggregateAttr, offsets), offsets.data(),
+                          sizeof(BEFAggregateAttrOffset32_t) * offsets.size());
+}
+
+// Encodes an op attribute array with one i32 attribute per element of
+// `values`, in the form that corert.executeop takes. The first attribute is
+// named `n` and the others `n<index>`.
+AlignedBuffer<BEFEmitter::kMaxAlignment> EncodeI32Attrs(
+    ArrayRef<int32_t> values) {
+  std::vector<std::unique_ptr<BEFEmitter>> pairs;
+  for (int i = 0, e = values.size(); i != e; ++i) {
+    BefAttrEncoder key;
+    auto error =
+        key.EncodeStringAttr(i == 0 ? std::string("n") : StrCat("n", i));
+    assert(!error);
+    (void)error;
+
+    BEFEmitter value;
+    value.EmitAlignment(alignof(BEFFixed32Attr));
+    BEFFixed32Attr attr;
+    attr.base.type = static_cast<BEFAttributeType>(DType::I32);
+    SetBEFAttrByteCount(sizeof(attr), &attr.base);
+    attr.data = values[i];
+    value.EmitBytes(llvm::makeArrayRef(reinterpret_cast<const uint8_t*>(&attr),
+                                       sizeof(attr)));
+
+    pairs.push_back(std::make_unique<BEFEmitter>());
+    EncodeAggregateAttr({&key, &value}, pairs.back().get());
+  }
+
+  SmallVector<const BEFEmitter*, 4> elements;
+  for (const auto& pair : pairs) elements.push_back(pair.get());
+  BEFEmitter emitter;
+  EncodeAggregateAttr(elements, &emitter);
+  return emitter.TakeResult();
+}
+
+AlignedBuffer<BEFEmitter::kMaxAlignment> EncodeString(string_view value) {
+  BefAttrEncoder encoder;
+  auto error = encoder.EncodeStringAttr(value);
+  assert(!error);
+  (void)error;
+  return encoder.TakeResult();
+}
+
+class ExecuteOpImplTest : public ::testing::Test {
+ protected:
+  ExecuteOpImplTest()
+      : core_rt_(CreateCoreRuntime()),
+        op_handler_(core_rt_.get()),
+        exec_ctx_(std::move(*RequestContextBuilder(core_rt_->GetHostContext(),
+                                                   /*resource_context=*/nullptr)
+                                  .build())),
+        op_name_buffer_(EncodeString("test.op")),
+        op_name_(op_name_buffer_.data()),
+        chain_(GetReadyChain(core_rt_->GetHostContext())) {}
+
+  std::unique_ptr<CoreRuntime> core_rt_;
+  CountingOpHandler op_handler_;
+  ExecutionContext exec_ctx_;
+  AlignedBuffer<BEFEmitter::kMaxAlignment> op_name_buffer_;
+  StringAttr op_name_;
+  AsyncValueRef<Chain> chain_;
+};
+
+TEST_F(ExecuteOpImplTest, PreparedOpHasFrozenAttributes) {
+  auto attrs = EncodeI32Attrs({42, 7});
+  auto prepared = PrepareOp(core_rt_.get(), "test.op", &op_handler_,
+                            AggregateAttr(attrs.data()),
+                            /*op_func_attr_array=*/AggregateAttr());
+  ASSERT_TRUE(!!prepared);
+  EXPECT_EQ((*prepared)->attrs.GetNumEntries(), 2);
+  // The frozen attributes do not refer to the encoded attributes.
+  attrs.clear();
+
+  ExecuteOpImpl((*prepared)->op, /*args=*/{}, &chain_, /*results=*/{},
+                (*prepared)->attrs, exec_ctx_);
+  EXPECT_EQ(op_handler_.last_n, 42);
+}
+
+TEST_F(ExecuteOpImplTest, CachePreparesEachKernelOnce) {
+  auto attrs = EncodeI32Attrs({1});
+  PreparedOpCache cache;
+
+  auto first = cache.GetOrPrepare(core_rt_.get(), op_name_, &op_handler_,
+                                  AggregateAttr(attrs.data()),
+                                  /*op_func_attr_array=*/AggregateAttr());
+  ASSERT_TRUE(!!first);
+  auto second = cache.GetOrPrepare(core_rt_.get(), op_name_, &op_handler_,
+                                   AggregateAttr(attrs.data()),
+                                   /*op_func_attr_array=*/AggregateAttr());
+  ASSERT_TRUE(!!second);
+  EXPECT_EQ(*first, *second);
+  EXPECT_EQ(op_handler_.num_make_op_calls, 1);
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST_F(ExecuteOpImplTest, CacheSeparatesAttributesAndOpHandlers) {
+  auto attrs = EncodeI32Attrs({1});
+  auto other_attrs = EncodeI32Attrs({2});
+  CountingOpHandler other_op_handler(core_rt_.get());
+  PreparedOpCache cache;
+
+  auto first = cache.GetOrPrepare(core_rt_.get(), op_name_, &op_handler_,
+                                  AggregateAttr(attrs.data()),
+                                  /*op_func_attr_array=*/AggregateAttr());
+  auto second = cache.GetOrPrepare(core_rt_.get(), op_name_, &op_handler_,
+                                   AggregateAttr(other_attrs.data()),
+                                   /*op_func_attr_array=*/AggregateAttr());
+  auto third = cache.GetOrPrepare(core_rt_.get(), op_name_, &other_op_handler,
+                                  AggregateAttr(attrs.data()),
+                                  /*op_func_attr_array=*/AggregateAttr());
+  ASSERT_TRUE(first && second && third);
+  EXPECT_NE(*first, *second);
+  EXPECT_NE(*first, *third);
+  EXPECT_EQ(op_handler_.num_make_op_calls, 2);
+  EXPECT_EQ(other_op_handler.num_make_op_calls, 1);
+  EXPECT_EQ(cache.size(), 3);
+
+  ExecuteOpImpl((*second)->op, /*args=*/{}, &chain_, /*results=*/{},
+                (*second)->attrs, exec_ctx_);
+  EXPECT_EQ(op_handler_.last_n, 2);
+}
+
+TEST_F(ExecuteOpImplTest, CacheDoesNotKeepErrors) {
+  auto attrs = EncodeI32Attrs({1});
+  auto unknown_op_name = EncodeString("test.unknown");
+  PreparedOpCache cache;
+
+  for (int i = 0; i < 2; ++i) {
+    auto prepared = cache.GetOrPrepare(
+        core_rt_.get(), StringAttr(unknown_op_name.data()), &op_handler_,
+        AggregateAttr(attrs.data()), /*op_func_attr_array=*/AggregateAttr());
+    ASSERT_FALSE(!!prepared);
+    EXPECT_EQ(StrCat(prepared.takeError()),
+              "test.unknown is not supported.");
+  }
+  EXPECT_EQ(op_handler_.num_make_op_calls, 2);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+// Per-op dispatch latency of an op with state.range(0) attributes when the op
+// is looked up and its attributes are set up on every execution.
+void BM_ExecuteOpUnprepared(benchmark::State& state) {
+  auto core_rt = CreateCoreRuntime();
+  CountingOpHandler op_handler(core_rt.get());
+  ExecutionContext exec_ctx(std::move(
+      *RequestContextBuilder(core_rt->GetHostContext(), nullptr).build()));
+  auto chain = GetReadyChain(core_rt->GetHostContext());
+  auto attrs = EncodeI32Attrs(std::vector<int32_t>(state.range(0), 1));
+  auto func_attrs = EncodeI32Attrs({});
+
+  for (auto _ : state) {
+    auto op = core_rt->MakeOp("test.op", &op_handler);
+    ExecuteOpImpl(std::move(*op), /*args=*/{}, &chain, /*results=*/{},
+                  AggregateAttr(attrs.data()),
+                  AggregateAttr(func_attrs.data()), exec_ctx);
+  }
+}
+BENCHMARK(BM_ExecuteOpUnprepared)->Arg(1)->Arg(8);
+
+// Same as above, but with the op and its attributes prepared once and looked
+// up in a PreparedOpCache, as corert.executeop does.
+void BM_ExecuteOpPrepared(benchmark::State& state) {
+  auto core_rt = CreateCoreRuntime();
+  CountingOpHandler op_handler(core_rt.get());
+  ExecutionContext exec_ctx(std::move(
+      *RequestContextBuilder(core_rt->GetHostContext(), nullptr).build()));
+  auto chain = GetReadyChain(core_rt->GetHostContext());
+  auto attrs = EncodeI32Attrs(std::vector<int32_t>(state.range(0), 1));
+  auto op_name = EncodeString("test.op");
+  PreparedOpCache cache;
+
+  for (auto _ : state) {
+    auto prepared = cache.GetOrPrepare(
+        core_rt.get(), StringAttr(op_name.data()), &op_handler,
+        AggregateAttr(attrs.data()), /*op_func_attr_array=*/AggregateAttr());
+    ExecuteOpImpl((*prepared)->op, /*args=*/{}, &chain, /*results=*/{},
+                  (*prepared)->attrs, exec_ctx);
+  }
+}
+BENCHMARK(BM_ExecuteOpPrepared)->Arg(1)->Arg(8);
+
+}  // namespace
+}  // namespace tfrt
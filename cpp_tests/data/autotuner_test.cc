@@ -0,0 +1,198 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- autotuner_test.cc ----------------------------------------*- C++ -*-===//
+//
+// Unit tests for the Autotuner and TunableParameter.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../lib/data/autotuner.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "../../lib/data/parallel_map_dataset.h"
+#include "../../lib/data/range_dataset.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/native_function.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+constexpr auto kBufferSize = TunableParameter::Kind::kBufferSize;
+constexpr auto kParallelism = TunableParameter::Kind::kParallelism;
+
+std::unique_ptr<HostContext> CreateTestHostContext(int num_threads) {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedWorkQueue(num_threads, /*num_blocking_threads=*/1));
+}
+
+// Records `num_windows` full windows of GetNext() calls.
+void RecordWindows(TunableParameter* parameter, int num_windows, bool ready,
+                   bool over_provisioned) {
+  for (int i = 0; i < num_windows * TunableParameter::kWindowSize; ++i)
+    parameter->RecordGetNext(ready, over_provisioned);
+}
+
+std::string GetStats(HostContext* host) {
+  std::string stats;
+  llvm::raw_string_ostream os(stats);
+  host->GetOrCreateSharedContext<Autotuner>().PrintStats(os);
+  return os.str();
+}
+
+class AutotunerTest : public ::testing::Test {
+ protected:
+  AutotunerTest()
+      : host_(CreateTestHostContext(4)),
+        autotuner_(host_->GetOrCreateSharedContext<Autotuner>()) {}
+
+  std::unique_ptr<HostContext> host_;
+  Autotuner& autotuner_;
+};
+
+TEST_F(AutotunerTest, BufferSizeDoublesWhileConsumerWaits) {
+  TunableParameter parameter("buffer", kBufferSize, /*min=*/1, /*max=*/12,
+                             /*initial=*/2, /*autotune=*/true, host_.get());
+  // Waiting for no more than one in eight calls does not change the value.
+  for (int i = 0; i < TunableParameter::kWindowSize; ++i)
+    parameter.RecordGetNext(/*ready=*/i % 8 != 0, /*over_provisioned=*/false);
+  EXPECT_EQ(parameter.value(), 2);
+
+  RecordWindows(&parameter, 1, /*ready=*/false, /*over_provisioned=*/false);
+  EXPECT_EQ(parameter.value(), 4);
+  RecordWindows(&parameter, 1, /*ready=*/false, /*over_provisioned=*/false);
+  EXPECT_EQ(parameter.value(), 8);
+  // The value does not grow beyond its maximum.
+  RecordWindows(&parameter, 2, /*ready=*/false, /*over_provisioned=*/false);
+  EXPECT_EQ(parameter.value(), 12);
+}
+
+TEST_F(AutotunerTest, ParallelismGrowsWithinCpuBudget) {
+  autotuner_.SetCpuBudget(3);
+  TunableParameter first("first", kParallelism, /*min=*/1, /*max=*/8,
+                         /*initial=*/1, /*autotune=*/true, host_.get());
+  TunableParameter second("second", kParallelism, /*min=*/1, /*max=*/8,
+                          /*initial=*/1, /*autotune=*/true, host_.get());
+
+  RecordWindows(&first, 4, /*ready=*/false, /*over_provisioned=*/false);
+  EXPECT_EQ(first.value(), 2);
+  RecordWindows(&second, 4, /*ready=*/false, /*over_provisioned=*/false);
+  EXPECT_EQ(second.value(), 1);
+}
+
+TEST_F(AutotunerTest, ShrinksAfterQuietWindows) {
+  TunableParameter parameter("buffer", kBufferSize, /*min=*/1, /*max=*/64,
+                             /*initial=*/16, /*autotune=*/true, host_.get());
+  RecordWindows(&parameter, TunableParameter::kQuietWindows - 1,
+                /*ready=*/true, /*over_provisioned=*/true);
+  EXPECT_EQ(parameter.value(), 16);
+  RecordWindows(&parameter, 1, /*ready=*/true, /*over_provisioned=*/true);
+  EXPECT_EQ(parameter.value(), 12);
+
+  // A window in which the buffer was not over-provisioned starts over.
+  RecordWindows(&parameter, TunableParameter::kQuietWindows - 1,
+                /*ready=*/true, /*over_provisioned=*/true);
+  RecordWindows(&parameter, 1, /*ready=*/true, /*over_provisioned=*/false);
+  RecordWindows(&parameter, TunableParameter::kQuietWindows - 1,
+                /*ready=*/true, /*over_provisioned=*/true);
+  EXPECT_EQ(parameter.value(), 12);
+}
+
+TEST_F(AutotunerTest, PrintStats) {
+  autotuner_.SetBufferBudget(100);
+  {
+    TunableParameter fixed("fixed_buffer", kBufferSize, /*min=*/8, /*max=*/8,
+                           /*initial=*/8, /*autotune=*/false, host_.get());
+    TunableParameter tuned("tuned_buffer", kBufferSize, /*min=*/1,
+                           /*max=*/64, /*initial=*/4, /*autotune=*/true,
+                           host_.get());
+    RecordWindows(&fixed, 1, /*ready=*/false, /*over_provisioned=*/false);
+    RecordWindows(&tuned, 1, /*ready=*/false, /*over_provisioned=*/false);
+    EXPECT_EQ(fixed.value(), 8);
+
+    std::string stats = GetStats(host_.get());
+    EXPECT_THAT(stats, HasSubstr("buffer 8/100 elements"));
+    EXPECT_THAT(stats, HasSubstr("fixed_buffer: value 8 in [8, 8] fixed, "
+                                 "get_next 32, waits 32, grows 0, shrinks 0"));
+    EXPECT_THAT(stats, HasSubstr("tuned_buffer: value 8 in [1, 64] autotuned, "
+                                 "get_next 32, waits 32, grows 1, shrinks 0"));
+  }
+  // Destroyed parameters return their budget.
+  std::string stats = GetStats(host_.get());
+  EXPECT_THAT(stats, HasSubstr("buffer 0/100 elements"));
+  EXPECT_THAT(stats, Not(HasSubstr("tuned_buffer")));
+}
+
+// A map function that is slow enough that a consumer with one invocation in
+// flight always has to wait.
+void SlowTimesTwo(AsyncValue* const* arguments, int num_arguments,
+                  RCReference<AsyncValue>* results, int num_results,
+                  HostContext* host) {
+  int64_t value = arguments[0]->get<int64_t>();
+  std::this_thread::sleep_for(std::chrono::microseconds(200));
+  results[0] = MakeAvailableAsyncValueRef<int64_t>(host, value * 2);
+}
+
+TEST_F(AutotunerTest, AutotunedParallelMapDataset) {
+  ExecutionContext exec_ctx(
+      std::move(*RequestContextBuilder(host_.get(), nullptr).build()));
+  auto i64 = host_->GetKernelRegistry().GetType("i64");
+  NativeFunction map_fn("slow_times_two", ArrayRef<TypeName>(i64),
+                        ArrayRef<TypeName>(i64), &SlowTimesTwo);
+
+  auto range = TakeRef(host_->Construct<RangeDataset>(
+      0, 400, 1, DType(DType::I64), host_.get()));
+  auto dataset = TakeRef(host_->Construct<ParallelMapDataset>(
+      std::move(range), kAutotune, /*is_deterministic=*/true,
+      RCArray<AsyncValue>(ArrayRef<AsyncValue*>()), FormRef(&map_fn),
+      host_.get()));
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  for (int i = 0; i < 400; ++i) {
+    auto result = iterator->GetNext(exec_ctx);
+    SmallVector<RCReference<AsyncValue>, 4> values;
+    for (auto* value : result.AsyncValues()) values.push_back(FormRef(value));
+    host_->Await(values);
+    ASSERT_FALSE(result.eof.get());
+    EXPECT_EQ(result.values[0]->get<int64_t>(), 2 * i);
+  }
+
+  // The number of parallel calls grows to the number of worker threads.
+  EXPECT_THAT(GetStats(host_.get()),
+              HasSubstr("parallel_map_dataset.num_parallel_calls: value 4 in "
+                        "[1, 4] autotuned"));
+  iterator.reset();
+  host_->Quiesce();
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
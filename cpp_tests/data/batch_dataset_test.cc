@@ -0,0 +1,237 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- batch_dataset_test.cc ------------------------------------*- C++ -*-===//
+//
+// Unit tests and throughput benchmarks for BatchDataset.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../lib/data/batch_dataset.h"
+
+#include <numeric>
+#include <vector>
+
+#include "../../lib/data/parallel_map_dataset.h"
+#include "../../lib/data/slice_dataset.h"
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/native_function.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+std::unique_ptr<HostContext> CreateTestHostContext() {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedWorkQueue(/*num_threads=*/4,
+                                   /*num_blocking_threads=*/1));
+}
+
+// Returns an i32 tensor with dimensions `dims` whose elements count up from
+// `first`.
+DenseHostTensor MakeTensor(ArrayRef<ssize_t> dims, int32_t first,
+                           HostContext* host) {
+  auto dht = DenseHostTensor::CreateUninitialized(
+      TensorMetadata(DType(DType::I32), dims), host);
+  auto* data = static_cast<int32_t*>(dht->data());
+  std::iota(data, data + dht->NumElements(), first);
+  return std::move(*dht);
+}
+
+std::vector<ssize_t> GetDimensions(const DenseHostTensor& tensor) {
+  SmallVector<ssize_t, 4> dims;
+  tensor.shape().GetDimensions(&dims);
+  return {dims.begin(), dims.end()};
+}
+
+std::vector<int32_t> GetValues(const DenseHostTensor& tensor) {
+  auto* data = static_cast<const int32_t*>(tensor.data());
+  return {data, data + tensor.NumElements()};
+}
+
+// Forwards its argument, so that a ParallelMapDataset returns its input
+// elements asynchronously.
+void Identity(AsyncValue* const* arguments, int num_arguments,
+              RCReference<AsyncValue>* results, int num_results,
+              HostContext* host) {
+  results[0] = FormRef(arguments[0]);
+}
+
+class BatchDatasetTest : public ::testing::Test {
+ protected:
+  BatchDatasetTest()
+      : host_(CreateTestHostContext()),
+        exec_ctx_(std::move(
+            *RequestContextBuilder(host_.get(), /*resource_context=*/nullptr)
+                 .build())) {
+    auto tensor = host_->GetKernelRegistry().GetType("!t.tensor");
+    identity_fn_ = std::make_unique<NativeFunction>(
+        "identity", /*argument_types=*/ArrayRef<TypeName>(tensor),
+        /*result_types=*/ArrayRef<TypeName>(tensor), &Identity);
+  }
+
+  ~BatchDatasetTest() override { host_->Quiesce(); }
+
+  // Returns an iterator over batches of `tensors`. If `pending` is true, the
+  // input elements become available only after GetNext() returns.
+  RCReference<Iterator> MakeIterator(std::vector<DenseHostTensor> tensors,
+                                     int64_t batch_size, bool pad,
+                                     bool pending = false) {
+    RCReference<Dataset> input =
+        TakeRef(host_->Construct<SliceDataset<DenseHostTensor>>(
+            std::move(tensors), host_.get()));
+    if (pending) {
+      input = TakeRef(host_->Construct<ParallelMapDataset>(
+          std::move(input), /*num_parallel_calls=*/1,
+          /*is_deterministic=*/true,
+          RCArray<AsyncValue>(ArrayRef<AsyncValue*>()),
+          FormRef(identity_fn_.get()), host_.get()));
+    }
+    auto dataset = TakeRef(host_->Construct<BatchDataset<DenseHostTensor>>(
+        std::move(input), batch_size, /*same_input_metadata=*/!pad, pad,
+        host_.get()));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  IterationResult AwaitNext(Iterator* iterator) {
+    auto result = iterator->GetNext(exec_ctx_);
+    SmallVector<RCReference<AsyncValue>, 4> values;
+    for (auto* value : result.AsyncValues()) values.push_back(FormRef(value));
+    host_->Await(values);
+    return result;
+  }
+
+  // Batches ten [2, 3] tensors with a batch size of four.
+  void ExpectUniformBatches(bool pending) {
+    std::vector<DenseHostTensor> tensors;
+    for (int i = 0; i < 10; ++i)
+      tensors.push_back(MakeTensor({2, 3}, i * 6, host_.get()));
+    auto iterator = MakeIterator(std::move(tensors), /*batch_size=*/4,
+                                 /*pad=*/false, pending);
+
+    for (int batch = 0; batch < 3; ++batch) {
+      auto result = AwaitNext(iterator.get());
+      ASSERT_FALSE(result.eof.get());
+      ASSERT_FALSE(result.values[0]->IsError());
+      auto& tensor = result.values[0]->get<DenseHostTensor>();
+      const int batch_size = batch < 2 ? 4 : 2;
+      EXPECT_EQ(GetDimensions(tensor),
+                std::vector<ssize_t>({batch_size, 2, 3}));
+      std::vector<int32_t> expected(batch_size * 6);
+      std::iota(expected.begin(), expected.end(), batch * 24);
+      EXPECT_EQ(GetValues(tensor), expected);
+    }
+    auto result = AwaitNext(iterator.get());
+    EXPECT_TRUE(result.eof.get());
+    EXPECT_TRUE(result.values[0]->IsError());
+  }
+
+  std::unique_ptr<HostContext> host_;
+  ExecutionContext exec_ctx_;
+  std::unique_ptr<NativeFunction> identity_fn_;
+};
+
+TEST_F(BatchDatasetTest, BatchesAvailableInputs) {
+  ExpectUniformBatches(/*pending=*/false);
+}
+
+TEST_F(BatchDatasetTest, BatchesPendingInputs) {
+  ExpectUniformBatches(/*pending=*/true);
+}
+
+TEST_F(BatchDatasetTest, PadsToLargestShapeInBatch) {
+  std::vector<DenseHostTensor> tensors;
+  tensors.push_back(MakeTensor({1, 2}, 1, host_.get()));
+  tensors.push_back(MakeTensor({2, 1}, 3, host_.get()));
+  tensors.push_back(MakeTensor({1, 1}, 5, host_.get()));
+  auto iterator = MakeIterator(std::move(tensors), /*batch_size=*/3,
+                               /*pad=*/true, /*pending=*/true);
+
+  auto result = AwaitNext(iterator.get());
+  ASSERT_FALSE(result.values[0]->IsError());
+  auto& tensor = result.values[0]->get<DenseHostTensor>();
+  EXPECT_EQ(GetDimensions(tensor), std::vector<ssize_t>({3, 2, 2}));
+  EXPECT_EQ(GetValues(tensor),
+            std::vector<int32_t>({1, 2, 0, 0, 3, 0, 4, 0, 5, 0, 0, 0}));
+  EXPECT_TRUE(AwaitNext(iterator.get()).eof.get());
+}
+
+TEST_F(BatchDatasetTest, PaddedBatchRequiresSameRank) {
+  std::vector<DenseHostTensor> tensors;
+  tensors.push_back(MakeTensor({2}, 0, host_.get()));
+  tensors.push_back(MakeTensor({2, 1}, 0, host_.get()));
+  auto iterator =
+      MakeIterator(std::move(tensors), /*batch_size=*/2, /*pad=*/true);
+
+  auto result = AwaitNext(iterator.get());
+  ASSERT_TRUE(result.values[0]->IsError());
+  EXPECT_NE(result.values[0]->GetError().message.find(
+                "batch elements have different metadata"),
+            std::string::npos);
+}
+
+TEST_F(BatchDatasetTest, UnpaddedBatchRequiresSameShape) {
+  std::vector<DenseHostTensor> tensors;
+  tensors.push_back(MakeTensor({2}, 0, host_.get()));
+  tensors.push_back(MakeTensor({3}, 0, host_.get()));
+  auto iterator =
+      MakeIterator(std::move(tensors), /*batch_size=*/2, /*pad=*/false);
+
+  EXPECT_TRUE(AwaitNext(iterator.get()).values[0]->IsError());
+}
+
+// Throughput benchmark: batches 32 available tensors of state.range(0) i32
+// elements each.
+void BM_BatchTensors(benchmark::State& state) {
+  auto host = CreateTestHostContext();
+  ExecutionContext exec_ctx(
+      std::move(*RequestContextBuilder(host.get(), nullptr).build()));
+  const int kBatchSize = 32;
+  const int kNumBatches = 16;
+  std::vector<DenseHostTensor> tensors;
+  for (int i = 0; i < kBatchSize * kNumBatches; ++i)
+    tensors.push_back(MakeTensor({state.range(0)}, i, host.get()));
+  auto slice = TakeRef(host->Construct<SliceDataset<DenseHostTensor>>(
+      std::move(tensors), host.get()));
+  auto dataset = TakeRef(host->Construct<BatchDataset<DenseHostTensor>>(
+      std::move(slice), kBatchSize, /*same_input_metadata=*/true,
+      /*pad=*/false, host.get()));
+
+  for (auto _ : state) {
+    auto iterator = dataset->MakeIterator(IteratorContext());
+    for (int i = 0; i < kNumBatches; ++i) {
+      auto result = iterator->GetNext(exec_ctx);
+      host->Await({FormRef(result.values[0].get())});
+    }
+  }
+  host->Quiesce();
+  state.SetBytesProcessed(state.iterations() * kBatchSize * kNumBatches *
+                          state.range(0) * sizeof(int32_t));
+}
+
+BENCHMARK(BM_BatchTensors)->Arg(16)->Arg(1024)->Arg(64 * 1024)->UseRealTime();
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
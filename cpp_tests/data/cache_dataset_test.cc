@@ -0,0 +1,424 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- cache_dataset_test.cc ------------------------------------*- C++ -*-===//
+//
+// Unit tests and second epoch throughput benchmarks for CacheDataset.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../lib/data/cache_dataset.h"
+
+#include <atomic>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../lib/data/map_dataset.h"
+#include "../../lib/data/parallel_map_dataset.h"
+#include "../../lib/data/range_dataset.h"
+#include "../../lib/data/slice_dataset.h"
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "llvm/Support/FileSystem.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/native_function.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+std::unique_ptr<HostContext> CreateTestHostContext() {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedWorkQueue(/*num_threads=*/2,
+                                   /*num_blocking_threads=*/2));
+}
+
+// Number of input elements produced by the map functions below.
+std::atomic<int> num_map_calls{0};
+
+// Forwards its argument and counts the call. MapDataset also calls it with the
+// error value of the end of the input, which is not counted.
+void CountingIdentity(AsyncValue* const* arguments, int num_arguments,
+                      RCReference<AsyncValue>* results, int num_results,
+                      HostContext* host) {
+  if (!arguments[0]->IsError()) num_map_calls.fetch_add(1);
+  results[0] = FormRef(arguments[0]);
+}
+
+// Results of DeferredIdentity calls made while defer_results is set, which
+// stay unavailable until ResolveDeferredResults is called.
+std::atomic<bool> defer_results{false};
+mutex deferred_mu;
+std::vector<std::pair<AsyncValueRef<int64_t>, int64_t>> deferred_results;
+
+// Like CountingIdentity, but returns a new value that is only available after
+// ResolveDeferredResults if defer_results is set.
+void DeferredIdentity(AsyncValue* const* arguments, int num_arguments,
+                      RCReference<AsyncValue>* results, int num_results,
+                      HostContext* host) {
+  if (arguments[0]->IsError() || !defer_results) {
+    CountingIdentity(arguments, num_arguments, results, num_results, host);
+    return;
+  }
+  num_map_calls.fetch_add(1);
+  auto result = MakeUnconstructedAsyncValueRef<int64_t>(host);
+  results[0] = result.CopyRCRef();
+  mutex_lock lock(deferred_mu);
+  deferred_results.emplace_back(std::move(result),
+                                arguments[0]->get<int64_t>());
+}
+
+// Resolves the deferred results in reverse order and stops deferring.
+void ResolveDeferredResults() {
+  defer_results = false;
+  mutex_lock lock(deferred_mu);
+  for (auto it = deferred_results.rbegin(); it != deferred_results.rend(); ++it)
+    it->first.emplace(it->second);
+  deferred_results.clear();
+}
+
+// Returns a 1 KB f32 tensor filled with its argument and counts the call.
+void MakeTensor(AsyncValue* const* arguments, int num_arguments,
+                RCReference<AsyncValue>* results, int num_results,
+                HostContext* host) {
+  if (arguments[0]->IsError()) {
+    results[0] = FormRef(arguments[0]);
+    return;
+  }
+  num_map_calls.fetch_add(1);
+  auto dht = DenseHostTensor::CreateUninitialized(
+      TensorMetadata(DType(DType::F32), ArrayRef<ssize_t>(256)), host);
+  auto* data = static_cast<float*>(dht->data());
+  std::fill(data, data + 256, static_cast<float>(arguments[0]->get<int64_t>()));
+  results[0] = MakeAvailableAsyncValueRef<DenseHostTensor>(host,
+                                                           std::move(*dht));
+}
+
+std::string GetTempPath(string_view name) {
+  std::string path = StrCat(::testing::TempDir(), "/", name);
+  std::remove(path.c_str());
+  return path;
+}
+
+// Returns true if a temporary file of the cache file at `path` exists.
+bool HasTempFile(const std::string& path) {
+  std::error_code error_code;
+  for (llvm::sys::fs::directory_iterator it(::testing::TempDir(), error_code),
+       end;
+       it != end && !error_code; it.increment(error_code)) {
+    if (llvm::StringRef(it->path()).startswith(path + ".tmp")) return true;
+  }
+  return false;
+}
+
+class CacheDatasetTest : public ::testing::Test {
+ protected:
+  CacheDatasetTest()
+      : host_(CreateTestHostContext()),
+        exec_ctx_(std::move(
+            *RequestContextBuilder(host_.get(), /*resource_context=*/nullptr)
+                 .build())) {
+    auto i64 = host_->GetKernelRegistry().GetType("i64");
+    identity_fn_ = std::make_unique<NativeFunction>(
+        "counting_identity", ArrayRef<TypeName>(i64), ArrayRef<TypeName>(i64),
+        &CountingIdentity);
+    num_map_calls = 0;
+  }
+
+  ~CacheDatasetTest() override { host_->Quiesce(); }
+
+  // Returns a dataset that caches the elements [start, start + 10) of a range.
+  RCReference<Dataset> MakeDataset(int64_t start, std::string filename) {
+    auto range = TakeRef(host_->Construct<RangeDataset>(
+        start, start + 10, 1, DType(DType::I64), host_.get()));
+    auto map = TakeRef(host_->Construct<MapDataset>(
+        std::move(range), RCArray<AsyncValue>(ArrayRef<AsyncValue*>()),
+        FormRef(identity_fn_.get()), host_.get()));
+    return TakeRef(host_->Construct<CacheDataset<int64_t>>(
+        std::move(map), std::move(filename), host_.get()));
+  }
+
+  IterationResult AwaitNext(Iterator* iterator) {
+    auto result = iterator->GetNext(exec_ctx_);
+    SmallVector<RCReference<AsyncValue>, 4> values;
+    for (auto* value : result.AsyncValues()) values.push_back(FormRef(value));
+    host_->Await(values);
+    return result;
+  }
+
+  // Reads an epoch of i64 elements.
+  std::vector<int64_t> ReadEpoch(Dataset* dataset) {
+    auto iterator = dataset->MakeIterator(IteratorContext());
+    std::vector<int64_t> elements;
+    while (true) {
+      auto result = AwaitNext(iterator.get());
+      EXPECT_FALSE(result.eof.IsError());
+      if (result.eof.IsError() || result.eof.get()) break;
+      EXPECT_FALSE(result.values[0]->IsError());
+      elements.push_back(result.values[0]->get<int64_t>());
+    }
+    // Wait for the cache to be written.
+    iterator.reset();
+    host_->Quiesce();
+    return elements;
+  }
+
+  std::vector<int64_t> Range(int64_t start) {
+    std::vector<int64_t> range(10);
+    std::iota(range.begin(), range.end(), start);
+    return range;
+  }
+
+  std::unique_ptr<HostContext> host_;
+  ExecutionContext exec_ctx_;
+  std::unique_ptr<NativeFunction> identity_fn_;
+};
+
+TEST_F(CacheDatasetTest, ServesLaterEpochsFromMemory) {
+  auto dataset = MakeDataset(0, /*filename=*/"");
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 10);
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 10);
+}
+
+TEST_F(CacheDatasetTest, ServesLaterEpochsFromFile) {
+  auto path = GetTempPath("cache_i64");
+  auto dataset = MakeDataset(0, path);
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_TRUE(llvm::sys::fs::exists(path));
+  EXPECT_FALSE(HasTempFile(path));
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 10);
+
+  // Another dataset with the same file reads the cache, not its own input.
+  auto other_dataset = MakeDataset(100, path);
+  EXPECT_EQ(ReadEpoch(other_dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 10);
+}
+
+TEST_F(CacheDatasetTest, IncompleteEpochIsNotCached) {
+  auto path = GetTempPath("cache_incomplete");
+  auto dataset = MakeDataset(0, path);
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  for (int i = 0; i < 3; ++i) AwaitNext(iterator.get());
+  iterator.reset();
+  host_->Quiesce();
+  EXPECT_FALSE(llvm::sys::fs::exists(path));
+  EXPECT_FALSE(HasTempFile(path));
+
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 13);
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 13);
+}
+
+TEST_F(CacheDatasetTest, CachesEpochOfAsyncInput) {
+  auto i64 = host_->GetKernelRegistry().GetType("i64");
+  NativeFunction map_fn("deferred_identity", ArrayRef<TypeName>(i64),
+                        ArrayRef<TypeName>(i64), &DeferredIdentity);
+  auto range = TakeRef(host_->Construct<RangeDataset>(0, 10, 1,
+                                                      DType(DType::I64),
+                                                      host_.get()));
+  auto map = TakeRef(host_->Construct<ParallelMapDataset>(
+      std::move(range), /*num_parallel_calls=*/2, /*is_deterministic=*/true,
+      RCArray<AsyncValue>(ArrayRef<AsyncValue*>()), FormRef(&map_fn),
+      host_.get()));
+  auto dataset = TakeRef(host_->Construct<CacheDataset<int64_t>>(
+      std::move(map), /*filename=*/"", host_.get()));
+
+  // Read the whole epoch and drop the iterator before any element is
+  // available. The epoch is still cached once the elements become available.
+  defer_results = true;
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  std::vector<IterationResult> results;
+  for (int i = 0; i <= 10; ++i) results.push_back(iterator->GetNext(exec_ctx_));
+  iterator.reset();
+  host_->Quiesce();
+  ResolveDeferredResults();
+
+  std::vector<int64_t> elements;
+  for (auto& result : results) {
+    SmallVector<RCReference<AsyncValue>, 4> values;
+    for (auto* value : result.AsyncValues()) values.push_back(FormRef(value));
+    host_->Await(values);
+    ASSERT_FALSE(result.eof.IsError());
+    if (!result.eof.get()) elements.push_back(result.values[0]->get<int64_t>());
+  }
+  EXPECT_TRUE(results.back().eof.get());
+  EXPECT_EQ(elements, Range(0));
+  host_->Quiesce();
+
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 10);
+}
+
+TEST_F(CacheDatasetTest, ConcurrentIteratorReadsInput) {
+  auto dataset = MakeDataset(0, /*filename=*/"");
+  auto writer = dataset->MakeIterator(IteratorContext());
+  AwaitNext(writer.get());
+  // The cache is being written, so this epoch is read from the input.
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 11);
+  while (!AwaitNext(writer.get()).eof.get()) {
+  }
+  writer.reset();
+  host_->Quiesce();
+  EXPECT_EQ(ReadEpoch(dataset.get()), Range(0));
+  EXPECT_EQ(num_map_calls, 20);
+}
+
+TEST_F(CacheDatasetTest, CachesTensorsAndStringsInFile) {
+  auto tensor_path = GetTempPath("cache_tensor");
+  std::vector<DenseHostTensor> tensors;
+  for (int i = 0; i < 3; ++i) {
+    auto dht = DenseHostTensor::CreateUninitialized(
+        TensorMetadata(DType(DType::I32), {static_cast<ssize_t>(i + 1), 2}),
+        host_.get());
+    auto* data = static_cast<int32_t*>(dht->data());
+    std::iota(data, data + dht->NumElements(), i);
+    tensors.push_back(std::move(*dht));
+  }
+  auto tensor_dataset =
+      TakeRef(host_->Construct<CacheDataset<DenseHostTensor>>(
+          TakeRef(host_->Construct<SliceDataset<DenseHostTensor>>(
+              std::move(tensors), host_.get())),
+          tensor_path, host_.get()));
+
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    auto iterator = tensor_dataset->MakeIterator(IteratorContext());
+    for (int i = 0; i < 3; ++i) {
+      auto result = AwaitNext(iterator.get());
+      ASSERT_FALSE(result.values[0]->IsError());
+      auto& tensor = result.values[0]->get<DenseHostTensor>();
+      EXPECT_EQ(tensor.dtype(), DType(DType::I32));
+      EXPECT_EQ(tensor.shape(), TensorShape({i + 1, 2}));
+      auto* data = static_cast<const int32_t*>(tensor.data());
+      std::vector<int32_t> expected(tensor.NumElements());
+      std::iota(expected.begin(), expected.end(), i);
+      EXPECT_EQ(std::vector<int32_t>(data, data + tensor.NumElements()),
+                expected);
+    }
+    EXPECT_TRUE(AwaitNext(iterator.get()).eof.get());
+    iterator.reset();
+    host_->Quiesce();
+  }
+
+  auto string_path = GetTempPath("cache_str");
+  std::vector<std::string> strings = {"a", "", "cache"};
+  auto string_dataset = TakeRef(host_->Construct<CacheDataset<std::string>>(
+      TakeRef(host_->Construct<SliceDataset<std::string>>(strings,
+                                                          host_.get())),
+      string_path, host_.get()));
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    auto iterator = string_dataset->MakeIterator(IteratorContext());
+    for (const auto& expected : strings) {
+      auto result = AwaitNext(iterator.get());
+      ASSERT_FALSE(result.values[0]->IsError());
+      EXPECT_EQ(result.values[0]->get<std::string>(), expected);
+    }
+    EXPECT_TRUE(AwaitNext(iterator.get()).eof.get());
+    iterator.reset();
+    host_->Quiesce();
+  }
+}
+
+TEST_F(CacheDatasetTest, CacheFileWithOtherComponentsIsAnError) {
+  auto path = GetTempPath("cache_mismatch");
+  ReadEpoch(MakeDataset(0, path).get());
+
+  auto dataset = TakeRef(host_->Construct<CacheDataset<int64_t, int64_t>>(
+      MakeDataset(0, /*filename=*/""), path, host_.get()));
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  auto result = AwaitNext(iterator.get());
+  EXPECT_TRUE(result.eof.IsError());
+}
+
+TEST_F(CacheDatasetTest, CacheFileWithOtherComponentTypesIsAnError) {
+  auto path = GetTempPath("cache_type_mismatch");
+  ReadEpoch(MakeDataset(0, path).get());
+
+  auto dataset = TakeRef(host_->Construct<CacheDataset<std::string>>(
+      MakeDataset(0, /*filename=*/""), path, host_.get()));
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  auto result = AwaitNext(iterator.get());
+  EXPECT_TRUE(result.eof.IsError());
+}
+
+// Throughput benchmark of the second epoch of 1024 1 KB tensors. The tensors
+// are created by a map function, read from a cache file (file), or from an
+// in-memory cache (memory).
+void BM_CacheSecondEpoch(benchmark::State& state, bool cache,
+                         string_view filename) {
+  auto host = CreateTestHostContext();
+  ExecutionContext exec_ctx(
+      std::move(*RequestContextBuilder(host.get(), nullptr).build()));
+  NativeFunction map_fn(
+      "make_tensor",
+      ArrayRef<TypeName>(host->GetKernelRegistry().GetType("i64")),
+      ArrayRef<TypeName>(host->GetKernelRegistry().GetType("!t.tensor")),
+      &MakeTensor);
+  const int kNumElements = 1024;
+  auto path = filename.empty() ? std::string() : GetTempPath(filename);
+
+  RCReference<Dataset> dataset = TakeRef(host->Construct<MapDataset>(
+      TakeRef(host->Construct<RangeDataset>(0, kNumElements, 1,
+                                            DType(DType::I64), host.get())),
+      RCArray<AsyncValue>(ArrayRef<AsyncValue*>()), FormRef(&map_fn),
+      host.get()));
+  if (cache) {
+    dataset = TakeRef(host->Construct<CacheDataset<DenseHostTensor>>(
+        std::move(dataset), path, host.get()));
+  }
+
+  auto read_epoch = [&]() {
+    auto iterator = dataset->MakeIterator(IteratorContext());
+    // Read the end of the input too, which completes the cache.
+    for (int i = 0; i <= kNumElements; ++i) {
+      auto result = iterator->GetNext(exec_ctx);
+      host->Await({FormRef(result.values[0].get())});
+    }
+  };
+  // The first epoch writes the cache.
+  read_epoch();
+  host->Quiesce();
+
+  for (auto _ : state) read_epoch();
+  host->Quiesce();
+  if (!path.empty()) std::remove(path.c_str());
+  state.SetItemsProcessed(state.iterations() * kNumElements);
+  state.SetBytesProcessed(state.iterations() * kNumElements * 1024);
+}
+
+BENCHMARK_CAPTURE(BM_CacheSecondEpoch, uncached, false, "")->UseRealTime();
+BENCHMARK_CAPTURE(BM_CacheSecondEpoch, memory, true, "")->UseRealTime();
+BENCHMARK_CAPTURE(BM_CacheSecondEpoch, file, true, "bm_cache")->UseRealTime();
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- io_test.cc -----------------------------------------------*- C++ -*-===//
+//
+// Unit tests and benchmarks for the prefetching policy of PrefetchingIterator.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../lib/data/io.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+std::unique_ptr<HostContext> CreateTestHostContext() {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedWorkQueue(/*num_threads=*/2,
+                                   /*num_blocking_threads=*/2));
+}
+
+// Produces `num_elements` strings of `element_size` bytes and counts how many
+// of them have been read from the "IO source".
+class FakeIterator : public io::PrefetchingIterator {
+ public:
+  FakeIterator(int num_elements, size_t element_size, int64_t max_prefetch_num,
+               int64_t prefetch_threshold, int64_t max_prefetch_bytes,
+               bool autotune, HostContext* host)
+      : io::PrefetchingIterator(max_prefetch_num, prefetch_threshold,
+                                max_prefetch_bytes, autotune, host,
+                                IteratorContext()),
+        num_elements_(num_elements),
+        element_size_(element_size),
+        host_(host) {}
+
+  int num_reads() const { return num_reads_.load(); }
+
+ protected:
+  IterationResult GetNextElement(const ExecutionContext& exec_ctx) final {
+    if (num_reads_ == num_elements_) return IterationResult::Eof(host_, 1);
+    int index = num_reads_++;
+    llvm::SmallVector<RCReference<AsyncValue>, 4> values;
+    values.push_back(MakeAvailableAsyncValueRef<std::string>(
+        host_, std::string(element_size_, 'a' + index % 26)));
+    return IterationResult::Values(std::move(values), host_);
+  }
+
+  size_t GetElementSize(const IterationResult& element) const final {
+    return element.values[0]->get<std::string>().size();
+  }
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<FakeIterator>(this, host_->allocator());
+  }
+
+  const int num_elements_;
+  const size_t element_size_;
+  HostContext* host_;
+  std::atomic<int> num_reads_{0};
+};
+
+class PrefetchingIteratorTest : public ::testing::Test {
+ protected:
+  PrefetchingIteratorTest()
+      : host_(CreateTestHostContext()),
+        exec_ctx_(std::move(
+            *RequestContextBuilder(host_.get(), /*resource_context=*/nullptr)
+                 .build())),
+        budget_(host_->GetOrCreateSharedContext<io::PrefetchMemoryBudget>()) {}
+
+  ~PrefetchingIteratorTest() override { host_->Quiesce(); }
+
+  RCReference<FakeIterator> MakeIterator(int num_elements, size_t element_size,
+                                         int64_t max_prefetch_bytes,
+                                         bool autotune = false) {
+    return TakeRef(host_->Construct<FakeIterator>(
+        num_elements, element_size, /*max_prefetch_num=*/64,
+        /*prefetch_threshold=*/16, max_prefetch_bytes, autotune, host_.get()));
+  }
+
+  // Returns the next element after it becomes available.
+  IterationResult AwaitNext(Iterator* iterator) {
+    auto result = iterator->GetNext(exec_ctx_);
+    SmallVector<RCReference<AsyncValue>, 4> values;
+    for (auto* value : result.AsyncValues()) values.push_back(FormRef(value));
+    host_->Await(values);
+    return result;
+  }
+
+  // Reads the elements [begin, end) and checks that they are produced in order
+  // and followed by eof.
+  void ExpectElements(Iterator* iterator, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      auto result = AwaitNext(iterator);
+      ASSERT_FALSE(result.eof.get());
+      EXPECT_EQ(result.values[0]->get<std::string>()[0], 'a' + i % 26);
+    }
+    EXPECT_TRUE(AwaitNext(iterator).eof.get());
+  }
+
+  std::unique_ptr<HostContext> host_;
+  ExecutionContext exec_ctx_;
+  io::PrefetchMemoryBudget& budget_;
+};
+
+TEST_F(PrefetchingIteratorTest, CountLimitWithoutMemoryLimit) {
+  auto iterator = MakeIterator(/*num_elements=*/200, /*element_size=*/1024,
+                               /*max_prefetch_bytes=*/0);
+  AwaitNext(iterator.get());
+  host_->Quiesce();
+  // One consumed value and max_prefetch_num prefetched values. The blocking
+  // task may start before the first value is requested, in which case it
+  // prefetches one value less.
+  EXPECT_GE(iterator->num_reads(), 64);
+  EXPECT_LE(iterator->num_reads(), 65);
+  EXPECT_EQ(budget_.GetUsage(), (iterator->num_reads() - 1) * 1024);
+
+  ExpectElements(iterator.get(), 1, 200);
+  EXPECT_EQ(budget_.GetUsage(), 0);
+}
+
+TEST_F(PrefetchingIteratorTest, IteratorMemoryLimit) {
+  auto iterator = MakeIterator(/*num_elements=*/200, /*element_size=*/1024,
+                               /*max_prefetch_bytes=*/4 * 1024);
+  AwaitNext(iterator.get());
+  host_->Quiesce();
+  EXPECT_GE(iterator->num_reads(), 4);
+  EXPECT_LE(iterator->num_reads(), 5);
+  EXPECT_EQ(budget_.GetUsage(), (iterator->num_reads() - 1) * 1024);
+
+  ExpectElements(iterator.get(), 1, 200);
+  EXPECT_EQ(budget_.GetUsage(), 0);
+}
+
+TEST_F(PrefetchingIteratorTest, GlobalMemoryLimit) {
+  budget_.SetLimit(8 * 1024);
+  auto first = MakeIterator(/*num_elements=*/100, /*element_size=*/1024,
+                            /*max_prefetch_bytes=*/0);
+  auto second = MakeIterator(/*num_elements=*/100, /*element_size=*/1024,
+                             /*max_prefetch_bytes=*/0);
+  AwaitNext(first.get());
+  host_->Quiesce();
+  EXPECT_GE(first->num_reads(), 8);
+  EXPECT_LE(first->num_reads(), 9);
+
+  // The budget is used up by the first iterator, so the second one reads only
+  // what it is asked for and one value ahead.
+  AwaitNext(second.get());
+  host_->Quiesce();
+  EXPECT_LE(second->num_reads(), 2);
+
+  // Destroying an iterator returns its memory to the budget.
+  first.reset();
+  EXPECT_LE(budget_.GetUsage(), 1024);
+  AwaitNext(second.get());
+  host_->Quiesce();
+  EXPECT_EQ(second->num_reads(), 10);
+
+  ExpectElements(second.get(), 2, 100);
+  EXPECT_EQ(budget_.GetUsage(), 0);
+}
+
+TEST_F(PrefetchingIteratorTest, AutotuneSlowConsumer) {
+  auto iterator = MakeIterator(/*num_elements=*/400, /*element_size=*/1024,
+                               /*max_prefetch_bytes=*/0, /*autotune=*/true);
+  // The first refill happens before any rate is known, so it reads up to
+  // max_prefetch_num values. Once the consumer is known to be much slower than
+  // the producer, only a few values are read ahead.
+  int consumed = 0;
+  for (; consumed < 200; ++consumed) {
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+    AwaitNext(iterator.get());
+  }
+  host_->Quiesce();
+  EXPECT_LT(iterator->num_reads() - consumed, 16);
+
+  ExpectElements(iterator.get(), 200, 400);
+}
+
+// Reads elements of state.range(0) bytes with and without a memory limit of
+// 1 MB.
+void BM_PrefetchingIterator(benchmark::State& state, int64_t max_bytes,
+                            bool autotune) {
+  auto host = CreateTestHostContext();
+  auto exec_ctx = ExecutionContext(std::move(
+      *RequestContextBuilder(host.get(), /*resource_context=*/nullptr)
+           .build()));
+  const int num_elements = 1000;
+  for (auto _ : state) {
+    auto iterator = TakeRef(host->Construct<FakeIterator>(
+        num_elements, state.range(0), /*max_prefetch_num=*/80,
+        /*prefetch_threshold=*/20, max_bytes, autotune, host.get()));
+    for (int i = 0; i <= num_elements; ++i) {
+      auto result = iterator->GetNext(exec_ctx);
+      host->Await({FormRef(result.eof.GetAsyncValue())});
+    }
+  }
+  host->Quiesce();
+  state.SetBytesProcessed(state.iterations() * num_elements * state.range(0));
+}
+
+void BM_CountLimit(benchmark::State& state) {
+  BM_PrefetchingIterator(state, 0, false);
+}
+void BM_MemoryLimit(benchmark::State& state) {
+  BM_PrefetchingIterator(state, 1024 * 1024, false);
+}
+void BM_Autotune(benchmark::State& state) {
+  BM_PrefetchingIterator(state, 1024 * 1024, true);
+}
+
+BENCHMARK(BM_CountLimit)->Arg(1024)->Arg(64 * 1024);
+BENCHMARK(BM_MemoryLimit)->Arg(1024)->Arg(64 * 1024);
+BENCHMARK(BM_Autotune)->Arg(1024)->Arg(64 * 1024);
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,258 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- parallel_map_dataset_test.cc -----------------------------*- C++ -*-===//
+//
+// Unit tests and throughput benchmarks for ParallelMapDataset.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../lib/data/parallel_map_dataset.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "../../lib/data/filter_dataset.h"
+#include "../../lib/data/range_dataset.h"
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/native_function.h"
+#include "tfrt/host_context/task_function.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+std::unique_ptr<HostContext> CreateTestHostContext(int num_threads) {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedWorkQueue(num_threads, /*num_blocking_threads=*/1));
+}
+
+// Burn some cycles, so that a map function invocation costs roughly as much as
+// decoding a small image.
+int64_t Compute(int64_t value, int iterations) {
+  for (int i = 0; i < iterations; ++i) {
+    value = value * 6364136223846793005 + 1442695040888963407;
+    benchmark::DoNotOptimize(value);
+  }
+  return value;
+}
+
+void AwaitResult(HostContext* host, const IterationResult& result) {
+  SmallVector<RCReference<AsyncValue>, 4> values;
+  for (auto* value : result.AsyncValues()) values.push_back(FormRef(value));
+  host->Await(values);
+}
+
+template <int kIterations>
+void TimesTwo(AsyncValue* const* arguments, int num_arguments,
+              RCReference<AsyncValue>* results, int num_results,
+              HostContext* host) {
+  int64_t value = arguments[0]->get<int64_t>();
+  benchmark::DoNotOptimize(Compute(value, kIterations));
+  results[0] = MakeAvailableAsyncValueRef<int64_t>(host, value * 2);
+}
+
+// Number of TimesTwoOrCountError invocations on an error argument, e.g. on the
+// values of the end of iteration.
+std::atomic<int> num_error_invocations{0};
+
+void TimesTwoOrCountError(AsyncValue* const* arguments, int num_arguments,
+                          RCReference<AsyncValue>* results, int num_results,
+                          HostContext* host) {
+  if (arguments[0]->IsError()) {
+    num_error_invocations.fetch_add(1);
+    results[0] = FormRef(arguments[0]);
+    return;
+  }
+  TimesTwo<100>(arguments, num_arguments, results, num_results, host);
+}
+
+// Keeps the even values. The predicate is resolved on the work queue, so the
+// end of iteration of the filtered elements is not yet available when GetNext
+// returns.
+void IsEvenAsync(AsyncValue* const* arguments, int num_arguments,
+                 RCReference<AsyncValue>* results, int num_results,
+                 HostContext* host) {
+  if (arguments[0]->IsError()) {
+    results[0] = FormRef(arguments[0]);
+    return;
+  }
+  int64_t value = arguments[0]->get<int64_t>();
+  auto is_even = MakeUnconstructedAsyncValueRef<bool>(host);
+  results[0] = is_even.CopyRCRef();
+  host->work_queue().AddTask(
+      TaskFunction([is_even = std::move(is_even), value]() mutable {
+        is_even.emplace(value % 2 == 0);
+      }));
+}
+
+class ParallelMapDatasetTest : public ::testing::Test {
+ protected:
+  ParallelMapDatasetTest()
+      : host_(CreateTestHostContext(4)),
+        exec_ctx_(std::move(
+            *RequestContextBuilder(host_.get(), /*resource_context=*/nullptr)
+                 .build())) {
+    auto i64 = host_->GetKernelRegistry().GetType("i64");
+    map_fn_ = std::make_unique<NativeFunction>(
+        "times_two", /*argument_types=*/ArrayRef<TypeName>(i64),
+        /*result_types=*/ArrayRef<TypeName>(i64), &TimesTwo<10000>);
+  }
+
+  // Map function tasks may still hold a reference to map_fn_.
+  ~ParallelMapDatasetTest() override { host_->Quiesce(); }
+
+  RCReference<Iterator> MakeIterator(int64_t num_elements,
+                                     int64_t num_parallel_calls,
+                                     bool is_deterministic) {
+    auto range = TakeRef(host_->Construct<RangeDataset>(
+        0, num_elements, 1, DType(DType::I64), host_.get()));
+    auto dataset = TakeRef(host_->Construct<ParallelMapDataset>(
+        std::move(range), num_parallel_calls, is_deterministic,
+        RCArray<AsyncValue>(ArrayRef<AsyncValue*>()), FormRef(map_fn_.get()),
+        host_.get()));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  // Drains the iterator and returns the values in the order they are
+  // returned.
+  std::vector<int64_t> GetAll(Iterator* iterator) {
+    std::vector<int64_t> values;
+    while (true) {
+      auto result = iterator->GetNext(exec_ctx_);
+      AwaitResult(host_.get(), result);
+      EXPECT_FALSE(result.eof.IsError());
+      if (result.eof.get()) break;
+      values.push_back(result.values[0]->get<int64_t>());
+    }
+    return values;
+  }
+
+  std::unique_ptr<HostContext> host_;
+  ExecutionContext exec_ctx_;
+  std::unique_ptr<NativeFunction> map_fn_;
+};
+
+TEST_F(ParallelMapDatasetTest, DeterministicPreservesInputOrder) {
+  auto iterator = MakeIterator(/*num_elements=*/100, /*num_parallel_calls=*/8,
+                               /*is_deterministic=*/true);
+  std::vector<int64_t> values = GetAll(iterator.get());
+
+  ASSERT_EQ(values.size(), 100);
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(values[i], 2 * i);
+
+  // The end of iteration is sticky.
+  auto result = iterator->GetNext(exec_ctx_);
+  AwaitResult(host_.get(), result);
+  EXPECT_TRUE(result.eof.get());
+}
+
+TEST_F(ParallelMapDatasetTest, NonDeterministicReturnsAllElements) {
+  auto iterator = MakeIterator(/*num_elements=*/100, /*num_parallel_calls=*/8,
+                               /*is_deterministic=*/false);
+  std::vector<int64_t> values = GetAll(iterator.get());
+
+  ASSERT_EQ(values.size(), 100);
+  std::sort(values.begin(), values.end());
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(values[i], 2 * i);
+}
+
+TEST_F(ParallelMapDatasetTest, EmptyInput) {
+  auto iterator = MakeIterator(/*num_elements=*/0, /*num_parallel_calls=*/4,
+                               /*is_deterministic=*/true);
+  EXPECT_TRUE(GetAll(iterator.get()).empty());
+}
+
+TEST_F(ParallelMapDatasetTest, AsyncEndOfIteration) {
+  auto i1 = host_->GetKernelRegistry().GetType("i1");
+  auto i64 = host_->GetKernelRegistry().GetType("i64");
+  NativeFunction filter_fn("is_even_async", ArrayRef<TypeName>(i64),
+                           ArrayRef<TypeName>(i1), &IsEvenAsync);
+  NativeFunction map_fn("times_two_or_count_error", ArrayRef<TypeName>(i64),
+                        ArrayRef<TypeName>(i64), &TimesTwoOrCountError);
+  num_error_invocations.store(0);
+  {
+    auto range = TakeRef(host_->Construct<RangeDataset>(
+        0, 100, 1, DType(DType::I64), host_.get()));
+    auto filter = TakeRef(host_->Construct<FilterDataset>(
+        std::move(range), FormRef(&filter_fn), host_.get()));
+    auto dataset = TakeRef(host_->Construct<ParallelMapDataset>(
+        std::move(filter), /*num_parallel_calls=*/8, /*is_deterministic=*/true,
+        RCArray<AsyncValue>(ArrayRef<AsyncValue*>()), FormRef(&map_fn),
+        host_.get()));
+    auto iterator = dataset->MakeIterator(IteratorContext());
+    std::vector<int64_t> values = GetAll(iterator.get());
+
+    ASSERT_EQ(values.size(), 50);
+    for (int i = 0; i < 50; ++i) EXPECT_EQ(values[i], 4 * i);
+
+    // The end of iteration is sticky.
+    for (int i = 0; i < 4; ++i) {
+      auto result = iterator->GetNext(exec_ctx_);
+      AwaitResult(host_.get(), result);
+      EXPECT_TRUE(result.eof.get());
+    }
+  }
+  host_->Quiesce();
+
+  // The map function never runs on the end of iteration.
+  EXPECT_EQ(num_error_invocations.load(), 0);
+}
+
+// Throughput benchmark: elements/sec of a parallel map with state.range(0)
+// worker threads and as many parallel calls.
+void BM_ParallelMap(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  auto host = CreateTestHostContext(num_threads);
+  ExecutionContext exec_ctx(
+      std::move(*RequestContextBuilder(host.get(), nullptr).build()));
+  auto i64 = host->GetKernelRegistry().GetType("i64");
+  NativeFunction map_fn("times_two", ArrayRef<TypeName>(i64),
+                        ArrayRef<TypeName>(i64), &TimesTwo<10000>);
+
+  const int64_t kNumElements = 1024;
+  for (auto _ : state) {
+    auto range = TakeRef(host->Construct<RangeDataset>(
+        0, kNumElements, 1, DType(DType::I64), host.get()));
+    auto dataset = TakeRef(host->Construct<ParallelMapDataset>(
+        std::move(range), num_threads, /*is_deterministic=*/true,
+        RCArray<AsyncValue>(ArrayRef<AsyncValue*>()), FormRef(&map_fn),
+        host.get()));
+    auto iterator = dataset->MakeIterator(IteratorContext());
+    while (true) {
+      auto result = iterator->GetNext(exec_ctx);
+      AwaitResult(host.get(), result);
+      if (result.eof.get()) break;
+    }
+  }
+  host->Quiesce();
+  state.SetItemsProcessed(state.iterations() * kNumElements);
+}
+
+BENCHMARK(BM_ParallelMap)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
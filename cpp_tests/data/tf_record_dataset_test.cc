@@ -0,0 +1,258 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- tf_record_dataset_test.cc --------------------------------*- C++ -*-===//
+//
+// Unit tests and throughput benchmarks for TFRecordDataset and
+// MappedTFRecordDataset.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../lib/data/tf_record_dataset.h"
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_buffer.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/crc32c.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+std::unique_ptr<HostContext> CreateTestHostContext() {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedWorkQueue(/*num_threads=*/2,
+                                   /*num_blocking_threads=*/2));
+}
+
+ExecutionContext CreateExecutionContext(HostContext* host) {
+  return ExecutionContext(
+      std::move(*RequestContextBuilder(host, /*resource_context=*/nullptr)
+                     .build()));
+}
+
+void AppendFixed(std::string* out, uint64_t value, int num_bytes) {
+  for (int i = 0; i < num_bytes; ++i) out->push_back((value >> (8 * i)) & 0xff);
+}
+
+void AppendChecksummed(std::string* out, string_view data) {
+  out->append(data.begin(), data.end());
+  AppendFixed(out, crc32c::Mask(crc32c::Value(data.data(), data.size())), 4);
+}
+
+// Returns the TFRecord encoding of `records`.
+std::string EncodeRecords(const std::vector<std::string>& records) {
+  std::string result;
+  for (const auto& record : records) {
+    std::string length;
+    AppendFixed(&length, record.size(), 8);
+    AppendChecksummed(&result, length);
+    AppendChecksummed(&result, record);
+  }
+  return result;
+}
+
+std::string WriteTempFile(string_view name, string_view contents) {
+  std::string path = StrCat(::testing::TempDir(), "/", name);
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(contents.data(), contents.size());
+  return path;
+}
+
+RCReference<Iterator> MakeMappedIterator(std::string path, HostContext* host) {
+  auto dataset = TakeRef(host->Construct<MappedTFRecordDataset>(
+      std::move(path), /*max_prefetch_num=*/8, /*prefetch_threshold=*/2,
+      /*max_prefetch_bytes=*/0, /*autotune=*/false, host));
+  return dataset->MakeIterator(IteratorContext());
+}
+
+RCReference<Iterator> MakeStreamIterator(std::string path, HostContext* host) {
+  auto dataset = TakeRef(host->Construct<TFRecordDataset>(
+      std::move(path), /*buffer_size=*/256 * 1024, /*max_prefetch_num=*/8,
+      /*prefetch_threshold=*/2, /*max_prefetch_bytes=*/0, /*autotune=*/false,
+      host));
+  return dataset->MakeIterator(IteratorContext());
+}
+
+IterationResult AwaitNext(Iterator* iterator,
+                          const ExecutionContext& exec_ctx) {
+  auto result = iterator->GetNext(exec_ctx);
+  SmallVector<RCReference<AsyncValue>, 4> values;
+  for (auto* value : result.AsyncValues()) values.push_back(FormRef(value));
+  exec_ctx.host()->Await(values);
+  return result;
+}
+
+string_view AsStringView(const HostBuffer& buffer) {
+  return string_view(static_cast<const char*>(buffer.data()), buffer.size());
+}
+
+TEST(MappedTFRecordDatasetTest, ReadsRecordsInPlace) {
+  auto host = CreateTestHostContext();
+  auto exec_ctx = CreateExecutionContext(host.get());
+
+  std::vector<std::string> records = {"first", "", std::string(1000, 'x')};
+  auto path = WriteTempFile("records.tfrecord", EncodeRecords(records));
+
+  auto iterator = MakeMappedIterator(path, host.get());
+  for (const auto& record : records) {
+    auto result = AwaitNext(iterator.get(), exec_ctx);
+    ASSERT_FALSE(result.eof.IsError());
+    ASSERT_FALSE(result.eof.get());
+    const auto& buffer = result.values[0]->get<RCReference<HostBuffer>>();
+    EXPECT_EQ(AsStringView(*buffer), record);
+  }
+  EXPECT_TRUE(AwaitNext(iterator.get(), exec_ctx).eof.get());
+
+  // The stream based dataset reads the same records into strings.
+  iterator = MakeStreamIterator(path, host.get());
+  for (const auto& record : records) {
+    auto result = AwaitNext(iterator.get(), exec_ctx);
+    ASSERT_FALSE(result.eof.get());
+    EXPECT_EQ(result.values[0]->get<std::string>(), record);
+  }
+  EXPECT_TRUE(AwaitNext(iterator.get(), exec_ctx).eof.get());
+
+  host->Quiesce();
+  std::remove(path.c_str());
+}
+
+TEST(MappedTFRecordDatasetTest, RecordsOutliveIterator) {
+  auto host = CreateTestHostContext();
+  auto exec_ctx = CreateExecutionContext(host.get());
+  auto path = WriteTempFile("outlive.tfrecord", EncodeRecords({"record"}));
+
+  RCReference<HostBuffer> buffer;
+  {
+    auto iterator = MakeMappedIterator(path, host.get());
+    auto result = AwaitNext(iterator.get(), exec_ctx);
+    buffer = result.values[0]->get<RCReference<HostBuffer>>().CopyRef();
+    host->Quiesce();
+  }
+  EXPECT_EQ(AsStringView(*buffer), "record");
+  std::remove(path.c_str());
+}
+
+TEST(MappedTFRecordDatasetTest, EmptyFile) {
+  auto host = CreateTestHostContext();
+  auto exec_ctx = CreateExecutionContext(host.get());
+  auto path = WriteTempFile("empty.tfrecord", "");
+
+  auto iterator = MakeMappedIterator(path, host.get());
+  EXPECT_TRUE(AwaitNext(iterator.get(), exec_ctx).eof.get());
+  host->Quiesce();
+  std::remove(path.c_str());
+}
+
+TEST(MappedTFRecordDatasetTest, CorruptedAndTruncatedRecords) {
+  auto host = CreateTestHostContext();
+  auto exec_ctx = CreateExecutionContext(host.get());
+
+  std::string contents = EncodeRecords({"first", "second"});
+  // Flip a byte in the data of the second record, which starts at offset 21.
+  std::string corrupted = contents;
+  corrupted[21 + 12] ^= 1;
+  auto path = WriteTempFile("corrupted.tfrecord", corrupted);
+
+  auto iterator = MakeMappedIterator(path, host.get());
+  EXPECT_FALSE(AwaitNext(iterator.get(), exec_ctx).eof.get());
+  auto result = AwaitNext(iterator.get(), exec_ctx);
+  ASSERT_TRUE(result.eof.IsError());
+  EXPECT_EQ(result.eof.GetError().message, "data corruption at position 21");
+  // The iterator does not read past an invalid record.
+  EXPECT_TRUE(AwaitNext(iterator.get(), exec_ctx).eof.get());
+  host->Quiesce();
+  std::remove(path.c_str());
+
+  path = WriteTempFile("truncated.tfrecord",
+                       string_view(contents).drop_back(1));
+  iterator = MakeMappedIterator(path, host.get());
+  EXPECT_FALSE(AwaitNext(iterator.get(), exec_ctx).eof.get());
+  result = AwaitNext(iterator.get(), exec_ctx);
+  ASSERT_TRUE(result.eof.IsError());
+  EXPECT_EQ(result.eof.GetError().message, "truncated record at position 21");
+  host->Quiesce();
+  std::remove(path.c_str());
+}
+
+// Throughput benchmarks: bytes/sec of reading a TFRecord file of
+// state.range(0) MB made of 100 KB records, roughly the size of an encoded
+// image. The file is written once and stays in the page cache.
+const std::string& GetBenchmarkFile(int64_t size_mb) {
+  static auto* files = new std::map<int64_t, std::string>();
+  auto& path = (*files)[size_mb];
+  if (!path.empty()) return path;
+
+  const size_t kRecordSize = 100 * 1024;
+  std::string record(kRecordSize, 'r');
+  for (size_t i = 0; i < kRecordSize; ++i) record[i] = i * 7919;
+  std::string encoded = EncodeRecords({record});
+
+  path = StrCat(::testing::TempDir(), "/benchmark_", size_mb, ".tfrecord");
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  for (int64_t written = 0; written < size_mb * 1024 * 1024;
+       written += encoded.size())
+    file.write(encoded.data(), encoded.size());
+  return path;
+}
+
+template <typename MakeIteratorFn>
+void BM_ReadTFRecords(benchmark::State& state, MakeIteratorFn make_iterator) {
+  auto host = CreateTestHostContext();
+  auto exec_ctx = CreateExecutionContext(host.get());
+  const std::string& path = GetBenchmarkFile(state.range(0));
+
+  int64_t num_bytes = 0;
+  for (auto _ : state) {
+    auto iterator = make_iterator(path, host.get());
+    while (true) {
+      auto result = AwaitNext(iterator.get(), exec_ctx);
+      if (result.eof.get()) break;
+      benchmark::DoNotOptimize(result.values[0]);
+    }
+    num_bytes += state.range(0) * 1024 * 1024;
+  }
+  host->Quiesce();
+  state.SetBytesProcessed(num_bytes);
+}
+
+void BM_ReadTFRecordsStream(benchmark::State& state) {
+  BM_ReadTFRecords(state, MakeStreamIterator);
+}
+void BM_ReadTFRecordsMapped(benchmark::State& state) {
+  BM_ReadTFRecords(state, MakeMappedIterator);
+}
+
+BENCHMARK(BM_ReadTFRecordsStream)->Arg(256)->Arg(2048)->UseRealTime();
+BENCHMARK(BM_ReadTFRecordsMapped)->Arg(256)->Arg(2048)->UseRealTime();
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
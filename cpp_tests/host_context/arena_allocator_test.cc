@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- arena_allocator_test.cc ----------------------------------*- C++ -*-===//
+//
+// Unit tests and benchmarks for ArenaAllocator.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/host_context/arena_allocator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+
+namespace tfrt {
+namespace {
+
+bool IsAligned(void* ptr, size_t alignment) {
+  return reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0;
+}
+
+TEST(ArenaAllocatorTest, AllocateDeallocateBytesWithAlignment) {
+  auto malloc_allocator = CreateMallocAllocator();
+  auto arena = TakeRef(new ArenaAllocator(malloc_allocator.get(), 1024));
+
+  for (size_t size : {1, 8, 100, 256, 1000, 10000}) {
+    for (size_t alignment : {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024}) {
+      void* buffer = arena->AllocateBytes(size, alignment);
+      ASSERT_NE(nullptr, buffer);
+      EXPECT_TRUE(IsAligned(buffer, alignment));
+      memset(buffer, 0, size);
+      arena->DeallocateBytes(buffer, size);
+    }
+  }
+}
+
+TEST(ArenaAllocatorTest, AllocationsKeepArenaAlive) {
+  auto malloc_allocator = CreateMallocAllocator();
+  auto arena = TakeRef(new ArenaAllocator(malloc_allocator.get()));
+  ArenaAllocator* allocator = arena.get();
+
+  int* values = allocator->Allocate<int>(16);
+  EXPECT_EQ(arena->NumRef(), 2);
+  EXPECT_EQ(arena->reserved_bytes(), ArenaAllocator::kDefaultBlockSize);
+
+  arena.reset();
+  for (int i = 0; i < 16; ++i) values[i] = i;
+  allocator->Deallocate(values, 16);
+}
+
+TEST(ArenaAllocatorTest, ConcurrentAllocations) {
+  auto malloc_allocator = CreateMallocAllocator();
+  auto arena = TakeRef(new ArenaAllocator(malloc_allocator.get(), 4096));
+
+  constexpr int kNumThreads = 4;
+  constexpr int kNumAllocations = 10000;
+
+  std::vector<std::vector<uint32_t*>> allocations(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < kNumAllocations; ++j) {
+        auto* ptr = arena->Allocate<uint32_t>(4);
+        for (int k = 0; k < 4; ++k) ptr[k] = i * kNumAllocations + j;
+        allocations[i].push_back(ptr);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // Check that concurrent allocations did not overlap.
+  for (int i = 0; i < kNumThreads; ++i) {
+    for (int j = 0; j < kNumAllocations; ++j) {
+      uint32_t* ptr = allocations[i][j];
+      for (int k = 0; k < 4; ++k) ASSERT_EQ(ptr[k], i * kNumAllocations + j);
+      arena->Deallocate(ptr, 4);
+    }
+  }
+  EXPECT_TRUE(arena->IsUnique());
+}
+
+// Allocates a batch of small objects from a fresh arena, which models the
+// request-lifetime allocations of a single request.
+void BM_ArenaAllocator(benchmark::State& state) {
+  static HostAllocator* malloc_allocator = CreateMallocAllocator().release();
+  constexpr int kNumAllocations = 256;
+  std::vector<void*> ptrs(kNumAllocations);
+
+  for (auto _ : state) {
+    auto arena = TakeRef(new ArenaAllocator(malloc_allocator));
+    for (int i = 0; i < kNumAllocations; ++i)
+      ptrs[i] = arena->AllocateBytes(64 + (i % 4) * 32, 16);
+    for (int i = 0; i < kNumAllocations; ++i)
+      arena->DeallocateBytes(ptrs[i], 64 + (i % 4) * 32);
+  }
+}
+
+void BM_MallocAllocator(benchmark::State& state) {
+  static HostAllocator* malloc_allocator = CreateMallocAllocator().release();
+  constexpr int kNumAllocations = 256;
+  std::vector<void*> ptrs(kNumAllocations);
+
+  for (auto _ : state) {
+    for (int i = 0; i < kNumAllocations; ++i)
+      ptrs[i] = malloc_allocator->AllocateBytes(64 + (i % 4) * 32, 16);
+    for (int i = 0; i < kNumAllocations; ++i)
+      malloc_allocator->DeallocateBytes(ptrs[i], 64 + (i % 4) * 32);
+  }
+}
+
+BENCHMARK(BM_ArenaAllocator)->ThreadRange(1, 8);
+BENCHMARK(BM_MallocAllocator)->ThreadRange(1, 8);
+
+}  // namespace
+}  // namespace tfrt
@@ -20,6 +20,9 @@
 
 #include "tfrt/host_context/async_value.h"
 
+#include <array>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "tfrt/cpp_tests/test_util.h"
 #include "tfrt/host_context/async_value_ref.h"
@@ -112,5 +115,61 @@ TEST_F(AsyncValueTest, AddAndDropRef) {
   value->DropRef();
 }
 
+TEST_F(AsyncValueTest, SmallAndLargeWaiters) {
+  AsyncValue* value =
+      MakeConstructedAsyncValueRef<int32_t>(host_context_.get(), 123).release();
+
+  AsyncValue::WaiterStats before;
+  if (AsyncValue::AsyncValueAllocationTrackingEnabled())
+    before = AsyncValue::GetWaiterStats();
+
+  // The small and the medium waiters are stored inline in their waiter list
+  // node, the large one does not fit and is boxed. Only the medium waiter is
+  // counted as inline, since the small one would fit into the inline storage
+  // of a boxed llvm::unique_function as well.
+  std::vector<int> order;
+  std::array<int64_t, 4> medium_capture = {};
+  medium_capture[3] = 2;
+  std::array<int64_t, 16> large_capture = {};
+  large_capture[15] = 3;
+  auto small_waiter = [&order] { order.push_back(1); };
+  auto medium_waiter = [&order, medium_capture] {
+    order.push_back(medium_capture[3]);
+  };
+  auto large_waiter = [&order, large_capture] {
+    order.push_back(large_capture[15]);
+  };
+  static_assert(sizeof(small_waiter) <=
+                    NotifierListNode::kUniqueFunctionInlineSize,
+                "small waiter is too large");
+  static_assert(sizeof(medium_waiter) >
+                        NotifierListNode::kUniqueFunctionInlineSize &&
+                    sizeof(medium_waiter) <= NotifierListNode::kInlineWaiterSize,
+                "medium waiter has the wrong size");
+  static_assert(sizeof(large_waiter) > NotifierListNode::kInlineWaiterSize,
+                "large waiter is too small");
+  value->AndThen(small_waiter);
+  value->AndThen(medium_waiter);
+  value->AndThen(large_waiter);
+  EXPECT_TRUE(order.empty());
+
+  value->SetStateConcrete();
+  ASSERT_EQ(order.size(), 3);
+  EXPECT_EQ(order[0] + order[1] + order[2], 6);
+
+  // The value is available, the waiter runs immediately.
+  value->AndThen([&order] { order.push_back(4); });
+  EXPECT_EQ(order.size(), 4);
+
+  if (AsyncValue::AsyncValueAllocationTrackingEnabled()) {
+    AsyncValue::WaiterStats after = AsyncValue::GetWaiterStats();
+    EXPECT_EQ(after.num_immediate - before.num_immediate, 1);
+    EXPECT_EQ(after.num_inline - before.num_inline, 1);
+    EXPECT_EQ(after.num_boxed - before.num_boxed, 1);
+  }
+
+  value->DropRef();
+}
+
 }  // namespace
 }  // namespace tfrt
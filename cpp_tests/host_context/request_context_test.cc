@@ -64,5 +64,36 @@ TEST(RequestContextTest, ContextData) {
   EXPECT_EQ(expected_request_context.get()->GetDataIfExists<int>(), nullptr);
 }
 
+TEST(RequestContextTest, ArenaAllocatorDisabledByDefault) {
+  auto host = CreateTestHostContext();
+  ResourceContext resource_context;
+  auto request_context =
+      RequestContextBuilder(host.get(), &resource_context).build();
+  ASSERT_FALSE(!request_context);
+
+  EXPECT_EQ(request_context.get()->arena_allocator(), nullptr);
+  EXPECT_EQ(request_context.get()->allocator(), host->allocator());
+}
+
+TEST(RequestContextTest, ArenaAllocatorOutlivesRequest) {
+  auto host = CreateTestHostContext();
+  ResourceContext resource_context;
+  auto request_context = RequestContextBuilder(host.get(), &resource_context)
+                             .enable_arena_allocator()
+                             .build();
+  ASSERT_FALSE(!request_context);
+
+  HostAllocator* allocator = request_context.get()->allocator();
+  EXPECT_EQ(allocator, request_context.get()->arena_allocator());
+
+  int* value = allocator->Allocate<int>(1);
+  *value = 42;
+
+  // Memory allocated from the arena stays valid until it is deallocated.
+  request_context = RCReference<RequestContext>();
+  EXPECT_EQ(*value, 42);
+  allocator->Deallocate(value, 1);
+}
+
 }  // namespace
 }  // namespace tfrt
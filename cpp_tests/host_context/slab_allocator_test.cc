@@ -0,0 +1,148 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- slab_allocator_test.cc -----------------------------------*- C++ -*-===//
+//
+// Unit tests and benchmarks for the slab HostAllocator.
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "llvm/ADT/STLExtras.h"
+#include "tfrt/host_context/host_allocator.h"
+
+namespace tfrt {
+namespace {
+
+bool IsAligned(void* ptr, size_t alignment) {
+  return reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0;
+}
+
+TEST(SlabAllocatorTest, AllocateDeallocateBytesWithAlignment) {
+  auto allocator = CreateSlabAllocator();
+
+  for (size_t size : {1, 8, 24, 100, 256, 1000, 4096, 10000}) {
+    for (size_t alignment :
+         {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 8192}) {
+      void* buffer = allocator->AllocateBytes(size, alignment);
+      ASSERT_NE(nullptr, buffer);
+      EXPECT_TRUE(IsAligned(buffer, alignment));
+      memset(buffer, 0, size);
+      allocator->DeallocateBytes(buffer, size);
+    }
+  }
+}
+
+TEST(SlabAllocatorTest, AllocationsDoNotOverlap) {
+  auto allocator = CreateSlabAllocator();
+
+  struct Allocation {
+    uint8_t* ptr;
+    size_t size;
+  };
+  std::vector<Allocation> allocations;
+
+  // Allocate enough objects of every size to span multiple slabs.
+  for (int i = 0; i < 20000; ++i) {
+    size_t size = 1 + (i * 37) % 5000;
+    auto* ptr = static_cast<uint8_t*>(allocator->AllocateBytes(size, 8));
+    memset(ptr, i % 251, size);
+    allocations.push_back({ptr, size});
+  }
+
+  for (int i = 0; i < allocations.size(); ++i) {
+    Allocation& alloc = allocations[i];
+    for (size_t j = 0; j < alloc.size; ++j) ASSERT_EQ(alloc.ptr[j], i % 251);
+    allocator->DeallocateBytes(alloc.ptr, alloc.size);
+  }
+}
+
+TEST(SlabAllocatorTest, DeallocateFromAnotherThread) {
+  auto allocator = CreateSlabAllocator();
+
+  constexpr int kNumThreads = 4;
+  constexpr int kNumAllocations = 10000;
+
+  // Each thread allocates objects that are deallocated by the next thread.
+  std::vector<std::vector<void*>> allocations(kNumThreads);
+  for (int i = 0; i < kNumThreads; ++i) {
+    std::thread([&, i]() {
+      for (int j = 0; j < kNumAllocations; ++j)
+        allocations[i].push_back(allocator->AllocateBytes(64, 16));
+    }).join();
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&, i]() {
+      for (void* ptr : allocations[(i + 1) % kNumThreads])
+        allocator->DeallocateBytes(ptr, 64);
+      // Reuse the memory freed by this thread.
+      for (int j = 0; j < kNumAllocations; ++j)
+        allocator->DeallocateBytes(allocator->AllocateBytes(64, 16), 64);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+// Allocates and deallocates a window of small objects of mixed sizes, which
+// roughly models allocation of async values and kernel frames.
+void BenchmarkAllocator(benchmark::State& state, HostAllocator* allocator) {
+  constexpr int kWindow = 64;
+  static constexpr size_t kSizes[] = {16, 32, 48, 64, 96, 128, 256, 512};
+
+  std::vector<std::pair<void*, size_t>> window(kWindow, {nullptr, 0});
+  int i = 0;
+  for (auto _ : state) {
+    auto& slot = window[i++ % kWindow];
+    if (slot.first) allocator->DeallocateBytes(slot.first, slot.second);
+    slot.second = kSizes[i % llvm::array_lengthof(kSizes)];
+    slot.first = allocator->AllocateBytes(slot.second, 8);
+    benchmark::DoNotOptimize(slot.first);
+  }
+  for (auto& slot : window)
+    if (slot.first) allocator->DeallocateBytes(slot.first, slot.second);
+}
+
+HostAllocator* GetMallocAllocator() {
+  static HostAllocator* allocator = CreateMallocAllocator().release();
+  return allocator;
+}
+
+HostAllocator* GetSlabAllocator() {
+  static HostAllocator* allocator = CreateSlabAllocator().release();
+  return allocator;
+}
+
+void BM_MallocAllocator(benchmark::State& state) {
+  BenchmarkAllocator(state, GetMallocAllocator());
+}
+
+void BM_SlabAllocator(benchmark::State& state) {
+  BenchmarkAllocator(state, GetSlabAllocator());
+}
+
+BENCHMARK(BM_MallocAllocator)->ThreadRange(1, 8);
+BENCHMARK(BM_SlabAllocator)->ThreadRange(1, 8);
+
+}  // namespace
+}  // namespace tfrt
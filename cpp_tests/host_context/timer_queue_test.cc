@@ -14,7 +14,7 @@
  * limitations under the License.
  */
 
-//===- host_context_test.cc -------------------------------------*- C++ -*-===//
+//===- timer_queue_test.cc --------------------------------------*- C++ -*-===//
 //
 // Unit test for TFRT TimerQueue.
 //
@@ -22,10 +22,13 @@
 
 #include "tfrt/host_context/timer_queue.h"
 
+#include <algorithm>
 #include <chrono>
 #include <ctime>
 #include <memory>
+#include <vector>
 
+#include "benchmark/benchmark.h"
 #include "gtest/gtest.h"
 
 namespace tfrt {
@@ -97,5 +100,59 @@ TEST(TimerQueueTest, TimerQueueTimerCancelled) {
   ASSERT_FALSE(expired_2);
 }
 
+// This test checks that timers in different levels of the timing wheel expire
+// after their deadline, and in order of their deadline.
+TEST(TimerQueueTest, TimerQueueManyTimersExpireInOrder) {
+  constexpr int kNumTimers = 256;
+  TimerQueue tq;
+  mutex mu;
+  std::vector<int> expiration_order;
+  std::atomic<bool> expired_early{false};
+
+  std::vector<TimerQueue::TimerHandle> timers;
+  for (int i = 0; i < kNumTimers; ++i) {
+    // Interleave short and long deadlines, up to 255 * 5ms.
+    int timeout_ms = ((i * 97) % kNumTimers) * 5;
+    auto deadline = std::chrono::system_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
+    timers.push_back(tq.ScheduleTimerAt(deadline, [&, timeout_ms, deadline] {
+      if (std::chrono::system_clock::now() < deadline) expired_early = true;
+      mutex_lock lock(mu);
+      expiration_order.push_back(timeout_ms);
+    }));
+  }
+
+  std::this_thread::sleep_for(2s);
+
+  mutex_lock lock(mu);
+  ASSERT_EQ(expiration_order.size(), kNumTimers);
+  EXPECT_TRUE(std::is_sorted(expiration_order.begin(), expiration_order.end()));
+  EXPECT_FALSE(expired_early);
+}
+
+// Schedules a timer per request deadline and cancels it when the request
+// completes, which is the common case for RequestDeadlineTracker.
+void BM_ScheduleAndCancelTimer(benchmark::State& state) {
+  static TimerQueue* tq = new TimerQueue();
+
+  for (auto _ : state) {
+    auto timer = tq->ScheduleTimer(10s, []() {});
+    tq->CancelTimer(timer);
+  }
+}
+
+// Schedules timers with short deadlines, so that the timer thread expires
+// them while new ones are scheduled.
+void BM_ScheduleExpiringTimer(benchmark::State& state) {
+  static TimerQueue* tq = new TimerQueue();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tq->ScheduleTimer(1ms, []() {}));
+  }
+}
+
+BENCHMARK(BM_ScheduleAndCancelTimer)->ThreadRange(1, 8);
+BENCHMARK(BM_ScheduleExpiringTimer)->ThreadRange(1, 8);
+
 }  // namespace
 }  // namespace tfrt
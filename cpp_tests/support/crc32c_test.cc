@@ -0,0 +1,117 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- crc32c_test.cc -------------------------------------------*- C++ -*-===//
+//
+// Unit tests and throughput benchmarks for crc32c.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/support/crc32c.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+
+namespace tfrt {
+namespace {
+
+// Bit-at-a-time reference implementation.
+uint32_t ReferenceValue(const char* data, size_t n) {
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < n; ++i) {
+    crc ^= static_cast<uint8_t>(data[i]);
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1)));
+  }
+  return crc ^ 0xffffffffu;
+}
+
+std::string RandomString(size_t size) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::string result(size, '\0');
+  for (auto& c : result) c = static_cast<char>(dist(gen));
+  return result;
+}
+
+// Test vectors from RFC 3720 section B.4.
+TEST(Crc32cTest, StandardResults) {
+  char buf[32];
+
+  std::memset(buf, 0, sizeof(buf));
+  EXPECT_EQ(crc32c::Value(buf, sizeof(buf)), 0x8a9136aa);
+
+  std::memset(buf, 0xff, sizeof(buf));
+  EXPECT_EQ(crc32c::Value(buf, sizeof(buf)), 0x62a8ab43);
+
+  for (int i = 0; i < 32; ++i) buf[i] = i;
+  EXPECT_EQ(crc32c::Value(buf, sizeof(buf)), 0x46dd794e);
+
+  for (int i = 0; i < 32; ++i) buf[i] = 31 - i;
+  EXPECT_EQ(crc32c::Value(buf, sizeof(buf)), 0x113fdb5c);
+
+  EXPECT_EQ(crc32c::Value("123456789", 9), 0xe3069283);
+}
+
+// Covers all combinations of the single stream, short block and long block
+// paths with unaligned starts.
+TEST(Crc32cTest, MatchesReference) {
+  std::string data = RandomString(100000);
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t size : {0, 1, 7, 15, 16, 17, 255, 767, 768, 769, 1000, 4096,
+                        24575, 24576, 24577, 25000, 50000, 99000}) {
+      EXPECT_EQ(crc32c::Value(data.data() + offset, size),
+                ReferenceValue(data.data() + offset, size))
+          << "offset " << offset << " size " << size;
+    }
+  }
+}
+
+TEST(Crc32cTest, Extend) {
+  std::string data = RandomString(60000);
+  uint32_t expected = crc32c::Value(data.data(), data.size());
+  for (size_t split : {0, 1, 9, 768, 5000, 24576, 30001, 60000}) {
+    uint32_t crc = crc32c::Value(data.data(), split);
+    crc = crc32c::Extend(crc, data.data() + split, data.size() - split);
+    EXPECT_EQ(crc, expected) << "split " << split;
+  }
+}
+
+TEST(Crc32cTest, Mask) {
+  uint32_t crc = crc32c::Value("foo", 3);
+  EXPECT_NE(crc, crc32c::Mask(crc));
+  EXPECT_NE(crc, crc32c::Mask(crc32c::Mask(crc)));
+  EXPECT_EQ(crc, crc32c::Unmask(crc32c::Mask(crc)));
+  EXPECT_EQ(crc, crc32c::Unmask(
+                     crc32c::Unmask(crc32c::Mask(crc32c::Mask(crc)))));
+}
+
+void BM_Crc32cValue(benchmark::State& state) {
+  std::string data = RandomString(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(crc32c::Value(data.data(), data.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+BENCHMARK(BM_Crc32cValue)->RangeMultiplier(8)->Range(64, 4 << 20);
+
+}  // namespace
+}  // namespace tfrt
@@ -0,0 +1,73 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- perf_counters_test.cc ------------------------------------*- C++ -*-===//
+//
+// Unit tests for the benchmark kernels hardware performance counters.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../../lib/test_kernels/perf_counters.h"
+
+#include <cstdlib>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace tfrt {
+namespace {
+
+bool AllUnavailable(const PerfCounters::Values& values) {
+  for (const auto& value : values)
+    if (value.hasValue()) return false;
+  return true;
+}
+
+TEST(PerfCountersTest, EnabledByEnvironment) {
+  setenv("TFRT_BENCHMARK_PERF_COUNTERS", "0", /*overwrite=*/1);
+  EXPECT_FALSE(PerfCounters::IsEnabled());
+
+  setenv("TFRT_BENCHMARK_PERF_COUNTERS", "1", /*overwrite=*/1);
+  EXPECT_TRUE(PerfCounters::IsEnabled());
+
+  unsetenv("TFRT_BENCHMARK_PERF_COUNTERS");
+  EXPECT_FALSE(PerfCounters::IsEnabled());
+}
+
+TEST(PerfCountersTest, NotStartedCountersAreUnavailable) {
+  PerfCounters counters;
+  EXPECT_TRUE(AllUnavailable(counters.Read()));
+}
+
+TEST(PerfCountersTest, StartedCountersIncludeCycles) {
+  PerfCounters counters;
+
+  // Counters are not available without a PMU or with a restrictive
+  // perf_event_paranoid level.
+  if (!counters.Start()) {
+    EXPECT_TRUE(AllUnavailable(counters.Read()));
+    return;
+  }
+
+  // Cycles counter leads the event groups of all the threads.
+  EXPECT_TRUE(counters.Read()[PerfCounters::kCycles].hasValue());
+
+  // Moved from counters are closed.
+  PerfCounters moved = std::move(counters);
+  EXPECT_TRUE(AllUnavailable(counters.Read()));
+  EXPECT_TRUE(moved.Read()[PerfCounters::kCycles].hasValue());
+}
+
+}  // namespace
+}  // namespace tfrt
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- kernel_profile_tracing_sink_test.cc ----------------------*- C++ -*-===//
+//
+// Unit test for KernelProfileTracingSink.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/tracing/kernel_profile_tracing_sink/kernel_profile_tracing_sink.h"
+
+#include <string>
+#include <thread>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/tracing/tracing.h"
+
+namespace tfrt {
+namespace tracing {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::MatchesRegex;
+
+TEST(KernelProfileTracingSinkTest, AggregatesScopesByName) {
+  KernelProfileTracingSink sink(/*output_path=*/"");
+  RegisterTracingSink(&sink);
+  SetTracingLevel(TracingLevel::Debug);
+
+  {
+    TracingRequester tracing;
+    auto run_kernels = [] {
+      for (int i = 0; i < 3; ++i) {
+        TFRT_TRACE_SCOPE(Debug, "test.outer");
+        {
+          TFRT_TRACE_SCOPE(Debug, "test.inner");
+        }
+      }
+    };
+    run_kernels();
+    std::thread(run_kernels).join();
+
+    std::string profile;
+    llvm::raw_string_ostream os(profile);
+    sink.WriteProfile(os);
+    os.flush();
+
+    EXPECT_THAT(profile,
+                MatchesRegex("# .*\n"
+                             "6 [0-9]+ test.inner\n"
+                             "6 [0-9]+ test.outer\n"));
+  }
+
+  SetTracingLevel(TracingLevel::Default);
+}
+
+TEST(KernelProfileTracingSinkTest, SeparatesProfilesOfSinks) {
+  auto profile_of = [](const KernelProfileTracingSink& sink) {
+    std::string profile;
+    llvm::raw_string_ostream os(profile);
+    sink.WriteProfile(os);
+    return os.str();
+  };
+
+  for (int i = 0; i < 2; ++i) {
+    KernelProfileTracingSink first(/*output_path=*/"");
+    KernelProfileTracingSink second(/*output_path=*/"");
+    first.PushTracingScope([] { return std::string("test.first"); });
+    first.PopTracingScope();
+    second.PushTracingScope([] { return std::string("test.second"); });
+    second.PopTracingScope();
+
+    EXPECT_THAT(profile_of(first), MatchesRegex("# .*\n"
+                                                "1 [0-9]+ test.first\n"));
+    EXPECT_THAT(profile_of(second), MatchesRegex("# .*\n"
+                                                 "1 [0-9]+ test.second\n"));
+  }
+}
+
+}  // namespace
+}  // namespace tracing
+}  // namespace tfrt
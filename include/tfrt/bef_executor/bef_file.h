@@ -52,13 +52,22 @@ class BEFFile : public ReferenceCounted<BEFFile> {
   // pointer to our initialized object on success.  On failure, an error
   // message is emitted to the error_handler and nullptr is returned.
   //
+  // If `lazy` is true, kernels are resolved against the `registry` and BEF
+  // functions are decoded on their first execution instead of when the file
+  // is opened, which makes opening programs with many functions cheaper when
+  // only a few of them are executed. Malformed functions and unknown kernels
+  // are then reported to the error_handler when the function is executed, and
+  // the `registry` must outlive the returned BEFFile. SyncBEFFunctions are
+  // always decoded when the file is opened.
+  //
   // TODO: This should (optionally) manage ownership of the underlying data
   // passed in, taking a closure to run when the lifetime of the BEFFile is
   // done.
   static RCReference<BEFFile> Open(ArrayRef<uint8_t> file,
                                    const KernelRegistry& registry,
                                    ErrorHandler error_handler,
-                                   HostAllocator* host_allocator);
+                                   HostAllocator* host_allocator,
+                                   bool lazy = false);
 
   // Get a list of functions out of the BEF file.
   void GetFunctionList(SmallVectorImpl<const Function*>* result) const;
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- mapped_bef_file.h ----------------------------------------*- C++ -*-===//
+//
+// This file declares MappedBEFFile, a read-only memory mapping of a BEF file.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_BEF_EXECUTOR_MAPPED_BEF_FILE_H_
+#define TFRT_BEF_EXECUTOR_MAPPED_BEF_FILE_H_
+
+#include <memory>
+
+#include "tfrt/support/forward_decls.h"
+
+namespace llvm {
+namespace sys {
+namespace fs {
+class mapped_file_region;
+}  // namespace fs
+}  // namespace sys
+}  // namespace llvm
+
+namespace tfrt {
+
+// MappedBEFFile maps a BEF file read-only into memory, so that BEFFile::Open
+// can read it in place instead of from a heap copy. Pages are loaded lazily
+// and shared with other processes mapping the same file via the page cache.
+//
+// The mapping is page aligned, which satisfies BefGetRequiredAlignment().
+// MappedBEFFile must outlive all BEFFiles opened from its data.
+class MappedBEFFile {
+ public:
+  // Maps the file at `path`. Returns an error if the file can't be mapped
+  // (e.g. it is empty or it is not a regular file).
+  static Expected<std::unique_ptr<MappedBEFFile>> Open(string_view path);
+
+  ~MappedBEFFile();
+
+  ArrayRef<uint8_t> data() const;
+
+ private:
+  explicit MappedBEFFile(
+      std::unique_ptr<llvm::sys::fs::mapped_file_region> region);
+
+  std::unique_ptr<llvm::sys::fs::mapped_file_region> region_;
+};
+
+}  // namespace tfrt
+
+#endif  // TFRT_BEF_EXECUTOR_MAPPED_BEF_FILE_H_
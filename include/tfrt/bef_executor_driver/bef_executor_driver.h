@@ -47,6 +47,10 @@ enum class HostAllocatorType {
   // Allocator wrapped around profiled malloc and exit(1) on detecting memory
   // leak.
   kLeakCheckMalloc,
+
+  // Allocator that serves small allocations from per-thread slab caches, and
+  // prints allocation statistics on exit.
+  kSlab,
 };
 
 struct RunBefConfig {
@@ -59,6 +63,8 @@ struct RunBefConfig {
   std::string work_queue_type;
   tfrt::HostAllocatorType host_allocator_type;
   bool print_error_code = false;
+  // Decode BEF functions on their first execution (see BEFFile::Open).
+  bool lazy_bef_open = false;
 };
 
 // Run the BEF program with default execution context.
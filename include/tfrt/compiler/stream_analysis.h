@@ -28,6 +28,11 @@
 // worth doing so. Note that dependent streams can still be merged regardless of
 // the cost. It is set through the module attribute `tfrt.cost_threshold`.
 //
+// Operation Cost: The cost of an operation is its `_tfrt_cost` attribute, which
+// is either static for operations with the CostTrait, or measured at runtime
+// and set by the tfrt-apply-cost-profile pass. Operations without cost are
+// treated as costing the cost threshold.
+//
 // The algorithm can be summarized as follows:
 //
 // 1. Build a naive stream tree where each stream contains only one operation:
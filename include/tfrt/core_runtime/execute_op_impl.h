@@ -23,16 +23,24 @@
 #ifndef TFRT_CORE_RUNTIME_EXECUTE_OP_IMPL_H_
 #define TFRT_CORE_RUNTIME_EXECUTE_OP_IMPL_H_
 
+#include <memory>
+#include <tuple>
+
+#include "llvm/ADT/DenseMap.h"
+#include "tfrt/core_runtime/core_runtime_op.h"
+#include "tfrt/core_runtime/op_attrs.h"
+#include "tfrt/host_context/attribute_utils.h"
 #include "tfrt/support/forward_decls.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
 
 namespace tfrt {
 
 class Chain;
-class AggregateAttr;
 class ExecutionContext;
 class AsyncValue;
-class CoreRuntimeOp;
-class OpAttrs;
+class CoreRuntime;
+class OpHandler;
 class Value;
 class TensorHandle;
 template <typename T>
@@ -59,12 +67,74 @@ void ExecuteOpImpl(CoreRuntimeOp op, ArrayRef<AsyncValue *> args,
                    AggregateAttr op_func_attr_array,
                    const ExecutionContext &exec_ctx);
 
+// Same as above, but with attributes that are already set up.
+void ExecuteOpImpl(const CoreRuntimeOp &op, ArrayRef<AsyncValue *> args,
+                   AsyncValueRef<Chain> *op_chain,
+                   MutableArrayRef<RCReference<AsyncValue>> results,
+                   const OpAttrsRef &op_attrs,
+                   const ExecutionContext &exec_ctx);
+
 void ExecuteOpImplSync(const CoreRuntimeOp &op,
                        RepeatedSyncArguments<TensorHandle> args,
                        AsyncValueRef<Chain> *op_chain, SyncKernelFrame *frame,
                        AggregateAttr op_attr_array,
                        const ExecutionContext &exec_ctx);
 
+// Same as above, but with attributes that are already set up.
+void ExecuteOpImplSync(const CoreRuntimeOp &op,
+                       RepeatedSyncArguments<TensorHandle> args,
+                       AsyncValueRef<Chain> *op_chain, SyncKernelFrame *frame,
+                       const OpAttrsRef &op_attrs,
+                       const ExecutionContext &exec_ctx);
+
+// A CoreRuntimeOp together with the frozen attributes of an op execution
+// kernel, ready to be executed.
+struct PreparedOp {
+  PreparedOp(CoreRuntimeOp op, OpAttrsRef attrs)
+      : op(std::move(op)), attrs(std::move(attrs)) {}
+
+  CoreRuntimeOp op;
+  OpAttrsRef attrs;
+};
+
+// Looks up `op_name` on `op_handler`, and sets up and freezes the attributes
+// in `op_attr_array` and `op_func_attr_array`. `op_func_attr_array` may be
+// null.
+Expected<std::unique_ptr<PreparedOp>> PrepareOp(
+    CoreRuntime *core_rt, string_view op_name, OpHandler *op_handler,
+    AggregateAttr op_attr_array, AggregateAttr op_func_attr_array);
+
+// PreparedOpCache keeps the PreparedOp of every op execution kernel and
+// OpHandler, so that the op lookup and the attribute decoding only happen on
+// the first execution of a kernel. A kernel is identified by the addresses of
+// its op name and attributes in the BEF file, so kernels whose attributes are
+// uniqued in the BEF file share an entry. The cache must not outlive the BEF
+// file, which is why the kernels keep it in the ResourceContext of the
+// execution. This class is thread-safe.
+class PreparedOpCache {
+ public:
+  // Returns the PreparedOp of the kernel, preparing it on the first call.
+  // Failures are not cached.
+  Expected<const PreparedOp *> GetOrPrepare(CoreRuntime *core_rt,
+                                            StringAttr op_name,
+                                            OpHandler *op_handler,
+                                            AggregateAttr op_attr_array,
+                                            AggregateAttr op_func_attr_array)
+      TFRT_EXCLUDES(mu_);
+
+  size_t size() const TFRT_EXCLUDES(mu_) {
+    mutex_lock lock(mu_);
+    return cache_.size();
+  }
+
+ private:
+  using Key = std::tuple<const void *, const void *, const void *,
+                         const OpHandler *>;
+
+  mutable mutex mu_;
+  llvm::DenseMap<Key, std::unique_ptr<PreparedOp>> cache_ TFRT_GUARDED_BY(mu_);
+};
+
 void AsyncWaitForResultsFromTensorHandles(
     MutableArrayRef<RCReference<AsyncValue>> results,
     MutableArrayRef<TensorHandle> result_ths);
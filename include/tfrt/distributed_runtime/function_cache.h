@@ -24,10 +24,12 @@
 #ifndef TFRT_DISTRIBUTED_RUNTIME_FUNCTION_CACHE_H_
 #define TFRT_DISTRIBUTED_RUNTIME_FUNCTION_CACHE_H_
 
+#include <memory>
 #include <unordered_map>
 
 #include "tfrt/bef_converter/bef_buffer.h"
 #include "tfrt/bef_executor/bef_file.h"
+#include "tfrt/bef_executor/mapped_bef_file.h"
 #include "tfrt/host_context/chain.h"
 #include "tfrt/host_context/resource_context.h"
 
@@ -44,6 +46,10 @@ class FunctionCache {
   // The program_name serves as both unique ID of this program.
   Error Register(const std::string& program_name, BEFBuffer bef_buffer);
 
+  // Register the program from the BEF file at `bef_path`. The file is memory
+  // mapped and read in place, instead of being copied into a BEFBuffer.
+  Error RegisterFromFile(const std::string& program_name, string_view bef_path);
+
   // Create BEFFile corresponding to the program with the given name.
   // A struct representing a BEFFile and the respective buffer.
   struct CachedBEF {
@@ -56,11 +62,25 @@ class FunctionCache {
   CachedBEF* Prepare(const std::string& program_name);
 
  private:
+  // Storage of the BEF binary of a registered program. Exactly one of the
+  // members owns the binary.
+  struct BEFStorage {
+    BEFBuffer bef_buffer;
+    std::unique_ptr<MappedBEFFile> mapped_bef_file;
+
+    ArrayRef<uint8_t> data() const {
+      if (mapped_bef_file) return mapped_bef_file->data();
+      return bef_buffer;
+    }
+  };
+
+  Error Register(const std::string& program_name, BEFStorage storage);
+
   HostContext* host_;
 
   mutex cached_bef_mutex_;
   // Map from the program name to the CachedBEF.
-  std::unordered_map<std::string, std::pair<BEFBuffer, CachedBEF>> cached_bef_
+  std::unordered_map<std::string, std::pair<BEFStorage, CachedBEF>> cached_bef_
       TFRT_GUARDED_BY(cached_bef_mutex_);
 };
 
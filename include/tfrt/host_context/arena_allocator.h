@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- arena_allocator.h ----------------------------------------*- C++ -*-===//
+//
+// This file declares ArenaAllocator, a thread-safe bump pointer HostAllocator
+// for request-lifetime data.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_HOST_CONTEXT_ARENA_ALLOCATOR_H_
+#define TFRT_HOST_CONTEXT_ARENA_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/ref_count.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+
+// ArenaAllocator carves allocations out of large memory blocks obtained from
+// an underlying HostAllocator. DeallocateBytes does not reuse memory, all
+// blocks are released together when the arena is destroyed. This makes
+// allocation a single atomic bump of the block offset, and deallocation a
+// reference count decrement.
+//
+// ArenaAllocator is reference counted, and every live allocation holds a
+// reference to the arena, so that memory that escapes the owner of the arena
+// (e.g. a tensor returned from a request) stays valid until it is deallocated.
+//
+// ArenaAllocator is intended for short-lived data, e.g. allocations made while
+// executing a single request (see RequestContextBuilder), because memory of
+// deallocated objects is not reclaimed until all allocations are released.
+class ArenaAllocator : public HostAllocator,
+                       public ReferenceCounted<ArenaAllocator> {
+ public:
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+  // Memory blocks are allocated from `allocator`, which must outlive the
+  // arena and all of its allocations.
+  explicit ArenaAllocator(HostAllocator* allocator,
+                          size_t block_size = kDefaultBlockSize);
+  ~ArenaAllocator() override;
+
+  void* AllocateBytes(size_t size, size_t alignment) override;
+  void DeallocateBytes(void* ptr, size_t size) override;
+
+  // Returns the number of bytes reserved in memory blocks.
+  size_t reserved_bytes() const {
+    return reserved_bytes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Block;
+
+  // Allocates a new block for an allocation of `size` bytes that does not fit
+  // into the `current` block. Returns nullptr if another thread has already
+  // replaced the `current` block.
+  void* AllocateFromNewBlock(Block* current, size_t size, size_t alignment);
+
+  Block* NewBlock(size_t capacity) TFRT_REQUIRES(mu_);
+
+  HostAllocator* const allocator_;
+  const size_t block_size_;
+
+  std::atomic<Block*> current_block_;
+  std::atomic<size_t> reserved_bytes_{0};
+
+  mutex mu_;
+  // All blocks owned by the arena, linked via Block::next.
+  Block* blocks_ TFRT_GUARDED_BY(mu_) = nullptr;
+};
+
+}  // namespace tfrt
+
+#endif  // TFRT_HOST_CONTEXT_ARENA_ALLOCATOR_H_
@@ -30,9 +30,11 @@
 #include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <new>
 #include <string>
 #include <type_traits>
 
+#include "llvm/ADT/FunctionExtras.h"
 #include "llvm/ADT/PointerIntPair.h"
 #include "tfrt/host_context/diagnostic.h"
 #include "tfrt/host_context/host_context_ptr.h"
@@ -171,6 +173,23 @@ class AsyncValue {
     return total_allocated_async_values_.load(std::memory_order_relaxed);
   }
 
+  /// Counters of the waiters passed to AndThen in the process. This is intended
+  /// for debugging/performance analysis only, and is only kept in sync if
+  /// AsyncValueAllocationTrackingEnabled() returns true.
+  struct WaiterStats {
+    /// Waiters that ran immediately because the value was already available.
+    int64_t num_immediate = 0;
+    /// Waiters stored inline in their waiter list node that are too large for
+    /// the inline storage of llvm::unique_function, i.e. the waiters for which
+    /// the inline storage saved a heap allocation. Smaller waiters are not
+    /// counted.
+    int64_t num_inline = 0;
+    /// Waiters too large to be stored inline, which were boxed into a heap
+    /// allocated closure.
+    int64_t num_boxed = 0;
+  };
+  static WaiterStats GetWaiterStats();
+
   /// Returns true if we track the number of alive AsyncValue instances in
   /// total_allocated_async_values_.
   static bool AsyncValueAllocationTrackingEnabled() {
@@ -302,6 +321,9 @@ class AsyncValue {
   void Destroy();
   void RunWaiters(NotifierListNode* list);
 
+  // Allocates an uninitialized waiter list node from the HostContext.
+  NotifierListNode* AllocateWaiterNode();
+
   // IsTypeIdCompatible returns true if the type value stored in this AsyncValue
   // instance can be safely cast to `T`. This is a conservative check. I.e.
   // IsTypeIdCompatible may return true even if the value cannot be safely cast
@@ -428,14 +450,19 @@ class AsyncValue {
   // Returns the TypeInfoTable instance (there is one per process).
   static TypeInfoTable* GetTypeInfoTableSingleton();
 
-  void EnqueueWaiter(llvm::unique_function<void()>&& waiter,
-                     WaitersAndState old_value);
+  void EnqueueWaiter(NotifierListNode* node, WaitersAndState old_value);
 
   /// This is a global counter of the number of AsyncValue instances currently
   /// live in the process.  This is intended to be used for debugging only, and
   /// is only kept in sync if AsyncValueAllocationTrackingEnabled() returns
   /// true.
   static std::atomic<ssize_t> total_allocated_async_values_;
+
+  /// Global counters backing GetWaiterStats(). Only kept in sync if
+  /// AsyncValueAllocationTrackingEnabled() returns true.
+  static std::atomic<int64_t> num_immediate_waiters_;
+  static std::atomic<int64_t> num_inline_waiters_;
+  static std::atomic<int64_t> num_boxed_waiters_;
 };
 
 // We only optimize the code for 64-bit architectures for now.
@@ -636,6 +663,54 @@ class IndirectAsyncValue : public AsyncValue {
 // -----------------------------------------------------------
 // Implementation details follow.  Clients should ignore them.
 //
+
+// This is a singly linked list of nodes waiting for notification, hanging off
+// of AsyncValue.  When the value becomes available or if an error occurs, the
+// callbacks are informed.
+//
+// Most AsyncValues have a single waiter with a small closure, so the closure is
+// stored in the node itself when it fits into kInlineWaiterSize bytes, and
+// enqueueing a waiter takes a single allocation from the HostContext
+// allocator. Larger closures are boxed into an llvm::unique_function.
+class NotifierListNode {
+ public:
+  static constexpr size_t kInlineWaiterSize = 48;
+  // Closures up to this size fit into the inline storage of
+  // llvm::unique_function, and do not need a heap allocation when boxed.
+  static constexpr size_t kUniqueFunctionInlineSize = 3 * sizeof(void*);
+
+  // Store `waiter` in this node. Returns true if it is stored inline.
+  template <typename WaiterT>
+  bool Emplace(WaiterT&& waiter) {
+    using Closure = std::decay_t<WaiterT>;
+    constexpr bool kIsInline = sizeof(Closure) <= kInlineWaiterSize &&
+                               alignof(Closure) <= alignof(void*);
+    using StoredClosure = std::conditional_t<kIsInline, Closure,
+                                             llvm::unique_function<void()>>;
+    static_assert(sizeof(StoredClosure) <= kInlineWaiterSize,
+                  "Boxed waiter does not fit into NotifierListNode");
+    new (&storage_) StoredClosure(std::forward<WaiterT>(waiter));
+    notify_ = &NotifyAndDestroy<StoredClosure>;
+    return kIsInline;
+  }
+
+ private:
+  friend class AsyncValue;
+
+  template <typename StoredClosure>
+  static void NotifyAndDestroy(NotifierListNode* node) {
+    auto* closure = reinterpret_cast<StoredClosure*>(&node->storage_);
+    (*closure)();
+    closure->~StoredClosure();
+  }
+
+  // This is the next thing waiting on the AsyncValue.
+  NotifierListNode* next_ = nullptr;
+  // Runs and destroys the closure in storage_.
+  void (*notify_)(NotifierListNode*) = nullptr;
+  std::aligned_storage_t<kInlineWaiterSize, alignof(void*)> storage_;
+};
+
 inline AsyncValue::~AsyncValue() {
   assert(waiters_and_state_.load().getPointer() == nullptr &&
          "An async value with waiters should never have refcount of zero");
@@ -793,10 +868,23 @@ void AsyncValue::AndThen(WaiterT&& waiter) {
   if (old_value.getInt() == State::kConcrete ||
       old_value.getInt() == State::kError) {
     assert(old_value.getPointer() == nullptr);
+    if (AsyncValueAllocationTrackingEnabled())
+      num_immediate_waiters_.fetch_add(1, std::memory_order_relaxed);
     waiter();
     return;
   }
-  EnqueueWaiter(std::forward<WaiterT>(waiter), old_value);
+
+  NotifierListNode* node = AllocateWaiterNode();
+  bool is_inline = node->Emplace(std::forward<WaiterT>(waiter));
+  if (AsyncValueAllocationTrackingEnabled()) {
+    if (!is_inline) {
+      num_boxed_waiters_.fetch_add(1, std::memory_order_relaxed);
+    } else if (sizeof(std::decay_t<WaiterT>) >
+               NotifierListNode::kUniqueFunctionInlineSize) {
+      num_inline_waiters_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  EnqueueWaiter(node, old_value);
 }
 
 inline raw_ostream& operator<<(raw_ostream& os,
@@ -163,6 +163,17 @@ std::unique_ptr<ConcurrentWorkQueue> CreateSingleThreadedWorkQueue();
 std::unique_ptr<ConcurrentWorkQueue> CreateMultiThreadedWorkQueue(
     int num_threads, int num_blocking_threads);
 
+// Create a multi-threaded non-blocking thread pool that schedules non-blocking
+// tasks submitted with an ExecutionContext according to the request priority
+// (see RequestOptions::priority). Worker threads always run the highest
+// priority pending task from their own queue first, and steal the highest
+// priority tasks from other threads. Tasks submitted without an
+// ExecutionContext run at the default priority.
+//
+// Arguments are the same as for CreateMultiThreadedWorkQueue.
+std::unique_ptr<ConcurrentWorkQueue> CreateMultiThreadedPriorityWorkQueue(
+    int num_threads, int num_blocking_threads);
+
 // A factory function for creating ConcurrentWorkQueue objects. The factory
 // function defines the semantics of the argument string.
 // TODO(pgavin): Consider using a configuration object or other data structure
@@ -23,6 +23,7 @@
 #ifndef TFRT_HOST_CONTEXT_EXECUTION_CONTEXT_H_
 #define TFRT_HOST_CONTEXT_EXECUTION_CONTEXT_H_
 
+#include "tfrt/host_context/arena_allocator.h"
 #include "tfrt/host_context/debug_info.h"
 #include "tfrt/host_context/location.h"
 #include "tfrt/host_context/resource_context.h"
@@ -54,6 +55,14 @@ class RequestContext : public ReferenceCounted<RequestContext> {
   HostContext* host() const { return host_; }
   ResourceContext* resource_context() const { return resource_context_; }
 
+  // Returns the allocator for request-lifetime data: the request arena
+  // allocator if it was enabled by the RequestContextBuilder, and the
+  // HostContext allocator otherwise.
+  HostAllocator* allocator() const;
+
+  // Returns the request arena allocator, or nullptr if it is not enabled.
+  ArenaAllocator* arena_allocator() const { return arena_allocator_.get(); }
+
   // If the request has been canceled, return an ErrorAsyncValue for
   // the cancellation. Otherwise, return nullptr.
   ErrorAsyncValue* GetCancelAsyncValue() const {
@@ -86,11 +95,13 @@ class RequestContext : public ReferenceCounted<RequestContext> {
   friend class RequestContextBuilder;
 
   RequestContext(HostContext* host, ResourceContext* resource_context,
-                 ContextData ctx_data, int64_t id)
+                 ContextData ctx_data, int64_t id,
+                 RCReference<ArenaAllocator> arena_allocator)
       : id_{id},
         host_{host},
         resource_context_{resource_context},
-        context_data_{std::move(ctx_data)} {}
+        context_data_{std::move(ctx_data)},
+        arena_allocator_{std::move(arena_allocator)} {}
 
   int64_t id_;
   HostContext* const host_ = nullptr;
@@ -104,6 +115,8 @@ class RequestContext : public ReferenceCounted<RequestContext> {
   // synchronization overhead.
   ResourceContext* const resource_context_ = nullptr;
   ContextData context_data_;
+  // Allocations made from the arena keep it alive after the request is done.
+  RCReference<ArenaAllocator> arena_allocator_;
 
   std::atomic<ErrorAsyncValue*> cancel_value_{nullptr};
 };
@@ -111,6 +124,10 @@ class RequestContext : public ReferenceCounted<RequestContext> {
 struct RequestOptions {
   using RequestPriority = int;
 
+  // Larger values mean higher priority. Work queues that support task
+  // priorities (see CreateMultiThreadedPriorityWorkQueue) map this value to
+  // one of four levels: `priority >= 2` is critical, `1` is high, `0` is
+  // default and negative values are low (e.g. batch or background traffic).
   RequestPriority priority = 0;
 };
 
@@ -136,6 +153,22 @@ class RequestContextBuilder {
     return std::move(*this);
   }
 
+  // Enables the request arena allocator (see RequestContext::allocator()).
+  // The arena allocates memory from the HostContext allocator in blocks of
+  // `block_size` bytes, and releases them when the request and all of the
+  // arena allocations are destroyed.
+  RequestContextBuilder& enable_arena_allocator(
+      size_t block_size = ArenaAllocator::kDefaultBlockSize) & {
+    arena_block_size_ = block_size;
+    return *this;
+  }
+
+  RequestContextBuilder&& enable_arena_allocator(
+      size_t block_size = ArenaAllocator::kDefaultBlockSize) && {
+    arena_block_size_ = block_size;
+    return std::move(*this);
+  }
+
   int64_t id() const { return id_; }
   HostContext* host() const { return host_; }
   ResourceContext* resource_context() const { return resource_context_; }
@@ -154,6 +187,8 @@ class RequestContextBuilder {
   RequestOptions request_options_;
   ResourceContext* resource_context_ = nullptr;
   RequestContext::ContextData context_data_;
+  // Arena allocator is disabled if the block size is zero.
+  size_t arena_block_size_ = 0;
 };
 
 // ExecutionContext holds the context information for kernel and op execution,
@@ -197,6 +232,7 @@ class ExecutionContext {
   Location location() const { return location_; }
   DebugInfo debug_info() const { return debug_info_; }
   HostContext* host() const { return request_ctx_->host(); }
+  HostAllocator* allocator() const { return request_ctx_->allocator(); }
   bool IsCancelled() const { return request_ctx_->IsCancelled(); }
   ErrorAsyncValue* GetCancelAsyncValue() const {
     return request_ctx_->GetCancelAsyncValue();
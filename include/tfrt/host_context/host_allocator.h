@@ -79,6 +79,12 @@ std::unique_ptr<HostAllocator> CreateMallocAllocator();
 // Create an allocator of fixed size for testing.
 std::unique_ptr<HostAllocator> CreateFixedSizeAllocator(size_t capacity = 1024);
 
+// Create an allocator that serves small allocations from per-size-class slabs
+// through per-thread caches, and falls back to aligned malloc for large ones.
+// If `print_stats` is true, allocation statistics are printed to stdout when
+// the allocator is destroyed.
+std::unique_ptr<HostAllocator> CreateSlabAllocator(bool print_stats = false);
+
 // An RAII-based abstraction that manages an array of objects via HostAllocator.
 template <typename ObjectT>
 class HostArray {
@@ -16,18 +16,23 @@
 
 //===- timer_queue.h - Timer Queue ------------------------------*- C++ -*-===//
 //
-// This file declares TimerQueue, a priority queue to keep track of pending
-// timers. The queue is keyed by timer deadline (the sooner it expires, the
-// higher the priority). On timer expiration, it calls the associated callback.
+// This file declares TimerQueue, which keeps track of pending timers and calls
+// the associated callback on timer expiration. Timers are kept in a
+// hierarchical timing wheel with a resolution of kTickDuration, so scheduling
+// and cancelling a timer are O(1).
 //
 //===----------------------------------------------------------------------===//
 
 #ifndef TFRT_HOST_CONTEXT_TIMER_QUEUE_H_
 #define TFRT_HOST_CONTEXT_TIMER_QUEUE_H_
 
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <queue>
+#include <cstdint>
+#include <limits>
 #include <thread>
+#include <vector>
 
 #include "llvm/ADT/FunctionExtras.h"
 #include "tfrt/support/mutex.h"
@@ -52,7 +57,8 @@ class TimerQueue {
   // On destruction, cancel every timer in the queue.
   ~TimerQueue();
 
-  // Enqueue a new timer.
+  // Enqueue a new timer. This does not take any lock unless the timer thread
+  // needs to be woken up for an earlier deadline.
   TimerHandle ScheduleTimerAt(TimePoint deadline, TimerCallback callback);
 
   // Enqueue a timer. Deadline is `timeout` microseconds from now.
@@ -61,45 +67,94 @@ class TimerQueue {
   void CancelTimer(const TimerHandle& timer_handle);
 
  private:
+  // Timers expire at the first tick at or after their deadline.
+  using Tick = int64_t;
+  static constexpr TimeDuration kTickDuration = std::chrono::milliseconds(1);
+
+  // The wheel has kNumLevels levels of kSlotsPerLevel slots. Level 0 has a
+  // slot per tick, and each slot in level N covers all of level N-1. Timers
+  // beyond the last level (about 4.6 hours) are kept in an overflow list.
+  static constexpr int kNumLevels = 4;
+  static constexpr int kBitsPerLevel = 6;
+  static constexpr int kSlotsPerLevel = 1 << kBitsPerLevel;
+
   // A reference counted timer, which has a deadline and a callback function.
   class TimerEntry : public ReferenceCounted<TimerEntry> {
    public:
     // Factory method to create a timer. Meant for internal usage only.
-    static RCReference<TimerEntry> Create(TimePoint deadline,
+    static RCReference<TimerEntry> Create(Tick tick,
                                           TimerCallback timer_callback) {
-      return TakeRef(new TimerEntry{deadline, std::move(timer_callback)});
+      return TakeRef(new TimerEntry{tick, std::move(timer_callback)});
     }
 
-    struct TimerEntryCompare {
-      bool operator()(const RCReference<TimerEntry>& a,
-                      const RCReference<TimerEntry>& b) const {
-        return a->deadline_ > b->deadline_;
-      }
-    };
-
    private:
     friend class TimerQueue;
-    TimerEntry(TimePoint deadline, TimerCallback timer_callback)
-        : deadline_(deadline), timer_callback_(std::move(timer_callback)) {}
-    TimePoint deadline_;
+    TimerEntry(Tick tick, TimerCallback timer_callback)
+        : tick_(tick), timer_callback_(std::move(timer_callback)) {}
+    Tick tick_;
     TimerCallback timer_callback_;
     std::atomic<bool> cancelled_{false};
+    // Link in the list of timers not yet added to the wheel.
+    TimerEntry* next_pending_ = nullptr;
+  };
+
+  struct WheelLevel {
+    // Bit N is set if slots[N] is not empty.
+    uint64_t occupied = 0;
+    std::array<std::vector<RCReference<TimerEntry>>, kSlotsPerLevel> slots;
   };
+
   // Timer thread. If a timeout goes off, it calls the callback.
   void TimerThreadRun();
 
-  // Obtain the top timer (timer with the closest deadline) from the queue.
-  // Returns NULL if no active (not cancelled) timer found.
-  TimerEntry* getTopTimer();
+  Tick ToTick(TimePoint time_point) const;
+  TimePoint ToTimePoint(Tick tick) const;
+  Tick CurrentTick() const;
+
+  // The functions below are only called on the timer thread.
+
+  // Move the timers scheduled since the last call into the wheel.
+  void AddPendingTimers(std::vector<RCReference<TimerEntry>>* expired);
+
+  // Add `timer` to the wheel, or to `expired` if its tick has passed.
+  void AddTimer(RCReference<TimerEntry> timer,
+                std::vector<RCReference<TimerEntry>>* expired);
+
+  // Advance the wheel to `tick`, and append the expired timers to `expired`
+  // in order of expiration.
+  void AdvanceTo(Tick tick, std::vector<RCReference<TimerEntry>>* expired);
+
+  // Redistribute the timers in level `level` slot `slot` to lower levels.
+  void CascadeSlot(int level, int slot,
+                   std::vector<RCReference<TimerEntry>>* expired);
+
+  // Returns the next tick at which the wheel needs to be advanced, or
+  // kNoTick if the wheel is empty.
+  Tick NextEventTick() const;
+
+  static constexpr Tick kNoTick = std::numeric_limits<Tick>::max();
+  // The value of next_wakeup_tick_ while the timer thread is running.
+  static constexpr Tick kAwake = std::numeric_limits<Tick>::min();
+
+  const TimePoint start_time_;
 
   mutable mutex mu_;
   condition_variable cv_;
   std::thread timer_thread_;
   std::atomic<bool> stop_{false};
-  std::priority_queue<RCReference<TimerEntry>,
-                      std::vector<RCReference<TimerEntry>>,
-                      TimerEntry::TimerEntryCompare>
-      timers_ TFRT_GUARDED_BY(mu_);
+
+  // Timers scheduled but not yet added to the wheel, as an intrusive stack
+  // owning one reference to each timer.
+  std::atomic<TimerEntry*> pending_timers_{nullptr};
+  // The tick at which the timer thread wakes up, or kAwake if it is running.
+  // Schedulers only need to notify the timer thread for earlier deadlines.
+  std::atomic<Tick> next_wakeup_tick_{kAwake};
+
+  // The timing wheel, only accessed by the timer thread. All timers up to
+  // current_tick_ have expired.
+  Tick current_tick_ = 0;
+  std::array<WheelLevel, kNumLevels> levels_;
+  std::vector<RCReference<TimerEntry>> overflow_;
 };
 
 }  // namespace tfrt
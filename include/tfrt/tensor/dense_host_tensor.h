@@ -29,6 +29,7 @@
 #include "tfrt/tensor/host_tensor.h"
 
 namespace tfrt {
+class ExecutionContext;
 class HostContext;
 
 void RegisterDenseHostTensorConversionFn(TensorConversionFnRegistry* registry);
@@ -53,12 +54,23 @@ class DenseHostTensor final : public HostTensor,
   static llvm::Optional<DenseHostTensor> CreateUninitialized(
       const TensorMetadata& metadata, HostAllocator* allocator);
 
+  // Allocates the tensor body from the request allocator, which is the request
+  // arena allocator if it is enabled (see RequestContext::allocator()).
+  static llvm::Optional<DenseHostTensor> CreateUninitialized(
+      const TensorMetadata& metadata, const ExecutionContext& exec_ctx);
+
   template <typename T>
   static llvm::Optional<DenseHostTensor> CreateUninitialized(
       const TensorShape& shape, HostContext* host) {
     return CreateUninitialized(TensorMetadata(GetDType<T>(), shape), host);
   }
 
+  template <typename T>
+  static llvm::Optional<DenseHostTensor> CreateUninitialized(
+      const TensorShape& shape, const ExecutionContext& exec_ctx) {
+    return CreateUninitialized(TensorMetadata(GetDType<T>(), shape), exec_ctx);
+  }
+
   // Make an AsyncValueRef<DenseHostTensor> with kConstructed state. This
   // returns an empty (default constructed) AsyncValueRef<T> on allocation
   // failure.
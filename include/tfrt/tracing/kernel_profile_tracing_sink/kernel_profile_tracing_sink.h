@@ -0,0 +1,85 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- kernel_profile_tracing_sink.h - Kernel Profile Sink ------*- C++ -*-===//
+//
+// This file declares a tracing sink that aggregates the wall time of tracing
+// scopes by name, and writes them as a kernel cost profile when tracing is
+// disabled. With the `debug` tracing level, the BEF executor opens a scope
+// named after the kernel around each kernel invocation, so the profile
+// contains the per-kernel cost that the tfrt-apply-cost-profile pass feeds
+// back into stream analysis.
+//
+// The profile is a text file with one line per scope name:
+//
+//   <number of calls> <total wall time in nanoseconds> <name>
+//
+// Lines starting with '#' are comments.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_TRACING_KERNEL_PROFILE_TRACING_SINK_H_
+#define TFRT_TRACING_KERNEL_PROFILE_TRACING_SINK_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
+#include "tfrt/tracing/tracing.h"
+
+namespace tfrt {
+namespace tracing {
+
+class KernelProfileTracingSink : public TracingSink {
+ public:
+  // The profile is written to `output_path` when tracing is disabled, or to
+  // stderr if `output_path` is empty.
+  explicit KernelProfileTracingSink(std::string output_path);
+  ~KernelProfileTracingSink() override;
+
+  Error RequestTracing(bool enable) override;
+  void RecordTracingEvent(NameGenerator gen_name) override;
+  void PushTracingScope(NameGenerator gen_name) override;
+  void PopTracingScope() override;
+
+  // Writes the profile collected so far to `os`.
+  void WriteProfile(llvm::raw_ostream& os) const;
+
+ private:
+  class ThreadProfile;
+
+  // Returns the profile of the calling thread for this sink.
+  ThreadProfile& GetThreadProfile();
+
+  // Unique among all the sinks created by the process.
+  const int64_t id_;
+  const std::string output_path_;
+
+  mutable mutex mu_;
+  // Profiles of all the threads that recorded a scope. They are kept alive
+  // after the threads exit.
+  std::vector<std::shared_ptr<ThreadProfile>> thread_profiles_
+      TFRT_GUARDED_BY(mu_);
+};
+
+}  // namespace tracing
+}  // namespace tfrt
+
+#endif  // TFRT_TRACING_KERNEL_PROFILE_TRACING_SINK_H_
@@ -18,12 +18,15 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <vector>
 
 #include "bef_file_impl.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "tfrt/host_context/async_dispatch.h"
 #include "tfrt/host_context/async_value.h"
@@ -34,6 +37,7 @@
 #include "tfrt/support/bef_reader.h"
 #include "tfrt/support/forward_decls.h"
 #include "tfrt/support/ref_count.h"
+#include "tfrt/support/string_util.h"
 #include "tfrt/tracing/tracing.h"
 
 #ifdef DEBUG_BEF_EXECUTOR
@@ -161,35 +165,16 @@ class ReadyKernelQueue {
                    MutableArrayRef<BEFFileImpl::KernelInfo> kernel_array)
       : stream_id_(stream_id), kernel_array_(kernel_array) {}
 
-  // Constructs a queue using `kernel_ids`. The stream id is randomly picked
-  // from the `kernel_ids`.
+  // Constructs a queue using `kernel_ids`, which must all have the same stream
+  // id. They are all executed inline.
   ReadyKernelQueue(MutableArrayRef<BEFFileImpl::KernelInfo> kernel_array,
                    std::vector<unsigned> kernel_ids)
-      : kernel_array_(kernel_array) {
-    assert(!kernel_ids.empty());
-
-    // Using the stream id of the first kernel.
-    stream_id_ = kernel_array[kernel_ids[0]].stream_id;
-
-    // Move kernels with the same stream id to `inline_kernel_ids_` and others
-    // to `outline_kernel_ids_`. This recursively partitions the kernel_ids by
-    // stream_id, by filtering out kernels that match stream_id on each
-    // iteration, dumping the remaining kernels into outline_kernels, then later
-    // creating another queue for outline_kernels, filtering out kernels that
-    // match the next stream_id, etc.
-    //
-    // TODO(chky): Consider partitioning kernel_ids for each stream_id instead
-    // of partitioning into only inline and outline groups.
-    inline_kernel_ids_ = std::move(kernel_ids);
-    auto outline_iter = std::partition(
-        inline_kernel_ids_.begin(), inline_kernel_ids_.end(),
-        [&](unsigned kernel_id) {
-          assert(kernel_id < kernel_array_.size());
-          return kernel_array_[kernel_id].stream_id == stream_id_;
-        });
-    outline_kernel_ids_.assign(outline_iter, inline_kernel_ids_.end());
-    inline_kernel_ids_.resize(
-        std::distance(inline_kernel_ids_.begin(), outline_iter));
+      : kernel_array_(kernel_array), inline_kernel_ids_(std::move(kernel_ids)) {
+    assert(!inline_kernel_ids_.empty());
+    stream_id_ = kernel_array[inline_kernel_ids_[0]].stream_id;
+    assert(llvm::all_of(inline_kernel_ids_, [&](unsigned kernel_id) {
+      return kernel_array_[kernel_id].stream_id == stream_id_;
+    }));
   }
 
   // Decrement the ready counts for `kernel_ids` and put them in the queue.
@@ -298,6 +283,9 @@ class BEFExecutor final : public ReferenceCounted<BEFExecutor> {
   // executed in a dfferent thread in parallel.
   void EnqueueReadyKernels(std::vector<unsigned> kernel_ids);
 
+  // Enqueue `kernel_ids`, which all have the same stream id, as one task.
+  void EnqueueStreamKernels(std::vector<unsigned> kernel_ids);
+
   HostContext* GetHost() const { return exec_ctx_.host(); }
   BEFFileImpl* BefFile() const { return bef_file_.get(); }
 
@@ -625,9 +613,35 @@ void BEFExecutor::ProcessReadyKernel(unsigned kernel_id,
 }
 
 // Enqueue `kernel_ids` to the concurrent work queue so that they can be
-// executed in a dfferent thread in parallel.
+// executed in a dfferent thread in parallel. Kernels are partitioned by
+// stream id up front and each stream is launched as a separate task, so that
+// independent streams start running in parallel right away.
 LLVM_ATTRIBUTE_NOINLINE void BEFExecutor::EnqueueReadyKernels(
     std::vector<unsigned> kernel_ids) {
+  assert(!kernel_ids.empty());
+  MutableArrayRef<BEFFileImpl::KernelInfo> kernel_array = kernel_infos();
+  auto by_stream_id = [&](unsigned lhs, unsigned rhs) {
+    return kernel_array[lhs].stream_id < kernel_array[rhs].stream_id;
+  };
+
+  // Fast path for the common case of a single outline stream.
+  if (llvm::is_sorted(kernel_ids, by_stream_id) &&
+      kernel_array[kernel_ids.front()].stream_id ==
+          kernel_array[kernel_ids.back()].stream_id) {
+    EnqueueStreamKernels(std::move(kernel_ids));
+    return;
+  }
+
+  // Keep the order of the kernels within each stream.
+  std::stable_sort(kernel_ids.begin(), kernel_ids.end(), by_stream_id);
+  for (auto begin = kernel_ids.begin(); begin != kernel_ids.end();) {
+    auto end = std::upper_bound(begin, kernel_ids.end(), *begin, by_stream_id);
+    EnqueueStreamKernels(std::vector<unsigned>(begin, end));
+    begin = end;
+  }
+}
+
+void BEFExecutor::EnqueueStreamKernels(std::vector<unsigned> kernel_ids) {
   AddRef();
   EnqueueWork(exec_ctx_, [this, kernel_ids = std::move(kernel_ids)]() mutable {
     ReadyKernelQueue ready_kernel_queue(kernel_infos(), std::move(kernel_ids));
@@ -707,6 +721,33 @@ void BEFExecutor::Execute() {
   ProcessReadyKernels(ready_kernel_queue);
 }
 
+// Initialize the mutable executor state in `function_info` from the function
+// layout decoded when the BEF file was opened.
+static void InitializeFunctionInfo(const BEFFunction::Layout& layout,
+                                   HostAllocator* host_allocator,
+                                   BEFFileImpl::FunctionInfo* function_info) {
+  function_info->kernels = layout.kernels;
+
+  const size_t num_registers = layout.register_user_counts.size();
+  function_info->register_infos.resize(num_registers, host_allocator);
+  auto* register_info_ptr =
+      function_info->register_infos.mutable_array().data();
+  for (size_t i = 0; i < num_registers; ++i) {
+    new (register_info_ptr + i)
+        BEFFileImpl::RegisterInfo(layout.register_user_counts[i]);
+  }
+
+  const size_t num_kernels = layout.kernel_layouts.size();
+  function_info->kernel_infos.resize(num_kernels, host_allocator);
+  auto* kernel_info_ptr = function_info->kernel_infos.mutable_array().data();
+  for (size_t i = 0; i < num_kernels; ++i) {
+    const auto& kernel_layout = layout.kernel_layouts[i];
+    new (kernel_info_ptr + i)
+        BEFFileImpl::KernelInfo(kernel_layout.offset, kernel_layout.stream_id,
+                                kernel_layout.num_operands);
+  }
+}
+
 // Set RegisterInfo::value for argument registers.
 static void InitializeArgumentRegisters(
     ArrayRef<AsyncValue*> arguments,
@@ -735,15 +776,23 @@ void BEFExecutor::Execute(ExecutionContext exec_ctx, const BEFFunction& fn,
          "incorrect number of results passed to function call");
 
   HostContext* host = exec_ctx.host();
+
+  // Layout is decoded on the first execution if the BEF file is opened lazily,
+  // which can fail if the function is malformed or uses unknown kernels.
+  const BEFFunction::Layout* layout = fn.GetLayout();
+  if (!layout) {
+    // The error has already been reported to the BEF file error handler.
+    auto error = MakeErrorAsyncValueRef(
+        host, StrCat("failed to decode BEF function '", fn.name(), "'"));
+    for (auto& result : results) result = error.CopyRef();
+    return;
+  }
+
   auto* exec_ptr = host->Allocate<BEFExecutor>();
   auto* exec = new (exec_ptr) BEFExecutor(std::move(exec_ctx), bef_file);
 
-  size_t location_offset;
-  SmallVector<size_t, 4> result_regs;
-  bool success = bef_file->ReadFunction(fn.function_offset(), fn.result_types(),
-                                        &location_offset, &exec->function_info_,
-                                        &result_regs, host->allocator());
-  if (!success) return;
+  InitializeFunctionInfo(*layout, host->allocator(), &exec->function_info_);
+  ArrayRef<uint32_t> result_regs = layout->result_regs;
   assert(result_regs.size() == fn.result_types().size());
 
   MutableArrayRef<BEFFileImpl::RegisterInfo> register_array =
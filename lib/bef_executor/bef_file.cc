@@ -61,15 +61,14 @@ class BEFFileReader : public BEFReader {
       : BEFReader(file), registry_(registry), bef_file_(bef_file) {}
 
   bool ReadNextSection();
-  bool ReadKernelsSection(HostAllocator* host_allocator);
+  bool ReadKernelsSection();
   bool ReadTypesSection();
   bool ReadFunctionIndexSection();
 
  private:
   bool ReadFunctionIndexSectionInternal(
       SmallVectorImpl<FunctionIndex>* function_indices);
-  bool DiagnoseUnknownKernel(size_t kernel_idx, const char* kernel_name,
-                             HostAllocator* host_allocator);
+  bool DiagnoseUnknownKernel(size_t kernel_idx, const char* kernel_name);
 
   // These are things set up at construction time.
   const KernelRegistry& registry_;
@@ -166,8 +165,7 @@ bool BEFFileReader::ReadNextSection() {
 //
 // If we can't find a nice location, we can fallback to a poor location.
 bool BEFFileReader::DiagnoseUnknownKernel(size_t kernel_idx,
-                                          const char* kernel_name,
-                                          HostAllocator* host_allocator) {
+                                          const char* kernel_name) {
   std::string error_message =
       "unknown kernel name '" + std::string(kernel_name) + "'";
 
@@ -182,27 +180,19 @@ bool BEFFileReader::DiagnoseUnknownKernel(size_t kernel_idx,
   // The unknown kernel must be referenced by some function in the program,
   // and each kernel record has location info.  Scan through to see if we can
   // figure out where the reference is coming from.
-  SmallVector<size_t, 4> result_regs;
-
   for (const auto& function_index : function_indices) {
     if (function_index.kind == FunctionKind::kNativeFunction) continue;
 
-    BEFFileImpl::FunctionInfo function_info;
-
-    result_regs.clear();
-    size_t location_offset;
-    bool success = bef_file_->ReadFunction(
-        function_index.function_offset, function_index.results,
-        &location_offset, &function_info, &result_regs, host_allocator);
+    BEFFunction::Layout layout;
+    bool success = bef_file_->ReadFunction(function_index.function_offset,
+                                           function_index.results, &layout);
     if (!success) continue;
 
     // Decode all of the kernels to see if any refers to our unknown kernel.
-    MutableArrayRef<BEFFileImpl::KernelInfo> kernel_infos_array =
-        function_info.kernel_infos.mutable_array();
-    for (const auto& kernel_info : kernel_infos_array) {
-      assert(kernel_info.offset % kKernelEntryAlignment == 0);
-      BEFKernel kernel(function_info.kernels.data() +
-                       kernel_info.offset / kKernelEntryAlignment);
+    for (const auto& kernel_layout : layout.kernel_layouts) {
+      assert(kernel_layout.offset % kKernelEntryAlignment == 0);
+      BEFKernel kernel(layout.kernels.data() +
+                       kernel_layout.offset / kKernelEntryAlignment);
 
       // Okay, we decoded the kernel.  See if this is referring to the
       // current kernel_idx.  If so, we can use its location.  We know that the
@@ -223,7 +213,7 @@ bool BEFFileReader::DiagnoseUnknownKernel(size_t kernel_idx,
 
 // Read the Kernels section from a BEF file, resolving the kernels and
 // returning true on success.  Emit an error and return false on failure.
-bool BEFFileReader::ReadKernelsSection(HostAllocator* host_allocator) {
+bool BEFFileReader::ReadKernelsSection() {
   auto format_error = [&]() -> bool {
     bef_file_->EmitFormatError("invalid Kernels section in BEF file");
     return false;
@@ -234,6 +224,8 @@ bool BEFFileReader::ReadKernelsSection(HostAllocator* host_allocator) {
   size_t num_kernels;
   if (!reader.ReadVbrInt(&num_kernels)) return format_error();
 
+  if (bef_file_->lazy_) bef_file_->lazy_kernel_names_.reserve(num_kernels);
+
 #if !defined(TFRT_DISABLE_TRACING) || defined(DEBUG_BEF_EXECUTOR)
   bef_file_->kernel_names_.reserve(num_kernels);
 #endif
@@ -257,10 +249,16 @@ bool BEFFileReader::ReadKernelsSection(HostAllocator* host_allocator) {
     bef_file_->kernel_names_.push_back(kernel_name);
 #endif
 
+    // Lazily opened BEF files resolve the kernel on first use.
+    if (bef_file_->lazy_) {
+      bef_file_->lazy_kernel_names_.push_back(kernel_name);
+      bef_file_->kernels_.emplace_back();
+      continue;
+    }
+
     auto kernel = registry_.GetKernel(kernel_name);
     if (kernel.is<Monostate>()) {
-      return DiagnoseUnknownKernel(bef_file_->kernels_.size(), kernel_name,
-                                   host_allocator);
+      return DiagnoseUnknownKernel(bef_file_->kernels_.size(), kernel_name);
     }
 
     // Otherwise remember it.
@@ -391,9 +389,21 @@ bool BEFFileReader::ReadFunctionIndexSection() {
         if (function_index.function_offset >=
             bef_file_->function_section_.size())
           return format_error("Invalid offset found for BEFFunction");
+        if (bef_file_->lazy_) {
+          bef_file_->functions_.push_back(std::make_unique<BEFFunction>(
+              name, function_index.arguments, function_index.results,
+              function_index.function_offset, bef_file_));
+          break;
+        }
+        // Decode the function layout once, so that it can be reused by all
+        // executions of this function.
+        BEFFunction::Layout layout;
+        if (!bef_file_->ReadFunction(function_index.function_offset,
+                                     function_index.results, &layout))
+          return false;
         auto bef_function = std::make_unique<BEFFunction>(
             name, function_index.arguments, function_index.results,
-            function_index.function_offset, bef_file_);
+            function_index.function_offset, bef_file_, std::move(layout));
         bef_file_->functions_.push_back(std::move(bef_function));
         break;
       }
@@ -405,6 +415,16 @@ bool BEFFileReader::ReadFunctionIndexSection() {
             name, function_index.arguments, function_index.results,
             function_index.function_offset, bef_file_);
         if (!bef_function) return format_error(bef_function.takeError());
+        if (bef_file_->lazy_) {
+          // The interpreter does not support lazy decoding, resolve all the
+          // kernels of the function now.
+          mutex_lock lock(bef_file_->lazy_mutex_);
+          for (uint32_t offset : bef_function.get()->kernel_offsets()) {
+            BEFKernel kernel(bef_function.get()->kernels().data() +
+                             offset / kKernelEntryAlignment);
+            if (!bef_file_->ResolveKernel(kernel)) return false;
+          }
+        }
         bef_file_->functions_.push_back(std::move(bef_function.get()));
         break;
       }
@@ -433,9 +453,12 @@ BEFFile::~BEFFile() {}
 RCReference<BEFFile> BEFFile::Open(ArrayRef<uint8_t> file,
                                    const KernelRegistry& registry,
                                    ErrorHandler error_handler,
-                                   tfrt::HostAllocator* host_allocator) {
+                                   tfrt::HostAllocator* host_allocator,
+                                   bool lazy) {
   auto* bef_impl = new BEFFileImpl(error_handler);
   auto bef_rc = TakeRef(bef_impl);
+  bef_impl->lazy_ = lazy;
+  bef_impl->registry_ = &registry;
 
   if (reinterpret_cast<uintptr_t>(file.data()) % BefGetRequiredAlignment() !=
       0) {
@@ -468,7 +491,7 @@ RCReference<BEFFile> BEFFile::Open(ArrayRef<uint8_t> file,
 
   // Now that we've figured out the contents of the sections, resolve some
   // things.
-  if (!reader.ReadKernelsSection(host_allocator) ||
+  if (!reader.ReadKernelsSection() ||
       !reader.ReadTypesSection() || !reader.ReadFunctionIndexSection())
     return {};
 
@@ -494,10 +517,7 @@ void BEFFileImpl::EmitFormatError(string_view message) {
 // reporting error via EmitFormatError to make the API more natural.
 bool BEFFileImpl::ReadFunction(size_t function_offset,
                                ArrayRef<TypeName> results,
-                               size_t* location_offset,
-                               FunctionInfo* function_info,
-                               SmallVectorImpl<size_t>* result_regs,
-                               HostAllocator* host_allocator) {
+                               BEFFunction::Layout* layout) {
   auto format_error = [&]() -> bool {
     EmitFormatError("invalid Function section in BEF file");
     return false;
@@ -509,57 +529,103 @@ bool BEFFileImpl::ReadFunction(size_t function_offset,
 
   // First we have the location info and register info table.
   size_t num_registers;
-  if (!reader.ReadVbrInt(location_offset) || !reader.ReadVbrInt(&num_registers))
+  if (!reader.ReadVbrInt(&layout->location_offset) ||
+      !reader.ReadVbrInt(&num_registers))
     return format_error();
 
-  function_info->register_infos.resize(num_registers, host_allocator);
-  auto* register_info_ptr =
-      function_info->register_infos.mutable_array().data();
-  unsigned register_idx = 0;
-  while (num_registers--) {
+  layout->register_user_counts.reserve(num_registers);
+  for (size_t reg_idx = 0; reg_idx < num_registers; ++reg_idx) {
     size_t user_count;
     if (!reader.ReadVbrInt(&user_count)) return format_error();
-    new (register_info_ptr + register_idx) RegisterInfo(user_count);
-    ++register_idx;
+    layout->register_user_counts.push_back(user_count);
   }
 
   // Next we have the kernel index table.
   size_t num_kernels;
   if (!reader.ReadVbrInt(&num_kernels)) return format_error();
 
-  function_info->kernel_infos.resize(num_kernels, host_allocator);
-  auto* kernel_info_ptr = function_info->kernel_infos.mutable_array().data();
-  unsigned kernel_idx = 0;
-  while (num_kernels--) {
+  layout->kernel_layouts.reserve(num_kernels);
+  for (size_t kernel_idx = 0; kernel_idx < num_kernels; ++kernel_idx) {
     size_t offset, num_operands, stream_id;
     if (!reader.ReadVbrInt(&offset) || !reader.ReadVbrInt(&num_operands) ||
         !reader.ReadVbrInt(&stream_id))
       return format_error();
-    new (kernel_info_ptr + kernel_idx)
-        KernelInfo(offset, stream_id, num_operands);
-    ++kernel_idx;
+    layout->kernel_layouts.push_back(
+        {static_cast<uint32_t>(offset), static_cast<uint32_t>(stream_id),
+         static_cast<uint32_t>(num_operands)});
   }
 
   // Read the result registers.
-  result_regs->reserve(results.size());
+  layout->result_regs.reserve(results.size());
   for (unsigned i = 0, e = results.size(); i != e; ++i) {
     size_t result_reg;
     if (!reader.ReadVbrInt(&result_reg) || result_reg >= num_registers)
       return format_error();
-    result_regs->push_back(result_reg);
+    layout->result_regs.push_back(result_reg);
   }
 
   // Kernels are aligned to kKernelEntryAlignment.
   if (!reader.ReadAlignment(kKernelEntryAlignment)) return format_error();
 
   // We found the start of our kernel section.
-  function_info->kernels = llvm::makeArrayRef(
+  layout->kernels = llvm::makeArrayRef(
       reinterpret_cast<const uint32_t*>(reader.file().begin()),
       reader.file().size() / kKernelEntryAlignment);
 
   return true;
 }
 
+bool BEFFileImpl::ResolveKernel(const BEFKernel& kernel) {
+  if (!lazy_) return true;
+
+  uint32_t kernel_code = kernel.kernel_code();
+  if (kernel_code >= kernels_.size()) {
+    EmitFormatError("invalid kernel code in BEF file");
+    return false;
+  }
+
+  KernelImplementation& kernel_impl = kernels_[kernel_code];
+  if (!kernel_impl.is<Monostate>()) return true;
+
+  const char* kernel_name = lazy_kernel_names_[kernel_code];
+  kernel_impl = registry_->GetKernel(kernel_name);
+  if (kernel_impl.is<Monostate>()) {
+    error_handler_(DecodedDiagnostic(
+        DecodeLocation(kernel.kernel_location()),
+        StrCat("unknown kernel name '", kernel_name, "'")));
+    return false;
+  }
+  return true;
+}
+
+const BEFFunction::Layout* BEFFunction::DecodeLayout() const {
+  mutex_lock lock(bef_file_->lazy_mutex_);
+
+  // Another thread might have decoded the layout while we were waiting.
+  LayoutState state = layout_state_.load(std::memory_order_relaxed);
+  if (state != LayoutState::kPending)
+    return state == LayoutState::kReady ? &layout_ : nullptr;
+
+  auto decode = [&]() -> bool {
+    if (!bef_file_->ReadFunction(function_offset_, result_types(), &layout_))
+      return false;
+
+    // The first kernel is the pseudo kernel, which is never executed.
+    for (const auto& kernel_layout : llvm::drop_begin(layout_.kernel_layouts,
+                                                      1)) {
+      BEFKernel kernel(layout_.kernels.data() +
+                       kernel_layout.offset / kKernelEntryAlignment);
+      if (!bef_file_->ResolveKernel(kernel)) return false;
+    }
+    return true;
+  };
+
+  bool success = decode();
+  layout_state_.store(success ? LayoutState::kReady : LayoutState::kError,
+                      std::memory_order_release);
+  return success ? &layout_ : nullptr;
+}
+
 // Given an offset into location_positions_section_, decode it and return
 // a DecodedDiagnostic.
 DecodedLocation BEFFileImpl::DecodeLocation(size_t location_position_offset) {
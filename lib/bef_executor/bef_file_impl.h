@@ -23,6 +23,7 @@
 #ifndef TFRT_LIB_BEF_EXECUTOR_BEF_FILE_IMPL_H_
 #define TFRT_LIB_BEF_EXECUTOR_BEF_FILE_IMPL_H_
 
+#include <atomic>
 #include <type_traits>
 
 #include "llvm/ADT/ArrayRef.h"
@@ -37,6 +38,8 @@
 #include "tfrt/host_context/location.h"
 #include "tfrt/host_context/native_function.h"
 #include "tfrt/support/forward_decls.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
 
 namespace tfrt {
 
@@ -107,6 +110,41 @@ class BEFInfoArray {
 // This class implements Function for BEF files.
 class BEFFunction : public Function {
  public:
+  // Immutable description of the function registers and kernels decoded from
+  // the BEF file. It is decoded once when the BEF file is opened (or on the
+  // first execution if the BEF file is opened lazily), and for every execution
+  // the BEFExecutor only initializes its mutable register and kernel arrays
+  // from it, instead of decoding the function section again.
+  struct Layout {
+    struct KernelLayout {
+      uint32_t offset;
+      uint32_t stream_id;
+      uint32_t num_operands;
+    };
+
+    // Offset of the function location in the LocationPositions section.
+    size_t location_offset = 0;
+    // The number of uses of each register, indexed by the register number.
+    SmallVector<uint32_t, 24> register_user_counts;
+    // Offsets, stream ids and the number of operands of all kernels, indexed
+    // by the kernel number.
+    SmallVector<KernelLayout, 8> kernel_layouts;
+    // Register indices of the function results.
+    SmallVector<uint32_t, 4> result_regs;
+    // This ArrayRef contains kernel entries of all kernels of this function.
+    ArrayRef<uint32_t> kernels;
+  };
+
+  BEFFunction(string_view name, ArrayRef<TypeName> arguments,
+              ArrayRef<TypeName> results, size_t function_offset,
+              BEFFileImpl* bef_file, Layout layout)
+      : BEFFunction(name, FunctionKind::kBEFFunction, arguments, results,
+                    function_offset, bef_file) {
+    layout_ = std::move(layout);
+    layout_state_ = LayoutState::kReady;
+  }
+
+  // Creates a function whose layout is decoded on the first GetLayout() call.
   BEFFunction(string_view name, ArrayRef<TypeName> arguments,
               ArrayRef<TypeName> results, size_t function_offset,
               BEFFileImpl* bef_file)
@@ -116,11 +154,24 @@ class BEFFunction : public Function {
   BEFFunction(BEFFunction&& other)
       : Function(std::move(other)),
         function_offset_(other.function_offset_),
-        bef_file_(other.bef_file_) {}
+        bef_file_(other.bef_file_),
+        layout_(std::move(other.layout_)),
+        layout_state_(other.layout_state_.load()) {}
 
   size_t function_offset() const { return function_offset_; }
   BEFFileImpl* bef_file() const { return bef_file_; }
 
+  // Returns the function layout, decoding it and resolving its kernels on the
+  // first call if the BEF file was opened lazily. Returns nullptr if the
+  // function is malformed or uses unknown kernels, in which case an error has
+  // been emitted to the BEF file error handler.
+  const Layout* GetLayout() const {
+    if (LLVM_LIKELY(layout_state_.load(std::memory_order_acquire) ==
+                    LayoutState::kReady))
+      return &layout_;
+    return DecodeLayout();
+  }
+
   void Execute(const ExecutionContext& exec_ctx,
                ArrayRef<AsyncValue*> arguments,
                MutableArrayRef<RCReference<AsyncValue>> results) const override;
@@ -137,6 +188,17 @@ class BEFFunction : public Function {
 
   size_t function_offset_;
   BEFFileImpl* bef_file_;
+
+ private:
+  enum class LayoutState : uint8_t { kPending, kReady, kError };
+
+  const Layout* DecodeLayout() const;
+
+  // Function layout decoded from the BEF file. It is empty for
+  // SyncBEFFunction, which keeps its own decoded information. It is written
+  // only once, before `layout_state_` becomes kReady.
+  mutable Layout layout_;
+  mutable std::atomic<LayoutState> layout_state_{LayoutState::kPending};
 };
 
 // This class implements SyncFunction for BEF files.
@@ -286,22 +348,21 @@ class BEFFileImpl : public BEFFile, public DebugInfoDecoder {
     KernelInfoArray kernel_infos;
   };
 
-  // Decode the specified BEFFunction into the FunctionInfo. `host_allocator` is
-  // used for the heap-allocated buffer that backs info arrays in FunctionInfo.
+  // Decode the layout of the specified BEFFunction from the function section.
   //
   // On error, an error is emitted and false is returned.
   //
-  // ReadFunction is invoked for every BEFFunction execution. We can consider
-  // caching the kernel and register information in the BEFFunction object to
-  // avoid repeadly reading the same information from the BEF file. However, in
-  // the current implementation, we couple BEFExecutor states, e.g. AsyncValue
-  // for RegisterInfo, with the function reading. Caching kernel and register
-  // information would require us to avoid such coupling which can adversely
-  // affect the performance.
+  // ReadFunction is invoked once for every BEFFunction when the BEF file is
+  // opened. The executor state (e.g. AsyncValue for RegisterInfo) is not part
+  // of the layout, and BEFExecutor initializes it from the decoded layout for
+  // every function execution.
   bool ReadFunction(size_t function_offset, ArrayRef<TypeName> results,
-                    size_t* location_offset, FunctionInfo* function_info,
-                    SmallVectorImpl<size_t>* result_regs,
-                    HostAllocator* host_allocator);
+                    BEFFunction::Layout* layout);
+
+  // Resolves the implementation of the kernel used by `kernel`, if the BEF
+  // file was opened lazily and it is not resolved yet. Returns false and emits
+  // an error if the kernel is unknown.
+  bool ResolveKernel(const BEFKernel& kernel) TFRT_REQUIRES(lazy_mutex_);
 
   // Given an offset into the LocationPositions section, decode it and return
   // a DecodedDiagnostic.
@@ -346,6 +407,16 @@ class BEFFileImpl : public BEFFile, public DebugInfoDecoder {
   llvm::StringMap<size_t> function_symbol_table_;
   SmallVector<std::unique_ptr<Function>, 8> functions_;
 
+  // If the BEF file is opened lazily, `kernels_` are resolved from the
+  // `registry_` on the first execution of a function that uses them, and
+  // BEFFunction layouts are decoded on their first execution. Writes to
+  // `kernels_` entries and function layouts are serialized by `lazy_mutex_`,
+  // and published to the executing threads by BEFFunction::layout_state_.
+  bool lazy_ = false;
+  const KernelRegistry* registry_ = nullptr;
+  std::vector<const char*> lazy_kernel_names_;
+  mutex lazy_mutex_;
+
 #if !defined(TFRT_DISABLE_TRACING) || defined(DEBUG_BEF_EXECUTOR)
   // Maps from kernel_id to the name of the kernel.
   std::vector<const char*> kernel_names_;
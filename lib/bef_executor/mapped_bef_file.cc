@@ -0,0 +1,85 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- mapped_bef_file.cc ---------------------------------------*- C++ -*-===//
+//
+// This file implements MappedBEFFile.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/bef_executor/mapped_bef_file.h"
+
+#include <cstdint>
+
+#include "llvm/Support/FileSystem.h"
+#include "tfrt/support/bef_reader.h"
+#include "tfrt/support/error_util.h"
+
+namespace tfrt {
+
+Expected<std::unique_ptr<MappedBEFFile>> MappedBEFFile::Open(
+    string_view path) {
+  namespace fs = ::llvm::sys::fs;
+
+  auto fd = fs::openNativeFileForRead(path);
+  if (!fd) return fd.takeError();
+
+  // The mapping stays valid after the file is closed.
+  auto close_file = [&]() { fs::closeFile(*fd); };
+
+  fs::file_status status;
+  if (auto ec = fs::status(*fd, status)) {
+    close_file();
+    return MakeStringError("failed to stat BEF file ", path, ": ",
+                           ec.message());
+  }
+
+  if (status.type() != fs::file_type::regular_file || status.getSize() == 0) {
+    close_file();
+    return MakeStringError("BEF file ", path,
+                           " is not a non-empty regular file");
+  }
+
+  std::error_code ec;
+  auto region = std::make_unique<fs::mapped_file_region>(
+      *fd, fs::mapped_file_region::readonly, status.getSize(),
+      /*offset=*/0, ec);
+  close_file();
+  if (ec)
+    return MakeStringError("failed to map BEF file ", path, ": ",
+                           ec.message());
+
+  assert(reinterpret_cast<uintptr_t>(region->const_data()) %
+                 BefGetRequiredAlignment() ==
+             0 &&
+         "mapped BEF file is not aligned");
+
+  return std::unique_ptr<MappedBEFFile>(new MappedBEFFile(std::move(region)));
+}
+
+MappedBEFFile::MappedBEFFile(
+    std::unique_ptr<llvm::sys::fs::mapped_file_region> region)
+    : region_(std::move(region)) {}
+
+MappedBEFFile::~MappedBEFFile() {}
+
+ArrayRef<uint8_t> MappedBEFFile::data() const {
+  return ArrayRef<uint8_t>(
+      reinterpret_cast<const uint8_t*>(region_->const_data()),
+      region_->size());
+}
+
+}  // namespace tfrt
@@ -25,12 +25,14 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/ScopeExit.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm_derived/Support/raw_ostream.h"
 #include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/MLIRContext.h"
 #include "mlir/Support/FileUtilities.h"
 #include "tfrt/bef_executor/bef_file.h"
+#include "tfrt/bef_executor/mapped_bef_file.h"
 #include "tfrt/core_runtime/core_runtime.h"
 #include "tfrt/core_runtime/tensor_handle.h"
 #include "tfrt/host_context/async_value.h"
@@ -77,12 +79,30 @@ int RunBefExecutor(
   TFRT_TRACE_SCOPE(Default, "Bef Executor");
   metrics::AddTFRTVersionMetric();
 
-  // Set up the input file.
-  std::string error_message;
-  auto file = mlir::openInputFile(run_config.input_filename, &error_message);
+  // Set up the input file. Regular files are memory mapped and read in place,
+  // other inputs (e.g. stdin) are read into memory.
+  std::unique_ptr<MappedBEFFile> mapped_file;
+  std::unique_ptr<llvm::MemoryBuffer> file;
+  if (run_config.input_filename != "-") {
+    auto mapped = MappedBEFFile::Open(run_config.input_filename);
+    if (mapped) {
+      mapped_file = std::move(*mapped);
+      auto data = mapped_file->data();
+      file = llvm::MemoryBuffer::getMemBuffer(
+          string_view(reinterpret_cast<const char*>(data.data()), data.size()),
+          run_config.input_filename, /*RequiresNullTerminator=*/false);
+    } else {
+      llvm::consumeError(mapped.takeError());
+    }
+  }
+
   if (!file) {
-    llvm::errs() << error_message << "\n";
-    return 1;
+    std::string error_message;
+    file = mlir::openInputFile(run_config.input_filename, &error_message);
+    if (!file) {
+      llvm::errs() << error_message << "\n";
+      return 1;
+    }
   }
 
   // Tell source_mgr about this buffer, which is what the parser will pick up.
@@ -131,6 +151,10 @@ int RunBefExecutor(
       host_allocator = CreateMallocAllocator();
       host_allocator = CreateLeakCheckAllocator(std::move(host_allocator));
       tfrt::outs() << "Choosing memory leak check allocator.\n";
+      break;
+    case HostAllocatorType::kSlab:
+      host_allocator = CreateSlabAllocator(/*print_stats=*/true);
+      tfrt::outs() << "Choosing slab allocator.\n";
   }
   tfrt::outs().flush();
 
@@ -190,7 +214,8 @@ int RunBefExecutor(
   }
 
   auto bef(BEFFile::Open(buffer_arr, host->GetKernelRegistry(),
-                         decoded_diagnostic_handler, host->allocator()));
+                         decoded_diagnostic_handler, host->allocator(),
+                         run_config.lazy_bef_open));
 
   if (!bef) {
     return mlir::failed(source_mgr_handler.verify());
@@ -0,0 +1,137 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- cost_profile_pass.cc -----------------------------------------------===//
+//
+// This implements ApplyCostProfilePass, which sets the `_tfrt_cost` attribute
+// of operations from a kernel cost profile measured at runtime, so that
+// StreamAnalysis splits expensive kernels off into their own streams and keeps
+// cheap chains inline. The profile is written by KernelProfileTracingSink,
+// with one line per kernel:
+//
+//   <number of calls> <total wall time in nanoseconds> <kernel name>
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <tuple>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Pass/Pass.h"
+
+namespace tfrt {
+namespace compiler {
+namespace {
+
+class ApplyCostProfilePass
+    : public mlir::PassWrapper<ApplyCostProfilePass,
+                               mlir::OperationPass<mlir::ModuleOp>> {
+ public:
+  ApplyCostProfilePass() = default;
+  ApplyCostProfilePass(const ApplyCostProfilePass&) {}
+
+  void runOnOperation() override {
+    auto module = getOperation();
+
+    if (cost_unit_ns_ <= 0) {
+      module.emitError("cost-unit-ns must be positive");
+      return signalPassFailure();
+    }
+
+    auto buffer = llvm::MemoryBuffer::getFile(profile_path_.getValue());
+    if (!buffer) {
+      module.emitError("failed to read kernel cost profile '")
+          << profile_path_.getValue() << "': " << buffer.getError().message();
+      return signalPassFailure();
+    }
+
+    llvm::StringMap<int64_t> kernel_costs;
+    if (mlir::failed(ParseProfile((*buffer)->getBuffer(), &kernel_costs)))
+      return signalPassFailure();
+
+    mlir::Builder builder(module.getContext());
+    module.walk([&](mlir::Operation* op) {
+      auto iter = kernel_costs.find(op->getName().getStringRef());
+      if (iter == kernel_costs.end()) return;
+      op->setAttr("_tfrt_cost", builder.getI64IntegerAttr(iter->second));
+    });
+
+    if (cost_threshold_ > 0) {
+      module->setAttr("tfrt.cost_threshold",
+                      builder.getI64IntegerAttr(cost_threshold_.getValue()));
+    }
+  }
+
+ private:
+  // Parses the profile into the average cost of each kernel, in cost units.
+  mlir::LogicalResult ParseProfile(llvm::StringRef profile,
+                                   llvm::StringMap<int64_t>* kernel_costs) {
+    llvm::SmallVector<llvm::StringRef, 16> lines;
+    profile.split(lines, '\n', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+    for (llvm::StringRef line : lines) {
+      line = line.trim();
+      if (line.empty() || line.startswith("#")) continue;
+
+      llvm::StringRef num_calls_str, total_ns_str, kernel_name;
+      std::tie(num_calls_str, kernel_name) = line.split(' ');
+      std::tie(total_ns_str, kernel_name) = kernel_name.ltrim().split(' ');
+      kernel_name = kernel_name.trim();
+
+      int64_t num_calls, total_ns;
+      if (num_calls_str.getAsInteger(10, num_calls) ||
+          total_ns_str.getAsInteger(10, total_ns) || num_calls <= 0 ||
+          total_ns < 0 || kernel_name.empty()) {
+        getOperation().emitError("invalid kernel cost profile line: '")
+            << line << "'";
+        return mlir::failure();
+      }
+
+      // Costs must be positive. Round to the nearest cost unit.
+      int64_t average_ns = total_ns / num_calls;
+      int64_t cost_unit_ns = cost_unit_ns_.getValue();
+      (*kernel_costs)[kernel_name] = std::max<int64_t>(
+          1, (average_ns + cost_unit_ns / 2) / cost_unit_ns);
+    }
+    return mlir::success();
+  }
+
+  Option<std::string> profile_path_{
+      *this, "profile",
+      llvm::cl::desc("Path to the kernel cost profile written by the "
+                     "kernel profile tracing sink.")};
+  Option<int64_t> cost_unit_ns_{
+      *this, "cost-unit-ns",
+      llvm::cl::desc("Wall time in nanoseconds of one unit of cost."),
+      llvm::cl::init(1000)};
+  Option<int64_t> cost_threshold_{
+      *this, "cost-threshold",
+      llvm::cl::desc("If positive, overrides the tfrt.cost_threshold module "
+                     "attribute, in units of cost."),
+      llvm::cl::init(0)};
+};
+
+static mlir::PassRegistration<ApplyCostProfilePass> apply_cost_profile(
+    "tfrt-apply-cost-profile",
+    "Set operation costs for stream analysis from a measured kernel profile");
+
+}  // namespace
+}  // namespace compiler
+}  // namespace tfrt
@@ -56,6 +56,11 @@ int64_t StreamAnalysis::GetOperationCost(mlir::Operation* op) const {
     return cost;
   }
 
+  // Other operations can have a cost measured at runtime, which is set by the
+  // tfrt-apply-cost-profile pass.
+  if (auto cost = op->getAttrOfType<mlir::IntegerAttr>("_tfrt_cost"))
+    return std::max<int64_t>(1, cost.getInt());
+
   // If there is no cost specified for this operation, We conservatively return
   // the cost threshold as its cost. So we treat operations without cost as
   // expensive ops, but not too expensive to outweigh any other operations.
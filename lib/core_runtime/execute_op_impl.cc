@@ -144,11 +144,10 @@ void AsyncWaitForResultsFromTensorHandles(
   }
 }
 
-void ExecuteOpImpl(CoreRuntimeOp op, ArrayRef<AsyncValue *> args,
+void ExecuteOpImpl(const CoreRuntimeOp &op, ArrayRef<AsyncValue *> args,
                    AsyncValueRef<Chain> *op_chain,
                    MutableArrayRef<RCReference<AsyncValue>> results,
-                   AggregateAttr op_attr_array,
-                   AggregateAttr op_func_attr_array,
+                   const OpAttrsRef &op_attrs,
                    const ExecutionContext &exec_ctx) {
   SmallVector<TensorHandle, 8> th_args;
   th_args.reserve(args.size());
@@ -167,6 +166,17 @@ void ExecuteOpImpl(CoreRuntimeOp op, ArrayRef<AsyncValue *> args,
   SmallVector<TensorHandle, 8> result_ths;
   result_ths.resize(results.size());
 
+  op(exec_ctx, th_args, op_attrs, result_ths, op_chain);
+
+  AsyncWaitForResultsFromTensorHandles(results, result_ths);
+}
+
+void ExecuteOpImpl(CoreRuntimeOp op, ArrayRef<AsyncValue *> args,
+                   AsyncValueRef<Chain> *op_chain,
+                   MutableArrayRef<RCReference<AsyncValue>> results,
+                   AggregateAttr op_attr_array,
+                   AggregateAttr op_func_attr_array,
+                   const ExecutionContext &exec_ctx) {
   // Set up OpAttrs.
   OpAttrs op_attrs;
   SetUpOpAttrs(op_attr_array, &op_attrs);
@@ -174,15 +184,13 @@ void ExecuteOpImpl(CoreRuntimeOp op, ArrayRef<AsyncValue *> args,
   // Set up OpAttrs specifically for function attributes.
   SetUpOpFuncAttrs(op_func_attr_array, &op_attrs);
 
-  op(exec_ctx, th_args, OpAttrsRef(op_attrs), result_ths, op_chain);
-
-  AsyncWaitForResultsFromTensorHandles(results, result_ths);
+  ExecuteOpImpl(op, args, op_chain, results, OpAttrsRef(op_attrs), exec_ctx);
 }
 
 void ExecuteOpImplSync(const CoreRuntimeOp &op,
                        RepeatedSyncArguments<TensorHandle> args,
                        AsyncValueRef<Chain> *op_chain, SyncKernelFrame *frame,
-                       AggregateAttr op_attr_array,
+                       const OpAttrsRef &op_attrs,
                        const ExecutionContext &exec_ctx) {
   SmallVector<TensorHandle, 8> th_args;
   th_args.reserve(args.size());
@@ -194,11 +202,7 @@ void ExecuteOpImplSync(const CoreRuntimeOp &op,
   SmallVector<TensorHandle, 8> result_ths;
   result_ths.resize(frame->GetNumResults());
 
-  // Set up OpAttrs.
-  OpAttrs op_attrs;
-  SetUpOpAttrs(op_attr_array, &op_attrs);
-
-  op(exec_ctx, th_args, OpAttrsRef(op_attrs), result_ths, op_chain);
+  op(exec_ctx, th_args, op_attrs, result_ths, op_chain);
 
   // Return all of the TensorHandles in AsyncValue's.
   for (size_t i = 0, e = result_ths.size(); i != e; ++i) {
@@ -207,4 +211,52 @@ void ExecuteOpImplSync(const CoreRuntimeOp &op,
   }
 }
 
+void ExecuteOpImplSync(const CoreRuntimeOp &op,
+                       RepeatedSyncArguments<TensorHandle> args,
+                       AsyncValueRef<Chain> *op_chain, SyncKernelFrame *frame,
+                       AggregateAttr op_attr_array,
+                       const ExecutionContext &exec_ctx) {
+  // Set up OpAttrs.
+  OpAttrs op_attrs;
+  SetUpOpAttrs(op_attr_array, &op_attrs);
+
+  ExecuteOpImplSync(op, args, op_chain, frame, OpAttrsRef(op_attrs),
+                    exec_ctx);
+}
+
+Expected<std::unique_ptr<PreparedOp>> PrepareOp(
+    CoreRuntime *core_rt, string_view op_name, OpHandler *op_handler,
+    AggregateAttr op_attr_array, AggregateAttr op_func_attr_array) {
+  auto op = core_rt->MakeOp(op_name, op_handler);
+  if (!op) return op.takeError();
+
+  OpAttrs op_attrs;
+  SetUpOpAttrs(op_attr_array, &op_attrs);
+  if (op_func_attr_array) SetUpOpFuncAttrs(op_func_attr_array, &op_attrs);
+
+  return std::make_unique<PreparedOp>(std::move(*op), op_attrs.freeze());
+}
+
+Expected<const PreparedOp *> PreparedOpCache::GetOrPrepare(
+    CoreRuntime *core_rt, StringAttr op_name, OpHandler *op_handler,
+    AggregateAttr op_attr_array, AggregateAttr op_func_attr_array) {
+  Key key(op_name.data(), op_attr_array.data(), op_func_attr_array.data(),
+          op_handler);
+  {
+    mutex_lock lock(mu_);
+    auto it = cache_.find(key);
+    if (it != cache_.end()) return it->second.get();
+  }
+
+  // Prepare the op without holding the lock. If another thread prepares the
+  // same kernel concurrently, the first inserted entry is kept.
+  auto prepared = PrepareOp(core_rt, op_name.GetValue(), op_handler,
+                            op_attr_array, op_func_attr_array);
+  if (!prepared) return prepared.takeError();
+
+  mutex_lock lock(mu_);
+  auto it = cache_.try_emplace(key, std::move(*prepared)).first;
+  return it->second.get();
+}
+
 }  // namespace tfrt
@@ -36,6 +36,7 @@
 #include "tfrt/host_context/chain.h"
 #include "tfrt/host_context/function.h"
 #include "tfrt/host_context/kernel_utils.h"
+#include "tfrt/host_context/resource_context.h"
 #include "tfrt/host_context/sync_kernel_utils.h"
 #include "tfrt/support/error_util.h"
 #include "tfrt/support/ref_count.h"
@@ -217,14 +218,29 @@ static llvm::Expected<TensorHandle> CreateDenseTensor(
   return TensorHandle(host->GetHostDeviceRef(), metadata, std::move(dht));
 }
 
-static llvm::Expected<CoreRuntimeOp> GetCoreRuntimeOp(
-    string_view op_name, OpHandler *op_handler,
-    const ExecutionContext &exec_ctx) {
+// Returns the op and frozen attributes of an op execution kernel. They are
+// prepared on the first execution of the kernel and kept in the resource
+// context. Without a resource context, the op is prepared into `uncached`.
+static llvm::Expected<const PreparedOp *> GetPreparedOp(
+    StringAttr op_name, OpHandler *op_handler, AggregateAttr op_attr_array,
+    AggregateAttr op_func_attr_array, const ExecutionContext &exec_ctx,
+    std::unique_ptr<PreparedOp> *uncached) {
   auto *host = exec_ctx.host();
   auto *core_rt = CoreRuntime::GetFromHostContext(host);
   if (!core_rt) return MakeStringError("no CoreRuntime available");
 
-  return core_rt->MakeOp(op_name, op_handler);
+  if (auto *res_ctx = exec_ctx.resource_context()) {
+    auto *cache = res_ctx->GetOrCreateResource<PreparedOpCache>(
+        "corert.prepared_op_cache");
+    return cache->GetOrPrepare(core_rt, op_name, op_handler, op_attr_array,
+                               op_func_attr_array);
+  }
+
+  auto prepared = PrepareOp(core_rt, op_name.GetValue(), op_handler,
+                            op_attr_array, op_func_attr_array);
+  if (!prepared) return prepared.takeError();
+  *uncached = std::move(*prepared);
+  return uncached->get();
 }
 
 // ExecuteOp executes the `op_name` operation on the `op_handler`.
@@ -233,16 +249,17 @@ static void ExecuteOp(Argument<OpHandler *> op_handler, RemainingArguments args,
                       AggregateAttr op_func_attr_array, StringAttr op_name,
                       KernelErrorHandler handler,
                       const ExecutionContext &exec_ctx) {
-  auto expected_op =
-      GetCoreRuntimeOp(op_name.GetValue(), op_handler.get(), exec_ctx);
-  if (!expected_op) return handler.ReportError(StrCat(expected_op.takeError()));
+  std::unique_ptr<PreparedOp> uncached;
+  auto prepared_op = GetPreparedOp(op_name, op_handler.get(), op_attr_array,
+                                   op_func_attr_array, exec_ctx, &uncached);
+  if (!prepared_op) return handler.ReportError(StrCat(prepared_op.takeError()));
 
   for (int b = 0, e = results.size(); b < e; ++b)
     results.AllocateAt<TensorHandle>(b);
 
-  ExecuteOpImpl(std::move(expected_op.get()), args.values(),
-                /*op_chain=*/nullptr, results.values(), op_attr_array,
-                op_func_attr_array, exec_ctx);
+  ExecuteOpImpl((*prepared_op)->op, args.values(),
+                /*op_chain=*/nullptr, results.values(), (*prepared_op)->attrs,
+                exec_ctx);
 }
 
 // ExecuteOpSeq executes the `op_name` operation on the `op_handler`. It takes
@@ -256,16 +273,17 @@ static void ExecuteOpSeq(Argument<OpHandler *> op_handler,
                          AggregateAttr op_func_attr_array, StringAttr op_name,
                          KernelErrorHandler handler,
                          const ExecutionContext &exec_ctx) {
-  auto expected_op =
-      GetCoreRuntimeOp(op_name.GetValue(), op_handler.get(), exec_ctx);
-  if (!expected_op) return handler.ReportError(StrCat(expected_op.takeError()));
+  std::unique_ptr<PreparedOp> uncached;
+  auto prepared_op = GetPreparedOp(op_name, op_handler.get(), op_attr_array,
+                                   op_func_attr_array, exec_ctx, &uncached);
+  if (!prepared_op) return handler.ReportError(StrCat(prepared_op.takeError()));
 
   for (int b = 0, e = results.size(); b < e; ++b)
     results.AllocateAt<TensorHandle>(b);
 
   auto op_chain = in_op_chain.ValueRef();
-  ExecuteOpImpl(std::move(expected_op.get()), args.values(), &op_chain,
-                results.values(), op_attr_array, op_func_attr_array, exec_ctx);
+  ExecuteOpImpl((*prepared_op)->op, args.values(), &op_chain, results.values(),
+                (*prepared_op)->attrs, exec_ctx);
   out_op_chain.Set(std::move(op_chain));
 }
 
@@ -275,12 +293,15 @@ static Error ExecuteOpSync(SyncArgument<OpHandler *> op_handler,
                            SyncKernelFrame *frame, AggregateAttr op_attr_array,
                            StringAttr op_name,
                            const ExecutionContext &exec_ctx) {
-  auto expected_op =
-      GetCoreRuntimeOp(op_name.GetValue(), op_handler.get(), exec_ctx);
-
-  if (!expected_op) return MakeStringError(expected_op.takeError());
-  ExecuteOpImplSync(expected_op.get(), args,
-                    /*op_chain=*/nullptr, frame, op_attr_array, exec_ctx);
+  std::unique_ptr<PreparedOp> uncached;
+  auto prepared_op = GetPreparedOp(op_name, op_handler.get(), op_attr_array,
+                                   /*op_func_attr_array=*/AggregateAttr(),
+                                   exec_ctx, &uncached);
+
+  if (!prepared_op) return MakeStringError(prepared_op.takeError());
+  ExecuteOpImplSync((*prepared_op)->op, args,
+                    /*op_chain=*/nullptr, frame, (*prepared_op)->attrs,
+                    exec_ctx);
   return Error::success();
 }
 
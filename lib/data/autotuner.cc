@@ -0,0 +1,180 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- autotuner.cc ---------------------------------------------*- C++ -*-===//
+//
+// This file implements the Autotuner and TunableParameter.
+//
+//===----------------------------------------------------------------------===//
+
+#include "autotuner.h"
+
+#include <algorithm>
+
+#include "io.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/host_context/host_context.h"
+
+namespace tfrt {
+namespace data {
+
+//===----------------------------------------------------------------------===//
+// TunableParameter methods
+//===----------------------------------------------------------------------===//
+
+TunableParameter::TunableParameter(string_view name, Kind kind, int64_t min,
+                                   int64_t max, int64_t initial, bool autotune,
+                                   HostContext* host)
+    : autotuner_(host->GetOrCreateSharedContext<Autotuner>()),
+      name_(name.str()),
+      kind_(kind),
+      min_(min),
+      max_(max),
+      autotune_(autotune),
+      value_(std::min(std::max(initial, min), max)) {
+  assert(min_ <= max_);
+  autotuner_.Register(this);
+}
+
+TunableParameter::~TunableParameter() { autotuner_.Unregister(this); }
+
+void TunableParameter::RecordGetNext(bool ready, bool over_provisioned) {
+  num_get_next_.fetch_add(1, std::memory_order_relaxed);
+  if (!ready) num_waits_.fetch_add(1, std::memory_order_relaxed);
+  if (!autotune_) return;
+
+  ++window_calls_;
+  if (!ready) ++window_waits_;
+  if (over_provisioned) ++window_over_provisioned_;
+  if (window_calls_ < kWindowSize) return;
+
+  Tune();
+  window_calls_ = 0;
+  window_waits_ = 0;
+  window_over_provisioned_ = 0;
+}
+
+void TunableParameter::Tune() {
+  const int64_t value = this->value();
+  if (window_waits_ * 8 > window_calls_) {
+    quiet_windows_ = 0;
+    // Buffers double, so that they catch up with bursty consumers quickly.
+    // Parallelism grows one task at a time, since every task costs a thread.
+    int64_t delta = kind_ == Kind::kBufferSize ? value : 1;
+    delta = std::min(std::max<int64_t>(delta, 1), max_ - value);
+    if (delta > 0 && autotuner_.TryAcquire(kind_, delta)) {
+      value_.store(value + delta, std::memory_order_relaxed);
+      num_grows_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return;
+  }
+
+  if (window_waits_ > 0 || window_over_provisioned_ < window_calls_) {
+    quiet_windows_ = 0;
+    return;
+  }
+
+  if (++quiet_windows_ < kQuietWindows) return;
+  quiet_windows_ = 0;
+  // Shrink more slowly than grow, to avoid oscillating around the best value.
+  int64_t delta = kind_ == Kind::kBufferSize ? value / 4 : 1;
+  delta = std::min(std::max<int64_t>(delta, 1), value - min_);
+  if (delta > 0) {
+    value_.store(value - delta, std::memory_order_relaxed);
+    autotuner_.Release(kind_, delta);
+    num_shrinks_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void TunableParameter::Print(raw_ostream& os) const {
+  os << "  #" << id_ << " " << name_ << ": value " << value() << " in [" << min_
+     << ", " << max_ << "]" << (autotune_ ? " autotuned" : " fixed")
+     << ", get_next " << num_get_next_.load(std::memory_order_relaxed)
+     << ", waits " << num_waits_.load(std::memory_order_relaxed) << ", grows "
+     << num_grows_.load(std::memory_order_relaxed) << ", shrinks "
+     << num_shrinks_.load(std::memory_order_relaxed) << "\n";
+}
+
+//===----------------------------------------------------------------------===//
+// Autotuner methods
+//===----------------------------------------------------------------------===//
+
+Autotuner::Autotuner(HostContext* host)
+    : memory_budget_(
+          host->GetOrCreateSharedContext<io::PrefetchMemoryBudget>()),
+      cpu_budget_(host->GetNumWorkerThreads()) {}
+
+void Autotuner::SetCpuBudget(int64_t budget) {
+  mutex_lock lock(mu_);
+  cpu_budget_ = budget;
+}
+
+void Autotuner::SetBufferBudget(int64_t budget) {
+  mutex_lock lock(mu_);
+  buffer_budget_ = budget;
+}
+
+void Autotuner::Register(TunableParameter* parameter) {
+  mutex_lock lock(mu_);
+  parameter->id_ = next_id_++;
+  parameters_.push_back(parameter);
+  // The initial value of an autotuned parameter is charged even if it exceeds
+  // the budget, so that the budget only restricts growth.
+  if (parameter->autotune_) {
+    auto& usage = parameter->kind_ == TunableParameter::Kind::kBufferSize
+                      ? buffer_usage_
+                      : cpu_usage_;
+    usage += parameter->value();
+  }
+}
+
+void Autotuner::Unregister(TunableParameter* parameter) {
+  if (parameter->autotune_) Release(parameter->kind_, parameter->value());
+  mutex_lock lock(mu_);
+  parameters_.erase(
+      std::find(parameters_.begin(), parameters_.end(), parameter));
+}
+
+bool Autotuner::TryAcquire(TunableParameter::Kind kind, int64_t amount) {
+  if (kind == TunableParameter::Kind::kBufferSize &&
+      memory_budget_.IsExhausted())
+    return false;
+  mutex_lock lock(mu_);
+  const bool is_buffer = kind == TunableParameter::Kind::kBufferSize;
+  auto& usage = is_buffer ? buffer_usage_ : cpu_usage_;
+  if (usage + amount > (is_buffer ? buffer_budget_ : cpu_budget_)) return false;
+  usage += amount;
+  return true;
+}
+
+void Autotuner::Release(TunableParameter::Kind kind, int64_t amount) {
+  mutex_lock lock(mu_);
+  auto& usage =
+      kind == TunableParameter::Kind::kBufferSize ? buffer_usage_ : cpu_usage_;
+  usage -= amount;
+}
+
+void Autotuner::PrintStats(raw_ostream& os) const {
+  mutex_lock lock(mu_);
+  os << "Autotuner: cpu " << cpu_usage_ << "/" << cpu_budget_ << ", buffer "
+     << buffer_usage_ << "/" << buffer_budget_ << " elements, prefetch memory "
+     << memory_budget_.GetUsage() << "/" << memory_budget_.GetLimit()
+     << " bytes\n";
+  for (const auto* parameter : parameters_) parameter->Print(os);
+}
+
+}  // namespace data
+}  // namespace tfrt
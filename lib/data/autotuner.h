@@ -0,0 +1,171 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- autotuner.h ----------------------------------------------*- C++ -*-===//
+//
+// This file declares the Autotuner, which adjusts buffer sizes and parallelism
+// of data pipeline iterators at runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_LIB_DATA_AUTOTUNER_H_
+#define TFRT_LIB_DATA_AUTOTUNER_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "tfrt/host_context/shared_context.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+class HostContext;
+
+namespace data {
+namespace io {
+class PrefetchMemoryBudget;
+}  // namespace io
+
+class Autotuner;
+
+// Dataset kernels that take a buffer size or a parallelism accept kAutotune to
+// let the Autotuner choose the value at runtime.
+constexpr int64_t kAutotune = -1;
+
+// A buffer size or parallelism of an iterator, together with statistics about
+// the GetNext() calls of the iterator.
+//
+// The owning iterator reports every GetNext() call. Every kWindowSize calls,
+// an autotuned parameter grows if the consumer had to wait for more than one
+// in eight results, and shrinks after kQuietWindows windows in a row in which
+// the consumer never waited and the iterator was over-provisioned. Growth is
+// granted by the Autotuner only within its budgets.
+//
+// The methods that take a GetNext() call must not be called concurrently,
+// which holds since iterators serialize their GetNext() calls.
+class TunableParameter {
+ public:
+  enum class Kind {
+    // Number of elements buffered ahead of the consumer. Limited by the buffer
+    // budget of the Autotuner and by the io::PrefetchMemoryBudget.
+    kBufferSize,
+    // Number of concurrent tasks. Limited by the CPU budget of the Autotuner.
+    kParallelism,
+  };
+
+  static constexpr int kWindowSize = 32;
+  static constexpr int kQuietWindows = 8;
+
+  // If `autotune` is false, the parameter keeps the value set by its owner and
+  // only collects statistics for the stats dump.
+  TunableParameter(string_view name, Kind kind, int64_t min, int64_t max,
+                   int64_t initial, bool autotune, HostContext* host);
+  ~TunableParameter();
+
+  // This class is not copyable or movable.
+  TunableParameter(const TunableParameter&) = delete;
+  TunableParameter& operator=(const TunableParameter&) = delete;
+
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+  // Sets the value of a parameter that is not autotuned.
+  void set_value(int64_t value) {
+    assert(!autotune_);
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  // Records a GetNext() call of the owning iterator. `ready` tells whether the
+  // returned result was already available, i.e. whether the consumer did not
+  // have to wait for it. `over_provisioned` tells whether at least half of the
+  // buffered results or parallel calls were already complete, i.e. whether a
+  // smaller value would have served the consumer as well.
+  void RecordGetNext(bool ready, bool over_provisioned);
+
+ private:
+  friend class Autotuner;
+
+  // Adjusts the value at the end of a window.
+  void Tune();
+
+  void Print(raw_ostream& os) const;
+
+  Autotuner& autotuner_;
+  const std::string name_;
+  const Kind kind_;
+  const int64_t min_;
+  const int64_t max_;
+  const bool autotune_;
+  int id_ = 0;
+
+  std::atomic<int64_t> value_;
+  std::atomic<int64_t> num_get_next_{0};
+  std::atomic<int64_t> num_waits_{0};
+  std::atomic<int64_t> num_grows_{0};
+  std::atomic<int64_t> num_shrinks_{0};
+
+  // State of the current window.
+  int window_calls_ = 0;
+  int window_waits_ = 0;
+  int window_over_provisioned_ = 0;
+  int quiet_windows_ = 0;
+};
+
+// Autotuner keeps track of all TunableParameters of a HostContext and of the
+// CPU and buffer budgets they share. The CPU budget is the total parallelism
+// of autotuned kParallelism parameters and defaults to the number of worker
+// threads. The buffer budget is the total number of elements of autotuned
+// kBufferSize parameters.
+class Autotuner : public SharedContext {
+ public:
+  static constexpr int64_t kDefaultBufferBudget = 4096;
+
+  explicit Autotuner(HostContext* host);
+
+  void SetCpuBudget(int64_t budget) TFRT_EXCLUDES(mu_);
+  void SetBufferBudget(int64_t budget) TFRT_EXCLUDES(mu_);
+
+  // Prints the budgets and, for every live parameter, its value, range and
+  // GetNext() statistics, and how often the Autotuner changed it.
+  void PrintStats(raw_ostream& os) const TFRT_EXCLUDES(mu_);
+
+ private:
+  friend class TunableParameter;
+
+  void Register(TunableParameter* parameter) TFRT_EXCLUDES(mu_);
+  void Unregister(TunableParameter* parameter) TFRT_EXCLUDES(mu_);
+
+  // Tries to take `amount` units of the budget for parameters of `kind`.
+  bool TryAcquire(TunableParameter::Kind kind, int64_t amount)
+      TFRT_EXCLUDES(mu_);
+  void Release(TunableParameter::Kind kind, int64_t amount) TFRT_EXCLUDES(mu_);
+
+  io::PrefetchMemoryBudget& memory_budget_;
+
+  mutable mutex mu_;
+  std::vector<TunableParameter*> parameters_ TFRT_GUARDED_BY(mu_);
+  int next_id_ TFRT_GUARDED_BY(mu_) = 0;
+  int64_t cpu_budget_ TFRT_GUARDED_BY(mu_);
+  int64_t cpu_usage_ TFRT_GUARDED_BY(mu_) = 0;
+  int64_t buffer_budget_ TFRT_GUARDED_BY(mu_) = kDefaultBufferBudget;
+  int64_t buffer_usage_ TFRT_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_AUTOTUNER_H_
@@ -25,9 +25,15 @@
 #ifndef TFRT_DATA_BATCH_DATASET_H_
 #define TFRT_DATA_BATCH_DATASET_H_
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "tfrt/data/dataset.h"
 #include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/parallel_for.h"
 #include "tfrt/support/error_util.h"
 #include "tfrt/support/forward_decls.h"
 #include "tfrt/support/ref_count.h"
@@ -351,22 +357,237 @@ static SmallVector<AsyncValueRef<DenseHostTensor>, 4> AllocateOutputTensors(
   return results;
 }
 
+// Batches whose inputs are all available are copied with a ParallelFor, in
+// blocks of at least this many bytes per component. Smaller batches are copied
+// inline by the thread that calls GetNext().
+constexpr size_t kMinBatchCopyBlockBytes = 256 * 1024;
+
+// Copies the row-major `src` tensor with dimensions `src_dims` into the leading
+// corner of the row-major `dst` buffer with dimensions `dst_dims`, which are at
+// least as large in every dimension. Bytes of `dst` outside the corner are not
+// written.
+static void CopyPadded(const char* src, ArrayRef<ssize_t> src_dims, char* dst,
+                       ArrayRef<ssize_t> dst_dims, size_t element_size) {
+  assert(src_dims.size() == dst_dims.size());
+  if (src_dims.drop_front() == dst_dims.drop_front()) {
+    size_t num_elements = 1;
+    for (ssize_t dim : src_dims) num_elements *= dim;
+    std::memcpy(dst, src, num_elements * element_size);
+    return;
+  }
+  size_t src_stride = element_size, dst_stride = element_size;
+  for (size_t i = 1; i < src_dims.size(); ++i) {
+    src_stride *= src_dims[i];
+    dst_stride *= dst_dims[i];
+  }
+  for (ssize_t i = 0; i < src_dims[0]; ++i) {
+    CopyPadded(src + i * src_stride, src_dims.drop_front(),
+               dst + i * dst_stride, dst_dims.drop_front(), element_size);
+  }
+}
+
+// Copy bytes of `src` to `dst`, which is a row of a batched tensor with
+// dimensions `row_dims`. This is useful to batch multiple scalar values into a
+// DenseHostTensor.
+template <typename T>
+void CopyRowHelper(const T& src, char* dst, ArrayRef<ssize_t> row_dims) {
+  std::memcpy(dst, &src, sizeof(src));
+}
+
+// Copy bytes of `src` to `dst`, which is a row of a batched tensor with
+// dimensions `row_dims`. If `src` is smaller than the row, it is copied into
+// the leading corner of the row.
+template <>
+inline void CopyRowHelper<DenseHostTensor>(const DenseHostTensor& src,
+                                           char* dst,
+                                           ArrayRef<ssize_t> row_dims) {
+  SmallVector<ssize_t, 4> src_dims;
+  src.shape().GetDimensions(&src_dims);
+  CopyPadded(static_cast<const char*>(src.data()), src_dims, dst, row_dims,
+             src.dtype().GetHostSize());
+}
+
+// Computes the dimensions of a row of the batched tensor for `values`, which
+// are all available. If `pad` is true, values may have different shapes of the
+// same rank, and the row is as large as the largest value in every dimension.
+// Otherwise all values must have the same shape.
+template <typename T>
+llvm::Expected<TensorMetadata> GetBatchedRowMetadata(
+    ArrayRef<RCReference<AsyncValue>> values, bool pad,
+    SmallVectorImpl<ssize_t>* row_dims, bool* needs_padding) {
+  auto first = GetMetadataFromValue(values[0]->get<T>());
+  first.shape.GetDimensions(row_dims);
+  *needs_padding = false;
+  for (auto& value : values.drop_front()) {
+    auto metadata = GetMetadataFromValue(value->get<T>());
+    if (metadata == first) continue;
+    if (metadata.dtype != first.dtype || !pad ||
+        metadata.shape.GetRank() != first.shape.GetRank()) {
+      return MakeStringError("batch elements have different metadata: ", first,
+                             " and ", metadata);
+    }
+    *needs_padding = true;
+    for (int i = 0; i < metadata.shape.GetRank(); ++i) {
+      (*row_dims)[i] =
+          std::max((*row_dims)[i], metadata.shape.GetDimensionSize(i));
+    }
+  }
+  return TensorMetadata(first.dtype, *row_dims);
+}
+
+// Batches `values` of a component, which are all available, into `result`.
+// The output tensor is allocated once, and the rows are gathered into it with
+// a ParallelFor. Padding is filled with zeros.
+template <typename T>
+void GatherComponent(SmallVector<RCReference<AsyncValue>, 4> values, bool pad,
+                     RCReference<AsyncValue> result,
+                     const ExecutionContext& exec_ctx) {
+  SmallVector<ssize_t, 4> row_dims;
+  bool needs_padding;
+  auto row_metadata =
+      GetBatchedRowMetadata<T>(values, pad, &row_dims, &needs_padding);
+  if (!row_metadata) {
+    result->SetError(EmitError(exec_ctx, StrCat(row_metadata.takeError())));
+    return;
+  }
+
+  SmallVector<ssize_t, 4> output_dims;
+  output_dims.push_back(values.size());
+  output_dims.append(row_dims.begin(), row_dims.end());
+  auto dht = DenseHostTensor::CreateUninitialized(
+      TensorMetadata(row_metadata->dtype, output_dims), exec_ctx.host());
+  if (!dht) {
+    result->SetError(
+        EmitError(exec_ctx, "failed to create uninitialized tensor"));
+    return;
+  }
+  if (needs_padding) std::memset(dht->data(), 0, dht->DataSizeInBytes());
+
+  struct GatherState {
+    SmallVector<RCReference<AsyncValue>, 4> values;
+    SmallVector<ssize_t, 4> row_dims;
+    DenseHostTensor output;
+    RCReference<AsyncValue> result;
+  };
+  const size_t row_bytes = dht->DataSizeInBytes() / values.size();
+  auto state = std::make_shared<GatherState>(
+      GatherState{std::move(values), std::move(row_dims), std::move(*dht),
+                  std::move(result)});
+  const size_t num_rows = state->values.size();
+  const size_t min_block_rows = std::max<size_t>(
+      1, kMinBatchCopyBlockBytes / std::max<size_t>(1, row_bytes));
+  ParallelFor(exec_ctx).Execute(
+      num_rows, ParallelFor::BlockSizes::Min(min_block_rows),
+      [state, row_bytes](size_t start, size_t end) {
+        char* dst = static_cast<char*>(state->output.data());
+        for (size_t i = start; i < end; ++i) {
+          CopyRowHelper<T>(state->values[i]->template get<T>(),
+                           dst + i * row_bytes, state->row_dims);
+        }
+      },
+      [state]() {
+        state->result->template emplace<DenseHostTensor>(
+            std::move(state->output));
+      });
+}
+
+// Recursive base case.
+template <size_t N>
+void GatherToBatchHelper(ArrayRef<IterationResult> inputs, bool pad,
+                         const IterationResult& result,
+                         const ExecutionContext& exec_ctx) {}
+
+// Batch `inputs`, which are all available and not at the end of iteration.
+// This function applies recursively to one component (with type T) at a time.
+template <size_t N, typename T, typename... RemainingT>
+void GatherToBatchHelper(ArrayRef<IterationResult> inputs, bool pad,
+                         const IterationResult& result,
+                         const ExecutionContext& exec_ctx) {
+  auto index = N - (sizeof...(RemainingT) + 1);
+
+  SmallVector<RCReference<AsyncValue>, 4> values;
+  values.reserve(inputs.size());
+  for (auto& input : inputs) values.push_back(input.values[index].CopyRef());
+  GatherComponent<T>(std::move(values), pad, result.values[index].CopyRef(),
+                     exec_ctx);
+
+  GatherToBatchHelper<N, RemainingT...>(inputs, pad, result, exec_ctx);
+}
+
+// Batch `inputs`, which are all available, into `result`. Inputs at the end
+// of iteration are dropped, and an error in any input is forwarded to all
+// components of `result`.
+template <typename... T>
+void GatherToBatch(ArrayRef<IterationResult> inputs, bool pad,
+                   const IterationResult& result,
+                   const ExecutionContext& exec_ctx) {
+  size_t batch_size = 0;
+  for (auto& input : inputs) {
+    AsyncValue* error = nullptr;
+    if (input.eof.IsError()) {
+      error = input.eof.GetAsyncValue();
+    } else if (input.eof.get()) {
+      continue;
+    } else {
+      for (auto& value : input.values) {
+        if (value->IsError()) {
+          error = value.get();
+          break;
+        }
+      }
+    }
+    if (error != nullptr) {
+      for (auto& value : result.values) value->SetError(error->GetError());
+      return;
+    }
+    // Inputs at the end of iteration can only follow the other inputs.
+    assert(batch_size == &input - inputs.begin());
+    ++batch_size;
+  }
+
+  if (batch_size == 0) {
+    auto error =
+        MakeErrorAsyncValueRef(exec_ctx.host(), "iterator reached end");
+    for (auto& value : result.values) value->SetError(error->GetError());
+    return;
+  }
+  GatherToBatchHelper<sizeof...(T), T...>(inputs.take_front(batch_size), pad,
+                                          result, exec_ctx);
+}
+
+// Returns true if the value of `input` or its end of iteration is available.
+static bool IsBatchInputAvailable(const IterationResult& input) {
+  if (!input.eof.IsAvailable()) return false;
+  if (!input.eof.IsError() && input.eof.get()) return true;
+  for (auto& value : input.values) {
+    if (!value->IsAvailable()) return false;
+  }
+  return true;
+}
+
 // BatchDataset wraps around another Dataset instance and batches the underlying
 // elements before returning them via GetNext().
 //
 // If the underlying dataset element type is a tensor, GetNext() should return a
 // tensor with +1 dimension. If the underlying dataset element type is a scalar,
 // GetNext() should return a 1-D tensor of the same scalar type.
+//
+// If all inputs of a batch are available when GetNext() is called, they are
+// gathered into the output tensors in bulk. Otherwise each input is copied
+// when it becomes available, by the thread that computed it.
 template <typename... T>
 class BatchDataset : public Dataset {
  public:
   // If `same_input_metadata` is true, all values from the `input_dataset`
-  // must have the DType and TensorShape.
+  // must have the DType and TensorShape. If `pad` is true, tensors in a batch
+  // may have different shapes of the same rank, and are padded with zeros to
+  // the largest size of each dimension in the batch.
   explicit BatchDataset(RCReference<Dataset> input_dataset, int64_t batch_size,
-                        bool same_input_metadata, HostContext* host)
+                        bool same_input_metadata, bool pad, HostContext* host)
       : input_dataset_(std::move(input_dataset)),
         batch_size_(batch_size),
         same_input_metadata_(same_input_metadata),
+        pad_(pad),
         host_(host),
         allocator_(host->allocator()) {}
 
@@ -387,6 +608,7 @@ class BatchDataset : public Dataset {
   RCReference<Dataset> input_dataset_;
   const int64_t batch_size_;
   const bool same_input_metadata_;
+  const bool pad_;
   HostContext* host_;
   HostAllocator* allocator_;
 };
@@ -444,6 +666,33 @@ IterationResult BatchDatasetIterator<T...>::GetNext(
     inputs.push_back(std::move(input));
   }
 
+  SmallVector<RCReference<AsyncValue>, 4> result_values;
+  result_values.reserve(sizeof...(T));
+  for (size_t i = 0; i < sizeof...(T); ++i) {
+    result_values.push_back(
+        MakeUnconstructedAsyncValueRef<DenseHostTensor>(host));
+  }
+  // result's eof should be exactly the same as the eof of the first input.
+  auto result = IterationResult::Pending(std::move(result_values),
+                                         inputs[0].eof.CopyRef());
+
+  // A padded batch can only be allocated once the shapes of all inputs are
+  // known, so it is always gathered in bulk.
+  if (parent_dataset_->pad_ ||
+      llvm::all_of(inputs, IsBatchInputAvailable)) {
+    SmallVector<AsyncValue*, 8> async_values;
+    for (const auto& input : inputs) {
+      auto input_values = input.AsyncValues();
+      async_values.append(input_values.begin(), input_values.end());
+    }
+    RunWhenReady(async_values, [inputs = std::move(inputs),
+                                pad = parent_dataset_->pad_,
+                                result = result.CopyRef(), exec_ctx]() {
+      GatherToBatch<T...>(inputs, pad, result, exec_ctx);
+    });
+    return result;
+  }
+
   SmallVector<AsyncValueRef<TensorMetadata>, 4> metadata;
   if (parent_dataset_->same_input_metadata_) {
     // If all input values have the same metadata, record the metadata of the
@@ -469,15 +718,6 @@ IterationResult BatchDatasetIterator<T...>::GetNext(
   auto temp_batched_values =
       AllocateOutputTensors(metadata, inputs.size(), exec_ctx);
 
-  SmallVector<RCReference<AsyncValue>, 4> result_values;
-  result_values.reserve(sizeof...(T));
-  for (size_t i = 0; i < sizeof...(T); ++i) {
-    result_values.push_back(
-        MakeUnconstructedAsyncValueRef<DenseHostTensor>(host));
-  }
-  // result's eof should be exactly the same as the eof of the first input.
-  auto result = IterationResult::Pending(std::move(result_values),
-                                         inputs[0].eof.CopyRef());
   CopyToBatch<T...>(std::move(inputs), std::move(metadata),
                     std::move(temp_batched_values), result.CopyRef(), exec_ctx);
   return result;
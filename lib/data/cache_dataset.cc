@@ -0,0 +1,197 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- cache_dataset.cc -----------------------------------------*- C++ -*-===//
+//
+// This file implements reading and writing of CacheDataset cache files.
+//
+//===----------------------------------------------------------------------===//
+
+#include "cache_dataset.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "tfrt/io/buffered_input_stream.h"
+#include "tfrt/io/file_input_stream.h"
+#include "tfrt/io/file_system.h"
+
+namespace tfrt {
+namespace data {
+namespace cache_file {
+namespace {
+
+constexpr uint64_t kMagic = 0x3248434143524654ULL;  // "TFRCACH2"
+
+// Offset of the number of elements in the header.
+constexpr uint64_t kNumElementsOffset = 2 * sizeof(uint64_t);
+
+}  // namespace
+
+void WriteComponent(const std::string& value, raw_ostream& os) {
+  WriteComponent(static_cast<uint64_t>(value.size()), os);
+  os.write(value.data(), value.size());
+}
+
+void WriteComponent(const DenseHostTensor& value, raw_ostream& os) {
+  const auto& metadata = value.metadata();
+  SmallVector<ssize_t, 4> dims;
+  metadata.shape.GetDimensions(&dims);
+  WriteComponent(static_cast<uint32_t>(metadata.dtype.kind()), os);
+  WriteComponent(static_cast<uint32_t>(dims.size()), os);
+  for (auto dim : dims) WriteComponent(static_cast<int64_t>(dim), os);
+  os.write(static_cast<const char*>(value.data()), value.DataSizeInBytes());
+}
+
+llvm::Error ReadBytes(InputStream* stream, char* buffer, size_t count) {
+  auto count_or_error = stream->Read(buffer, count);
+  if (!count_or_error) return count_or_error.takeError();
+  if (*count_or_error != count)
+    return MakeStringError("truncated cache file");
+  return llvm::Error::success();
+}
+
+template <>
+llvm::Expected<std::string> ReadComponent<std::string>(InputStream* stream,
+                                                       HostContext* host) {
+  auto size = ReadComponent<uint64_t>(stream, host);
+  if (!size) return size.takeError();
+  std::string value(*size, '\0');
+  if (auto error = ReadBytes(stream, &value[0], value.size()))
+    return std::move(error);
+  return value;
+}
+
+template <>
+llvm::Expected<DenseHostTensor> ReadComponent<DenseHostTensor>(
+    InputStream* stream, HostContext* host) {
+  auto kind = ReadComponent<uint32_t>(stream, host);
+  if (!kind) return kind.takeError();
+  if (*kind < static_cast<uint32_t>(DType::FirstDType) ||
+      *kind > static_cast<uint32_t>(DType::LastDType))
+    return MakeStringError("invalid dtype in cache file: ", *kind);
+  auto rank = ReadComponent<uint32_t>(stream, host);
+  if (!rank) return rank.takeError();
+  SmallVector<ssize_t, 4> dims;
+  for (uint32_t i = 0; i < *rank; ++i) {
+    auto dim = ReadComponent<int64_t>(stream, host);
+    if (!dim) return dim.takeError();
+    dims.push_back(*dim);
+  }
+
+  auto dht = DenseHostTensor::CreateUninitialized(
+      TensorMetadata(DType(static_cast<DType::Kind>(*kind)), dims), host);
+  if (!dht) return MakeStringError("cannot allocate tensor");
+  if (auto error = ReadBytes(stream, static_cast<char*>(dht->data()),
+                             dht->DataSizeInBytes()))
+    return std::move(error);
+  return std::move(*dht);
+}
+
+llvm::Expected<uint64_t> OpenCacheFile(
+    string_view path, ArrayRef<uint32_t> component_types, int64_t buffer_size,
+    HostAllocator* allocator, std::unique_ptr<InputStream>* stream) {
+  auto* file_system = ::tfrt::io::FileSystemRegistry::Default()->Lookup("");
+  if (!file_system)
+    return MakeStringError("No file system is found for the given scheme");
+
+  std::unique_ptr<::tfrt::io::RandomAccessFile> file;
+  if (auto error = file_system->NewRandomAccessFile(path.str(), &file))
+    return std::move(error);
+  *stream = std::make_unique<::tfrt::io::BufferedInputStream>(
+      std::make_unique<::tfrt::io::FileInputStream>(std::move(file)),
+      buffer_size, allocator);
+
+  uint64_t header[3];
+  if (auto error = ReadBytes(stream->get(), reinterpret_cast<char*>(header),
+                             sizeof(header)))
+    return std::move(error);
+  if (header[0] != kMagic)
+    return MakeStringError(path, " is not a cache file");
+  if (header[1] != component_types.size()) {
+    return MakeStringError("cache file ", path, " has ", header[1],
+                           " components per element, expected ",
+                           component_types.size());
+  }
+  for (size_t i = 0; i < component_types.size(); ++i) {
+    auto type = ReadComponent<uint32_t>(stream->get(), /*host=*/nullptr);
+    if (!type) return type.takeError();
+    if (*type != component_types[i]) {
+      return MakeStringError("cache file ", path, " has type ", *type,
+                             " for component ", i, ", expected ",
+                             component_types[i]);
+    }
+  }
+  return header[2];
+}
+
+//===----------------------------------------------------------------------===//
+// CacheFileWriter methods
+//===----------------------------------------------------------------------===//
+
+llvm::Expected<std::unique_ptr<CacheFileWriter>> CacheFileWriter::Create(
+    std::string path, ArrayRef<uint32_t> component_types) {
+  // Several writers, also of different processes, may write the same cache
+  // file at a time. Each writes its own temporary file.
+  int fd;
+  llvm::SmallString<128> temp_path;
+  if (auto error_code = llvm::sys::fs::createUniqueFile(
+          path + ".tmp-%%%%%%%%", fd, temp_path)) {
+    return MakeStringError("cannot create temporary file for cache file ",
+                           path, ": ", error_code.message());
+  }
+  auto os = std::make_unique<llvm::raw_fd_ostream>(fd, /*shouldClose=*/true);
+  std::unique_ptr<CacheFileWriter> writer(new CacheFileWriter(
+      std::move(path), temp_path.str().str(), std::move(os)));
+  WriteComponent(kMagic, writer->os());
+  WriteComponent(static_cast<uint64_t>(component_types.size()), writer->os());
+  // The number of elements is written on commit.
+  WriteComponent(uint64_t{0}, writer->os());
+  for (uint32_t type : component_types) WriteComponent(type, writer->os());
+  return std::move(writer);
+}
+
+CacheFileWriter::CacheFileWriter(std::string path, std::string temp_path,
+                                 std::unique_ptr<llvm::raw_fd_ostream> os)
+    : path_(std::move(path)),
+      temp_path_(std::move(temp_path)),
+      os_(std::move(os)) {}
+
+CacheFileWriter::~CacheFileWriter() {
+  if (committed_) return;
+  os_.reset();
+  llvm::sys::fs::remove(temp_path_);
+}
+
+llvm::Error CacheFileWriter::Commit() {
+  os_->seek(kNumElementsOffset);
+  WriteComponent(num_elements_, *os_);
+  os_->close();
+  if (os_->has_error()) {
+    auto message = os_->error().message();
+    os_->clear_error();
+    return MakeStringError("cannot write cache file ", temp_path_, ": ",
+                           message);
+  }
+  if (auto error_code = llvm::sys::fs::rename(temp_path_, path_)) {
+    return MakeStringError("cannot rename ", temp_path_, " to ", path_, ": ",
+                           error_code.message());
+  }
+  committed_ = true;
+  return llvm::Error::success();
+}
+
+}  // namespace cache_file
+}  // namespace data
+}  // namespace tfrt
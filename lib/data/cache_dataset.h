@@ -0,0 +1,627 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- cache_dataset.h ------------------------------------------*- C++ -*-===//
+//
+// This file declares CacheDataset class which materializes the elements of
+// another Dataset instance in memory or in a local file during the first
+// epoch, and serves the following epochs from there.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_LIB_DATA_CACHE_DATASET_H_
+#define TFRT_LIB_DATA_CACHE_DATASET_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/io/input_stream.h"
+#include "tfrt/support/error_util.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/ref_count.h"
+#include "tfrt/support/thread_annotations.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+
+namespace tfrt {
+namespace data {
+
+//===----------------------------------------------------------------------===//
+// Cache file format
+//===----------------------------------------------------------------------===//
+//
+// A cache file stores the elements of one epoch in order, in host byte order:
+//
+//   <magic:uint64_t><num_components:uint64_t><num_elements:uint64_t>
+//   <component_type:uint32_t[num_components]>
+//   <component_1><component_2>...<component_N>   (for every element)
+//
+// The type of a scalar or string component is the kind of its DType, and that
+// of a DenseHostTensor component is kDenseHostTensorType.
+//
+// A scalar component is stored as its bytes, a string as <size:uint64_t>
+// followed by its bytes, and a DenseHostTensor as
+// <dtype:uint32_t><rank:uint32_t><dims:int64_t[rank]><data>.
+namespace cache_file {
+
+using ::tfrt::io::InputStream;
+
+// Not a DType kind, the dtype of a tensor is stored with every element.
+constexpr uint32_t kDenseHostTensorType = 0x100;
+
+template <typename T>
+uint32_t GetComponentType() {
+  return GetDType<T>().kind();
+}
+template <>
+inline uint32_t GetComponentType<DenseHostTensor>() {
+  return kDenseHostTensorType;
+}
+
+template <typename T>
+void WriteComponent(const T& value, raw_ostream& os) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+void WriteComponent(const std::string& value, raw_ostream& os);
+void WriteComponent(const DenseHostTensor& value, raw_ostream& os);
+
+// Reads exactly `count` bytes. Fails if the stream ends earlier.
+llvm::Error ReadBytes(InputStream* stream, char* buffer, size_t count);
+
+template <typename T>
+llvm::Expected<T> ReadComponent(InputStream* stream, HostContext* host) {
+  T value;
+  if (auto error =
+          ReadBytes(stream, reinterpret_cast<char*>(&value), sizeof(value)))
+    return std::move(error);
+  return value;
+}
+template <>
+llvm::Expected<std::string> ReadComponent<std::string>(InputStream* stream,
+                                                       HostContext* host);
+template <>
+llvm::Expected<DenseHostTensor> ReadComponent<DenseHostTensor>(
+    InputStream* stream, HostContext* host);
+
+template <typename T>
+size_t GetComponentSize(const T& value) {
+  return sizeof(value);
+}
+inline size_t GetComponentSize(const std::string& value) {
+  return value.size();
+}
+inline size_t GetComponentSize(const DenseHostTensor& value) {
+  return value.DataSizeInBytes();
+}
+
+// Opens the cache file at `path` with a read buffer of `buffer_size` bytes and
+// reads its header. Fails if the components of the cached elements do not have
+// the `component_types`. Returns the number of cached elements.
+llvm::Expected<uint64_t> OpenCacheFile(
+    string_view path, ArrayRef<uint32_t> component_types, int64_t buffer_size,
+    HostAllocator* allocator, std::unique_ptr<InputStream>* stream);
+
+// Writes a cache file. Elements are written to a temporary file with a unique
+// name, which only replaces the file at `path` when the cache is committed, so
+// that a cache file that exists is always complete.
+class CacheFileWriter {
+ public:
+  static llvm::Expected<std::unique_ptr<CacheFileWriter>> Create(
+      std::string path, ArrayRef<uint32_t> component_types);
+  // Removes the temporary file unless the cache was committed.
+  ~CacheFileWriter();
+
+  // This class is not copyable or movable.
+  CacheFileWriter(const CacheFileWriter&) = delete;
+  CacheFileWriter& operator=(const CacheFileWriter&) = delete;
+
+  // The stream to write the components of the next element to.
+  raw_ostream& os() { return *os_; }
+  void FinishElement() { ++num_elements_; }
+
+  // Writes the number of elements and moves the file to `path`.
+  llvm::Error Commit();
+
+ private:
+  CacheFileWriter(std::string path, std::string temp_path,
+                  std::unique_ptr<llvm::raw_fd_ostream> os);
+
+  const std::string path_;
+  const std::string temp_path_;
+  std::unique_ptr<llvm::raw_fd_ostream> os_;
+  uint64_t num_elements_ = 0;
+  bool committed_ = false;
+};
+
+// Recursive base case.
+template <size_t N>
+void WriteElementHelper(ArrayRef<RCReference<AsyncValue>> values,
+                        raw_ostream& os) {}
+
+// Writes the components of an element, one component (with type T) at a time.
+template <size_t N, typename T, typename... RemainingT>
+void WriteElementHelper(ArrayRef<RCReference<AsyncValue>> values,
+                        raw_ostream& os) {
+  auto index = N - (sizeof...(RemainingT) + 1);
+  WriteComponent(values[index]->get<T>(), os);
+  WriteElementHelper<N, RemainingT...>(values, os);
+}
+
+// Recursive base case.
+template <size_t N>
+llvm::Error ReadElementHelper(
+    InputStream* stream, HostContext* host,
+    SmallVectorImpl<RCReference<AsyncValue>>* values) {
+  return llvm::Error::success();
+}
+
+// Reads the components of an element, one component (with type T) at a time.
+template <size_t N, typename T, typename... RemainingT>
+llvm::Error ReadElementHelper(
+    InputStream* stream, HostContext* host,
+    SmallVectorImpl<RCReference<AsyncValue>>* values) {
+  auto value = ReadComponent<T>(stream, host);
+  if (!value) return value.takeError();
+  values->push_back(MakeAvailableAsyncValueRef<T>(host, std::move(*value)));
+  return ReadElementHelper<N, RemainingT...>(stream, host, values);
+}
+
+// Recursive base case.
+template <size_t N>
+size_t GetElementSizeHelper(ArrayRef<RCReference<AsyncValue>> values) {
+  return 0;
+}
+
+template <size_t N, typename T, typename... RemainingT>
+size_t GetElementSizeHelper(ArrayRef<RCReference<AsyncValue>> values) {
+  auto index = N - (sizeof...(RemainingT) + 1);
+  size_t size = values[index]->IsConcrete()
+                    ? GetComponentSize(values[index]->get<T>())
+                    : 0;
+  return size + GetElementSizeHelper<N, RemainingT...>(values);
+}
+
+}  // namespace cache_file
+
+template <typename... T>
+class CacheWriter;
+template <typename... T>
+class CacheWriterIterator;
+template <typename... T>
+class MemoryCacheIterator;
+template <typename... T>
+class FileCacheIterator;
+
+// CacheDataset wraps around another Dataset instance and caches its elements.
+//
+// The first iterator records the elements of the input dataset as they become
+// available. When the input reaches its end, the recorded elements become the
+// cache, and all later iterators read them from the cache instead of the input.
+// If the first iterator is destroyed before the end of the input, or an
+// element is an error, nothing is cached and the next iterator starts over.
+// Iterators created while the cache is being written read the input directly.
+//
+// If `filename` is empty, the cache holds references to the elements in
+// memory. Otherwise the elements are written to the file, and the file is
+// reused by every CacheDataset with the same filename, also across runs.
+template <typename... T>
+class CacheDataset : public Dataset {
+ public:
+  // Settings for reading the cache file, matching those of TFRecordDataset.
+  static constexpr int64_t kBufferSize = 256 * 1024;
+  static constexpr int64_t kMaxPrefetchNum = 80;
+  static constexpr int64_t kPrefetchThreshold = 20;
+  static constexpr int64_t kMaxPrefetchBytes = 64 * 1024 * 1024;
+
+  explicit CacheDataset(RCReference<Dataset> input_dataset,
+                        std::string filename, HostContext* host)
+      : input_dataset_(std::move(input_dataset)),
+        filename_(std::move(filename)),
+        host_(host),
+        allocator_(host->allocator()) {}
+
+  // This class is not copyable or movable.
+  CacheDataset(const CacheDataset&) = delete;
+  CacheDataset& operator=(const CacheDataset&) = delete;
+
+  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+
+ private:
+  friend class CacheWriter<T...>;
+  friend class CacheWriterIterator<T...>;
+  friend class MemoryCacheIterator<T...>;
+  friend class FileCacheIterator<T...>;
+
+  enum class State { kEmpty, kWriting, kComplete };
+
+  void Destroy() override {
+    internal::DestroyImpl<CacheDataset<T...>>(this, allocator_);
+  }
+
+  // Called by the CacheWriter when the first epoch has been recorded.
+  // `values` is empty for a file cache.
+  void CompleteCache(std::vector<RCReference<AsyncValue>> values)
+      TFRT_EXCLUDES(mu_) {
+    mutex_lock lock(mu_);
+    values_ = std::move(values);
+    state_ = State::kComplete;
+  }
+
+  // Called by the CacheWriter when the first epoch could not be recorded.
+  void ResetCache() TFRT_EXCLUDES(mu_) {
+    mutex_lock lock(mu_);
+    state_ = State::kEmpty;
+  }
+
+  RCReference<Dataset> input_dataset_;
+  const std::string filename_;
+  HostContext* host_;
+  HostAllocator* allocator_;
+
+  mutex mu_;
+  State state_ TFRT_GUARDED_BY(mu_) = State::kEmpty;
+  // The components of the cached elements of an in-memory cache, element by
+  // element. They are not modified once the state is kComplete, so iterators
+  // read them without holding mu_.
+  std::vector<RCReference<AsyncValue>> values_;
+};
+
+// CacheWriter records the elements of the first epoch in order, as they become
+// available. It is shared by the writing iterator and the callbacks waiting for
+// its elements, which may outlive the iterator.
+//
+// Elements of a file cache are written to the file by blocking work items, one
+// at a time, so that file IO does not run on the non-blocking work queue.
+template <typename... T>
+class CacheWriter : public ReferenceCounted<CacheWriter<T...>> {
+ public:
+  CacheWriter(RCReference<CacheDataset<T...>> dataset,
+              std::unique_ptr<cache_file::CacheFileWriter> file)
+      : dataset_(std::move(dataset)),
+        write_file_(file != nullptr),
+        file_(std::move(file)) {}
+
+  // Records the `index`-th result of the input iterator, which is available.
+  void Add(size_t index, IterationResult input,
+           const ExecutionContext& exec_ctx) TFRT_EXCLUDES(mu_) {
+    mutex_lock lock(mu_);
+    if (done_) return;
+    pending_.emplace(index, std::move(input));
+    while (!done_ && !pending_.empty() &&
+           pending_.begin()->first == next_index_) {
+      auto next = std::move(pending_.begin()->second);
+      pending_.erase(pending_.begin());
+      ++next_index_;
+      Record(std::move(next));
+    }
+    MaybeAbortCancelled();
+    MaybeScheduleWrite(exec_ctx);
+  }
+
+  // Called when the writing iterator is destroyed after handing out
+  // `num_results` results. Results that are not yet available may still
+  // include the end of the input, so the recorded elements are only discarded
+  // once all of them have been recorded without reaching the end.
+  void Cancel(size_t num_results) TFRT_EXCLUDES(mu_) {
+    mutex_lock lock(mu_);
+    cancelled_ = true;
+    num_results_ = num_results;
+    MaybeAbortCancelled();
+  }
+
+ private:
+  void Record(IterationResult input) TFRT_REQUIRES(mu_) {
+    if (input.eof.IsError()) return Abort();
+    if (input.eof.get()) return Finish();
+    for (auto& value : input.values) {
+      if (value->IsError()) return Abort();
+    }
+    for (auto& value : input.values) values_.push_back(std::move(value));
+  }
+
+  void Finish() TFRT_REQUIRES(mu_) {
+    done_ = true;
+    pending_.clear();
+    // A file cache is completed once all the elements are written.
+    if (write_file_) {
+      commit_ = true;
+      return;
+    }
+    dataset_->CompleteCache(std::move(values_));
+  }
+
+  // Enqueues a blocking work item to write the recorded elements to the cache
+  // file, unless one is already running.
+  void MaybeScheduleWrite(const ExecutionContext& exec_ctx)
+      TFRT_REQUIRES(mu_) {
+    if (writing_ || !file_ || (values_.empty() && !commit_)) return;
+    writing_ = true;
+    bool enqueued = EnqueueBlockingWork(
+        exec_ctx, [writer = FormRef(this)] { writer->WriteFile(); });
+    // Do not cache this epoch if the file cannot be written, the next iterator
+    // tries again.
+    if (!enqueued) {
+      writing_ = false;
+      Abort();
+    }
+  }
+
+  // Writes the recorded elements to the cache file, and commits the file once
+  // the epoch is complete. The work item owns the file while it runs.
+  void WriteFile() TFRT_EXCLUDES(mu_) {
+    std::unique_ptr<cache_file::CacheFileWriter> file;
+    {
+      mutex_lock lock(mu_);
+      file = std::move(file_);
+    }
+    while (true) {
+      std::vector<RCReference<AsyncValue>> values;
+      bool commit;
+      {
+        mutex_lock lock(mu_);
+        // The file is removed when it is destroyed without a commit.
+        if (done_ && !commit_) return;
+        if (values_.empty() && !commit_) {
+          file_ = std::move(file);
+          writing_ = false;
+          return;
+        }
+        std::swap(values, values_);
+        commit = commit_;
+      }
+      for (size_t i = 0; i < values.size(); i += sizeof...(T)) {
+        cache_file::WriteElementHelper<sizeof...(T), T...>(
+            llvm::makeArrayRef(values).slice(i, sizeof...(T)), file->os());
+        file->FinishElement();
+      }
+      if (commit) break;
+    }
+    if (auto error = file->Commit()) {
+      dataset_->host_->EmitError(DecodedDiagnostic(error));
+      dataset_->ResetCache();
+      return;
+    }
+    dataset_->CompleteCache({});
+  }
+
+  void MaybeAbortCancelled() TFRT_REQUIRES(mu_) {
+    if (cancelled_ && !done_ && next_index_ == num_results_) Abort();
+  }
+
+  void Abort() TFRT_REQUIRES(mu_) {
+    done_ = true;
+    pending_.clear();
+    values_.clear();
+    file_.reset();
+    dataset_->ResetCache();
+  }
+
+  RCReference<CacheDataset<T...>> dataset_;
+  mutex mu_;
+  // Set if the elements are cached in a file rather than in memory.
+  const bool write_file_;
+  bool done_ TFRT_GUARDED_BY(mu_) = false;
+  // Set when the epoch is complete, and the cache file is to be committed once
+  // all the elements are written.
+  bool commit_ TFRT_GUARDED_BY(mu_) = false;
+  // Index of the next input result to record.
+  size_t next_index_ TFRT_GUARDED_BY(mu_) = 0;
+  // Set when the writing iterator is destroyed, together with the number of
+  // results it handed out.
+  bool cancelled_ TFRT_GUARDED_BY(mu_) = false;
+  size_t num_results_ TFRT_GUARDED_BY(mu_) = 0;
+  // Available input results that follow a result that is not yet available.
+  std::map<size_t, IterationResult> pending_ TFRT_GUARDED_BY(mu_);
+  // The components of the recorded elements, element by element. For a file
+  // cache, only those not yet written to the file.
+  std::vector<RCReference<AsyncValue>> values_ TFRT_GUARDED_BY(mu_);
+  // Set while a blocking work item writes to the file. The work item owns the
+  // file in the meantime, and file_ is null.
+  bool writing_ TFRT_GUARDED_BY(mu_) = false;
+  std::unique_ptr<cache_file::CacheFileWriter> file_ TFRT_GUARDED_BY(mu_);
+};
+
+// Returns the elements of the input dataset and records them with a
+// CacheWriter.
+template <typename... T>
+class CacheWriterIterator : public Iterator {
+ public:
+  explicit CacheWriterIterator(RCReference<CacheDataset<T...>> parent_dataset,
+                               RCReference<CacheWriter<T...>> writer,
+                               const IteratorContext& context)
+      : Iterator(),
+        parent_dataset_(std::move(parent_dataset)),
+        input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+        writer_(std::move(writer)) {}
+
+  ~CacheWriterIterator() override { writer_->Cancel(num_inputs_); }
+
+  // This class is not copyable or movable.
+  CacheWriterIterator(const CacheWriterIterator&) = delete;
+  CacheWriterIterator& operator=(const CacheWriterIterator&) = delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override {
+    auto input = input_iterator_->GetNext(exec_ctx);
+    RunWhenReady(input.AsyncValues(),
+                 [writer = writer_.CopyRef(), index = num_inputs_++,
+                  input = input.CopyRef(), exec_ctx]() mutable {
+                   writer->Add(index, std::move(input), exec_ctx);
+                 });
+    return input;
+  }
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<CacheWriterIterator>(this,
+                                               parent_dataset_->allocator_);
+  }
+
+  RCReference<CacheDataset<T...>> parent_dataset_;
+  RCReference<Iterator> input_iterator_;
+  RCReference<CacheWriter<T...>> writer_;
+  size_t num_inputs_ = 0;
+};
+
+// Returns the elements of an in-memory cache.
+template <typename... T>
+class MemoryCacheIterator : public Iterator {
+ public:
+  explicit MemoryCacheIterator(RCReference<CacheDataset<T...>> parent_dataset)
+      : Iterator(), parent_dataset_(std::move(parent_dataset)) {}
+
+  // This class is not copyable or movable.
+  MemoryCacheIterator(const MemoryCacheIterator&) = delete;
+  MemoryCacheIterator& operator=(const MemoryCacheIterator&) = delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override {
+    HostContext* host = exec_ctx.host();
+    const auto& cached_values = parent_dataset_->values_;
+    if (index_ == cached_values.size()) {
+      return IterationResult::Eof(host, sizeof...(T));
+    }
+    SmallVector<RCReference<AsyncValue>, 4> values;
+    for (size_t i = 0; i < sizeof...(T); ++i)
+      values.push_back(cached_values[index_++].CopyRef());
+    return IterationResult::Values(std::move(values), host);
+  }
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<MemoryCacheIterator>(this,
+                                               parent_dataset_->allocator_);
+  }
+
+  RCReference<CacheDataset<T...>> parent_dataset_;
+  size_t index_ = 0;
+};
+
+// Returns the elements of a cache file. Like TFRecordDatasetIterator, it reads
+// the file with blocking tasks ahead of the consumer.
+template <typename... T>
+class FileCacheIterator : public io::PrefetchingIterator {
+ public:
+  explicit FileCacheIterator(RCReference<CacheDataset<T...>> parent_dataset,
+                             const IteratorContext& context)
+      : io::PrefetchingIterator(CacheDataset<T...>::kMaxPrefetchNum,
+                                CacheDataset<T...>::kPrefetchThreshold,
+                                CacheDataset<T...>::kMaxPrefetchBytes,
+                                /*autotune=*/true, parent_dataset->host_,
+                                context, sizeof...(T)),
+        parent_dataset_(std::move(parent_dataset)) {}
+
+  // This class is not copyable or movable.
+  FileCacheIterator(const FileCacheIterator&) = delete;
+  FileCacheIterator& operator=(const FileCacheIterator&) = delete;
+
+ protected:
+  IterationResult GetNextElement(const ExecutionContext& exec_ctx) final {
+    HostContext* host = exec_ctx.host();
+    if (!stream_) {
+      auto num_elements = cache_file::OpenCacheFile(
+          parent_dataset_->filename_, {cache_file::GetComponentType<T>()...},
+          CacheDataset<T...>::kBufferSize, parent_dataset_->allocator_,
+          &stream_);
+      if (!num_elements) {
+        return IterationResult::Error(
+            MakeErrorAsyncValueRef(host, StrCat(num_elements.takeError())),
+            sizeof...(T));
+      }
+      num_elements_ = *num_elements;
+    }
+    if (index_ == num_elements_) {
+      return IterationResult::Eof(host, sizeof...(T));
+    }
+
+    SmallVector<RCReference<AsyncValue>, 4> values;
+    if (auto error = cache_file::ReadElementHelper<sizeof...(T), T...>(
+            stream_.get(), host, &values)) {
+      // Make the error sticky, a partially read element cannot be skipped.
+      num_elements_ = index_;
+      return IterationResult::Error(
+          MakeErrorAsyncValueRef(host, StrCat(error)), sizeof...(T));
+    }
+    ++index_;
+    return IterationResult::Values(std::move(values), host);
+  }
+
+  size_t GetElementSize(const IterationResult& element) const final {
+    return cache_file::GetElementSizeHelper<sizeof...(T), T...>(
+        element.values);
+  }
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<FileCacheIterator>(this, parent_dataset_->allocator_);
+  }
+
+  RCReference<CacheDataset<T...>> parent_dataset_;
+  std::unique_ptr<::tfrt::io::InputStream> stream_;
+  uint64_t num_elements_ = 0;
+  uint64_t index_ = 0;
+};
+
+template <typename... T>
+RCReference<Iterator> CacheDataset<T...>::MakeIterator(
+    const IteratorContext& context) {
+  mutex_lock lock(mu_);
+  if (state_ == State::kEmpty && !filename_.empty() &&
+      llvm::sys::fs::exists(filename_)) {
+    state_ = State::kComplete;
+  }
+
+  if (state_ == State::kComplete) {
+    if (filename_.empty()) {
+      return TakeRef(
+          host_->Construct<MemoryCacheIterator<T...>>(FormRef(this)));
+    }
+    return TakeRef(
+        host_->Construct<FileCacheIterator<T...>>(FormRef(this), context));
+  }
+
+  if (state_ == State::kEmpty) {
+    std::unique_ptr<cache_file::CacheFileWriter> file;
+    if (!filename_.empty()) {
+      auto writer = cache_file::CacheFileWriter::Create(
+          filename_, {cache_file::GetComponentType<T>()...});
+      if (!writer) {
+        host_->EmitError(DecodedDiagnostic(writer.takeError()));
+        return input_dataset_->MakeIterator(context);
+      }
+      file = std::move(*writer);
+    }
+    state_ = State::kWriting;
+    auto writer =
+        TakeRef(new CacheWriter<T...>(FormRef(this), std::move(file)));
+    return TakeRef(host_->Construct<CacheWriterIterator<T...>>(
+        FormRef(this), std::move(writer), context));
+  }
+
+  // Another iterator is writing the cache, read the input directly.
+  return input_dataset_->MakeIterator(context);
+}
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_CACHE_DATASET_H_
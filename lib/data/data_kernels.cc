@@ -18,12 +18,16 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "autotuner.h"
 #include "batch_dataset.h"
+#include "cache_dataset.h"
 #include "filter_dataset.h"
 #include "interleave_dataset.h"
+#include "llvm_derived/Support/raw_ostream.h"
 #include "log_dataset.h"
 #include "map_dataset.h"
 #include "memory_dataset.h"
+#include "parallel_map_dataset.h"
 #include "prefetch_dataset.h"
 #include "range_dataset.h"
 #include "repeat_dataset.h"
@@ -104,6 +108,20 @@ RCReference<MapDataset> MakeMapDataset(RCReference<Dataset>* dataset,
       FormRef(&fn.get()), exec_ctx.host()));
 }
 
+//===----------------------------------------------------------------------===//
+// ParallelMapDataset
+//===----------------------------------------------------------------------===//
+
+RCReference<ParallelMapDataset> MakeParallelMapDataset(
+    RCReference<Dataset>* dataset, int64_t num_parallel_calls,
+    RemainingArguments args, Attribute<bool> is_deterministic,
+    Attribute<Function> fn, const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  return TakeRef(host->Construct<ParallelMapDataset>(
+      dataset->CopyRef(), num_parallel_calls, is_deterministic.get(),
+      RCArray<AsyncValue>(args.values()), FormRef(&fn.get()), host));
+}
+
 //===----------------------------------------------------------------------===//
 // FilterDataset
 //===----------------------------------------------------------------------===//
@@ -143,9 +161,23 @@ RCReference<TFRecordDataset> MakeTFRecordDataset(
   int64_t buffer_size = 256 * 1024;
   int64_t max_prefetch_num = 80;
   int64_t prefetch_threshold = 20;
+  // Default prefetch memory to 64 MB per iterator.
+  int64_t max_prefetch_bytes = 64 * 1024 * 1024;
+  bool autotune = true;
   return TakeRef(exec_ctx.host()->Construct<TFRecordDataset>(
       std::move(path), buffer_size, max_prefetch_num, prefetch_threshold,
-      exec_ctx.host()));
+      max_prefetch_bytes, autotune, exec_ctx.host()));
+}
+
+RCReference<MappedTFRecordDataset> MakeMappedTFRecordDataset(
+    std::string path, const ExecutionContext& exec_ctx) {
+  int64_t max_prefetch_num = 80;
+  int64_t prefetch_threshold = 20;
+  int64_t max_prefetch_bytes = 64 * 1024 * 1024;
+  bool autotune = true;
+  return TakeRef(exec_ctx.host()->Construct<MappedTFRecordDataset>(
+      std::move(path), max_prefetch_num, prefetch_threshold,
+      max_prefetch_bytes, autotune, exec_ctx.host()));
 }
 
 //===----------------------------------------------------------------------===//
@@ -204,7 +236,31 @@ RCReference<BatchDataset<T...>> MakeBatchDataset(
     Attribute<bool> same_input_metadata, const ExecutionContext& exec_ctx) {
   HostContext* host = exec_ctx.host();
   return TakeRef(host->Construct<BatchDataset<T...>>(
-      dataset->CopyRef(), batch_size, same_input_metadata.get(), host));
+      dataset->CopyRef(), batch_size, same_input_metadata.get(),
+      /*pad=*/false, host));
+}
+
+template <typename... T>
+RCReference<BatchDataset<T...>> MakePaddedBatchDataset(
+    RCReference<Dataset>* dataset, int64_t batch_size,
+    const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  return TakeRef(host->Construct<BatchDataset<T...>>(
+      dataset->CopyRef(), batch_size, /*same_input_metadata=*/false,
+      /*pad=*/true, host));
+}
+
+//===----------------------------------------------------------------------===//
+// CacheDataset
+//===----------------------------------------------------------------------===//
+
+template <typename... T>
+RCReference<CacheDataset<T...>> MakeCacheDataset(
+    RCReference<Dataset>* dataset, std::string filename,
+    const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  return TakeRef(host->Construct<CacheDataset<T...>>(
+      dataset->CopyRef(), std::move(filename), host));
 }
 
 //===----------------------------------------------------------------------===//
@@ -215,9 +271,6 @@ RCReference<PrefetchDataset> MakePrefetchDataset(
     RCReference<Dataset>* dataset, int64_t prefetch_num,
     Attribute<bool> is_deterministic, const ExecutionContext& exec_ctx) {
   HostContext* host = exec_ctx.host();
-  if (prefetch_num == -1) {
-    prefetch_num = host->GetNumWorkerThreads();
-  }
   return TakeRef(host->Construct<PrefetchDataset>(
       dataset->CopyRef(), prefetch_num, is_deterministic.get(), host));
 }
@@ -455,6 +508,19 @@ RCReference<LogDataset> MakeLogDataset(RCReference<Dataset>* dataset,
   return TakeRef(host->Construct<LogDataset>(dataset->CopyRef(), host));
 }
 
+//===----------------------------------------------------------------------===//
+// Autotuner
+//===----------------------------------------------------------------------===//
+
+// Print the budgets of the Autotuner and the statistics of all live tunable
+// parameters.
+static Chain PrintAutotuneStats(Chain chain, const ExecutionContext& exec_ctx) {
+  exec_ctx.host()->GetOrCreateSharedContext<Autotuner>().PrintStats(
+      tfrt::outs());
+  tfrt::outs().flush();
+  return Chain();
+}
+
 //===----------------------------------------------------------------------===//
 // Kernel registrations
 //===----------------------------------------------------------------------===//
@@ -490,17 +556,33 @@ void RegisterDataKernels(KernelRegistry* registry) {
                       TFRT_KERNEL(MakeBatchDataset<DenseHostTensor, int64_t>));
   registry->AddKernel("tfrt_data.batch_dataset.i64_and_i64",
                       TFRT_KERNEL(MakeBatchDataset<int64_t, int64_t>));
+  registry->AddKernel("tfrt_data.padded_batch_dataset.tensor",
+                      TFRT_KERNEL(MakePaddedBatchDataset<DenseHostTensor>));
+  registry->AddKernel(
+      "tfrt_data.padded_batch_dataset.tensor_and_i64",
+      TFRT_KERNEL(MakePaddedBatchDataset<DenseHostTensor, int64_t>));
 
   registry->AddKernel("tfrt_data.memory_dataset.i64",
                       TFRT_KERNEL(MakeMemoryDataset<int64_t>));
   registry->AddKernel("tfrt_data.memory_dataset.str",
                       TFRT_KERNEL(MakeMemoryDataset<std::string>));
 
+  registry->AddKernel("tfrt_data.cache_dataset.i64",
+                      TFRT_KERNEL(MakeCacheDataset<int64_t>));
+  registry->AddKernel("tfrt_data.cache_dataset.str",
+                      TFRT_KERNEL(MakeCacheDataset<std::string>));
+  registry->AddKernel("tfrt_data.cache_dataset.tensor",
+                      TFRT_KERNEL(MakeCacheDataset<DenseHostTensor>));
+  registry->AddKernel("tfrt_data.cache_dataset.tensor_and_i64",
+                      TFRT_KERNEL(MakeCacheDataset<DenseHostTensor, int64_t>));
+
   registry->AddKernel("tfrt_data.filter_dataset",
                       TFRT_KERNEL(MakeFilterDataset));
   registry->AddKernel("tfrt_data.interleave_dataset",
                       TFRT_KERNEL(MakeInterleaveDataset));
   registry->AddKernel("tfrt_data.map_dataset", TFRT_KERNEL(MakeMapDataset));
+  registry->AddKernel("tfrt_data.parallel_map_dataset",
+                      TFRT_KERNEL(MakeParallelMapDataset));
   registry->AddKernel("tfrt_data.prefetch_dataset",
                       TFRT_KERNEL(MakePrefetchDataset));
   registry->AddKernel("tfrt_data.repeat_dataset",
@@ -508,9 +590,14 @@ void RegisterDataKernels(KernelRegistry* registry) {
   registry->AddKernel("tfrt_data.skip_dataset", TFRT_KERNEL(MakeSkipDataset));
   registry->AddKernel("tfrt_data.tf_record_dataset",
                       TFRT_KERNEL(MakeTFRecordDataset));
+  registry->AddKernel("tfrt_data.mapped_tf_record_dataset",
+                      TFRT_KERNEL(MakeMappedTFRecordDataset));
   registry->AddKernel("tfrt_data.shuffle_dataset",
                       TFRT_KERNEL(MakeShuffleDataset));
   registry->AddKernel("tfrt_data.log_dataset", TFRT_KERNEL(MakeLogDataset));
+
+  registry->AddKernel("tfrt_data.print_autotune_stats",
+                      TFRT_KERNEL(PrintAutotuneStats));
 }
 
 }  // namespace data
@@ -23,6 +23,9 @@
 
 #include "io.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "tfrt/host_context/async_dispatch.h"
 #include "tfrt/tracing/tracing.h"
 
@@ -34,14 +37,26 @@ IterationResult PrefetchingIterator::GetNext(const ExecutionContext& exec_ctx) {
   auto* host = exec_ctx.host();
   {
     mutex_lock lock(mu_);
+    // The time since the previous call measures the consumer rate only if the
+    // previous call returned a value that was ready. Otherwise it includes the
+    // time the consumer waited for this iterator.
+    const auto now = Clock::now();
+    if (autotune_ && last_get_next_time_ != Clock::time_point()) {
+      UpdateAverage(std::chrono::duration<double>(now - last_get_next_time_)
+                        .count(),
+                    &consumer_interval_);
+    }
+    last_get_next_time_ = Clock::time_point();
+
     // Schedule a blocking thread to fetch data if the number of prefetched
-    // values has dropped below the threshold.
+    // values has dropped below the threshold and the memory budget allows it.
     if (!token_owned_ && !reached_eof_ &&
         prefetch_buffer_.size() <
-            prefetch_threshold_ + output_buffer_.size() + 1) {
-      auto task = [iterator = FormRef(this), exec_ctx]() {
+            GetPrefetchThreshold() + output_buffer_.size() + 1 &&
+        !IsOverMemoryBudget()) {
+      auto task = [iterator = FormRef(this), exec_ctx, enqueue_time = now]() {
         TFRT_TRACE_SCOPE(Default, "ReadIOSource");
-        iterator->ReadIOSource(exec_ctx);
+        iterator->ReadIOSource(exec_ctx, enqueue_time);
       };
       // This call can fail if the work queue is full.
       if (EnqueueBlockingWork(exec_ctx, std::move(task))) {
@@ -50,6 +65,10 @@ IterationResult PrefetchingIterator::GetNext(const ExecutionContext& exec_ctx) {
         token_owned_ = true;
       }
     }
+    const bool ready = !prefetch_buffer_.empty() && output_buffer_.empty();
+    prefetch_num_parameter_.set_value(GetPrefetchNum());
+    prefetch_num_parameter_.RecordGetNext(ready, /*over_provisioned=*/false);
+
     // Optimize the fast path. Return the first value from prefetched buffer if
     // there is no other pending output value and there is prefetched value
     // available.
@@ -59,9 +78,9 @@ IterationResult PrefetchingIterator::GetNext(const ExecutionContext& exec_ctx) {
     // values from the prefetch_buffer to another buffer that can only be
     // accessed by the caller of GetNext(), so that the GetNext() can return
     // value from this buffer directly if it is non-empty.
-    if (!prefetch_buffer_.empty() && output_buffer_.empty()) {
-      auto input = std::move(prefetch_buffer_.front());
-      prefetch_buffer_.pop();
+    if (ready) {
+      last_get_next_time_ = now;
+      auto input = PopPrefetchBuffer();
       // An IterationResult from GetNextElement() should only contain available
       // AsyncValues.
       assert(input.eof.IsAvailable());
@@ -74,11 +93,11 @@ IterationResult PrefetchingIterator::GetNext(const ExecutionContext& exec_ctx) {
     }
   }
 
-  llvm::SmallVector<RCReference<AsyncValue>, 1> result_values;
-  result_values.resize(1);
-  // The IndirectAsyncValue might be filled later by the background blocking
+  llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
+  // The IndirectAsyncValues might be filled later by the background blocking
   // thread.
-  result_values[0] = MakeIndirectAsyncValue(host);
+  for (size_t i = 0; i < num_values_; ++i)
+    result_values.push_back(MakeIndirectAsyncValue(host));
   auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
   auto result =
       IterationResult::Pending(std::move(result_values), std::move(result_eof));
@@ -98,7 +117,8 @@ IterationResult PrefetchingIterator::GetNext(const ExecutionContext& exec_ctx) {
       // Read the next element from IO source directly so that
       // output_buffer_size == prefetch_buffer_size.
       auto input = GetNextElement(exec_ctx);
-      prefetch_buffer_.push(std::move(input));
+      const size_t size = GetElementSize(input);
+      PushPrefetchBuffer(std::move(input), size);
     }
   }
 
@@ -106,7 +126,14 @@ IterationResult PrefetchingIterator::GetNext(const ExecutionContext& exec_ctx) {
   return result;
 }
 
-void PrefetchingIterator::ReadIOSource(const ExecutionContext& exec_ctx) {
+void PrefetchingIterator::ReadIOSource(const ExecutionContext& exec_ctx,
+                                       Clock::time_point enqueue_time) {
+  if (autotune_) {
+    const double scheduling_latency =
+        std::chrono::duration<double>(Clock::now() - enqueue_time).count();
+    mutex_lock lock(mu_);
+    UpdateAverage(scheduling_latency, &scheduling_latency_);
+  }
   while (true) {
     int64_t fetch_num;
     {
@@ -115,29 +142,43 @@ void PrefetchingIterator::ReadIOSource(const ExecutionContext& exec_ctx) {
       // The caller is the token owner, there are enough prefetched values and
       // there is no output value to update. Release the token and return.
       if (output_buffer_.empty() &&
-          (prefetch_buffer_.size() >= prefetch_threshold_ || reached_eof_)) {
+          (prefetch_buffer_.size() >= GetPrefetchThreshold() || reached_eof_ ||
+           IsOverMemoryBudget())) {
         token_owned_ = false;
         return;
       }
+      // The autotuned prefetch number may have dropped below the number of
+      // prefetched values, in which case only outputs are materialized.
       fetch_num =
-          max_prefetch_num_ + output_buffer_.size() - prefetch_buffer_.size();
+          static_cast<int64_t>(GetPrefetchNum() + output_buffer_.size()) -
+          static_cast<int64_t>(prefetch_buffer_.size());
     }
-    for (int32_t i = 0; i < fetch_num; ++i) {
+    for (int64_t i = 0; i < fetch_num; ++i) {
       if (exec_ctx.IsCancelled()) return;
       // Since only one thread can own the token, we can access the underlying
       // IO source without a lock.
+      const auto start_time = Clock::now();
       auto input = GetNextElement(exec_ctx);
+      const double latency =
+          std::chrono::duration<double>(Clock::now() - start_time).count();
       if (input.eof.IsConcrete() && input.eof.get()) {
         mutex_lock lock(mu_);
         reached_eof_ = true;
         break;
       }
+      const size_t size = GetElementSize(input);
       bool need_to_materialize_output = false;
+      bool over_memory_budget = false;
       {
         mutex_lock lock(mu_);
+        if (autotune_) UpdateAverage(latency, &producer_latency_);
         need_to_materialize_output =
             prefetch_buffer_.empty() && !output_buffer_.empty();
-        prefetch_buffer_.push(std::move(input));
+        PushPrefetchBuffer(std::move(input), size);
+        // Keep reading values that are already requested by the consumer, but
+        // do not read further ahead once the memory budget is used up.
+        over_memory_budget = output_buffer_.size() < prefetch_buffer_.size() &&
+                             IsOverMemoryBudget();
       }
       // If prefetch_buffer was empty and output_buffer is not empty, it is
       // possible that data pipeline's control flow is blocked waiting for the
@@ -150,11 +191,57 @@ void PrefetchingIterator::ReadIOSource(const ExecutionContext& exec_ctx) {
       // the current iterator's output and it is preferred to let the control
       // flow thread update values in the output_buffer.
       if (need_to_materialize_output) MaterializeOutputs(exec_ctx);
+      if (over_memory_budget) break;
     }
     MaterializeOutputs(exec_ctx);
   }
 }
 
+void PrefetchingIterator::PushPrefetchBuffer(IterationResult element,
+                                             size_t size) {
+  prefetch_buffer_.push(PrefetchedElement{std::move(element), size});
+  prefetch_bytes_ += size;
+  budget_.Charge(size);
+}
+
+IterationResult PrefetchingIterator::PopPrefetchBuffer() {
+  auto& front = prefetch_buffer_.front();
+  auto result = std::move(front.result);
+  prefetch_bytes_ -= front.size;
+  budget_.Release(front.size);
+  prefetch_buffer_.pop();
+  return result;
+}
+
+bool PrefetchingIterator::IsOverMemoryBudget() const {
+  if (prefetch_buffer_.empty()) return false;
+  if (max_prefetch_bytes_ > 0 && prefetch_bytes_ >= max_prefetch_bytes_)
+    return true;
+  return budget_.IsExhausted();
+}
+
+size_t PrefetchingIterator::GetPrefetchThreshold() const {
+  if (!autotune_ || consumer_interval_ == 0) return prefetch_threshold_;
+  // The number of values the consumer takes while a blocking task is scheduled
+  // and reads the first value, plus one to absorb jitter.
+  const double refill_num =
+      std::ceil((scheduling_latency_ + producer_latency_) /
+                consumer_interval_) +
+      1;
+  return std::min<double>(prefetch_threshold_, refill_num);
+}
+
+size_t PrefetchingIterator::GetPrefetchNum() const {
+  if (!autotune_ || consumer_interval_ == 0 || prefetch_threshold_ == 0)
+    return max_prefetch_num_;
+  // Scale max_prefetch_num_ by the same factor as the threshold, so that every
+  // blocking task still reads a proportional batch of values.
+  const size_t prefetch_num =
+      (GetPrefetchThreshold() * max_prefetch_num_ + prefetch_threshold_ - 1) /
+      prefetch_threshold_;
+  return std::max<size_t>(prefetch_num, 1);
+}
+
 void PrefetchingIterator::ForwardInputToOutput(
     IterationResult input, IterationResult output,
     const ExecutionContext& exec_ctx) {
@@ -188,9 +275,8 @@ void PrefetchingIterator::MaterializeOutputs(const ExecutionContext& exec_ctx) {
     {
       mutex_lock lock(mu_);
       while (!prefetch_buffer_.empty() && !output_buffer_.empty()) {
-        auto input = std::move(prefetch_buffer_.front());
+        auto input = PopPrefetchBuffer();
         auto output = std::move(output_buffer_.front());
-        prefetch_buffer_.pop();
         output_buffer_.pop();
         pairs.push_back(std::make_pair(std::move(input), std::move(output)));
       }
@@ -207,7 +293,8 @@ void PrefetchingIterator::MaterializeOutputs(const ExecutionContext& exec_ctx) {
     pairs.clear();
   }
   if (reached_eof && prefetch_buffer_size == 0) {
-    IterationResult eof_result = IterationResult::Eof(exec_ctx.host(), 1);
+    IterationResult eof_result =
+        IterationResult::Eof(exec_ctx.host(), num_values_);
     while (auto output = DequeueOutputBuffer()) {
       ForwardInputToOutput(eof_result.CopyRef(), std::move(output.getValue()),
                            exec_ctx);
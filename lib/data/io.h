@@ -24,11 +24,15 @@
 #define TFRT_LIB_DATA_IO_H_
 
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <queue>
 
+#include "autotuner.h"
 #include "tfrt/data/dataset.h"
 #include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/shared_context.h"
 #include "tfrt/support/forward_decls.h"
 #include "tfrt/support/mutex.h"
 #include "tfrt/support/ref_count.h"
@@ -38,6 +42,43 @@ namespace tfrt {
 namespace data {
 namespace io {
 
+// Memory budget shared by all prefetching iterators of a HostContext. Each
+// iterator charges the bytes held in its prefetch buffer against the budget and
+// stops prefetching ahead of the consumer while the budget is exhausted.
+//
+// The budget is soft: an iterator with an empty prefetch buffer may always read
+// one element, and elements already requested by GetNext() are always read, so
+// an exhausted budget slows iterators down but never deadlocks them.
+class PrefetchMemoryBudget : public SharedContext {
+ public:
+  static constexpr int64_t kDefaultLimit = 1024 * 1024 * 1024;
+
+  explicit PrefetchMemoryBudget(HostContext* host) {}
+
+  // Sets the maximum number of bytes that all prefetching iterators of the
+  // HostContext may hold ahead of their consumers.
+  void SetLimit(int64_t limit) {
+    limit_.store(limit, std::memory_order_relaxed);
+  }
+  int64_t GetLimit() const { return limit_.load(std::memory_order_relaxed); }
+
+  // Returns the number of bytes currently held by all prefetching iterators.
+  int64_t GetUsage() const { return usage_.load(std::memory_order_relaxed); }
+
+  bool IsExhausted() const { return GetUsage() >= GetLimit(); }
+
+  void Charge(int64_t bytes) {
+    usage_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  void Release(int64_t bytes) {
+    usage_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> limit_{kDefaultLimit};
+  std::atomic<int64_t> usage_{0};
+};
+
 // The goal of a prefetching iterator is to move all slow and potentially
 // blocking IO operations out of the Iterator::GetNext() execution path.
 //
@@ -57,18 +98,45 @@ namespace io {
 // This is an internal implementation detail, and it is not exposed to the end
 // user as a dataset type.
 //
-// TODO(ezhulenev): Add flexible prefetching policy based not only on the number
-// of prefetched records, but also on the memory consumption.
+// Prefetching policy: the iterator prefetches up to max_prefetch_num elements
+// and refills the buffer once it holds fewer than prefetch_threshold elements.
+// In addition, it stops prefetching once the buffered elements take
+// max_prefetch_bytes (if positive), or once the PrefetchMemoryBudget of the
+// HostContext is exhausted. Element sizes are reported by the derived iterator
+// via GetElementSize().
+//
+// If autotune is true, the element counts above are upper bounds, and the
+// iterator prefetches just enough elements to hide the observed producer
+// latency from the observed consumer rate. Fast consumers of slow IO sources
+// get deep buffers, and slow consumers do not pin memory they will not need
+// soon.
+//
+// Every element has num_values values.
 class PrefetchingIterator : public Iterator {
  public:
   explicit PrefetchingIterator(int64_t max_prefetch_num,
                                int64_t prefetch_threshold,
-                               const IteratorContext& context)
+                               int64_t max_prefetch_bytes, bool autotune,
+                               HostContext* host,
+                               const IteratorContext& context,
+                               size_t num_values = 1)
       : Iterator(),
+        num_values_(num_values),
         max_prefetch_num_(max_prefetch_num),
         prefetch_threshold_(prefetch_threshold),
+        max_prefetch_bytes_(max_prefetch_bytes),
+        autotune_(autotune),
+        budget_(host->GetOrCreateSharedContext<PrefetchMemoryBudget>()),
+        prefetch_num_parameter_("io_prefetch.prefetch_num",
+                                TunableParameter::Kind::kBufferSize,
+                                /*min=*/0, max_prefetch_num, max_prefetch_num,
+                                /*autotune=*/false, host),
         token_owned_(false),
-        reached_eof_(false) {}
+        reached_eof_(false) {
+    assert(prefetch_threshold_ <= max_prefetch_num_);
+  }
+
+  ~PrefetchingIterator() override { budget_.Release(prefetch_bytes_); }
 
   // Gets the next element from a prefetch buffer, and may be enqueue an
   // asynchronous blocking task to fill up the buffer. If the prefetch buffer is
@@ -93,10 +161,48 @@ class PrefetchingIterator : public Iterator {
   // forwards the error to an output value.
   virtual IterationResult GetNextElement(const ExecutionContext& exec_cxt) = 0;
 
+  // Returns the number of bytes held by an element returned from
+  // GetNextElement(). The default counts only elements, so only the count based
+  // limits apply.
+  virtual size_t GetElementSize(const IterationResult& element) const {
+    return 0;
+  }
+
  private:
+  using Clock = std::chrono::steady_clock;
+
+  // An element returned from GetNextElement() together with its size.
+  struct PrefetchedElement {
+    IterationResult result;
+    size_t size;
+  };
+
+  // Adds the element to the back of prefetch_buffer_.
+  void PushPrefetchBuffer(IterationResult element, size_t size)
+      TFRT_REQUIRES(mu_);
+  // Removes the element at the front of prefetch_buffer_.
+  IterationResult PopPrefetchBuffer() TFRT_REQUIRES(mu_);
+
+  // Returns true if the prefetched elements use up the memory budget of this
+  // iterator or the global one. Never true if prefetch_buffer_ is empty.
+  bool IsOverMemoryBudget() const TFRT_REQUIRES(mu_);
+
+  // The number of prefetched elements to read ahead of the consumer, and the
+  // number below which the buffer is refilled, after autotuning.
+  size_t GetPrefetchNum() const TFRT_REQUIRES(mu_);
+  size_t GetPrefetchThreshold() const TFRT_REQUIRES(mu_);
+
+  // Updates the exponential moving average with a new sample.
+  static void UpdateAverage(double sample, double* average) {
+    *average = *average == 0 ? sample : *average + (sample - *average) / 8;
+  }
+
   // Read data from IO source if there is more data to fetch. And it forwards
   // values from the prefetch_buffer_ to those values in the output_buffer_.
-  void ReadIOSource(const ExecutionContext& exec_ctx) TFRT_EXCLUDES(mu_);
+  // enqueue_time is the time when the blocking task calling this method was
+  // enqueued.
+  void ReadIOSource(const ExecutionContext& exec_ctx,
+                    Clock::time_point enqueue_time) TFRT_EXCLUDES(mu_);
 
   // Forward eof and values from the given input to the given output.
   void ForwardInputToOutput(IterationResult input, IterationResult output,
@@ -116,11 +222,15 @@ class PrefetchingIterator : public Iterator {
 
   mutex mu_;
   // A queue of IterationResult returned by GetNextElement(...).
-  std::queue<IterationResult> prefetch_buffer_ TFRT_GUARDED_BY(mu_);
+  std::queue<PrefetchedElement> prefetch_buffer_ TFRT_GUARDED_BY(mu_);
+  // Total size of the elements in prefetch_buffer_.
+  size_t prefetch_bytes_ TFRT_GUARDED_BY(mu_) = 0;
   // A queue of IterationResult that have already been returned to the
   // GetNext(...) caller.
   std::queue<IterationResult> output_buffer_ TFRT_GUARDED_BY(mu_);
 
+  // Number of values of every element.
+  const size_t num_values_;
   // Maximum number of values to prefetch from the underlying IO source
   // in addition to meeting the number of output values already requested in the
   // output_buffer_. The total number of values in the queues of the open
@@ -129,6 +239,24 @@ class PrefetchingIterator : public Iterator {
   // Schedule background blocking thread to prefetch from the underlying IO
   // source if the number of prefetched values dropped below this threadhold.
   const size_t prefetch_threshold_;
+  // Maximum number of bytes to prefetch, or 0 for no per-iterator limit.
+  const size_t max_prefetch_bytes_;
+  // Whether to adjust the number of prefetched values to the observed consumer
+  // rate and producer latency.
+  const bool autotune_;
+  PrefetchMemoryBudget& budget_;
+  // Reports the prefetch number and GetNext() statistics to the Autotuner. The
+  // prefetch number is tuned by the iterator itself as it depends on the IO
+  // latency.
+  TunableParameter prefetch_num_parameter_;
+
+  // Moving averages of the time between GetNext() calls, the time to read an
+  // element from the IO source, and the time it takes a blocking task to start
+  // after it is enqueued, in seconds.
+  Clock::time_point last_get_next_time_ TFRT_GUARDED_BY(mu_);
+  double consumer_interval_ TFRT_GUARDED_BY(mu_) = 0;
+  double producer_latency_ TFRT_GUARDED_BY(mu_) = 0;
+  double scheduling_latency_ TFRT_GUARDED_BY(mu_) = 0;
 
   // This is a unique logical token for this iterator instance. It effectively
   // acts as a lock to ensure in-order delivery of results by guaranteeing that
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- parallel_map_dataset.cc ----------------------------------*- C++ -*-===//
+//
+// This file implements ParallelMapDataset class which wraps around another
+// Dataset instance and transforms its elements by invoking the map function
+// concurrently on the HostContext work queue.
+//
+//===----------------------------------------------------------------------===//
+
+#include "parallel_map_dataset.h"
+
+#include <iterator>
+
+#include "tfrt/host_context/async_dispatch.h"
+
+namespace tfrt {
+namespace data {
+
+// Run `function` as a separate task on the work queue once all `arguments` and
+// `eof` are available, and return IndirectAsyncValues that are forwarded to the
+// function results. Unlike RunFunctionWhenReady, the function never runs inline
+// in the caller thread, so that invocations on different elements run
+// concurrently. The function does not run at all if `eof` resolves to true or
+// to an error, and the results are set to the end of iteration or the error.
+static SmallVector<RCReference<AsyncValue>, 4> EnqueueFunctionWhenReady(
+    RCReference<const Function> function,
+    SmallVector<RCReference<AsyncValue>, 4> arguments, AsyncValueRef<bool> eof,
+    const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  auto num_results = function->result_types().size();
+
+  SmallVector<RCReference<IndirectAsyncValue>, 4> results;
+  SmallVector<RCReference<AsyncValue>, 4> results_copy;
+  results.resize(num_results);
+  results_copy.resize(num_results);
+  for (size_t i = 0; i < num_results; ++i) {
+    results[i] = MakeIndirectAsyncValue(host);
+    results_copy[i] = results[i].CopyRef();
+  }
+
+  SmallVector<AsyncValue*, 4> argument_ptrs;
+  for (const auto& argument : arguments)
+    argument_ptrs.push_back(argument.get());
+  argument_ptrs.push_back(eof.GetAsyncValue());
+
+  RunWhenReady(argument_ptrs, [function = std::move(function),
+                               arguments = std::move(arguments),
+                               eof = std::move(eof),
+                               results = std::move(results),
+                               exec_ctx]() mutable {
+    if (eof.IsError()) {
+      for (auto& result : results) result->ForwardTo(eof.CopyRCRef());
+      return;
+    }
+    if (eof.get()) {
+      auto end = IterationResult::Eof(exec_ctx.host(), results.size());
+      for (size_t i = 0, e = results.size(); i < e; ++i) {
+        results[i]->ForwardTo(std::move(end.values[i]));
+      }
+      return;
+    }
+    EnqueueWork(exec_ctx, [function = std::move(function),
+                           arguments = std::move(arguments),
+                           results = std::move(results), exec_ctx]() {
+      SmallVector<AsyncValue*, 4> argument_ptrs;
+      for (const auto& argument : arguments)
+        argument_ptrs.push_back(argument.get());
+      SmallVector<RCReference<AsyncValue>, 4> fn_results;
+      fn_results.resize(results.size());
+      function->Execute(exec_ctx, argument_ptrs, fn_results);
+      for (size_t i = 0, e = results.size(); i < e; ++i) {
+        results[i]->ForwardTo(std::move(fn_results[i]));
+      }
+    });
+  });
+
+  return results_copy;
+}
+
+static bool IsAvailable(const IterationResult& result) {
+  if (!result.eof.IsAvailable()) return false;
+  for (auto& value : result.values) {
+    if (!value->IsAvailable()) return false;
+  }
+  return true;
+}
+
+static bool AvailableAndNotEof(const IterationResult& result) {
+  if (!result.eof.IsConcrete() || result.eof.get()) return false;
+  for (auto& value : result.values) {
+    if (!value->IsAvailable()) return false;
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// ParallelMapDataset methods
+//===----------------------------------------------------------------------===//
+RCReference<Iterator> ParallelMapDataset::MakeIterator(
+    const IteratorContext& context) {
+  return TakeRef(
+      host_->Construct<ParallelMapDatasetIterator>(FormRef(this), context));
+}
+
+//===----------------------------------------------------------------------===//
+// ParallelMapDatasetIterator methods
+//===----------------------------------------------------------------------===//
+IterationResult ParallelMapDatasetIterator::MapNextElement(
+    const ExecutionContext& exec_ctx) {
+  auto input = input_iterator_->GetNext(exec_ctx);
+  // Do not enqueue the map function on the end of iteration.
+  if (input.eof.IsConcrete() && input.eof.get()) {
+    input_exhausted_ = true;
+    return IterationResult::Eof(exec_ctx.host(),
+                                parent_dataset_->map_fn_->num_results());
+  }
+
+  SmallVector<RCReference<AsyncValue>, 4> arguments;
+  for (auto* value : parent_dataset_->additional_fn_args_.values())
+    arguments.push_back(FormRef(value));
+  for (auto& value : input.values) arguments.push_back(std::move(value));
+  // The end of iteration may not be known yet, in which case the map function
+  // invocation waits for it and is skipped if the input is exhausted.
+  auto result = EnqueueFunctionWhenReady(parent_dataset_->map_fn_.CopyRef(),
+                                         std::move(arguments),
+                                         input.eof.CopyRef(), exec_ctx);
+  return IterationResult::Pending(std::move(result), std::move(input.eof));
+}
+
+IterationResult ParallelMapDatasetIterator::GetNext(
+    const ExecutionContext& exec_ctx) {
+  // Stop fetching input elements once the end of iteration of a buffered
+  // element has resolved, and drop the elements fetched after it.
+  if (!input_exhausted_) {
+    for (auto it = buffer_.begin(), e = buffer_.end(); it != e; ++it) {
+      if (it->eof.IsConcrete() && it->eof.get()) {
+        input_exhausted_ = true;
+        buffer_.erase(std::next(it), e);
+        break;
+      }
+    }
+  }
+
+  // Keep num_parallel_calls map function invocations in flight.
+  while (!input_exhausted_ && buffer_.size() < num_parallel_calls_.value()) {
+    buffer_.push_back(MapNextElement(exec_ctx));
+  }
+
+  // More invocations are in flight than needed if the one halfway through the
+  // buffer has already completed.
+  const bool over_provisioned = IsAvailable(buffer_[buffer_.size() / 2]);
+
+  if (!parent_dataset_->is_deterministic_) {
+    for (auto it = buffer_.begin(), e = buffer_.end(); it != e; ++it) {
+      if (AvailableAndNotEof(*it)) {
+        num_parallel_calls_.RecordGetNext(/*ready=*/true, over_provisioned);
+        auto result = std::move(*it);
+        buffer_.erase(it);
+        return result;
+      }
+    }
+  }
+
+  num_parallel_calls_.RecordGetNext(IsAvailable(buffer_.front()),
+                                    over_provisioned);
+  auto result = std::move(buffer_.front());
+  buffer_.pop_front();
+  // The end of iteration is the last buffered element once the input is
+  // exhausted. Keep returning it from now on.
+  if (input_exhausted_ && buffer_.empty()) buffer_.push_back(result.CopyRef());
+  return result;
+}
+
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- parallel_map_dataset.h -----------------------------------*- C++ -*-===//
+//
+// This file declares ParallelMapDataset class which wraps around another
+// Dataset instance and transforms its elements by invoking the map function
+// concurrently on the HostContext work queue.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_LIB_DATA_PARALLEL_MAP_DATASET_H_
+#define TFRT_LIB_DATA_PARALLEL_MAP_DATASET_H_
+
+#include <deque>
+
+#include "autotuner.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/function.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+
+class ParallelMapDatasetIterator;
+
+// ParallelMapDataset maps a user-defined function over the elements in its
+// input dataset. Unlike MapDataset, which runs the function inline in the
+// thread that calls GetNext or resolves the inputs, it keeps up to
+// `num_parallel_calls` invocations of the function in flight, each of them
+// running as a separate task on the HostContext work queue.
+//
+// If num_parallel_calls is kAutotune, each iterator starts with one invocation
+// in flight and the Autotuner adjusts the number of invocations up to the
+// number of worker threads.
+class ParallelMapDataset : public Dataset {
+ public:
+  explicit ParallelMapDataset(RCReference<Dataset> input_dataset,
+                              int64_t num_parallel_calls, bool is_deterministic,
+                              RCArray<AsyncValue> additional_fn_args,
+                              RCReference<const Function> map_fn,
+                              HostContext* host)
+      : input_dataset_(std::move(input_dataset)),
+        num_parallel_calls_(num_parallel_calls),
+        is_deterministic_(is_deterministic),
+        host_(host),
+        allocator_(host->allocator()),
+        additional_fn_args_(std::move(additional_fn_args)),
+        map_fn_(std::move(map_fn)) {
+    assert(num_parallel_calls_ > 0 || num_parallel_calls_ == kAutotune);
+  }
+
+  // This class is not copyable or movable.
+  ParallelMapDataset(const ParallelMapDataset&) = delete;
+  ParallelMapDataset& operator=(const ParallelMapDataset&) = delete;
+
+  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+
+ private:
+  // Allow iterator to rely on private data members of this dataset.
+  friend class ParallelMapDatasetIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<ParallelMapDataset>(this, allocator_);
+  }
+
+  // Bounds and initial value of the number of parallel calls of a new
+  // iterator. Iterators construct their TunableParameter in place from these,
+  // since the parameter registers its own address with the Autotuner.
+  bool autotune_num_parallel_calls() const {
+    return num_parallel_calls_ == kAutotune;
+  }
+  int64_t min_num_parallel_calls() const {
+    return autotune_num_parallel_calls() ? 1 : num_parallel_calls_;
+  }
+  int64_t max_num_parallel_calls() const {
+    return autotune_num_parallel_calls() ? host_->GetNumWorkerThreads()
+                                         : num_parallel_calls_;
+  }
+  int64_t initial_num_parallel_calls() const {
+    return min_num_parallel_calls();
+  }
+
+  RCReference<Dataset> input_dataset_;
+  const int64_t num_parallel_calls_;
+  // If this is set to true, the dataset returns values in the order of the
+  // input elements. Otherwise, it might return the values of a later input
+  // element first if its map function invocation finished earlier.
+  const bool is_deterministic_;
+  HostContext* host_;
+  HostAllocator* allocator_;
+  RCArray<AsyncValue> additional_fn_args_;
+  RCReference<const Function> map_fn_;
+};
+
+class ParallelMapDatasetIterator : public Iterator {
+ public:
+  explicit ParallelMapDatasetIterator(
+      RCReference<ParallelMapDataset> parent_dataset,
+      const IteratorContext& context)
+      : Iterator(),
+        parent_dataset_(std::move(parent_dataset)),
+        input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+        num_parallel_calls_("parallel_map_dataset.num_parallel_calls",
+                            TunableParameter::Kind::kParallelism,
+                            parent_dataset_->min_num_parallel_calls(),
+                            parent_dataset_->max_num_parallel_calls(),
+                            parent_dataset_->initial_num_parallel_calls(),
+                            parent_dataset_->autotune_num_parallel_calls(),
+                            parent_dataset_->host_) {}
+
+  // This class is not copyable or movable.
+  ParallelMapDatasetIterator(const ParallelMapDatasetIterator&) = delete;
+  ParallelMapDatasetIterator& operator=(const ParallelMapDatasetIterator&) =
+      delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<ParallelMapDatasetIterator>(
+        this, parent_dataset_->allocator_);
+  }
+
+  // Fetch the next input element and enqueue the map function invocation on
+  // it once the element and its end of iteration are available.
+  IterationResult MapNextElement(const ExecutionContext& exec_ctx);
+
+  RCReference<ParallelMapDataset> parent_dataset_;
+  RCReference<Iterator> input_iterator_;
+  TunableParameter num_parallel_calls_;
+  // Results of the in-flight map function invocations, in input order.
+  std::deque<IterationResult> buffer_;
+  // Set when the input iterator is known to have reached the end, so that no
+  // more input elements are fetched. The end of iteration of an input element
+  // may resolve asynchronously, in which case this is set by a later GetNext.
+  bool input_exhausted_ = false;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_PARALLEL_MAP_DATASET_H_
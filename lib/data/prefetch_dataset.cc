@@ -41,13 +41,25 @@ RCReference<Iterator> PrefetchDataset::MakeIterator(
 //===----------------------------------------------------------------------===//
 // PrefetchDatasetIterator methods
 //===----------------------------------------------------------------------===//
+static bool IsAvailable(const IterationResult& result) {
+  if (!result.eof.IsAvailable()) return false;
+  for (auto& value : result.values) {
+    if (!value->IsAvailable()) return false;
+  }
+  return true;
+}
+
 IterationResult PrefetchDatasetIterator::GetNext(
     const ExecutionContext& exec_ctx) {
-  while (buffer_.size() < parent_dataset_->prefetch_num_ + 1) {
-    buffer_.push(input_iterator_->GetNext(exec_ctx));
+  while (buffer_.size() < prefetch_num_.value() + 1) {
+    buffer_.push_back(input_iterator_->GetNext(exec_ctx));
   }
+  // The buffer is larger than needed if the value halfway through it is
+  // already available.
+  prefetch_num_.RecordGetNext(IsAvailable(buffer_.front()),
+                              IsAvailable(buffer_[buffer_.size() / 2]));
   auto result = std::move(buffer_.front());
-  buffer_.pop();
+  buffer_.pop_front();
   return result;
 }
 
@@ -66,15 +78,24 @@ static bool AvailableAndNotEof(const IterationResult& result) {
 
 IterationResult NonDeterministicPrefetchDatasetIterator::GetNext(
     const ExecutionContext& exec_ctx) {
-  while (buffer_.size() < parent_dataset_->prefetch_num_ + 1) {
+  while (buffer_.size() < prefetch_num_.value() + 1) {
     buffer_.push_back(input_iterator_->GetNext(exec_ctx));
   }
+  // The buffer is larger than needed if at least half of it is available.
+  size_t num_available = 0;
+  auto first_available = buffer_.end();
   for (auto it = buffer_.begin(), e = buffer_.end(); it != e; ++it) {
-    if (AvailableAndNotEof(*it)) {
-      auto value = std::move(*it);
-      buffer_.erase(it);
-      return value;
-    }
+    if (!AvailableAndNotEof(*it)) continue;
+    if (num_available++ == 0) first_available = it;
+    if (2 * num_available >= buffer_.size()) break;
+  }
+  prefetch_num_.RecordGetNext(first_available != buffer_.end(),
+                              2 * num_available >= buffer_.size());
+
+  if (first_available != buffer_.end()) {
+    auto value = std::move(*first_available);
+    buffer_.erase(first_available);
+    return value;
   }
 
   auto result = std::move(buffer_.front());
@@ -25,9 +25,10 @@
 #ifndef TFRT_LIB_DATA_PREFETCH_DATASET_H_
 #define TFRT_LIB_DATA_PREFETCH_DATASET_H_
 
+#include <deque>
 #include <list>
-#include <queue>
 
+#include "autotuner.h"
 #include "tfrt/data/dataset.h"
 #include "tfrt/support/forward_decls.h"
 
@@ -38,8 +39,14 @@ class PrefetchDatasetIterator;
 
 // PrefetchDataset class which wraps around another dataset instance and
 // prefetches elements from the underlying dataset in an internal buffer.
+//
+// If prefetch_num is kAutotune, each iterator starts with one element per
+// worker thread and the Autotuner adjusts the number of prefetched elements
+// up to kMaxAutotunedPrefetchNum.
 class PrefetchDataset : public Dataset {
  public:
+  static constexpr int64_t kMaxAutotunedPrefetchNum = 1024;
+
   explicit PrefetchDataset(RCReference<Dataset> input_dataset,
                            int64_t prefetch_num, bool is_deterministic,
                            HostContext* host)
@@ -63,6 +70,21 @@ class PrefetchDataset : public Dataset {
     internal::DestroyImpl<PrefetchDataset>(this, host_->allocator());
   }
 
+  // Bounds and initial value of the number of prefetched elements of a new
+  // iterator. Iterators construct their TunableParameter in place from these,
+  // since the parameter registers its own address with the Autotuner.
+  bool autotune_prefetch_num() const { return prefetch_num_ == kAutotune; }
+  int64_t min_prefetch_num() const {
+    return autotune_prefetch_num() ? 1 : prefetch_num_;
+  }
+  int64_t max_prefetch_num() const {
+    return autotune_prefetch_num() ? kMaxAutotunedPrefetchNum : prefetch_num_;
+  }
+  int64_t initial_prefetch_num() const {
+    return autotune_prefetch_num() ? host_->GetNumWorkerThreads()
+                                   : prefetch_num_;
+  }
+
   RCReference<Dataset> input_dataset_;
   int64_t prefetch_num_;
   // If this is set to true, the dataset returns values in a deterministic
@@ -79,8 +101,14 @@ class PrefetchDatasetIterator : public Iterator {
                                    const IteratorContext& context)
       : Iterator(),
         parent_dataset_(std::move(parent_dataset)),
-        input_iterator_(
-            parent_dataset_->input_dataset_->MakeIterator(context)) {}
+        input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+        prefetch_num_("prefetch_dataset.prefetch_num",
+                      TunableParameter::Kind::kBufferSize,
+                      parent_dataset_->min_prefetch_num(),
+                      parent_dataset_->max_prefetch_num(),
+                      parent_dataset_->initial_prefetch_num(),
+                      parent_dataset_->autotune_prefetch_num(),
+                      parent_dataset_->host_) {}
 
   // This class is not copyable or movable.
   PrefetchDatasetIterator(const PrefetchDatasetIterator&) = delete;
@@ -96,7 +124,8 @@ class PrefetchDatasetIterator : public Iterator {
 
   RCReference<PrefetchDataset> parent_dataset_;
   RCReference<Iterator> input_iterator_;
-  std::queue<IterationResult> buffer_;
+  TunableParameter prefetch_num_;
+  std::deque<IterationResult> buffer_;
 };
 
 // This iterator might return values in a non-deterministic order.
@@ -107,8 +136,14 @@ class NonDeterministicPrefetchDatasetIterator : public Iterator {
       const IteratorContext& context)
       : Iterator(),
         parent_dataset_(std::move(parent_dataset)),
-        input_iterator_(
-            parent_dataset_->input_dataset_->MakeIterator(context)) {}
+        input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+        prefetch_num_("prefetch_dataset.prefetch_num",
+                      TunableParameter::Kind::kBufferSize,
+                      parent_dataset_->min_prefetch_num(),
+                      parent_dataset_->max_prefetch_num(),
+                      parent_dataset_->initial_prefetch_num(),
+                      parent_dataset_->autotune_prefetch_num(),
+                      parent_dataset_->host_) {}
 
   // This class is not copyable or movable.
   NonDeterministicPrefetchDatasetIterator(const PrefetchDatasetIterator&) =
@@ -126,6 +161,7 @@ class NonDeterministicPrefetchDatasetIterator : public Iterator {
 
   RCReference<PrefetchDataset> parent_dataset_;
   RCReference<Iterator> input_iterator_;
+  TunableParameter prefetch_num_;
   std::list<IterationResult> buffer_;
 };
 
@@ -15,12 +15,14 @@
 //===- tf_record_dataset.cc -----------------------------------------------===//
 //
 // This file implements TFRecordDataset class which reads records from TFRecord
-// files into strings.
+// files into strings, and MappedTFRecordDataset class which returns records as
+// views into a read-only memory mapping of the file.
 //
 //===----------------------------------------------------------------------===//
 
 #include "tf_record_dataset.h"
 
+#include "llvm/Support/FileSystem.h"
 #include "tfrt/io/buffered_input_stream.h"
 #include "tfrt/io/file_input_stream.h"
 #include "tfrt/io/file_system.h"
@@ -71,6 +73,12 @@ IterationResult TFRecordDatasetIterator::GetNextElement(
   return IterationResult::Values(std::move(values), host);
 }
 
+size_t TFRecordDatasetIterator::GetElementSize(
+    const IterationResult& element) const {
+  auto* value = element.values[0].get();
+  return value->IsConcrete() ? value->get<std::string>().size() : 0;
+}
+
 // Logic based on tensorflow/core/io/record_reader.*
 // Note: RecordReader maintains the offset. For now, we're relying on
 // ifstream reading sequentially.
@@ -151,5 +159,143 @@ llvm::Error TFRecordDatasetIterator::MaybeInitializeStream() {
   return llvm::Error::success();
 }
 
+//===----------------------------------------------------------------------===//
+// Implementation for MappedTFRecordDataset member functions
+//===----------------------------------------------------------------------===//
+
+RCReference<Iterator> MappedTFRecordDataset::MakeIterator(
+    const IteratorContext& context) {
+  return TakeRef(
+      host_->Construct<MappedTFRecordDatasetIterator>(FormRef(this), context));
+}
+
+//===----------------------------------------------------------------------===//
+// Implementation for MappedTFRecordDatasetIterator member functions
+//===----------------------------------------------------------------------===//
+IterationResult MappedTFRecordDatasetIterator::GetNextElement(
+    const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  if (auto error = MaybeMapFile()) {
+    auto async_error = MakeErrorAsyncValueRef(host, StrCat(error));
+    return IterationResult::Error(std::move(async_error), 1);
+  }
+
+  bool eof = false;
+  auto result = ReadRecord(&eof);
+
+  if (eof) {
+    return IterationResult::Eof(host, 1);
+  }
+  if (!result) {
+    // Do not decode location or emit error because the local handler might have
+    // been freed.
+    auto error = MakeErrorAsyncValueRef(host, StrCat(result.takeError()));
+    return IterationResult::Error(std::move(error), 1);
+  }
+
+  llvm::SmallVector<RCReference<AsyncValue>, 4> values;
+  values.push_back(MakeAvailableAsyncValueRef<RCReference<HostBuffer>>(
+      host, std::move(*result)));
+  return IterationResult::Values(std::move(values), host);
+}
+
+size_t MappedTFRecordDatasetIterator::GetElementSize(
+    const IterationResult& element) const {
+  auto* value = element.values[0].get();
+  return value->IsConcrete() ? value->get<RCReference<HostBuffer>>()->size()
+                             : 0;
+}
+
+llvm::Error MappedTFRecordDatasetIterator::VerifyChecksummed(size_t pos,
+                                                             size_t offset,
+                                                             size_t n) const {
+  // The crc has size uint32. Compare sizes without overflowing on a corrupted
+  // record length.
+  const size_t available = file_->size() - offset;
+  if (available < sizeof(uint32_t) || available - sizeof(uint32_t) < n) {
+    return MakeStringError("truncated record at position ", pos);
+  }
+
+  const char* data = static_cast<const char*>(file_->data()) + offset;
+  const uint32_t masked_crc = DecodeFixed32(data + n);
+  if (crc32c::Unmask(masked_crc) != crc32c::Value(data, n)) {
+    return MakeStringError("data corruption at position ", pos);
+  }
+  return llvm::Error::success();
+}
+
+llvm::Expected<RCReference<HostBuffer>>
+MappedTFRecordDatasetIterator::ReadRecord(bool* eof) {
+  *eof = false;
+  const size_t pos = offset_;
+  if (!file_ || pos == file_->size()) {
+    *eof = true;
+    return RCReference<HostBuffer>();
+  }
+
+  // The header is the record length followed by its checksum.
+  const size_t header_size = sizeof(uint64_t) + sizeof(uint32_t);
+  auto error = VerifyChecksummed(pos, pos, sizeof(uint64_t));
+  uint64_t length = 0;
+  if (!error) {
+    length = DecodeFixed64(static_cast<const char*>(file_->data()) + pos);
+    error = VerifyChecksummed(pos, pos + header_size, length);
+  }
+  if (error) {
+    // The following records can't be located without a valid header.
+    offset_ = file_->size();
+    return std::move(error);
+  }
+
+  offset_ = pos + header_size + length + sizeof(uint32_t);
+  return HostBuffer::CreateFromExternal(file_.CopyRef(), pos + header_size,
+                                        length);
+}
+
+llvm::Error MappedTFRecordDatasetIterator::MaybeMapFile() {
+  namespace fs = ::llvm::sys::fs;
+
+  if (initialization_error_) {
+    return MakeStringError(initialization_error_);
+  }
+
+  if (file_mapped_) return llvm::Error::success();
+
+  const std::string& path = parent_dataset_->path_;
+  auto fd = fs::openNativeFileForRead(path);
+  if (!fd) {
+    initialization_error_ = MakeStringError("failed to open file ", path, ": ",
+                                            llvm::toString(fd.takeError()));
+    return MakeStringError(initialization_error_);
+  }
+
+  // The mapping stays valid after the file is closed.
+  fs::file_status status;
+  std::error_code ec = fs::status(*fd, status);
+  std::unique_ptr<fs::mapped_file_region> region;
+  if (!ec && status.getSize() > 0) {
+    region = std::make_unique<fs::mapped_file_region>(
+        *fd, fs::mapped_file_region::readonly, status.getSize(),
+        /*offset=*/0, ec);
+  }
+  fs::closeFile(*fd);
+  if (ec) {
+    initialization_error_ =
+        MakeStringError("failed to map file ", path, ": ", ec.message());
+    return MakeStringError(initialization_error_);
+  }
+
+  file_mapped_ = true;
+  // An empty file has no records and can't be mapped.
+  if (!region) return llvm::Error::success();
+
+  void* data = const_cast<char*>(region->const_data());
+  size_t size = region->size();
+  file_ = HostBuffer::CreateFromExternal(
+      data, size,
+      [region = std::move(region)](void*, size_t) mutable { region.reset(); });
+  return llvm::Error::success();
+}
+
 }  // namespace data
 }  // namespace tfrt
@@ -17,7 +17,8 @@
 //===- tf_record_dataset.h --------------------------------------*- C++ -*-===//
 //
 // This file declares TFRecordDataset class which reads records from TFRecord
-// files into strings.
+// files into strings, and MappedTFRecordDataset class which returns records as
+// views into a read-only memory mapping of the file.
 //
 //===----------------------------------------------------------------------===//
 
@@ -26,6 +27,7 @@
 
 #include "io.h"
 #include "tfrt/data/dataset.h"
+#include "tfrt/host_context/host_buffer.h"
 #include "tfrt/io/input_stream.h"
 #include "tfrt/support/forward_decls.h"
 
@@ -35,18 +37,21 @@ namespace data {
 // TFRecordDataset reads TFRecord bytes from a file.
 //
 // TODO(rachelim): Consider using a custom data type to represent the
-// bytes read from a TFRecord file. This will make the code more type safe
-// and allow for future optimizations to use mmap instead of copying bytes
-// from the file onto the heap.
+// bytes read from a TFRecord file. This will make the code more type safe.
+// MappedTFRecordDataset below avoids copying bytes from the file onto the heap
+// for local files.
 class TFRecordDataset : public Dataset {
  public:
   explicit TFRecordDataset(std::string path, int64_t buffer_size,
                            int64_t max_prefetch_num, int64_t prefetch_threshold,
+                           int64_t max_prefetch_bytes, bool autotune,
                            HostContext* host)
       : path_(std::move(path)),
         buffer_size_(buffer_size),
         max_prefetch_num_(max_prefetch_num),
         prefetch_threshold_(prefetch_threshold),
+        max_prefetch_bytes_(max_prefetch_bytes),
+        autotune_(autotune),
         host_(host),
         allocator_(host->allocator()) {
     assert(buffer_size_ >= 0);
@@ -69,6 +74,8 @@ class TFRecordDataset : public Dataset {
   const int64_t buffer_size_;
   const int64_t max_prefetch_num_;
   const int64_t prefetch_threshold_;
+  const int64_t max_prefetch_bytes_;
+  const bool autotune_;
   HostContext* host_;
   HostAllocator* allocator_;
 };
@@ -77,8 +84,11 @@ class TFRecordDatasetIterator : public io::PrefetchingIterator {
  public:
   explicit TFRecordDatasetIterator(RCReference<TFRecordDataset> parent_dataset,
                                    const IteratorContext& context)
-      : io::PrefetchingIterator(parent_dataset->max_prefetch_num_,
-                                parent_dataset->prefetch_threshold_, context),
+      : io::PrefetchingIterator(
+            parent_dataset->max_prefetch_num_,
+            parent_dataset->prefetch_threshold_,
+            parent_dataset->max_prefetch_bytes_, parent_dataset->autotune_,
+            parent_dataset->host_, context),
         parent_dataset_(std::move(parent_dataset)) {}
 
   // This class is not copyable or movable.
@@ -91,6 +101,9 @@ class TFRecordDatasetIterator : public io::PrefetchingIterator {
   // the next record.
   IterationResult GetNextElement(const ExecutionContext& exec_ctx) final;
 
+  // Returns the size of the record in the element.
+  size_t GetElementSize(const IterationResult& element) const final;
+
   llvm::Error MaybeInitializeStream();
 
  private:
@@ -120,6 +133,103 @@ class TFRecordDatasetIterator : public io::PrefetchingIterator {
   llvm::Error initialization_error_ = llvm::Error::success();
 };
 
+// MappedTFRecordDataset reads TFRecords from a local file that is mapped
+// read-only into memory. Every record is returned as a RCReference<HostBuffer>
+// slice of the mapped file, so record headers are parsed and checksums are
+// verified in place, and the record bytes are never copied. The mapping stays
+// alive as long as any of the returned records does.
+class MappedTFRecordDataset : public Dataset {
+ public:
+  explicit MappedTFRecordDataset(std::string path, int64_t max_prefetch_num,
+                                 int64_t prefetch_threshold,
+                                 int64_t max_prefetch_bytes, bool autotune,
+                                 HostContext* host)
+      : path_(std::move(path)),
+        max_prefetch_num_(max_prefetch_num),
+        prefetch_threshold_(prefetch_threshold),
+        max_prefetch_bytes_(max_prefetch_bytes),
+        autotune_(autotune),
+        host_(host),
+        allocator_(host->allocator()) {}
+
+  // This class is not copyable or movable.
+  MappedTFRecordDataset(const MappedTFRecordDataset&) = delete;
+  MappedTFRecordDataset& operator=(const MappedTFRecordDataset&) = delete;
+
+  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+
+ private:
+  friend class MappedTFRecordDatasetIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<MappedTFRecordDataset>(this, allocator_);
+  }
+
+  const std::string path_;
+  const int64_t max_prefetch_num_;
+  const int64_t prefetch_threshold_;
+  const int64_t max_prefetch_bytes_;
+  const bool autotune_;
+  HostContext* host_;
+  HostAllocator* allocator_;
+};
+
+class MappedTFRecordDatasetIterator : public io::PrefetchingIterator {
+ public:
+  explicit MappedTFRecordDatasetIterator(
+      RCReference<MappedTFRecordDataset> parent_dataset,
+      const IteratorContext& context)
+      : io::PrefetchingIterator(
+            parent_dataset->max_prefetch_num_,
+            parent_dataset->prefetch_threshold_,
+            parent_dataset->max_prefetch_bytes_, parent_dataset->autotune_,
+            parent_dataset->host_, context),
+        parent_dataset_(std::move(parent_dataset)) {}
+
+  // This class is not copyable or movable.
+  MappedTFRecordDatasetIterator(const MappedTFRecordDatasetIterator&) = delete;
+  MappedTFRecordDatasetIterator& operator=(
+      const MappedTFRecordDatasetIterator&) = delete;
+
+ protected:
+  // Returns the next record in the mapped file. Returns error async value if
+  // the next record is truncated or corrupted.
+  IterationResult GetNextElement(const ExecutionContext& exec_ctx) final;
+
+  // Returns the size of the record in the element. Records are pages of the
+  // mapped file rather than heap memory, but they are resident once read, so
+  // they are charged against the prefetch memory budget all the same.
+  size_t GetElementSize(const IterationResult& element) const final;
+
+  llvm::Error MaybeMapFile();
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<MappedTFRecordDatasetIterator>(
+        this, parent_dataset_->allocator_);
+  }
+
+  // Verifies that the checksum of the `n` bytes at `offset` in the mapped file
+  // is stored in the 4 bytes that follow them. Returns an error that refers to
+  // the record at `pos` if the file ends before that, or if the checksum
+  // doesn't match.
+  llvm::Error VerifyChecksummed(size_t pos, size_t offset, size_t n) const;
+
+  // Parses the record at offset_ and advances offset_ to the start of the next
+  // record. Updates *eof to true iff offset_ is already at the end of file.
+  // Otherwise, returns a slice of file_ with the record data or an error. After
+  // an error, the iterator is at the end of file.
+  llvm::Expected<RCReference<HostBuffer>> ReadRecord(bool* eof);
+
+  RCReference<MappedTFRecordDataset> parent_dataset_;
+  // The mapped file. It is null before the file is mapped, and for empty files.
+  RCReference<HostBuffer> file_;
+  bool file_mapped_ = false;
+  // Offset of the next record in file_.
+  size_t offset_ = 0;
+  llvm::Error initialization_error_ = llvm::Error::success();
+};
+
 }  // namespace data
 }  // namespace tfrt
 
@@ -37,9 +37,29 @@ namespace tfrt {
 
 Error FunctionCache::Register(const std::string& program_name,
                               BEFBuffer bef_buffer) {
+  BEFStorage storage;
+  storage.bef_buffer = std::move(bef_buffer);
+  return Register(program_name, std::move(storage));
+}
+
+Error FunctionCache::RegisterFromFile(const std::string& program_name,
+                                      string_view bef_path) {
+  auto mapped_bef_file = MappedBEFFile::Open(bef_path);
+  if (!mapped_bef_file) return mapped_bef_file.takeError();
+
+  BEFStorage storage;
+  storage.mapped_bef_file = std::move(*mapped_bef_file);
+  return Register(program_name, std::move(storage));
+}
+
+Error FunctionCache::Register(const std::string& program_name,
+                              BEFStorage storage) {
+  // A registered program is executed through its `program_name` function, so
+  // open it lazily and only decode the functions that are actually called.
   RCReference<BEFFile> bef_file =
-      tfrt::BEFFile::Open(bef_buffer, host_->GetKernelRegistry(),
-                          host_->diag_handler(), host_->allocator());
+      tfrt::BEFFile::Open(storage.data(), host_->GetKernelRegistry(),
+                          host_->diag_handler(), host_->allocator(),
+                          /*lazy=*/true);
 
   if (!bef_file) {
     return llvm::make_error<MalformattedMlirFileErrorInfo>(
@@ -67,7 +87,7 @@ Error FunctionCache::Register(const std::string& program_name,
         StrCat("Program ", program_name, " already registered."));
   }
   auto& cached = cached_bef_[program_name];
-  cached.first = std::move(bef_buffer);
+  cached.first = std::move(storage);
   cached.second.bef_file = bef_file.CopyRef();
   cached.second.require_distributed_context = require_distributed_context;
   cached.second.require_preallocated_outputs = require_preallocated_outputs;
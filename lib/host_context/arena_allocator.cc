@@ -0,0 +1,121 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- arena_allocator.cc ---------------------------------------*- C++ -*-===//
+//
+// This file implements ArenaAllocator.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/host_context/arena_allocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "llvm/Support/MathExtras.h"
+
+namespace tfrt {
+
+constexpr size_t ArenaAllocator::kDefaultBlockSize;
+
+struct ArenaAllocator::Block {
+  explicit Block(Block* next, size_t capacity)
+      : next(next), capacity(capacity), offset(0) {}
+
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+
+  // Bumps the block offset to allocate `size` bytes with the given alignment.
+  // Returns nullptr if the block does not have enough space left.
+  void* Allocate(size_t size, size_t alignment) {
+    auto base = reinterpret_cast<uintptr_t>(data());
+    size_t current = offset.load(std::memory_order_relaxed);
+    while (true) {
+      size_t start = llvm::alignTo(base + current, alignment) - base;
+      if (start + size > capacity) return nullptr;
+      if (offset.compare_exchange_weak(current, start + size,
+                                       std::memory_order_relaxed))
+        return data() + start;
+    }
+  }
+
+  Block* const next;
+  const size_t capacity;
+  std::atomic<size_t> offset;
+};
+
+ArenaAllocator::ArenaAllocator(HostAllocator* allocator, size_t block_size)
+    : allocator_(allocator), block_size_(block_size), current_block_(nullptr) {}
+
+ArenaAllocator::~ArenaAllocator() {
+  mutex_lock lock(mu_);
+  Block* block = blocks_;
+  while (block) {
+    Block* next = block->next;
+    size_t capacity = block->capacity;
+    block->~Block();
+    allocator_->DeallocateBytes(block, sizeof(Block) + capacity);
+    block = next;
+  }
+}
+
+void* ArenaAllocator::AllocateBytes(size_t size, size_t alignment) {
+  // Every live allocation keeps the arena alive.
+  AddRef();
+
+  // Large allocations get a dedicated block, so that they do not waste the
+  // space left in the current block.
+  if (size > block_size_ / 4) {
+    mutex_lock lock(mu_);
+    return NewBlock(size + alignment)->Allocate(size, alignment);
+  }
+
+  while (true) {
+    Block* block = current_block_.load(std::memory_order_acquire);
+    if (block) {
+      if (void* ptr = block->Allocate(size, alignment)) return ptr;
+    }
+    if (void* ptr = AllocateFromNewBlock(block, size, alignment)) return ptr;
+  }
+}
+
+void ArenaAllocator::DeallocateBytes(void* ptr, size_t size) {
+  // Memory is released when the last allocation and the owner of the arena
+  // drop their references.
+  DropRef();
+}
+
+void* ArenaAllocator::AllocateFromNewBlock(Block* current, size_t size,
+                                           size_t alignment) {
+  mutex_lock lock(mu_);
+  if (current_block_.load(std::memory_order_relaxed) != current) return nullptr;
+
+  Block* block = NewBlock(std::max(block_size_, size + alignment));
+  void* ptr = block->Allocate(size, alignment);
+  current_block_.store(block, std::memory_order_release);
+  return ptr;
+}
+
+ArenaAllocator::Block* ArenaAllocator::NewBlock(size_t capacity) {
+  void* memory = allocator_->AllocateBytes(sizeof(Block) + capacity,
+                                           alignof(std::max_align_t));
+  blocks_ = new (memory) Block(blocks_, capacity);
+  reserved_bytes_.fetch_add(capacity, std::memory_order_relaxed);
+  return blocks_;
+}
+
+}  // namespace tfrt
@@ -27,21 +27,6 @@
 
 namespace tfrt {
 
-// This is a singly linked list of nodes waiting for notification, hanging off
-// of AsyncValue.  When the value becomes available or if an error occurs, the
-// callbacks are informed.
-class NotifierListNode {
- public:
-  explicit NotifierListNode(llvm::unique_function<void()> notification)
-      : next_(nullptr), notification_(std::move(notification)) {}
-
- private:
-  friend class AsyncValue;
-  // This is the next thing waiting on the AsyncValue.
-  NotifierListNode* next_;
-  llvm::unique_function<void()> notification_;
-};
-
 /*static*/ uint16_t AsyncValue::CreateTypeInfoAndReturnTypeIdImpl(
     Destructor destructor) {
   TypeInfo type_info{destructor};
@@ -59,6 +44,19 @@ AsyncValue::TypeInfoTable* AsyncValue::GetTypeInfoTableSingleton() {
 }
 
 std::atomic<ssize_t> AsyncValue::total_allocated_async_values_;
+std::atomic<int64_t> AsyncValue::num_immediate_waiters_;
+std::atomic<int64_t> AsyncValue::num_inline_waiters_;
+std::atomic<int64_t> AsyncValue::num_boxed_waiters_;
+
+/*static*/ AsyncValue::WaiterStats AsyncValue::GetWaiterStats() {
+  assert(AsyncValueAllocationTrackingEnabled() &&
+         "AsyncValue waiter tracking disabled!");
+  WaiterStats stats;
+  stats.num_immediate = num_immediate_waiters_.load(std::memory_order_relaxed);
+  stats.num_inline = num_inline_waiters_.load(std::memory_order_relaxed);
+  stats.num_boxed = num_boxed_waiters_.load(std::memory_order_relaxed);
+  return stats;
+}
 
 const AsyncValue::TypeInfo& AsyncValue::GetTypeInfo() const {
   TypeInfoTable* type_info_table = AsyncValue::GetTypeInfoTableSingleton();
@@ -108,21 +106,24 @@ void AsyncValue::RunWaiters(NotifierListNode* list) {
   HostContext* host = GetHostContext();
   while (list) {
     auto* node = list;
-    // TODO(chky): pass state into notification_ so that waiters do not need to
+    // TODO(chky): pass state into notify_ so that waiters do not need to
     // check atomic state again.
-    node->notification_();
+    node->notify_(node);
     list = node->next_;
-    host->Destruct(node);
+    host->Deallocate(node);
   }
 }
 
+NotifierListNode* AsyncValue::AllocateWaiterNode() {
+  return new (GetHostContext()->Allocate<NotifierListNode>())
+      NotifierListNode();
+}
+
 // If the value is available or becomes available, this calls the closure
 // immediately. Otherwise, the add closure to the waiter list where it will be
 // called when the value becomes available.
-void AsyncValue::EnqueueWaiter(llvm::unique_function<void()>&& waiter,
+void AsyncValue::EnqueueWaiter(NotifierListNode* node,
                                WaitersAndState old_value) {
-  // Create the node for our waiter.
-  auto* node = GetHostContext()->Construct<NotifierListNode>(std::move(waiter));
   auto old_state = old_value.getInt();
 
   // Swap the next link in. old_value.getInt() must be unavailable when
@@ -33,6 +33,11 @@ RequestContext::~RequestContext() {
   }
 }
 
+HostAllocator* RequestContext::allocator() const {
+  if (arena_allocator_) return arena_allocator_.get();
+  return host_->allocator();
+}
+
 void RequestContext::Cancel() {
   // Create an AsyncValue in error state for cancel.
   auto* error_value = MakeErrorAsyncValueRef(host_, "Cancelled").release();
@@ -53,8 +58,14 @@ Expected<RCReference<RequestContext>> RequestContextBuilder::build() && {
   auto& cwq = host_->work_queue();
   if (auto error = cwq.InitRequest(this)) return std::move(error);
 
+  RCReference<ArenaAllocator> arena_allocator;
+  if (arena_block_size_ > 0)
+    arena_allocator =
+        TakeRef(new ArenaAllocator(host_->allocator(), arena_block_size_));
+
   return TakeRef(new RequestContext(host_, resource_context_,
-                                    std::move(context_data_), id_));
+                                    std::move(context_data_), id_,
+                                    std::move(arena_allocator)));
 };
 
 }  // namespace tfrt
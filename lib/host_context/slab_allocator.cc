@@ -0,0 +1,388 @@
+/*
+ * Copyright 2020 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//===- slab_allocator.cc - Size-class slab HostAllocator --------*- C++ -*-===//
+//
+// This file implements a HostAllocator that serves small allocations from
+// per-size-class slabs, with a per-thread cache of free objects.
+//
+// Small objects (up to kMaxObjectSize bytes) are carved from kSlabSize-aligned
+// slabs. Every slab holds objects of a single size class, and the size class is
+// recorded in the slab header, so that DeallocateBytes can find it from the
+// object address.
+//
+// Every thread owns a cache with a free list for each size class. Allocation
+// and deallocation only touch the caller thread cache in the common case. When
+// the thread cache is empty, it takes a batch of objects from the central free
+// list of the size class (carving a new slab if needed), and when the thread
+// cache grows too large, it returns a batch of objects to the central free
+// list. Objects freed by a thread other than the allocating one simply go to
+// the freeing thread cache, and flow back to other threads via the central
+// free lists.
+//
+// Slab memory is never returned to the system before the allocator is
+// destroyed. Large allocations fall back to AlignedAlloc/free.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/MathExtras.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/support/alloc.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
+#include "tfrt/support/thread_local.h"
+
+namespace tfrt {
+namespace {
+
+// Size classes are 16 byte apart up to 256 bytes, and powers of two above.
+constexpr size_t kSmallSizeClassStep = 16;
+constexpr size_t kMaxSmallSizeClass = 256;
+constexpr size_t kNumSmallSizeClasses =
+    kMaxSmallSizeClass / kSmallSizeClassStep;
+
+// Allocations larger than kMaxObjectSize bytes fall back to AlignedAlloc.
+constexpr size_t kMaxObjectSize = 4096;
+constexpr size_t kNumSizeClasses = kNumSmallSizeClasses + 4;  // 512 ... 4096
+static_assert(kMaxSmallSizeClass << (kNumSizeClasses - kNumSmallSizeClasses) ==
+                  kMaxObjectSize,
+              "Unexpected number of size classes");
+
+// Slabs are aligned to their size, so that the slab header can be found by
+// masking the object address.
+constexpr size_t kSlabSize = 64 * 1024;
+constexpr size_t kSlabHeaderSize = 64;
+
+// Maximum number of threads that can access the allocator without falling back
+// to the mutex protected ThreadLocal storage.
+constexpr size_t kMaxLockFreeThreads = 256;
+
+size_t SizeClassIndex(size_t size) {
+  assert(size <= kMaxObjectSize);
+  if (size <= kMaxSmallSizeClass)
+    return size == 0 ? 0 : (size - 1) / kSmallSizeClassStep;
+  return kNumSmallSizeClasses + llvm::Log2_64_Ceil(size) -
+         llvm::Log2_64(kMaxSmallSizeClass) - 1;
+}
+
+size_t SizeClassSize(size_t size_class) {
+  assert(size_class < kNumSizeClasses);
+  if (size_class < kNumSmallSizeClasses)
+    return (size_class + 1) * kSmallSizeClassStep;
+  return kMaxSmallSizeClass << (size_class - kNumSmallSizeClasses + 1);
+}
+
+// Objects of a size class are laid out back to back, so they are aligned to the
+// largest power of two that divides the size class size.
+size_t SizeClassAlignment(size_t size_class) {
+  size_t size = SizeClassSize(size_class);
+  return size & (~size + 1);
+}
+
+// The number of objects moved between a thread cache and a central free list
+// at once. Bounds the amount of memory held in a thread cache to roughly
+// 2 * kTransferBytes per size class.
+size_t TransferBatchSize(size_t size_class) {
+  constexpr size_t kTransferBytes = 16 * 1024;
+  size_t batch = kTransferBytes / SizeClassSize(size_class);
+  return std::max<size_t>(4, std::min<size_t>(64, batch));
+}
+
+struct SlabHeader {
+  size_t size_class;
+};
+static_assert(sizeof(SlabHeader) <= kSlabHeaderSize, "Slab header too large");
+
+// Intrusive singly linked list of free objects.
+struct FreeList {
+  void* head = nullptr;
+  size_t length = 0;
+
+  void Push(void* ptr) {
+    *static_cast<void**>(ptr) = head;
+    head = ptr;
+    ++length;
+  }
+
+  void* Pop() {
+    assert(head != nullptr);
+    void* ptr = head;
+    head = *static_cast<void**>(ptr);
+    --length;
+    return ptr;
+  }
+};
+
+struct ThreadCache {
+  std::array<FreeList, kNumSizeClasses> free_lists;
+
+  // Statistics, only updated by the owning thread.
+  int64_t num_allocations = 0;
+  int64_t num_deallocations = 0;
+  int64_t num_refills = 0;
+  int64_t num_flushes = 0;
+};
+
+class SlabAllocator : public HostAllocator {
+ public:
+  explicit SlabAllocator(bool print_stats)
+      : id_(NextAllocatorId()),
+        print_stats_(print_stats),
+        thread_caches_(
+            ThreadLocal<ThreadCache>::Capacity(kMaxLockFreeThreads)) {}
+
+  ~SlabAllocator() override {
+    if (print_stats_) PrintStats();
+    mutex_lock lock(slabs_mu_);
+    for (void* slab : slabs_) free(slab);
+  }
+
+  void* AllocateBytes(size_t size, size_t alignment) override {
+    if (size > kMaxObjectSize) return AllocateLarge(size, alignment);
+    if (alignment > kMaxObjectSize) return AllocateOveraligned(size, alignment);
+
+    size_t size_class = SizeClassIndex(std::max(size, alignment));
+    if (alignment > SizeClassAlignment(size_class))
+      size_class =
+          SizeClassIndex(llvm::PowerOf2Ceil(std::max(size, alignment)));
+
+    ThreadCache& cache = LocalCache();
+    ++cache.num_allocations;
+
+    FreeList& free_list = cache.free_lists[size_class];
+    if (free_list.head == nullptr) Refill(size_class, &cache);
+    return free_list.Pop();
+  }
+
+  void DeallocateBytes(void* ptr, size_t size) override {
+    if (size > kMaxObjectSize) {
+      DeallocateLarge(ptr);
+      return;
+    }
+    if (num_overaligned_.load(std::memory_order_relaxed) > 0 &&
+        DeallocateOveraligned(ptr))
+      return;
+
+    size_t size_class = GetSlabHeader(ptr)->size_class;
+    assert(SizeClassSize(size_class) >= size);
+
+    ThreadCache& cache = LocalCache();
+    ++cache.num_deallocations;
+
+    FreeList& free_list = cache.free_lists[size_class];
+    free_list.Push(ptr);
+    if (free_list.length >= 2 * TransferBatchSize(size_class))
+      Flush(size_class, &cache);
+  }
+
+ private:
+  struct alignas(64) CentralFreeList {
+    mutex mu;
+    FreeList free_list TFRT_GUARDED_BY(mu);
+  };
+
+  static uint64_t NextAllocatorId() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // ThreadLocal lookup is relatively expensive compared to the rest of the
+  // allocation fast path, so every thread remembers the cache it used last.
+  // Allocators are identified by a unique id rather than by address, because
+  // a new allocator might be constructed at the address of a destroyed one.
+  ThreadCache& LocalCache() {
+    struct LastUsedCache {
+      uint64_t allocator_id = 0;
+      ThreadCache* cache = nullptr;
+    };
+    static thread_local LastUsedCache last_used;
+
+    if (LLVM_LIKELY(last_used.allocator_id == id_)) return *last_used.cache;
+    ThreadCache& cache = thread_caches_.Local();
+    last_used = {id_, &cache};
+    return cache;
+  }
+
+  static SlabHeader* GetSlabHeader(void* ptr) {
+    auto addr = reinterpret_cast<uintptr_t>(ptr);
+    return reinterpret_cast<SlabHeader*>(addr & ~(kSlabSize - 1));
+  }
+
+  // Moves a batch of free objects from the central free list into the thread
+  // cache, carving a new slab if the central free list is empty.
+  LLVM_ATTRIBUTE_NOINLINE void Refill(size_t size_class, ThreadCache* cache) {
+    ++cache->num_refills;
+    FreeList& local = cache->free_lists[size_class];
+    size_t batch = TransferBatchSize(size_class);
+
+    CentralFreeList& central = central_free_lists_[size_class];
+    {
+      mutex_lock lock(central.mu);
+      while (central.free_list.head != nullptr && local.length < batch)
+        local.Push(central.free_list.Pop());
+    }
+    if (local.head != nullptr) return;
+
+    // Central free list is empty, carve a new slab. Keep one batch of objects
+    // in the thread cache, and give the rest to the central free list.
+    char* slab = static_cast<char*>(AlignedAlloc(kSlabSize, kSlabSize));
+    assert(slab != nullptr);
+    new (slab) SlabHeader{size_class};
+
+    size_t object_size = SizeClassSize(size_class);
+    size_t offset =
+        llvm::alignTo(kSlabHeaderSize, SizeClassAlignment(size_class));
+
+    FreeList carved;
+    for (; offset + object_size <= kSlabSize; offset += object_size)
+      carved.Push(slab + offset);
+
+    while (carved.head != nullptr && local.length < batch)
+      local.Push(carved.Pop());
+
+    {
+      mutex_lock lock(central.mu);
+      while (carved.head != nullptr) central.free_list.Push(carved.Pop());
+    }
+
+    mutex_lock lock(slabs_mu_);
+    slabs_.push_back(slab);
+  }
+
+  // Moves a batch of free objects from the thread cache to the central free
+  // list.
+  LLVM_ATTRIBUTE_NOINLINE void Flush(size_t size_class, ThreadCache* cache) {
+    ++cache->num_flushes;
+    FreeList& local = cache->free_lists[size_class];
+    size_t batch = TransferBatchSize(size_class);
+
+    CentralFreeList& central = central_free_lists_[size_class];
+    mutex_lock lock(central.mu);
+    for (size_t i = 0; i < batch && local.head != nullptr; ++i)
+      central.free_list.Push(local.Pop());
+  }
+
+  void* AllocateLarge(size_t size, size_t alignment) {
+    num_large_allocations_.fetch_add(1, std::memory_order_relaxed);
+    return AlignedAlloc(alignment, size);
+  }
+
+  void DeallocateLarge(void* ptr) {
+    num_large_deallocations_.fetch_add(1, std::memory_order_relaxed);
+    free(ptr);
+  }
+
+  // Small objects with alignment requirement larger than kMaxObjectSize can't
+  // be served from slabs, and can't be distinguished from slab objects by size
+  // in DeallocateBytes, so we keep track of them explicitly. They are
+  // extremely rare in practice.
+  void* AllocateOveraligned(size_t size, size_t alignment) {
+    void* ptr = AllocateLarge(size, alignment);
+    mutex_lock lock(overaligned_mu_);
+    overaligned_.insert(ptr);
+    num_overaligned_.fetch_add(1, std::memory_order_relaxed);
+    return ptr;
+  }
+
+  bool DeallocateOveraligned(void* ptr) {
+    {
+      mutex_lock lock(overaligned_mu_);
+      if (!overaligned_.erase(ptr)) return false;
+      num_overaligned_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    DeallocateLarge(ptr);
+    return true;
+  }
+
+  void PrintStats() {
+    int64_t num_allocations = 0;
+    int64_t num_deallocations = 0;
+    int64_t num_refills = 0;
+    int64_t num_flushes = 0;
+    int64_t num_thread_caches = 0;
+    thread_caches_.ForEach([&](std::thread::id, ThreadCache& cache) {
+      num_allocations += cache.num_allocations;
+      num_deallocations += cache.num_deallocations;
+      num_refills += cache.num_refills;
+      num_flushes += cache.num_flushes;
+      ++num_thread_caches;
+    });
+
+    int64_t num_large_allocations = num_large_allocations_.load();
+    int64_t num_large_deallocations = num_large_deallocations_.load();
+    int64_t num_slabs;
+    {
+      mutex_lock lock(slabs_mu_);
+      num_slabs = slabs_.size();
+    }
+
+    printf("SlabAllocator profile:\n");
+    printf("Current number of allocations = %" PRId64 "\n",
+           num_allocations + num_large_allocations - num_deallocations -
+               num_large_deallocations);
+    printf("Total number of allocations = %" PRId64 "\n",
+           num_allocations + num_large_allocations);
+    printf("Total number of slab allocations = %" PRId64 "\n",
+           num_allocations);
+    printf("Total number of large allocations = %" PRId64 "\n",
+           num_large_allocations);
+    printf("Number of thread cache refills = %" PRId64 "\n", num_refills);
+    printf("Number of thread cache flushes = %" PRId64 "\n", num_flushes);
+    printf("Number of thread caches = %" PRId64 "\n", num_thread_caches);
+    printf("Number of bytes reserved in slabs = %" PRId64 "\n",
+           num_slabs * static_cast<int64_t>(kSlabSize));
+    fflush(stdout);
+  }
+
+  const uint64_t id_;
+  const bool print_stats_;
+
+  ThreadLocal<ThreadCache> thread_caches_;
+  std::array<CentralFreeList, kNumSizeClasses> central_free_lists_;
+
+  mutex slabs_mu_;
+  std::vector<void*> slabs_ TFRT_GUARDED_BY(slabs_mu_);
+
+  mutex overaligned_mu_;
+  llvm::DenseSet<void*> overaligned_ TFRT_GUARDED_BY(overaligned_mu_);
+  std::atomic<int64_t> num_overaligned_{0};
+
+  std::atomic<int64_t> num_large_allocations_{0};
+  std::atomic<int64_t> num_large_deallocations_{0};
+};
+
+}  // namespace
+
+std::unique_ptr<HostAllocator> CreateSlabAllocator(bool print_stats) {
+  return std::make_unique<SlabAllocator>(print_stats);
+}
+
+}  // namespace tfrt
@@ -50,6 +50,14 @@ struct MakeMultiThreadedWorkQueue {
   }
 };
 
+struct MakeMultiThreadedPriorityWorkQueue {
+  static std::unique_ptr<ConcurrentWorkQueue> make(int num_nonblocking_threads,
+                                                   int num_blocking_threads) {
+    return CreateMultiThreadedPriorityWorkQueue(num_nonblocking_threads,
+                                                num_blocking_threads);
+  }
+};
+
 // Factory function for a multi-threaded thread pool.  Parses the given argument
 // to determine the construction parameters.  The argument must be either "X" or
 // "X,Y", where X and Y are integers. X will determine the number of threads to
@@ -102,5 +110,8 @@ std::unique_ptr<ConcurrentWorkQueue> MultiThreadedWorkQueueFactory(
 TFRT_WORK_QUEUE_FACTORY("s", SingleThreadedWorkQueueFactory);
 TFRT_WORK_QUEUE_FACTORY(
     "mstd", MultiThreadedWorkQueueFactory<MakeMultiThreadedWorkQueue>);
+TFRT_WORK_QUEUE_FACTORY(
+    "mstd_priority",
+    MultiThreadedWorkQueueFactory<MakeMultiThreadedPriorityWorkQueue>);
 
 }  // namespace tfrt
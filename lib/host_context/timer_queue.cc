@@ -20,77 +20,208 @@
 
 #include "tfrt/host_context/timer_queue.h"
 
+#include "llvm/Support/MathExtras.h"
+
 namespace tfrt {
 
-TimerQueue::TimerQueue() {
+TimerQueue::TimerQueue() : start_time_(Clock::now()) {
   // Start the timer thread.
   // TODO(tfrt-devs): use alternative to std::thread in google-internal build.
   timer_thread_ = std::thread([this]() { TimerThreadRun(); });
 }
 
 TimerQueue::~TimerQueue() {
-  mu_.lock();
-  // Cancel every timer in the queue.
-  while (!timers_.empty()) {
-    timers_.pop();
+  {
+    mutex_lock lock(mu_);
+    stop_.store(true, std::memory_order_release);
+    // Notify the timer thread we are done.
+    cv_.notify_one();
   }
-  stop_.store(true, std::memory_order_release);
-  // Notify the timer thread we are done cleaning up.
-  cv_.notify_one();
-  mu_.unlock();
   assert(timer_thread_.joinable());
   timer_thread_.join();
+
+  // Cancel every timer in the queue. Timers in the wheel are released with
+  // the wheel.
+  TimerEntry* pending = pending_timers_.exchange(nullptr);
+  while (pending) {
+    TimerEntry* next = pending->next_pending_;
+    pending->DropRef();
+    pending = next;
+  }
+}
+
+constexpr TimerQueue::TimeDuration TimerQueue::kTickDuration;
+
+TimerQueue::Tick TimerQueue::ToTick(TimePoint time_point) const {
+  // Round up. duration_cast truncates towards zero.
+  auto elapsed = time_point - start_time_;
+  auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+  if (elapsed - ticks > TimeDuration::zero()) ++ticks;
+  return ticks.count();
+}
+
+TimerQueue::TimePoint TimerQueue::ToTimePoint(Tick tick) const {
+  return start_time_ + tick * kTickDuration;
+}
+
+TimerQueue::Tick TimerQueue::CurrentTick() const {
+  // Round down. duration_cast truncates towards zero.
+  auto elapsed = Clock::now() - start_time_;
+  auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+  if (elapsed - ticks < TimeDuration::zero()) --ticks;
+  return ticks.count();
 }
 
 void TimerQueue::TimerThreadRun() {
+  std::vector<RCReference<TimerEntry>> expired;
+
   mutex_lock lock(mu_);
   while (!stop_.load(std::memory_order_acquire)) {
-    const TimerEntry* top_entry = getTopTimer();
-    if (!top_entry) {
-      cv_.wait(lock);
-    } else {
-      // Wait till the timer expires.
-      cv_.wait_until(lock, top_entry->deadline_);
-    }
-    while (!timers_.empty() && timers_.top()->deadline_ <= Clock::now()) {
-      const auto top_entry = timers_.top().CopyRef();
-      timers_.pop();
+    AddPendingTimers(&expired);
+    AdvanceTo(CurrentTick(), &expired);
+
+    if (!expired.empty()) {
+      // Run the callbacks of the expired timers as a batch.
       mu_.unlock();
-      // If timer is not cancelled, run the callback.
-      if (!top_entry->cancelled_) {
-        top_entry->timer_callback_();
+      for (auto& timer : expired) {
+        // If timer is not cancelled, run the callback.
+        if (!timer->cancelled_) timer->timer_callback_();
       }
+      expired.clear();
       mu_.lock();
+      continue;
     }
+
+    // Publish the wakeup tick before checking for new timers one last time.
+    // A concurrent ScheduleTimerAt() either sees the wakeup tick and notifies
+    // us under `mu_`, or its timer is seen here.
+    Tick next_tick = NextEventTick();
+    next_wakeup_tick_.store(next_tick);
+    if (pending_timers_.load() == nullptr) {
+      if (next_tick == kNoTick) {
+        cv_.wait(lock);
+      } else {
+        // Wait till the next timer expires.
+        cv_.wait_until(lock, ToTimePoint(next_tick));
+      }
+    }
+    next_wakeup_tick_.store(kAwake);
   }
 }
 
-TimerQueue::TimerEntry* TimerQueue::getTopTimer() TFRT_REQUIRES(mu_) {
-  while (!timers_.empty()) {
-    if (timers_.top()->cancelled_) {
-      // Timer is cancelled, discard.
-      timers_.pop();
-    } else {
-      return timers_.top().get();
+void TimerQueue::AddPendingTimers(
+    std::vector<RCReference<TimerEntry>>* expired) {
+  TimerEntry* pending = pending_timers_.exchange(nullptr);
+  while (pending) {
+    TimerEntry* next = pending->next_pending_;
+    pending->next_pending_ = nullptr;
+    AddTimer(TakeRef(pending), expired);
+    pending = next;
+  }
+}
+
+void TimerQueue::AddTimer(RCReference<TimerEntry> timer,
+                          std::vector<RCReference<TimerEntry>>* expired) {
+  // Drop cancelled timers early.
+  if (timer->cancelled_.load(std::memory_order_relaxed)) return;
+
+  Tick tick = timer->tick_;
+  if (tick <= current_tick_) {
+    expired->push_back(std::move(timer));
+    return;
+  }
+
+  // The timer goes to the lowest level in which it shares the slots of all
+  // higher levels with the current tick.
+  for (int level = 0; level < kNumLevels; ++level) {
+    int shift = kBitsPerLevel * (level + 1);
+    if ((tick >> shift) != (current_tick_ >> shift)) continue;
+    int slot = (tick >> (kBitsPerLevel * level)) & (kSlotsPerLevel - 1);
+    levels_[level].slots[slot].push_back(std::move(timer));
+    levels_[level].occupied |= uint64_t{1} << slot;
+    return;
+  }
+  overflow_.push_back(std::move(timer));
+}
+
+void TimerQueue::CascadeSlot(int level, int slot,
+                             std::vector<RCReference<TimerEntry>>* expired) {
+  auto timers = std::move(levels_[level].slots[slot]);
+  levels_[level].slots[slot].clear();
+  levels_[level].occupied &= ~(uint64_t{1} << slot);
+  for (auto& timer : timers) AddTimer(std::move(timer), expired);
+}
+
+void TimerQueue::AdvanceTo(Tick tick,
+                           std::vector<RCReference<TimerEntry>>* expired) {
+  constexpr int kWheelBits = kBitsPerLevel * kNumLevels;
+
+  while (current_tick_ < tick) {
+    // Skip the ticks without any timer to expire or cascade.
+    Tick next_tick = NextEventTick();
+    if (next_tick > tick) {
+      current_tick_ = tick;
+      return;
+    }
+    current_tick_ = next_tick;
+
+    // Redistribute the timers of the slots starting at this tick, from the
+    // highest level down, so that they end up in level 0 or `expired`.
+    if ((current_tick_ & ((Tick{1} << kWheelBits) - 1)) == 0) {
+      auto overflow = std::move(overflow_);
+      overflow_.clear();
+      for (auto& timer : overflow) AddTimer(std::move(timer), expired);
+    }
+    for (int level = kNumLevels - 1; level > 0; --level) {
+      int shift = kBitsPerLevel * level;
+      if ((current_tick_ & ((Tick{1} << shift) - 1)) != 0) continue;
+      CascadeSlot(level, (current_tick_ >> shift) & (kSlotsPerLevel - 1),
+                  expired);
     }
+    CascadeSlot(0, current_tick_ & (kSlotsPerLevel - 1), expired);
   }
-  // No active timer found. Return a nullptr.
-  return nullptr;
+}
+
+TimerQueue::Tick TimerQueue::NextEventTick() const {
+  for (int level = 0; level < kNumLevels; ++level) {
+    int shift = kBitsPerLevel * level;
+    int current_slot = (current_tick_ >> shift) & (kSlotsPerLevel - 1);
+    // Only slots after the current one can be occupied.
+    uint64_t later_slots =
+        current_slot == kSlotsPerLevel - 1 ? 0 : ~uint64_t{0}
+                                                     << (current_slot + 1);
+    uint64_t occupied = levels_[level].occupied & later_slots;
+    if (occupied == 0) continue;
+
+    int level_shift = shift + kBitsPerLevel;
+    Tick level_start = (current_tick_ >> level_shift) << level_shift;
+    return level_start + (Tick{llvm::countTrailingZeros(occupied)} << shift);
+  }
+
+  if (!overflow_.empty()) {
+    constexpr int kWheelBits = kBitsPerLevel * kNumLevels;
+    return ((current_tick_ >> kWheelBits) + 1) << kWheelBits;
+  }
+  return kNoTick;
 }
 
 TimerQueue::TimerHandle TimerQueue::ScheduleTimerAt(TimePoint deadline,
                                                     TimerCallback callback) {
-  TimerHandle th = TimerEntry::Create(deadline, std::move(callback));
-  bool notify = false;
-  {
+  Tick tick = ToTick(deadline);
+  TimerHandle th = TimerEntry::Create(tick, std::move(callback));
+
+  // Push the timer to the pending timers, the timer thread adds it to the
+  // wheel.
+  TimerEntry* timer = th.CopyRef().release();
+  timer->next_pending_ = pending_timers_.load(std::memory_order_relaxed);
+  while (!pending_timers_.compare_exchange_weak(timer->next_pending_, timer)) {
+  }
+
+  // Only notify timer thread when it sleeps past the new timer's deadline.
+  if (tick < next_wakeup_tick_.load()) {
     mutex_lock lock(mu_);
-    // Only notify timer thread when the queue is empty, or when the newly added
-    // timer's deadline is shorter.
-    notify = timers_.empty() || timers_.top()->deadline_ > deadline;
-    timers_.push(th.CopyRef());
+    cv_.notify_one();
   }
-  // Notify the timer thread that a new timer is added.
-  if (notify) cv_.notify_one();
   return th;
 }
 
@@ -25,18 +25,18 @@
 
 // SSE4.2 accelerated CRC32c.
 
-// See if the SSE4.2 crc32c instruction is available.
+// See if the SSE4.2 crc32c instruction is available. The accelerated code is
+// compiled for SSE4.2 with a function attribute and only called if the
+// running CPU supports it, so the library itself does not require -msse4.2.
 #undef USE_SSE_CRC32C
-#ifdef __SSE4_2__
 #if defined(__x86_64__) && defined(__GNUC__) && \
-    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
 #define USE_SSE_CRC32C 1
 #elif defined(__x86_64__) && defined(__clang__)
 #if __has_builtin(__builtin_cpu_supports)
 #define USE_SSE_CRC32C 1
 #endif
 #endif
-#endif /* __SSE4_2__ */
 
 // This version of Apple clang has a bug:
 // https://llvm.org/bugs/show_bug.cgi?id=25510
@@ -46,6 +46,8 @@
 
 #ifdef USE_SSE_CRC32C
 #include <nmmintrin.h>
+
+#define TFRT_SSE42_TARGET __attribute__((target("sse4.2")))
 #endif
 
 namespace tfrt {
@@ -61,10 +63,104 @@ uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size) {
 
 #else
 
+namespace {
+
+// The crc32 instruction has a latency of 3 cycles but a throughput of one per
+// cycle, so a single dependent chain leaves most of the CRC unit idle. Large
+// buffers are therefore split into three blocks of equal size whose CRCs are
+// computed in three independent chains and combined afterwards.
+//
+// Long blocks amortize the cost of combining, short blocks keep medium sized
+// buffers (e.g. small TFRecords) on the interleaved path.
+constexpr size_t kLongBlockSize = 8192;
+constexpr size_t kShortBlockSize = 256;
+
+// Shifts a CRC register by a fixed number of zero bytes, i.e. multiplies it by
+// x^(8 * block_size) modulo the CRC32c polynomial. The operation is linear in
+// the register bits, so it is tabulated per input byte and costs four lookups.
+class ZeroShiftTable {
+ public:
+  TFRT_SSE42_TARGET explicit ZeroShiftTable(size_t block_size) {
+    // The image of each single-bit register under the shift.
+    uint32_t basis[32];
+    for (int bit = 0; bit < 32; ++bit) {
+      uint64_t l64 = uint32_t{1} << bit;
+      for (size_t i = 0; i < block_size; i += 8) l64 = _mm_crc32_u64(l64, 0);
+      basis[bit] = static_cast<uint32_t>(l64);
+    }
+    for (int byte = 0; byte < 4; ++byte) {
+      for (int value = 0; value < 256; ++value) {
+        uint32_t shifted = 0;
+        for (int bit = 0; bit < 8; ++bit) {
+          if (value & (1 << bit)) shifted ^= basis[byte * 8 + bit];
+        }
+        table_[byte][value] = shifted;
+      }
+    }
+  }
+
+  uint32_t Shift(uint32_t l) const {
+    return table_[0][l & 0xff] ^ table_[1][(l >> 8) & 0xff] ^
+           table_[2][(l >> 16) & 0xff] ^ table_[3][l >> 24];
+  }
+
+ private:
+  uint32_t table_[4][256];
+};
+
+// Loads a naturally-aligned 64-bit word.
+inline uint64_t Load64(const uint8_t *p) {
+  return *reinterpret_cast<const uint64_t *>(p);
+}
+
+// Processes [p, e) in chunks of three blocks of kBlockSize bytes each while
+// possible, advancing p. p must be 8-byte aligned.
+template <size_t kBlockSize>
+TFRT_SSE42_TARGET uint64_t ExtendInterleaved(uint64_t l64, const uint8_t *&p,
+                                             const uint8_t *e,
+                                             const ZeroShiftTable &table) {
+  while (e - p >= static_cast<ptrdiff_t>(3 * kBlockSize)) {
+    const uint8_t *p1 = p + kBlockSize;
+    const uint8_t *p2 = p1 + kBlockSize;
+    uint64_t l64_1 = 0;
+    uint64_t l64_2 = 0;
+    for (size_t i = 0; i < kBlockSize; i += 8) {
+      l64 = _mm_crc32_u64(l64, Load64(p + i));
+      l64_1 = _mm_crc32_u64(l64_1, Load64(p1 + i));
+      l64_2 = _mm_crc32_u64(l64_2, Load64(p2 + i));
+    }
+    // CRC(A || B) == Shift(CRC(A), |B|) ^ CRC(B) when B starts from a zero
+    // register, which is how the second and third chains were seeded.
+    l64 = table.Shift(table.Shift(static_cast<uint32_t>(l64)) ^
+                      static_cast<uint32_t>(l64_1)) ^
+          static_cast<uint32_t>(l64_2);
+    p += 3 * kBlockSize;
+  }
+  return l64;
+}
+
+// Processes the first size - size % (3 * kShortBlockSize) bytes at p, which
+// must be 8-byte aligned. Kept out of line so that short buffers do not pay
+// for its stack frame.
+static_assert(kLongBlockSize % kShortBlockSize == 0,
+              "Long chunks must be a multiple of short chunks");
+__attribute__((noinline)) TFRT_SSE42_TARGET uint64_t
+ExtendLarge(uint64_t l64, const uint8_t *p, size_t size) {
+  static const ZeroShiftTable *long_table = new ZeroShiftTable(kLongBlockSize);
+  static const ZeroShiftTable *short_table =
+      new ZeroShiftTable(kShortBlockSize);
+  const uint8_t *e = p + size;
+  l64 = ExtendInterleaved<kLongBlockSize>(l64, p, e, *long_table);
+  return ExtendInterleaved<kShortBlockSize>(l64, p, e, *short_table);
+}
+
+}  // namespace
+
 // SSE4.2 optimized crc32c computation.
 bool CanAccelerate() { return __builtin_cpu_supports("sse4.2"); }
 
-uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size) {
+TFRT_SSE42_TARGET uint32_t AcceleratedExtend(uint32_t crc, const char *buf,
+                                             size_t size) {
   const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
   const uint8_t *e = p + size;
   uint32_t l = crc ^ 0xffffffffu;
@@ -82,8 +178,17 @@ uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size) {
     }
   }
 
-  // Process bytes 16 at a time
   uint64_t l64 = l;
+
+  // Process large chunks in three interleaved streams.
+  if (e - p >= static_cast<ptrdiff_t>(3 * kShortBlockSize)) {
+    const size_t size = e - p;
+    const size_t large_size = size - size % (3 * kShortBlockSize);
+    l64 = ExtendLarge(l64, p, large_size);
+    p += large_size;
+  }
+
+  // Process bytes 16 at a time
   while ((e - p) >= 16) {
     l64 = _mm_crc32_u64(l64, *reinterpret_cast<const uint64_t *>(p));
     l64 = _mm_crc32_u64(l64, *reinterpret_cast<const uint64_t *>(p + 8));
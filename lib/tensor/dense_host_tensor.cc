@@ -49,6 +49,11 @@ llvm::Optional<DenseHostTensor> DenseHostTensor::CreateUninitialized(
   return CreateUninitialized(metadata, host->allocator());
 }
 
+llvm::Optional<DenseHostTensor> DenseHostTensor::CreateUninitialized(
+    const TensorMetadata& metadata, const ExecutionContext& exec_ctx) {
+  return CreateUninitialized(metadata, exec_ctx.allocator());
+}
+
 AsyncValueRef<DenseHostTensor> DenseHostTensor::MakeConstructedAsyncValueRef(
     const TensorMetadata& metadata, HostContext* host) {
   auto dht = CreateUninitialized(metadata, host);
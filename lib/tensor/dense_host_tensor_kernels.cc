@@ -42,7 +42,7 @@ template <typename T, size_t Rank>
 static Expected<DenseHostTensor> CreateUninitializedDenseTensor(
     ArrayAttribute<ssize_t> shape_in, const ExecutionContext& exec_ctx) {
   auto result = DenseHostTensor::CreateUninitialized<T>(
-      TensorShape(shape_in.data()), exec_ctx.host());
+      TensorShape(shape_in.data()), exec_ctx);
   if (!result.hasValue()) {
     return MakeStringError("Cannot allocate tensor");
   }
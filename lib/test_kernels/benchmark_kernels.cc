@@ -18,13 +18,17 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <ctime>
+#include <vector>
 
 #include "llvm/ADT/FunctionExtras.h"
+#include "llvm/ADT/Optional.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm_derived/Support/raw_ostream.h"
+#include "perf_counters.h"
 #include "tfrt/bef_executor/bef_file.h"
 #include "tfrt/bef_executor/bef_interpreter.h"
 #include "tfrt/host_context/async_dispatch.h"
@@ -34,13 +38,25 @@
 #include "tfrt/host_context/kernel_utils.h"
 #include "tfrt/host_context/sync_kernel_utils.h"
 #include "tfrt/support/error_util.h"
+#include "tfrt/support/mutex.h"
 #include "tfrt/support/ref_count.h"
+#include "tfrt/support/thread_annotations.h"
 #include "tfrt/test_kernels.h"
 
 namespace tfrt {
 namespace {
 class BenchmarkStats {
  public:
+  using Clock = std::chrono::steady_clock;
+
+  // Start of a single benchmarked function execution. With concurrent runs
+  // multiple executions are in flight, and each of them tracks its own start.
+  struct Run {
+    int index;
+    Clock::time_point start_walltime;
+    std::clock_t start_cpu;
+  };
+
   BenchmarkStats(string_view name, int num_warmup_runs, int max_count,
                  std::chrono::microseconds benchmark_duration)
       : name_{name},
@@ -48,49 +64,69 @@ class BenchmarkStats {
         max_count_{max_count},
         benchmark_duration_{benchmark_duration} {}
 
-  void StartRun() {
-    ++cur_count_;
-    // Start recording CPU time.
-    cur_start_cpu_ = std::clock();
-    cur_start_walltime_ = std::chrono::steady_clock::now();
+  Run StartRun() { return StartRun(Clock::now()); }
+
+  // Starts a run that is accounted from `start_walltime`. Open loop runs start
+  // at their scheduled arrival time, so that the time a run waits behind the
+  // previous ones (for the timer or for the work queue) is part of its latency.
+  Run StartRun(Clock::time_point start_walltime) {
+    // Hardware performance counters are collected for the whole benchmark
+    // duration after the warm up period.
+    if (cur_count_ == num_warmup_runs_ && PerfCounters::IsEnabled() &&
+        !perf_counters_.Start()) {
+      tfrt::errs() << "Hardware performance counters are not available\n";
+    }
+
+    Run run{cur_count_++, start_walltime, std::clock()};
+
+    // The benchmark duration is measured from the start of the first run
+    // after the warm up period.
+    if (run.index == num_warmup_runs_) {
+      start_walltime_ = run.start_walltime;
+      start_cpu_ = run.start_cpu;
+    }
+
+    return run;
   }
 
-  void StopRun() {
-    // Do not collect the runtime statistics if we are still in the warm up
-    // period.
-    if (cur_count_ <= num_warmup_runs_) return;
+  void StopRun(const Run& run) {
+    // Do not collect the runtime statistics if the run is a part of the warm
+    // up period.
+    if (run.index < num_warmup_runs_) return;
 
     // Stop the wall clock timer.
-    auto cur_stop_walltime_ = std::chrono::steady_clock::now();
+    auto cur_stop_walltime_ = Clock::now();
 
     // Stop the CPU timer.
     std::clock_t cur_stop_cpu_ = std::clock();
 
     // Collect the wall clock duration.
-    auto duration_walltime_ = cur_stop_walltime_ - cur_start_walltime_;
+    auto duration_walltime_ = cur_stop_walltime_ - run.start_walltime;
     run_times_walltime_.push_back(duration_walltime_);
 
     // Collect the CPU duration in microseconds.
     // First cast to integer that represents microseconds with truncation, as
     // does std::chrono::duration_cast. Then cast to std::chrono::microseconds.
-    std::clock_t duration_cpu_raw = cur_stop_cpu_ - cur_start_cpu_;
-    auto duration_cpu_ = static_cast<std::chrono::nanoseconds>(
-        static_cast<int64_t>(1e9 * duration_cpu_raw / CLOCKS_PER_SEC));
-
-    run_times_cpu_.push_back(duration_cpu_);
+    // Note that std::clock() measures the CPU time of the whole process, so
+    // with concurrent runs it includes the CPU time of the other runs.
+    std::clock_t duration_cpu_raw = cur_stop_cpu_ - run.start_cpu;
+    run_times_cpu_.push_back(ToNanoseconds(duration_cpu_raw));
 
-    total_duration_walltime_ += duration_walltime_;
-    total_duration_cpu_ += duration_cpu_;
+    stop_walltime_ = std::max(stop_walltime_, cur_stop_walltime_);
+    stop_cpu_ = std::max(stop_cpu_, cur_stop_cpu_);
   }
 
   // Return if we should we run more rounds.
   bool MoreRun() const {
-    return cur_count_ < max_count_ + num_warmup_runs_ &&
-           total_duration_walltime_ < benchmark_duration_;
+    if (cur_count_ >= max_count_ + num_warmup_runs_) return false;
+    if (cur_count_ <= num_warmup_runs_) return true;
+    return Clock::now() - start_walltime_ < benchmark_duration_;
   }
 
   // Summarize the benchmark results.
   void Summarize() {
+    PerfCounters::Values counters = perf_counters_.Read();
+
     std::sort(run_times_walltime_.begin(), run_times_walltime_.end());
     std::sort(run_times_cpu_.begin(), run_times_cpu_.end());
 
@@ -103,8 +139,25 @@ class BenchmarkStats {
     // BM: prefix is added to make grepping results from lit output easier.
     std::string prefix;
     llvm::raw_string_ostream(prefix) << "BM:" << name_ << ':';
+
+    if (run_times_walltime_.empty()) {
+      tfrt::outs() << prefix << "Count: 0\n";
+      tfrt::outs().flush();
+      return;
+    }
+
+    // Wall and CPU time between the start of the first and the end of the
+    // last benchmarked run. With concurrent runs it is smaller than the sum of
+    // the individual run times.
+    std::chrono::nanoseconds total_duration_walltime_ =
+        stop_walltime_ - start_walltime_;
+    std::chrono::nanoseconds total_duration_cpu_ =
+        ToNanoseconds(stop_cpu_ - start_cpu_);
+
     auto cpu_utilization =
         total_duration_cpu_.count() * 100.0 / total_duration_walltime_.count();
+    auto throughput =
+        run_times_walltime_.size() * 1e9 / total_duration_walltime_.count();
 
     tfrt::outs() << prefix
                  << "Duration(ns): " << total_duration_walltime_.count()
@@ -119,6 +172,11 @@ class BenchmarkStats {
                  << percentile(0.95, run_times_walltime_).count() << '\n';
     tfrt::outs() << prefix << "Time 99%(ns): "
                  << percentile(0.99, run_times_walltime_).count() << '\n';
+    tfrt::outs() << prefix << "Time 99.9%(ns): "
+                 << percentile(0.999, run_times_walltime_).count() << '\n';
+    tfrt::outs() << prefix
+                 << "Time Max(ns): " << run_times_walltime_.back().count()
+                 << '\n';
 
     // Log CPU time statistics.
     tfrt::outs() << prefix << "CPU Min(ns): " << run_times_cpu_.front().count()
@@ -134,30 +192,84 @@ class BenchmarkStats {
                  << '\n';
     tfrt::outs() << prefix << "CPU utilization(percent): " << cpu_utilization
                  << "\n";
+    tfrt::outs() << prefix << "Throughput(qps): " << throughput << "\n";
+
+    // Log hardware performance counters averaged over the benchmarked runs.
+    auto cycles = counters[PerfCounters::kCycles];
+    auto instructions = counters[PerfCounters::kInstructions];
+    auto cache_misses = counters[PerfCounters::kCacheMisses];
+    auto branch_misses = counters[PerfCounters::kBranchMisses];
+    auto count = run_times_walltime_.size();
+
+    if (cycles) {
+      tfrt::outs() << prefix << "Cycles/run: " << *cycles / count << "\n";
+    }
+    if (instructions) {
+      tfrt::outs() << prefix << "Instructions/run: " << *instructions / count
+                   << "\n";
+    }
+    if (cycles && instructions && *cycles > 0) {
+      tfrt::outs() << prefix << "IPC: "
+                   << static_cast<double>(*instructions) / *cycles << "\n";
+    }
+    if (cache_misses) {
+      tfrt::outs() << prefix << "LLC misses/run: " << *cache_misses / count
+                   << "\n";
+    }
+    if (branch_misses) {
+      tfrt::outs() << prefix << "Branch misses/run: " << *branch_misses / count
+                   << "\n";
+    }
+
     tfrt::outs().flush();
   }
 
  private:
+  static std::chrono::nanoseconds ToNanoseconds(std::clock_t cpu) {
+    return static_cast<std::chrono::nanoseconds>(
+        static_cast<int64_t>(1e9 * cpu / CLOCKS_PER_SEC));
+  }
+
   const std::string name_;
   const int num_warmup_runs_;
   const int max_count_;
   int cur_count_ = 0;
   const std::chrono::nanoseconds benchmark_duration_;
-  std::chrono::nanoseconds total_duration_walltime_{};
-  std::chrono::nanoseconds total_duration_cpu_{};
-  std::chrono::time_point<std::chrono::steady_clock> cur_start_walltime_{};
-  std::clock_t cur_start_cpu_;
+  // Wall and CPU time at the start of the first run after the warm up period,
+  // and at the end of the last finished run.
+  Clock::time_point start_walltime_{};
+  Clock::time_point stop_walltime_{};
+  std::clock_t start_cpu_ = 0;
+  std::clock_t stop_cpu_ = 0;
   std::vector<std::chrono::nanoseconds> run_times_walltime_;
   // CPU run times in microseconds.
   std::vector<std::chrono::nanoseconds> run_times_cpu_;
+  // Hardware performance counters, started only if enabled by the
+  // TFRT_BENCHMARK_PERF_COUNTERS environment variable.
+  PerfCounters perf_counters_;
 };
 
+// Runs the benchmarked function in one of the two load generation modes:
+//
+//   Closed loop (target_qps == 0): keeps `num_concurrent_runs` function
+//   executions in flight, and starts a new execution as soon as one of them
+//   finishes. With a single concurrent run this measures the latency of a
+//   single stream of requests.
+//
+//   Open loop (target_qps > 0): starts function executions at the fixed rate
+//   of `target_qps` executions per second, independent of how many executions
+//   are still in flight. Executions are paced by the host context timer queue,
+//   and if the timer fires late all the overdue executions are started at
+//   once, so the average rate matches the target.
 class AsyncBenchmarkRunner {
  public:
-  AsyncBenchmarkRunner(BenchmarkStats bm_stats, const Function* func,
+  AsyncBenchmarkRunner(BenchmarkStats bm_stats, int num_concurrent_runs,
+                       int target_qps, const Function* func,
                        ArrayRef<AsyncValue*> args,
                        const ExecutionContext& exec_ctx)
       : bm_stats_(std::move(bm_stats)),
+        num_concurrent_runs_(num_concurrent_runs),
+        target_qps_(target_qps),
         func_{FormRef(func)},
         args_{args.begin(), args.end()},
         exec_ctx_(exec_ctx) {
@@ -180,17 +292,85 @@ class AsyncBenchmarkRunner {
 
   void Start(llvm::unique_function<void()> clean_up) {
     clean_up_ = std::move(clean_up);
-    StartNewRun();
+
+    if (target_qps_ > 0) {
+      {
+        mutex_lock lock(mu_);
+        next_arrival_ = BenchmarkStats::Clock::now();
+      }
+      StartScheduledRuns();
+      return;
+    }
+
+    llvm::SmallVector<BenchmarkStats::Run, 4> runs;
+    {
+      mutex_lock lock(mu_);
+      while (runs.size() < static_cast<size_t>(num_concurrent_runs_) &&
+             bm_stats_.MoreRun())
+        runs.push_back(StartRun());
+      if (runs.empty()) done_starting_runs_ = true;
+    }
+
+    if (runs.empty()) return Finish();
+    for (auto& run : runs) ExecuteRun(run);
   }
 
  private:
+  // Starts a new run and updates the number of runs in flight.
+  BenchmarkStats::Run StartRun() TFRT_REQUIRES(mu_) {
+    ++num_in_flight_;
+    return bm_stats_.StartRun();
+  }
+
+  // Starts a new open loop run that arrived at `arrival`.
+  BenchmarkStats::Run StartRun(BenchmarkStats::Clock::time_point arrival)
+      TFRT_REQUIRES(mu_) {
+    ++num_in_flight_;
+    return bm_stats_.StartRun(arrival);
+  }
+
+  // Start all the runs that are due according to the open loop schedule, and
+  // schedule a timer for the next one.
+  void StartScheduledRuns() {
+    using Clock = BenchmarkStats::Clock;
+    auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::nanoseconds(1000000000) / target_qps_);
+
+    llvm::SmallVector<BenchmarkStats::Run, 4> runs;
+    bool finished = false;
+    llvm::Optional<Clock::duration> next_arrival_in;
+    {
+      mutex_lock lock(mu_);
+      auto now = Clock::now();
+      while (next_arrival_ <= now && bm_stats_.MoreRun()) {
+        runs.push_back(StartRun(next_arrival_));
+        next_arrival_ += interval;
+      }
+
+      if (bm_stats_.MoreRun()) {
+        next_arrival_in = next_arrival_ - now;
+      } else {
+        done_starting_runs_ = true;
+        finished = num_in_flight_ == 0;
+      }
+    }
+
+    if (finished) return Finish();
+
+    if (next_arrival_in) {
+      exec_ctx_.host()->GetTimerQueue()->ScheduleTimer(
+          *next_arrival_in, [this] { StartScheduledRuns(); });
+    }
+
+    for (auto& run : runs) ExecuteRun(run);
+  }
+
   // Start benchmarking a new function execution.
-  void StartNewRun() {
-    bm_stats_.StartRun();
+  void ExecuteRun(BenchmarkStats::Run run) {
     // We need to run the actual work in the work queue to avoid exhausting the
     // stack space, otherwise, we will have very deep recursion of
     // Function::Execute -> AsyncValue::AndThen -> Function::Execute -> ...
-    EnqueueWork(exec_ctx_, [this] {
+    EnqueueWork(exec_ctx_, [this, run] {
       // The benchmarked function should return exactly one value.
       assert(func_->result_types().size() == 1);
 
@@ -199,23 +379,56 @@ class AsyncBenchmarkRunner {
 
       // AndThen() is called when the function execution finishes. We record the
       // execution time and start the next run in the AndThen() callback.
-      // Therefore, each of the function execution is run serially.
       auto* result_ptr = result.release();
-      result_ptr->AndThen([this, result_ptr]() mutable {
-        bm_stats_.StopRun();
+      result_ptr->AndThen([this, run, result_ptr]() {
         result_ptr->DropRef();
+        FinishRun(run);
+      });
+    });
+  }
 
+  void FinishRun(const BenchmarkStats::Run& run) {
+    llvm::Optional<BenchmarkStats::Run> next_run;
+    bool finished = false;
+    {
+      mutex_lock lock(mu_);
+      bm_stats_.StopRun(run);
+      --num_in_flight_;
+
+      // In the closed loop mode each finished run starts the next one. In the
+      // open loop mode runs are started only by the timer.
+      if (target_qps_ == 0 && !done_starting_runs_) {
         if (bm_stats_.MoreRun()) {
-          StartNewRun();
+          next_run = StartRun();
         } else {
-          bm_stats_.Summarize();
-          clean_up_();
+          done_starting_runs_ = true;
         }
-      });
-    });
+      }
+
+      finished = done_starting_runs_ && num_in_flight_ == 0;
+    }
+
+    if (next_run) ExecuteRun(*next_run);
+    if (finished) Finish();
   }
 
-  BenchmarkStats bm_stats_;
+  // Called once after all runs have finished.
+  void Finish() {
+    {
+      mutex_lock lock(mu_);
+      bm_stats_.Summarize();
+    }
+    clean_up_();
+  }
+
+  mutex mu_;
+  BenchmarkStats bm_stats_ TFRT_GUARDED_BY(mu_);
+  const int num_concurrent_runs_;
+  const int target_qps_;
+  int num_in_flight_ TFRT_GUARDED_BY(mu_) = 0;
+  bool done_starting_runs_ TFRT_GUARDED_BY(mu_) = false;
+  // Start time of the next run in the open loop mode.
+  BenchmarkStats::Clock::time_point next_arrival_ TFRT_GUARDED_BY(mu_);
   RCReference<const Function> func_;
   SmallVector<AsyncValue*, 4> args_;
   ExecutionContext exec_ctx_;
@@ -231,13 +444,19 @@ class AsyncBenchmarkRunner {
 // duration_secs: Benchmark duration in seconds.
 // max_count: Max run count of input function.
 // name: The name used to tag the benchmark results.
+// num_concurrent_runs: Number of function executions kept in flight in the
+//   closed loop mode.
 // num_warmup_runs: Number of warm up runs before benchmarking starts.
+// target_qps: If positive, start function executions at this rate in the open
+//   loop mode, and ignore num_concurrent_runs.
 // fn_const: The input function to be benchmarked.
 static void TestAsyncBenchmark(RemainingArguments args, Result<Chain> chain,
                                Attribute<int32_t> duration_secs,
                                Attribute<int32_t> max_count,
                                StringAttribute name,
+                               Attribute<int32_t> num_concurrent_runs,
                                Attribute<int32_t> num_warmup_runs,
+                               Attribute<int32_t> target_qps,
                                Attribute<Function> fn_const,
                                KernelErrorHandler handler,
                                const ExecutionContext& exec_ctx) {
@@ -250,10 +469,21 @@ static void TestAsyncBenchmark(RemainingArguments args, Result<Chain> chain,
     return;
   }
 
+  if (*num_concurrent_runs < 1) {
+    handler.ReportError("Benchmark op requires num_concurrent_runs >= 1");
+    return;
+  }
+
+  if (*target_qps < 0) {
+    handler.ReportError("Benchmark op requires target_qps >= 0");
+    return;
+  }
+
   BenchmarkStats bm_stats{name.str(), *num_warmup_runs, *max_count,
                           std::chrono::seconds(*duration_secs)};
-  auto benchmark_runner = new AsyncBenchmarkRunner(std::move(bm_stats), fn,
-                                                   args.values(), exec_ctx);
+  auto benchmark_runner = new AsyncBenchmarkRunner(
+      std::move(bm_stats), *num_concurrent_runs, *target_qps, fn,
+      args.values(), exec_ctx);
 
   benchmark_runner->Start([benchmark_runner, chain = chain.Allocate()] {
     chain.emplace();
@@ -305,9 +535,9 @@ static Error TestSyncBenchmark(RemainingSyncArguments args,
   BEFInterpreter interpreter{*fn};
 
   while (bm_stats.MoreRun()) {
-    bm_stats.StartRun();
+    auto run = bm_stats.StartRun();
     auto error = interpreter.Execute(exec_ctx, func_args, {});
-    bm_stats.StopRun();
+    bm_stats.StopRun(run);
     if (error) return error;
   }
 
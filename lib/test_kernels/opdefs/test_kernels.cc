@@ -193,6 +193,9 @@ static ParseResult parseBenchmarkOp(OpAsmParser &parser,
 
   // Set the default attribute num_warmup_runs to 1 if unset
   setDefaultAttrIfUnset("num_warmup_runs", 1);
+  // By default run a single function execution at a time.
+  setDefaultAttrIfUnset("num_concurrent_runs", 1);
+  setDefaultAttrIfUnset("target_qps", 0);
 
   Region *target = result.addRegion();
   return parser.parseRegion(*target, operands, types,
@@ -0,0 +1,210 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- perf_counters.cc -----------------------------------------*- C++ -*-===//
+//
+// This file implements hardware performance counters for the benchmark kernels.
+//
+//===----------------------------------------------------------------------===//
+
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace tfrt {
+
+bool PerfCounters::IsEnabled() {
+  const char* flag = std::getenv("TFRT_BENCHMARK_PERF_COUNTERS");
+  return flag && std::strcmp(flag, "0") != 0 && std::strcmp(flag, "") != 0;
+}
+
+PerfCounters::~PerfCounters() { Close(); }
+
+PerfCounters::PerfCounters(PerfCounters&& other)
+    : groups_(std::move(other.groups_)) {
+  other.groups_.clear();
+}
+
+PerfCounters& PerfCounters::operator=(PerfCounters&& other) {
+  if (this == &other) return *this;
+  Close();
+  groups_ = std::move(other.groups_);
+  other.groups_.clear();
+  return *this;
+}
+
+#ifdef __linux__
+
+// Opens the `counter` of the thread `tid` in the group led by `group_fd`, or as
+// a new group leader if `group_fd` is -1.
+static int PerfEventOpen(PerfCounters::Counter counter, pid_t tid,
+                         int group_fd) {
+  static constexpr uint64_t kConfig[PerfCounters::kNumCounters] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES,
+  };
+
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = kConfig[counter];
+  // Group members are enabled and disabled together with the leader.
+  attr.disabled = group_fd == -1;
+  // Counting only the user space events works with the default
+  // perf_event_paranoid level on most distributions.
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(__NR_perf_event_open, &attr, tid, /*cpu=*/-1, group_fd,
+                 /*flags=*/0);
+}
+
+// Returns the ids of all the threads of the current process.
+static std::vector<pid_t> ProcessThreads() {
+  std::vector<pid_t> tids;
+
+  DIR* dir = opendir("/proc/self/task");
+  if (!dir) return tids;
+
+  while (dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] == '.') continue;
+    tids.push_back(std::atoi(entry->d_name));
+  }
+
+  closedir(dir);
+  return tids;
+}
+
+bool PerfCounters::Start() {
+  Close();
+
+  // Open the cycles counter of every thread as the group leader.
+  for (pid_t tid : ProcessThreads()) {
+    int fd = PerfEventOpen(kCycles, tid, /*group_fd=*/-1);
+    // The thread might have exited after we listed the process threads.
+    if (fd < 0 && errno == ESRCH) continue;
+
+    if (fd < 0) {
+      Close();
+      return false;
+    }
+
+    groups_.push_back({tid, {{kCycles, fd}}});
+  }
+
+  // Add the other counters to the groups. Do not report partial counts if the
+  // counter is not available for some of the threads. Closing a group member
+  // removes it from the group.
+  for (int i = kCycles + 1; i < kNumCounters; ++i) {
+    auto counter = static_cast<Counter>(i);
+
+    bool available = true;
+    for (Group& group : groups_) {
+      // The thread might have exited after the leader was opened, in which case
+      // its counters stay at zero.
+      int fd = PerfEventOpen(counter, group.tid, group.fds.front().second);
+      if (fd < 0 && errno == ESRCH) continue;
+      if (fd < 0) {
+        available = false;
+        break;
+      }
+      group.fds.emplace_back(counter, fd);
+    }
+
+    if (available) continue;
+
+    for (Group& group : groups_) {
+      if (group.fds.back().first != counter) continue;
+      close(group.fds.back().second);
+      group.fds.pop_back();
+    }
+  }
+
+  for (Group& group : groups_) {
+    int leader = group.fds.front().second;
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  return !groups_.empty();
+}
+
+PerfCounters::Values PerfCounters::Read() const {
+  Values values;
+  if (groups_.empty()) return values;
+
+  std::array<double, kNumCounters> totals{};
+  std::array<bool, kNumCounters> available{};
+
+  for (const Group& group : groups_) {
+    // Number of counters, time enabled, time running and the counter values
+    // in the group order.
+    uint64_t buf[3 + kNumCounters];
+    size_t size = (3 + group.fds.size()) * sizeof(uint64_t);
+    if (read(group.fds.front().second, buf, size) !=
+            static_cast<ssize_t>(size) ||
+        buf[0] != group.fds.size())
+      return {};
+
+    for (const auto& counter : group.fds) available[counter.first] = true;
+
+    // Scale the values if the group was multiplexed with other events. All
+    // the counters of the group were scheduled at the same time.
+    if (buf[2] == 0) continue;
+    for (size_t i = 0; i < group.fds.size(); ++i)
+      totals[group.fds[i].first] += static_cast<double>(buf[3 + i]) * buf[1] /
+                                    buf[2];
+  }
+
+  for (int i = 0; i < kNumCounters; ++i)
+    if (available[i]) values[i] = static_cast<uint64_t>(totals[i]);
+
+  return values;
+}
+
+void PerfCounters::Close() {
+  // Close the group members before the leaders.
+  for (Group& group : groups_)
+    for (auto it = group.fds.rbegin(); it != group.fds.rend(); ++it)
+      close(it->second);
+  groups_.clear();
+}
+
+#else  // __linux__
+
+bool PerfCounters::Start() { return false; }
+
+PerfCounters::Values PerfCounters::Read() const { return {}; }
+
+void PerfCounters::Close() {}
+
+#endif  // __linux__
+
+}  // namespace tfrt
@@ -0,0 +1,93 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- perf_counters.h ------------------------------------------*- C++ -*-===//
+//
+// Hardware performance counters for the benchmark kernels.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_LIB_TEST_KERNELS_PERF_COUNTERS_H_
+#define TFRT_LIB_TEST_KERNELS_PERF_COUNTERS_H_
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/Optional.h"
+
+namespace tfrt {
+
+// Hardware performance counters of all the threads of the current process,
+// collected with perf_event_open(2) on Linux.
+//
+// Counters are opened only for the threads that are running at the time of
+// the Start() call, which is fine for the benchmarks because the work queue
+// threads are created together with the host context. The counters of each
+// thread form a single event group led by the cycles counter, so that they are
+// scheduled on the PMU together and their ratios (e.g. IPC) are consistent
+// when the PMU is multiplexed. Counters that can't be opened (other platforms,
+// restrictive perf_event_paranoid, virtual machines without a PMU) are
+// reported as unavailable, and without the cycles counter none of the counters
+// are available.
+class PerfCounters {
+ public:
+  enum Counter {
+    kCycles,
+    kInstructions,
+    kCacheMisses,  // Usually last level cache misses.
+    kBranchMisses,
+    kNumCounters,
+  };
+
+  using Values = std::array<llvm::Optional<uint64_t>, kNumCounters>;
+
+  // Returns true if the performance counters collection is enabled by the
+  // TFRT_BENCHMARK_PERF_COUNTERS environment variable.
+  static bool IsEnabled();
+
+  PerfCounters() = default;
+  ~PerfCounters();
+
+  PerfCounters(PerfCounters&& other);
+  PerfCounters& operator=(PerfCounters&& other);
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // Opens, resets and enables the counters. Returns false if none of the
+  // counters are available.
+  bool Start();
+
+  // Returns the counter values accumulated since the Start() call, scaled to
+  // account for the time the counters were not scheduled on the PMU.
+  Values Read() const;
+
+ private:
+  void Close();
+
+  // Counters of a single thread in the group read order. The first one is the
+  // cycles counter, which is the group leader.
+  struct Group {
+    int tid;
+    std::vector<std::pair<Counter, int>> fds;
+  };
+
+  std::vector<Group> groups_;
+};
+
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_TEST_KERNELS_PERF_COUNTERS_H_
@@ -0,0 +1,167 @@
+// Copyright 2020 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- kernel_profile_tracing_sink.cc - Kernel Profile Sink -----*- C++ -*-===//
+//
+// This file implements a tracing sink which aggregates the wall time of
+// tracing scopes into a kernel cost profile.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tfrt/tracing/kernel_profile_tracing_sink/kernel_profile_tracing_sink.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "tfrt/support/logging.h"
+
+namespace tfrt {
+namespace tracing {
+
+// Per-thread scope stack and aggregated scope times. The mutex is only
+// contended while the profile is written.
+class KernelProfileTracingSink::ThreadProfile {
+  using Time = std::chrono::steady_clock::time_point;
+
+ public:
+  struct Stats {
+    int64_t num_calls = 0;
+    int64_t total_ns = 0;
+  };
+
+  void PushScope(std::string&& name) {
+    stack_.emplace_back(std::move(name), std::chrono::steady_clock::now());
+  }
+
+  void PopScope() {
+    // Scopes pushed before tracing was enabled are not on the stack.
+    if (stack_.empty()) return;
+    auto end = std::chrono::steady_clock::now();
+    auto& scope = stack_.back();
+    auto duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end - std::get<Time>(scope));
+    {
+      mutex_lock lock(mu_);
+      auto& stats = stats_[std::get<std::string>(scope)];
+      ++stats.num_calls;
+      stats.total_ns += duration_ns.count();
+    }
+    stack_.pop_back();
+  }
+
+  // Adds the stats of this thread to `stats`.
+  void MergeInto(llvm::StringMap<Stats>* stats) const {
+    mutex_lock lock(mu_);
+    for (const auto& entry : stats_) {
+      auto& merged = (*stats)[entry.getKey()];
+      merged.num_calls += entry.getValue().num_calls;
+      merged.total_ns += entry.getValue().total_ns;
+    }
+  }
+
+ private:
+  // Only accessed by the owning thread.
+  llvm::SmallVector<std::tuple<std::string, Time>, 16> stack_;
+
+  mutable mutex mu_;
+  llvm::StringMap<Stats> stats_ TFRT_GUARDED_BY(mu_);
+};
+
+static int64_t NextSinkId() {
+  static std::atomic<int64_t> next_id{0};
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+KernelProfileTracingSink::KernelProfileTracingSink(std::string output_path)
+    : id_(NextSinkId()), output_path_(std::move(output_path)) {}
+
+KernelProfileTracingSink::~KernelProfileTracingSink() = default;
+
+KernelProfileTracingSink::ThreadProfile&
+KernelProfileTracingSink::GetThreadProfile() {
+  // Profiles are keyed by the sink id rather than its address, because a later
+  // sink may be allocated at the address of a destroyed one.
+  static thread_local llvm::SmallDenseMap<int64_t,
+                                          std::shared_ptr<ThreadProfile>, 2>
+      thread_profiles;
+  auto& thread_profile = thread_profiles[id_];
+  if (!thread_profile) {
+    thread_profile = std::make_shared<ThreadProfile>();
+    mutex_lock lock(mu_);
+    thread_profiles_.push_back(thread_profile);
+  }
+  return *thread_profile;
+}
+
+Error KernelProfileTracingSink::RequestTracing(bool enable) {
+  if (enable) return Error::success();
+
+  if (output_path_.empty()) {
+    WriteProfile(llvm::errs());
+    return Error::success();
+  }
+
+  std::error_code error_code;
+  llvm::raw_fd_ostream os(output_path_, error_code, llvm::sys::fs::OF_Text);
+  if (error_code) {
+    TFRT_LOG(ERROR) << "Failed to write kernel profile to " << output_path_
+                    << ": " << error_code.message();
+    return llvm::errorCodeToError(error_code);
+  }
+  WriteProfile(os);
+  return Error::success();
+}
+
+void KernelProfileTracingSink::RecordTracingEvent(NameGenerator gen_name) {
+  // Instant events have no cost.
+}
+
+void KernelProfileTracingSink::PushTracingScope(NameGenerator gen_name) {
+  GetThreadProfile().PushScope(gen_name());
+}
+
+void KernelProfileTracingSink::PopTracingScope() {
+  GetThreadProfile().PopScope();
+}
+
+void KernelProfileTracingSink::WriteProfile(llvm::raw_ostream& os) const {
+  llvm::StringMap<ThreadProfile::Stats> stats;
+  {
+    mutex_lock lock(mu_);
+    for (const auto& thread_profile : thread_profiles_)
+      thread_profile->MergeInto(&stats);
+  }
+
+  // Sort by name for a deterministic output.
+  std::vector<llvm::StringRef> names;
+  names.reserve(stats.size());
+  for (const auto& entry : stats) names.push_back(entry.getKey());
+  llvm::sort(names);
+
+  os << "# <number of calls> <total wall time in nanoseconds> <name>\n";
+  for (llvm::StringRef name : names) {
+    const auto& entry = stats[name];
+    os << entry.num_calls << " " << entry.total_ns << " " << name << "\n";
+  }
+}
+
+}  // namespace tracing
+}  // namespace tfrt
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 // RUN: bef_executor_lite $(bef_name %s) 2>&1 | FileCheck %s --dump-input=fail
+// RUN: bef_executor_lite --lazy_bef_open $(bef_name %s) 2>&1 | FileCheck %s --dump-input=fail
 
 // CHECK: --- Running 'print_test'
 func @print_test() {
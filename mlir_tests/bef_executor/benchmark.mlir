@@ -68,3 +68,76 @@ func @benchmark2() {
 
   tfrt.return
 }
+
+// A function to measure the per-call overhead of the BEF executor for a small
+// function, where setting up the executor registers and kernels is a large
+// fraction of the execution time.
+// CHECK-LABEL: --- Running 'benchmark_small_function'
+func @benchmark_small_function() {
+  // CHECK: BM:small_function:Duration(ns):
+  // CHECK: BM:small_function:Count: 1000
+  // CHECK: BM:small_function:Time Min(ns):
+  // CHECK: BM:small_function:Time 50%(ns):
+  // CHECK: BM:small_function:Time 95%(ns):
+  // CHECK: BM:small_function:Time 99%(ns):
+  // CHECK: BM:small_function:CPU Min(ns):
+  // CHECK: BM:small_function:CPU 50%(ns):
+  // CHECK: BM:small_function:CPU 95%(ns):
+  // CHECK: BM:small_function:CPU 99%(ns):
+  // CHECK: BM:small_function:CPU utilization(percent):
+
+  tfrt_test.benchmark "small_function"() duration_secs = 1, max_count = 1000, num_warmup_runs = 10
+  {
+    %c = tfrt.constant.i32 1
+    %x = tfrt.add.i32 %c, %c
+    %y = tfrt.add.i32 %x, %c
+    %z = tfrt.add.i32 %y, %x
+    tfrt.return %z : i32
+  }
+
+  tfrt.return
+}
+
+// A function to demonstrate the closed loop benchmark mode, which keeps
+// multiple executions of the benchmarked function in flight.
+// CHECK-LABEL: --- Running 'benchmark_concurrent'
+func @benchmark_concurrent() {
+  // CHECK: BM:concurrent:Duration(ns):
+  // CHECK: BM:concurrent:Count: 100
+  // CHECK: BM:concurrent:Time 50%(ns):
+  // CHECK: BM:concurrent:Time 99%(ns):
+  // CHECK: BM:concurrent:Time 99.9%(ns):
+  // CHECK: BM:concurrent:Time Max(ns):
+  // CHECK: BM:concurrent:Throughput(qps):
+
+  %c = tfrt.constant.i32 42
+
+  tfrt_test.benchmark "concurrent"(%c : i32) duration_secs = 1, max_count = 100, num_concurrent_runs = 4
+  {
+    %x = tfrt.add.i32 %c, %c
+    tfrt.return %x : i32
+  }
+
+  tfrt.return
+}
+
+// A function to demonstrate the open loop benchmark mode, which starts
+// executions of the benchmarked function at a fixed rate.
+// CHECK-LABEL: --- Running 'benchmark_target_qps'
+func @benchmark_target_qps() {
+  // CHECK: BM:target_qps:Duration(ns):
+  // CHECK: BM:target_qps:Count: 100
+  // CHECK: BM:target_qps:Time 50%(ns):
+  // CHECK: BM:target_qps:Time 99%(ns):
+  // CHECK: BM:target_qps:Throughput(qps):
+
+  %c = tfrt.constant.i32 42
+
+  tfrt_test.benchmark "target_qps"(%c : i32) duration_secs = 1, max_count = 100, target_qps = 1000
+  {
+    %x = tfrt.add.i32 %c, %c
+    tfrt.return %x : i32
+  }
+
+  tfrt.return
+}
@@ -22,16 +22,39 @@ lib/test_kernels/benchmark_kernels.cc).
 
 The following metrics are collected:
 
-  Duration(us): The total benchmark duration for this function in microseconds
+  Duration(ns): The total benchmark duration for this function in nanoseconds
   Count: The total number of runs for this function
-  Time Min(us): The minimum wall time for this function in microseconds
-  Time 50%(us): The median (50%) wall time for this function in microseconds
-  Time 95%(us): The 95 percentile wall time for this function in microseconds
-  Time 99%(us): The 99 percentile wall time for this function in microseconds
-  CPU Min(us): The minimum CPU time for this function in microseconds
-  CPU 50%(us): The median (50%) CPU time for this function in microseconds
-  CPU 95%(us): The 95 percentile CPU time for this function in microseconds
-  CPU 99%(us): The 99 percentile CPU time for this function in microseconds
+  Time Min(ns): The minimum wall time for this function in nanoseconds
+  Time 50%(ns): The median (50%) wall time for this function in nanoseconds
+  Time 95%(ns): The 95 percentile wall time for this function in nanoseconds
+  Time 99%(ns): The 99 percentile wall time for this function in nanoseconds
+  Time 99.9%(ns): The 99.9 percentile wall time for this function in
+    nanoseconds
+  Time Max(ns): The maximum wall time for this function in nanoseconds
+  CPU Min(ns): The minimum CPU time for this function in nanoseconds
+  CPU 50%(ns): The median (50%) CPU time for this function in nanoseconds
+  CPU 95%(ns): The 95 percentile CPU time for this function in nanoseconds
+  CPU 99%(ns): The 99 percentile CPU time for this function in nanoseconds
+  CPU utilization(percent): The process CPU time over the benchmark duration
+  Throughput(qps): The number of runs per second achieved by the benchmark
+
+With --perf_counters the benchmark kernel also collects hardware performance
+counters with perf_event_open (Linux only). The counters are summed over all
+threads of the process for the benchmark duration, so they include the work
+queue threads spinning while waiting for work. Counters that are not available
+(e.g. because of kernel.perf_event_paranoid or a virtual machine without a
+PMU) are omitted, and are printed as '-' in the table.
+
+  Cycles/run: The average number of CPU cycles per run
+  Instructions/run: The average number of retired instructions per run
+  IPC: The number of instructions per cycle
+  LLC misses/run: The average number of last level cache misses per run
+  Branch misses/run: The average number of mispredicted branches per run
+
+Functions benchmarked with num_concurrent_runs > 1 (closed loop) or with
+target_qps > 0 (open loop) run several executions concurrently, so the
+throughput is not the inverse of the latency, and the per-run CPU time
+includes the CPU time of the other executions in flight.
 
 Usage:
 
@@ -86,19 +109,21 @@ def print_perf_results(results, cpu_info):
   print('Num cores: {}'.format(cpu_info['num_cpus']))
   print('Frequency: {} MHz'.format(cpu_info['mhz_per_cpu']))
 
-  metrics = None
-  row_format = None
+  # Collect the union of the metrics reported by all functions, keeping the
+  # order in which the benchmark kernel reports them. Metrics missing for a
+  # function (e.g. reported by an older benchmark kernel) are printed as '-'.
+  metrics = []
+  for res_dict in results.values():
+    metrics.extend(m for m in res_dict if m not in metrics)
 
-  for name, res_dict in results.items():
-    if not metrics:
-      metrics = res_dict.keys()
-      row_format = '{:<25}' + '{:^15}' * len(metrics)
+  row_format = '{:<25}' + '{:^15}' * len(metrics)
 
-      # print the header.
-      print(row_format.format('', *metrics))
+  # print the header.
+  print(row_format.format('', *metrics))
 
-    results = [res_dict[m] for m in metrics]
-    print(row_format.format(name, *results))
+  for name, res_dict in results.items():
+    values = [res_dict.get(m, '-') for m in metrics]
+    print(row_format.format(name, *values))
 
 
 def run_benchmark(env: Env, in_file):
@@ -137,6 +162,10 @@ def main():
       '--work_queue_type',
       default='s',
       help='Type of work queue (s(default), mstd, ...)')
+  parser.add_argument(
+      '--perf_counters',
+      action='store_true',
+      help='Collect hardware performance counters (IPC, LLC misses, ...)')
   parser.add_argument(
       '--tfrt_translate',
       default=os.path.join(BUILD_DIR, 'tools/tfrt_translate'),
@@ -149,7 +178,7 @@ def main():
   args = parser.parse_args()
 
   env = Env(args.tfrt_translate, args.bef_executor, args.host_allocator_type,
-            args.work_queue_type)
+            args.work_queue_type, args.perf_counters)
 
   # Run through each of the input mlir files.
   print('-' * 40)
@@ -22,6 +22,7 @@ from __future__ import print_function
 import collections
 from cpuinfo import cpuinfo
 from datetime import datetime
+import os
 import re
 import subprocess
 
@@ -31,13 +32,18 @@ STR_ENCODING = 'utf-8'
 class Env:
   """Runtime environment."""
 
-  def __init__(self, tfrt_translate, bef_executor, host_allocator_type,
-               work_queue_type):
+  def __init__(self,
+               tfrt_translate,
+               bef_executor,
+               host_allocator_type,
+               work_queue_type,
+               perf_counters=False):
     """Initialize various runtime env parameters."""
     self.tfrt_translate = tfrt_translate
     self.bef_executor = bef_executor
     self.host_allocator_type = host_allocator_type
     self.work_queue_type = work_queue_type
+    self.perf_counters = perf_counters
 
   def run_mlir(self, in_str, additional_executor_flags=''):
     """Execute the given mlir.
@@ -60,11 +66,17 @@ class Env:
                                           additional_executor_flags,
                                           self.host_allocator_type,
                                           self.work_queue_type)
+    env = dict(os.environ)
+    if self.perf_counters:
+      # Enables hardware performance counters in the benchmark kernel.
+      env['TFRT_BENCHMARK_PERF_COUNTERS'] = '1'
+
     proc = subprocess.run(
         cmd,
         input=in_str.encode(STR_ENCODING),
         shell=True,
         check=True,
+        env=env,
         stdout=subprocess.PIPE,
         stderr=subprocess.PIPE)
 
@@ -0,0 +1,46 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// RUN: echo "4 8000 tfrt.constant.i32" > %t
+// RUN: echo "2 100000 tfrt.add.i32" >> %t
+// RUN: tfrt_opt -tfrt-apply-cost-profile="profile=%t cost-threshold=10" -tfrt-print-stream -verify-diagnostics %s
+
+// With 1us per unit of cost, tfrt.constant.i32 costs 2 and tfrt.add.i32 costs
+// 50. Operations not in the profile cost the threshold (10).
+
+// expected-remark@+1 {{stream id: 0, stream cost: 17, parent stream: -1}}
+func @cheap_kernels_stay_inline() -> (i32, i32, i32) {
+  // %0, %1, and %2 are independent, but they are measured to be cheap, so
+  // they are merged into the root stream.
+  // expected-remark@+1 {{stream id: 0, stream cost: 17, parent stream: -1}}
+  %0 = tfrt.constant.i32 0
+  // expected-remark@+1 {{stream id: 0, stream cost: 17, parent stream: -1}}
+  %1 = tfrt.constant.i32 1
+  // expected-remark@+1 {{stream id: 0, stream cost: 17, parent stream: -1}}
+  %2 = tfrt.constant.i32 2
+  // expected-remark@+1 {{stream id: 0, stream cost: 17, parent stream: -1}}
+  tfrt.return %0, %1, %2 : i32, i32, i32
+}
+
+// expected-remark@+1 {{stream id: 0, stream cost: 61, parent stream: -1}}
+func @expensive_kernels_split(%a: i32) -> (i32, i32) {
+  // %0 and %1 are independent and measured to be expensive, so %1 is split
+  // off into its own stream.
+  // expected-remark@+1 {{stream id: 0, stream cost: 61, parent stream: -1}}
+  %0 = "tfrt.add.i32"(%a, %a) : (i32, i32) -> i32
+  // expected-remark@+1 {{stream id: 1, stream cost: 50, parent stream: 0}}
+  %1 = "tfrt.add.i32"(%a, %a) : (i32, i32) -> i32
+  // expected-remark@+1 {{stream id: 0, stream cost: 61, parent stream: -1}}
+  tfrt.return %0, %1 : i32, i32
+}
@@ -0,0 +1,29 @@
+// Copyright 2021 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// RUN: env TFRT_KERNEL_PROFILE_PATH=%t bef_executor_kernel_profile --enable_tracing --tracing_level=debug $(bef_name %s)
+// RUN: FileCheck %s --input-file=%t --dump-input=fail
+
+// CHECK: # <number of calls> <total wall time in nanoseconds> <name>
+// CHECK-DAG: {{^}}3 {{[0-9]+}} tfrt.add.i32{{$}}
+// CHECK-DAG: {{^}}1 {{[0-9]+}} tfrt.print.i32{{$}}
+func @profile_test() {
+  %ch0 = tfrt.new.chain
+  %a = tfrt.constant.i32 1
+  %b = "tfrt.add.i32"(%a, %a) : (i32, i32) -> i32
+  %c = "tfrt.add.i32"(%b, %b) : (i32, i32) -> i32
+  %d = "tfrt.add.i32"(%c, %c) : (i32, i32) -> i32
+  %ch1 = tfrt.print.i32 %d, %ch0
+  tfrt.return
+}
@@ -8,14 +8,21 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <vector>
 
+#include "benchmark/benchmark.h"
 #include "gtest/gtest.h"
 #include "tfrt/host_context/async_dispatch.h"
 #include "tfrt/host_context/concurrent_work_queue.h"
 #include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
 #include "tfrt/host_context/host_allocator.h"
 #include "tfrt/host_context/host_context.h"
+#include "tfrt/support/latch.h"
+#include "tfrt/support/mutex.h"
 
 namespace tfrt {
 namespace {
@@ -26,6 +33,22 @@ std::unique_ptr<HostContext> CreateTestHostContext(int num_threads) {
       CreateMultiThreadedWorkQueue(num_threads, num_threads));
 }
 
+std::unique_ptr<HostContext> CreatePriorityTestHostContext(int num_threads) {
+  return std::make_unique<HostContext>(
+      [](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+      CreateMultiThreadedPriorityWorkQueue(num_threads, num_threads));
+}
+
+ExecutionContext CreateExecutionContext(HostContext* host, int priority) {
+  RequestOptions request_options;
+  request_options.priority = priority;
+  auto req_ctx = RequestContextBuilder(host, /*resource_context=*/nullptr)
+                     .set_request_options(request_options)
+                     .build();
+  assert(req_ctx);
+  return ExecutionContext(std::move(*req_ctx));
+}
+
 TEST(MultiThreadedWorkQueueTest, PingPong) {
   auto host = CreateTestHostContext(4);
 
@@ -54,5 +77,140 @@ TEST(MultiThreadedWorkQueueTest, PingPong) {
   ASSERT_EQ(last_executed_task, num_tasks - 1);
 }
 
+TEST(MultiThreadedWorkQueueTest, PriorityPingPong) {
+  auto host = CreatePriorityTestHostContext(4);
+  ExecutionContext exec_ctx = CreateExecutionContext(host.get(), 1);
+
+  std::atomic<int64_t> last_executed_task = -1;
+  const int64_t num_tasks = 10000;
+
+  llvm::unique_function<void(int64_t)> enqueue;
+  enqueue = [&](int64_t n) {
+    if (n >= num_tasks) return;
+    last_executed_task = n;
+
+    if (n % 2 == 0) {
+      EnqueueWork(exec_ctx, [&, n]() { enqueue(n + 1); });
+    } else {
+      bool enqueued =
+          EnqueueBlockingWork(host.get(), [&, n]() { enqueue(n + 1); });
+      if (!enqueued) last_executed_task = -100;
+    }
+  };
+
+  enqueue(0);
+  host->Quiesce();
+  ASSERT_EQ(last_executed_task, num_tasks - 1);
+}
+
+TEST(MultiThreadedWorkQueueTest, HighPriorityTasksRunFirst) {
+  auto host = CreatePriorityTestHostContext(1);
+  ExecutionContext low_priority = CreateExecutionContext(host.get(), -1);
+  ExecutionContext high_priority = CreateExecutionContext(host.get(), 1);
+
+  // Keep the only worker thread busy until all tasks are submitted.
+  tfrt::latch started(1);
+  tfrt::latch release(1);
+  EnqueueWork(host.get(), [&]() {
+    started.count_down();
+    release.wait();
+  });
+  started.wait();
+
+  const int num_tasks = 10;
+  tfrt::latch done(2 * num_tasks);
+  std::vector<int> executed;
+
+  for (int i = 0; i < num_tasks; ++i) {
+    EnqueueWork(low_priority, [&]() {
+      executed.push_back(-1);
+      done.count_down();
+    });
+    EnqueueWork(high_priority, [&]() {
+      executed.push_back(1);
+      done.count_down();
+    });
+  }
+
+  release.count_down();
+  done.wait();
+  host->Quiesce();
+
+  ASSERT_EQ(executed.size(), 2 * num_tasks);
+  for (int i = 0; i < num_tasks; ++i) EXPECT_EQ(executed[i], 1);
+  for (int i = num_tasks; i < 2 * num_tasks; ++i) EXPECT_EQ(executed[i], -1);
+}
+
+// Measures the queueing latency of high priority requests competing with low
+// priority batch requests for the same work queue. Each low priority task
+// keeps a worker thread busy for ~20us, and every tenth submitted task is a
+// high priority task that records the time it spent in the queue.
+//
+// Reports p50 and p99 latency (in microseconds) of the high priority tasks.
+void HighPriorityLatency(HostContext* host, benchmark::State& state) {
+  using Clock = std::chrono::steady_clock;
+
+  const int num_tasks = state.range(0);
+  ExecutionContext low_priority = CreateExecutionContext(host, -1);
+  ExecutionContext high_priority = CreateExecutionContext(host, 1);
+
+  mutex mu;
+  std::vector<double> latencies_us;
+
+  for (auto _ : state) {
+    tfrt::latch done(num_tasks);
+
+    for (int i = 0; i < num_tasks; ++i) {
+      if (i % 10 == 0) {
+        EnqueueWork(high_priority, [&, enqueued = Clock::now()]() {
+          auto latency = Clock::now() - enqueued;
+          {
+            mutex_lock lock(mu);
+            latencies_us.push_back(
+                std::chrono::duration<double, std::micro>(latency).count());
+          }
+          done.count_down();
+        });
+      } else {
+        EnqueueWork(low_priority, [&]() {
+          auto deadline = Clock::now() + std::chrono::microseconds(20);
+          while (Clock::now() < deadline) {
+          }
+          done.count_down();
+        });
+      }
+    }
+
+    done.wait();
+  }
+
+  std::sort(latencies_us.begin(), latencies_us.end());
+  auto percentile = [&](double p) -> double {
+    if (latencies_us.empty()) return 0.0;
+    size_t idx = static_cast<size_t>(p * (latencies_us.size() - 1));
+    return latencies_us[idx];
+  };
+
+  state.counters["p50_us"] = percentile(0.50);
+  state.counters["p99_us"] = percentile(0.99);
+  state.SetItemsProcessed(num_tasks * state.iterations());
+}
+
+static void BM_HighPriorityLatency(benchmark::State& state) {
+  auto host = CreateTestHostContext(4);
+  HighPriorityLatency(host.get(), state);
+}
+
+static void BM_HighPriorityLatencyWithPriorities(benchmark::State& state) {
+  auto host = CreatePriorityTestHostContext(4);
+  HighPriorityLatency(host.get(), state);
+}
+
+BENCHMARK(BM_HighPriorityLatency)->UseRealTime()->Arg(1000)->Arg(2000);
+BENCHMARK(BM_HighPriorityLatencyWithPriorities)
+    ->UseRealTime()
+    ->Arg(1000)
+    ->Arg(2000);
+
 }  // namespace
 }  // namespace tfrt
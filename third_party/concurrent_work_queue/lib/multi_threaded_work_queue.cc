@@ -14,9 +14,11 @@
 
 #include "blocking_work_queue.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "non_blocking_priority_work_queue.h"
 #include "non_blocking_work_queue.h"
 #include "tfrt/host_context/async_value.h"
 #include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/execution_context.h"
 #include "tfrt/host_context/task_function.h"
 #include "tfrt/support/latch.h"
 #include "tfrt/support/ref_count.h"
@@ -25,19 +27,19 @@
 
 namespace tfrt {
 
-class MultiThreadedWorkQueue : public ConcurrentWorkQueue {
- public:
-  MultiThreadedWorkQueue(int num_threads, int num_blocking_threads);
-  ~MultiThreadedWorkQueue() override;
+namespace {
 
-  std::string name() const override {
-    return StrCat("Multi-threaded C++ work queue (", num_threads_, " threads, ",
-                  num_blocking_threads_, " blocking threads)");
-  }
+// MultiThreadedWorkQueueBase composes a non-blocking work queue for compute
+// tasks with a blocking work queue for tasks that wait on external events. The
+// type of the non-blocking work queue defines how compute tasks are scheduled.
+template <typename NonBlockingQueue>
+class MultiThreadedWorkQueueBase : public ConcurrentWorkQueue {
+ public:
+  MultiThreadedWorkQueueBase(int num_threads, int num_blocking_threads);
+  ~MultiThreadedWorkQueueBase() override;
 
   int GetParallelismLevel() const final { return num_threads_; }
 
-  void AddTask(TaskFunction task) final;
   Optional<TaskFunction> AddBlockingTask(TaskFunction task,
                                          bool allow_queuing) final;
   void Quiesce() final;
@@ -45,34 +47,34 @@ class MultiThreadedWorkQueue : public ConcurrentWorkQueue {
 
   bool IsInWorkerThread() const final;
 
- private:
+ protected:
   const int num_threads_;
   const int num_blocking_threads_;
 
   std::unique_ptr<internal::QuiescingState> quiescing_state_;
-  internal::NonBlockingWorkQueue<ThreadingEnvironment> non_blocking_work_queue_;
+  NonBlockingQueue non_blocking_work_queue_;
   internal::BlockingWorkQueue<ThreadingEnvironment> blocking_work_queue_;
 };
 
-MultiThreadedWorkQueue::MultiThreadedWorkQueue(int num_threads,
-                                               int num_blocking_threads)
+template <typename NonBlockingQueue>
+MultiThreadedWorkQueueBase<NonBlockingQueue>::MultiThreadedWorkQueueBase(
+    int num_threads, int num_blocking_threads)
     : num_threads_(num_threads),
       num_blocking_threads_(num_blocking_threads),
       quiescing_state_(std::make_unique<internal::QuiescingState>()),
       non_blocking_work_queue_(quiescing_state_.get(), num_threads),
       blocking_work_queue_(quiescing_state_.get(), num_blocking_threads) {}
 
-MultiThreadedWorkQueue::~MultiThreadedWorkQueue() {
+template <typename NonBlockingQueue>
+MultiThreadedWorkQueueBase<NonBlockingQueue>::~MultiThreadedWorkQueueBase() {
   // Pending tasks in the underlying queues might submit new tasks to each other
   // during destruction.
   Quiesce();
 }
 
-void MultiThreadedWorkQueue::AddTask(TaskFunction task) {
-  non_blocking_work_queue_.AddTask(std::move(task));
-}
-
-Optional<TaskFunction> MultiThreadedWorkQueue::AddBlockingTask(
+template <typename NonBlockingQueue>
+Optional<TaskFunction>
+MultiThreadedWorkQueueBase<NonBlockingQueue>::AddBlockingTask(
     TaskFunction task, bool allow_queuing) {
   if (allow_queuing) {
     return blocking_work_queue_.EnqueueBlockingTask(std::move(task));
@@ -81,7 +83,8 @@ Optional<TaskFunction> MultiThreadedWorkQueue::AddBlockingTask(
   }
 }
 
-void MultiThreadedWorkQueue::Quiesce() {
+template <typename NonBlockingQueue>
+void MultiThreadedWorkQueueBase<NonBlockingQueue>::Quiesce() {
   // Turn on pending tasks counter inside both work queues.
   auto quiescing = internal::Quiescing::Start(quiescing_state_.get());
 
@@ -101,7 +104,9 @@ void MultiThreadedWorkQueue::Quiesce() {
   }
 }
 
-void MultiThreadedWorkQueue::Await(ArrayRef<RCReference<AsyncValue>> values) {
+template <typename NonBlockingQueue>
+void MultiThreadedWorkQueueBase<NonBlockingQueue>::Await(
+    ArrayRef<RCReference<AsyncValue>> values) {
   // We might block on a latch waiting for the completion of all tasks, and
   // this is not allowed to do inside non blocking work queue.
   non_blocking_work_queue_.CheckCallerThread("MultiThreadedWorkQueue::Await");
@@ -118,10 +123,85 @@ void MultiThreadedWorkQueue::Await(ArrayRef<RCReference<AsyncValue>> values) {
   values_remaining.wait();
 }
 
-bool MultiThreadedWorkQueue::IsInWorkerThread() const {
+template <typename NonBlockingQueue>
+bool MultiThreadedWorkQueueBase<NonBlockingQueue>::IsInWorkerThread() const {
   return non_blocking_work_queue_.IsInWorkerThread();
 }
 
+//===----------------------------------------------------------------------===//
+// MultiThreadedWorkQueue ignores the execution context of the tasks.
+//===----------------------------------------------------------------------===//
+
+class MultiThreadedWorkQueue
+    : public MultiThreadedWorkQueueBase<
+          internal::NonBlockingWorkQueue<ThreadingEnvironment>> {
+ public:
+  using MultiThreadedWorkQueueBase::MultiThreadedWorkQueueBase;
+
+  std::string name() const override {
+    return StrCat("Multi-threaded C++ work queue (", num_threads_, " threads, ",
+                  num_blocking_threads_, " blocking threads)");
+  }
+
+  void AddTask(TaskFunction task) final {
+    non_blocking_work_queue_.AddTask(std::move(task));
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// PriorityMultiThreadedWorkQueue schedules non-blocking tasks according to the
+// priority of the request they belong to.
+//===----------------------------------------------------------------------===//
+
+// Task priority of a request, stored in the request context data when the
+// request is initialized by the PriorityMultiThreadedWorkQueue.
+struct RequestTaskPriority {
+  internal::TaskPriority priority;
+};
+
+internal::TaskPriority ToTaskPriority(
+    RequestOptions::RequestPriority priority) {
+  if (priority >= 2) return internal::TaskPriority::kCritical;
+  if (priority == 1) return internal::TaskPriority::kHigh;
+  if (priority == 0) return internal::TaskPriority::kDefault;
+  return internal::TaskPriority::kLow;
+}
+
+class PriorityMultiThreadedWorkQueue
+    : public MultiThreadedWorkQueueBase<
+          internal::NonBlockingPriorityWorkQueue<ThreadingEnvironment>> {
+ public:
+  using MultiThreadedWorkQueueBase::MultiThreadedWorkQueueBase;
+
+  std::string name() const override {
+    return StrCat("Multi-threaded C++ priority work queue (", num_threads_,
+                  " threads, ", num_blocking_threads_, " blocking threads)");
+  }
+
+  Error InitRequest(RequestContextBuilder* ctx_builder) final {
+    ctx_builder->context_data().emplace<RequestTaskPriority>(
+        RequestTaskPriority{
+            ToTaskPriority(ctx_builder->request_options().priority)});
+    return Error::success();
+  }
+
+  void AddTask(TaskFunction task) final {
+    non_blocking_work_queue_.AddTask(std::move(task));
+  }
+
+  void AddTask(const ExecutionContext& exec_ctx, TaskFunction task) final {
+    RequestContext* req_ctx = exec_ctx.request_ctx();
+    RequestTaskPriority* request_priority =
+        req_ctx ? req_ctx->GetDataIfExists<RequestTaskPriority>() : nullptr;
+    non_blocking_work_queue_.AddTask(std::move(task),
+                                     request_priority
+                                         ? request_priority->priority
+                                         : internal::TaskPriority::kDefault);
+  }
+};
+
+}  // namespace
+
 std::unique_ptr<ConcurrentWorkQueue> CreateMultiThreadedWorkQueue(
     int num_threads, int num_blocking_threads) {
   assert(num_threads > 0 && num_blocking_threads > 0);
@@ -129,4 +209,11 @@ std::unique_ptr<ConcurrentWorkQueue> CreateMultiThreadedWorkQueue(
                                                   num_blocking_threads);
 }
 
+std::unique_ptr<ConcurrentWorkQueue> CreateMultiThreadedPriorityWorkQueue(
+    int num_threads, int num_blocking_threads) {
+  assert(num_threads > 0 && num_blocking_threads > 0);
+  return std::make_unique<PriorityMultiThreadedWorkQueue>(num_threads,
+                                                          num_blocking_threads);
+}
+
 }  // namespace tfrt
@@ -0,0 +1,158 @@
+// This file is part of Eigen, a lightweight C++ template library
+// for linear algebra.
+//
+// Copyright (C) 2016 Dmitry Vyukov <dvyukov@google.com>
+//
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//===- non_blocking_priority_work_queue.h -----------------------*- C++ -*-===//
+//
+// Work queue implementation based on non-blocking concurrency primitives
+// optimized for CPU intensive non-blocking compute tasks, with a support of
+// task priorities.
+//
+// This work queue is identical to the NonBlockingWorkQueue, except that it uses
+// TaskPriorityDeque for storing pending tasks. Worker threads always pick the
+// task with the highest priority from their own queue (and from the queue they
+// steal from), so that latency critical tasks are not stuck behind a long tail
+// of low priority tasks submitted to the same thread.
+//
+// Priorities are not global: a high priority task in one worker queue does not
+// preempt a low priority task in another worker queue, and tasks that are
+// already running are never preempted.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TFRT_THIRD_PARTY_CONCURRENT_WORK_QUEUE_NON_BLOCKING_PRIORITY_WORK_QUEUE_H_
+#define TFRT_THIRD_PARTY_CONCURRENT_WORK_QUEUE_NON_BLOCKING_PRIORITY_WORK_QUEUE_H_
+
+#include "llvm/Support/Compiler.h"
+#include "task_priority_deque.h"
+#include "tfrt/host_context/task_function.h"
+#include "work_queue_base.h"
+
+namespace tfrt {
+namespace internal {
+
+template <typename ThreadingEnvironment>
+class NonBlockingPriorityWorkQueue;
+
+template <typename ThreadingEnvironmentTy>
+struct WorkQueueTraits<NonBlockingPriorityWorkQueue<ThreadingEnvironmentTy>> {
+  using ThreadingEnvironment = ThreadingEnvironmentTy;
+  using Thread = typename ThreadingEnvironment::Thread;
+  using Queue = ::tfrt::internal::TaskPriorityDeque;
+};
+
+template <typename ThreadingEnvironment>
+class NonBlockingPriorityWorkQueue
+    : public WorkQueueBase<NonBlockingPriorityWorkQueue<ThreadingEnvironment>> {
+  using Base =
+      WorkQueueBase<NonBlockingPriorityWorkQueue<ThreadingEnvironment>>;
+
+  using Queue = typename Base::Queue;
+  using Thread = typename Base::Thread;
+  using PerThread = typename Base::PerThread;
+  using ThreadData = typename Base::ThreadData;
+
+ public:
+  explicit NonBlockingPriorityWorkQueue(QuiescingState* quiescing_state,
+                                        int num_threads);
+  ~NonBlockingPriorityWorkQueue() = default;
+
+  void AddTask(TaskFunction task, TaskPriority priority);
+  void AddTask(TaskFunction task) {
+    AddTask(std::move(task), TaskPriority::kDefault);
+  }
+
+  using Base::Steal;
+
+ private:
+  static constexpr char const* kThreadNamePrefix =
+      "tfrt-non-blocking-priority-queue";
+
+  template <typename WorkQueue>
+  friend class WorkQueueBase;
+
+  using Base::GetPerThread;
+  using Base::IsNotifyParkedThreadRequired;
+  using Base::IsQuiescing;
+  using Base::WithPendingTaskCounter;
+
+  using Base::coprimes_;
+  using Base::event_count_;
+  using Base::num_threads_;
+  using Base::thread_data_;
+
+  LLVM_NODISCARD Optional<TaskFunction> NextTask(Queue* queue);
+  LLVM_NODISCARD Optional<TaskFunction> Steal(Queue* queue);
+  LLVM_NODISCARD bool Empty(Queue* queue);
+};
+
+template <typename ThreadingEnvironment>
+NonBlockingPriorityWorkQueue<
+    ThreadingEnvironment>::NonBlockingPriorityWorkQueue(QuiescingState*
+                                                            quiescing_state,
+                                                        int num_threads)
+    : WorkQueueBase<NonBlockingPriorityWorkQueue>(
+          quiescing_state, kThreadNamePrefix, num_threads) {}
+
+template <typename ThreadingEnvironment>
+void NonBlockingPriorityWorkQueue<ThreadingEnvironment>::AddTask(
+    TaskFunction task, TaskPriority priority) {
+  // Keep track of the number of pending tasks.
+  if (IsQuiescing()) task = WithPendingTaskCounter(std::move(task));
+
+  // If the worker queue is full, we will execute `task` in the current thread.
+  llvm::Optional<TaskFunction> inline_task;
+
+  // See NonBlockingWorkQueue::AddTask() for the details of the task placement
+  // and parked threads notification. The only difference is that the tasks are
+  // pushed into the deque of the requested priority level.
+  bool skip_notify = false;
+
+  PerThread* pt = GetPerThread();
+  if (pt->parent == this) {
+    // Worker thread of this pool, push onto the thread's queue.
+    Queue& q = thread_data_[pt->thread_id].queue;
+    skip_notify = q.Empty();
+    inline_task = q.PushFront(std::move(task), priority);
+  } else {
+    // A free-standing thread (or worker of another pool).
+    unsigned rnd = FastReduce(pt->rng(), num_threads_);
+    Queue& q = thread_data_[rnd].queue;
+    inline_task = q.PushBack(std::move(task), priority);
+  }
+
+  if (!inline_task.hasValue()) {
+    if (!skip_notify && IsNotifyParkedThreadRequired())
+      event_count_.Notify(/*notify_all=*/false);
+  } else {
+    (*inline_task)();  // Push failed, execute directly.
+  }
+}
+
+template <typename ThreadingEnvironment>
+LLVM_NODISCARD Optional<TaskFunction>
+NonBlockingPriorityWorkQueue<ThreadingEnvironment>::NextTask(Queue* queue) {
+  return queue->PopFront();
+}
+
+template <typename ThreadingEnvironment>
+LLVM_NODISCARD Optional<TaskFunction>
+NonBlockingPriorityWorkQueue<ThreadingEnvironment>::Steal(Queue* queue) {
+  return queue->PopBack();
+}
+
+template <typename ThreadingEnvironment>
+LLVM_NODISCARD bool NonBlockingPriorityWorkQueue<ThreadingEnvironment>::Empty(
+    Queue* queue) {
+  return queue->Empty();
+}
+
+}  // namespace internal
+}  // namespace tfrt
+
+#endif  // TFRT_THIRD_PARTY_CONCURRENT_WORK_QUEUE_NON_BLOCKING_PRIORITY_WORK_QUEUE_H_
@@ -0,0 +1,27 @@
+// This Source Code Form is subject to the terms of the Mozilla
+// Public License v. 2.0. If a copy of the MPL was not distributed
+// with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//===- task_priority_deque.cc -----------------------------------*- C++ -*-===//
+//
+// TaskPriorityDeque definitions.
+//
+//===----------------------------------------------------------------------===//
+#include "task_priority_deque.h"
+
+namespace tfrt {
+namespace internal {
+
+constexpr std::array<TaskPriority, TaskPriorityDeque::kNumTaskPriorities>
+    TaskPriorityDeque::kTaskPriorities;
+constexpr std::array<uint64_t, TaskPriorityDeque::kNumTaskPriorities>
+    TaskPriorityDeque::kIndexShift;
+constexpr std::array<uint64_t, TaskPriorityDeque::kNumTaskPriorities>
+    TaskPriorityDeque::kIndexMasks;
+constexpr std::array<uint64_t, TaskPriorityDeque::kNumTaskPriorities>
+    TaskPriorityDeque::kIndexMasksExt;
+constexpr std::array<uint64_t, TaskPriorityDeque::kNumTaskPriorities>
+    TaskPriorityDeque::kIndexMaskCompl;
+
+}  // namespace internal
+}  // namespace tfrt
@@ -252,6 +252,9 @@ class WorkQueueBase {
   template <typename ThreadingEnvironment>
   friend class NonBlockingWorkQueue;
 
+  template <typename ThreadingEnvironment>
+  friend class NonBlockingPriorityWorkQueue;
+
   struct PerThread {
     constexpr PerThread() : parent(nullptr), rng(0), thread_id(-1) {}
     Derived* parent;
@@ -62,7 +62,9 @@ static llvm::cl::opt<tfrt::HostAllocatorType> cl_host_allocator_type(  // NOLINT
         clEnumValN(tfrt::HostAllocatorType::kProfiledMalloc,
                    "profiled_allocator", "Malloc with metric profiling."),
         clEnumValN(tfrt::HostAllocatorType::kLeakCheckMalloc,
-                   "leak_check_allocator", "Malloc with memory leak check.")),
+                   "leak_check_allocator", "Malloc with memory leak check."),
+        clEnumValN(tfrt::HostAllocatorType::kSlab, "slab_allocator",
+                   "Per-thread slab allocator with allocation statistics.")),
     llvm::cl::init(tfrt::HostAllocatorType::kLeakCheckMalloc));
 
 // Enable aggregate op handler types to be specified on the command line.
@@ -84,6 +86,13 @@ static llvm::cl::opt<bool> cl_print_error_code(  // NOLINT
     llvm::cl::desc("Print error code if there's any error."),
     llvm::cl::Optional, llvm::cl::ValueDisallowed);
 
+// Decode BEF functions lazily.
+static llvm::cl::opt<bool> cl_lazy_bef_open(  // NOLINT
+    "lazy_bef_open",
+    llvm::cl::desc("Decode BEF functions on their first execution instead of "
+                   "when the BEF file is opened."),
+    llvm::cl::Optional, llvm::cl::ValueDisallowed);
+
 //===----------------------------------------------------------------------===//
 // Driver main
 //===----------------------------------------------------------------------===//
@@ -100,6 +109,7 @@ int main(int argc, char** argv) {
   run_config.work_queue_type = cl_work_queue_type;
   run_config.host_allocator_type = cl_host_allocator_type;
   run_config.print_error_code = cl_print_error_code;
+  run_config.lazy_bef_open = cl_lazy_bef_open;
 
   llvm::Optional<tfrt::tracing::TracingRequester> tracing;
   if (cl_enable_tracing) tracing.emplace();